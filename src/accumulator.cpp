@@ -74,24 +74,74 @@ int RtAccum_t::GetPackedLen() const
 void RtAccum_t::Sort()
 {
 	TRACE_CONN ( "conn", "RtAccum_t::Sort" );
+	CSphTightVector<CSphWordHit> dSorted;
+	dSorted.Resize ( m_dAccum.GetLength() );
+	if ( sphSortHits ( m_dAccum.Begin(), dSorted.Begin(), m_dAccum.GetLength() )!=m_dAccum.Begin() )
+		m_dAccum.SwapData ( dSorted );
+
 	if ( !m_bKeywordDict )
-		m_dAccum.Sort ( Lesser ( [] ( const CSphWordHit& a, const CSphWordHit& b )
-		{
-			return 	( a.m_uWordID<b.m_uWordID ) ||
-				( a.m_uWordID==b.m_uWordID && a.m_tRowID<b.m_tRowID ) ||
-				( a.m_uWordID==b.m_uWordID && a.m_tRowID==b.m_tRowID && HITMAN::GetPosWithField ( a.m_uWordPos )<HITMAN::GetPosWithField ( b.m_uWordPos ) );
-		}));
-	else
+		return;
+
+	// with keywords dict word ids are offsets of packed keywords, so now hits of every keyword go together,
+	// and these runs have to be put in keywords order
+	assert ( m_pDictRt );
+	const BYTE* pPackedKeywords = GetPackedKeywords();
+	auto fnCmpKeywords = [pPackedKeywords] ( SphWordID_t uA, SphWordID_t uB )
+	{
+		const BYTE* pPackedA = pPackedKeywords + uA;
+		const BYTE* pPackedB = pPackedKeywords + uB;
+		return sphDictCmpStrictly ( (const char*)pPackedA + 1, *pPackedA, (const char*)pPackedB + 1, *pPackedB );
+	};
+
+	struct KeywordHits_t
+	{
+		SphWordID_t m_uWordID;
+		int			m_iStart;
+		int			m_iHits;
+	};
+
+	CSphVector<KeywordHits_t> dKeywords;
+	bool bOrdered = true;
+	ARRAY_FOREACH ( i, m_dAccum )
 	{
-		assert ( m_pDictRt );
-		m_dAccum.Sort ( Lesser ( [pPackedKeywords = GetPackedKeywords()] ( const CSphWordHit& a, const CSphWordHit& b )
+		if ( i && m_dAccum[i].m_uWordID==m_dAccum[i-1].m_uWordID )
 		{
-			const BYTE* pPackedA = pPackedKeywords + a.m_uWordID;
-			const BYTE* pPackedB = pPackedKeywords + b.m_uWordID;
-			int iCmp = sphDictCmpStrictly ( (const char*)pPackedA + 1, *pPackedA, (const char*)pPackedB + 1, *pPackedB );
-			return ( iCmp < 0 ) || ( iCmp == 0 && a.m_tRowID < b.m_tRowID ) || ( iCmp == 0 && a.m_tRowID == b.m_tRowID && HITMAN::GetPosWithField ( a.m_uWordPos ) < HITMAN::GetPosWithField ( b.m_uWordPos ) );
-		}));
+			dKeywords.Last().m_iHits++;
+			continue;
+		}
+
+		if ( i && bOrdered )
+			bOrdered = fnCmpKeywords ( m_dAccum[i-1].m_uWordID, m_dAccum[i].m_uWordID )<0;
+
+		dKeywords.Add ( { m_dAccum[i].m_uWordID, i, 1 } );
 	}
+
+	if ( bOrdered )
+		return;
+
+	dKeywords.Sort ( Lesser ( [&fnCmpKeywords] ( const KeywordHits_t& a, const KeywordHits_t& b ) { return fnCmpKeywords ( a.m_uWordID, b.m_uWordID )<0; } ) );
+
+	// same keyword under different offsets; these hits have to be interleaved by rowid and position
+	for ( int i = 1; i<dKeywords.GetLength(); ++i )
+		if ( !fnCmpKeywords ( dKeywords[i-1].m_uWordID, dKeywords[i].m_uWordID ) )
+		{
+			m_dAccum.Sort ( Lesser ( [&fnCmpKeywords] ( const CSphWordHit& a, const CSphWordHit& b )
+			{
+				int iCmp = fnCmpKeywords ( a.m_uWordID, b.m_uWordID );
+				return ( iCmp < 0 ) || ( iCmp == 0 && a.m_tRowID < b.m_tRowID ) || ( iCmp == 0 && a.m_tRowID == b.m_tRowID && HITMAN::GetPosWithField ( a.m_uWordPos ) < HITMAN::GetPosWithField ( b.m_uWordPos ) );
+			}));
+			return;
+		}
+
+	dSorted.Resize ( m_dAccum.GetLength() );
+	CSphWordHit* pOut = dSorted.Begin();
+	for ( const auto& tKeyword : dKeywords )
+	{
+		memcpy ( pOut, m_dAccum.Begin() + tKeyword.m_iStart, tKeyword.m_iHits * sizeof ( CSphWordHit ) );
+		pOut += tKeyword.m_iHits;
+	}
+
+	m_dAccum.SwapData ( dSorted );
 }
 
 void RtAccum_t::CleanupPart()
@@ -873,6 +873,25 @@ const char * sphGetBlobLocatorName()
 	return BLOB_LOCATOR_ATTR;
 }
 
+
+const char * sphGetJsonMaskName()
+{
+	static const char * JSON_MASK_ATTR = "$_json_mask";
+	return JSON_MASK_ATTR;
+}
+
+
+bool sphIsJsonColumnAttr ( const CSphString & sAttrName )
+{
+	return sAttrName.Begins ( "$_json" );
+}
+
+
+bool sphIsJsonTypedColumnAttr ( const CSphString & sAttrName )
+{
+	return sphIsJsonColumnAttr ( sAttrName ) && sAttrName!=sphGetJsonMaskName();
+}
+
 static const CSphString g_sDocidName { "id" };
 
 const char * sphGetDocidName()
@@ -1025,7 +1044,7 @@ static void MVA2Str ( const T * pMVA, int iLengthBytes, StringBuilder_c &dStr )
 
 bool sphIsInternalAttr ( const CSphString & sAttrName )
 {
-	return sAttrName==sphGetBlobLocatorName();
+	return sAttrName==sphGetBlobLocatorName() || sphIsJsonColumnAttr ( sAttrName );
 }
 
 
@@ -80,6 +80,15 @@ bool				sphCheckBlobRow ( int64_t iOff, DebugCheckReader_i & tBlobs, const CSphS
 // return blob locator attribute name
 const char *		sphGetBlobLocatorName();
 
+// return json_columns presence mask attribute name
+const char *		sphGetJsonMaskName();
+
+// returns true if this is a hidden json_columns attribute (a typed column or the mask)
+bool				sphIsJsonColumnAttr ( const CSphString & sAttrName );
+
+// returns true if this is a typed json_columns copy (unlike other internal attributes, these get histograms and secondary indexes)
+bool				sphIsJsonTypedColumnAttr ( const CSphString & sAttrName );
+
 // current docid attribute name
 const char *		sphGetDocidName();
 const CSphString &	sphGetDocidStr();
@@ -14,6 +14,7 @@
 #include "sphinxsearch.h"
 #include "sphinxpq.h"
 #include "accumulator.h"
+#include "coroutine.h"
 
 #define BINLOG_WRITE_BUFFER		(256*1024)
 #define BINLOG_AUTO_FLUSH		1000000 // 1 sec
@@ -59,6 +60,9 @@ public:
 
 	bool			Write ( bool bRemoveUnsuccessful = true );
 	bool			Fsync();
+
+	void			SwapBuffer ( CSphVector<BYTE> & dBuf );
+	bool			WriteAndSync ( const CSphVector<BYTE> & dBuf );
 	int64_t			GetPos() const				{ return m_iFilePos; }
 
 	bool			OpenFile ( const CSphString & sFile, CSphString & sError );
@@ -117,6 +121,7 @@ public:
 
 	bool	IsActive () const { return !m_bDisabled; }
 	bool 	MockDisabled ( bool bNewVal );
+	Binlog::FnMockSync MockGroupSync ( Binlog::FnMockSync fnMock );
 	void	CheckPath ( const CSphConfigSection & hSearchd, bool bTestMode );
 
 	bool	IsFlushingEnabled() const;
@@ -139,6 +144,23 @@ private:
 
 	CSphMutex				m_tWriteLock; // lock on operation
 
+	// group commit (binlog_flush=1): committers serialize under m_tWriteLock and then wait on m_tSyncLock;
+	// whoever gets it first writes and fsyncs everything queued so far in one go, the rest find their txn already synced
+	struct FailedBatch_t
+	{
+		int64_t		m_iFrom = 0;
+		int64_t		m_iTo = 0;
+		int64_t		m_iPending = 0;	// committers of this batch that haven't picked up the error yet
+		CSphString	m_sError;
+	};
+
+	CSphMutex				m_tSyncLock;
+	int64_t					m_iQueuedTxn GUARDED_BY ( m_tWriteLock ) = 0;	// txns serialized into the writer buffer
+	int64_t					m_iSyncedTxn GUARDED_BY ( m_tSyncLock ) = 0;	// txns written and synced (or failed)
+	CSphVector<BYTE>		m_dSyncBuf GUARDED_BY ( m_tSyncLock );			// batch being written
+	CSphVector<FailedBatch_t> m_dFailedBatches GUARDED_BY ( m_tSyncLock );
+	Binlog::FnMockSync		m_fnMockSync GUARDED_BY ( m_tSyncLock );
+
 	int						m_iLockFD = -1;
 	CSphString				m_sWriterError;
 	BinlogWriter_c			m_tWriter;
@@ -162,13 +184,20 @@ private:
 	void					SaveMeta ();
 	void					LockFile ( bool bLock );
 	void					DoCacheWrite ();
+	bool					NeedRestart() const;
 	void					CheckDoRestart ();
 	bool					CheckDoFlush();
+	bool					GroupCommit ( int64_t iTxn, CSphString & sError );
+	bool					GetBatchResult ( int64_t iTxn, CSphString & sError );
+	void					AddFailedBatch ( int64_t iFrom, int64_t iTo, int64_t iPending, const CSphString & sError );
 	void					OpenNewLog ( int iLastState=0 );
 
-	int						ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int iBinlog );
-	bool					ReplayTxn ( Binlog::Blop_e eOp, int iBinlog, BinlogReader_c & tReader ) const;
-	bool					ReplayUpdateAttributes ( int iBinlog, BinlogReader_c & tReader ) const;
+	int						ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int iBinlog, ProgressCallbackSimple_t * pfnProgressCallback );
+	bool					ReplayOp ( Binlog::Blop_e eOp, BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const;
+	bool					SkipOp ( Binlog::Blop_e eOp, const BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const;
+	bool					ReplayTxn ( Binlog::Blop_e eOp, BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const;
+	bool					ReplayUpdateAttributes ( BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const;
+	void					ReplayJobs ( int iBinlog, CSphVector<ReplayJob_t> & dJobs, int * pTotal, int64_t & iFailedPos, ProgressCallbackSimple_t * pfnProgressCallback ) const;
 	bool					ReplayIndexAdd ( int iBinlog, const SmallStringHash_T<CSphIndex*> & hIndexes, BinlogReader_c & tReader ) const;
 	bool					ReplayCacheAdd ( int iBinlog, DWORD uVersion, BinlogReader_c & tReader ) const;
 	bool 					IsBinlogWritable ( int64_t * pTID = nullptr );
@@ -329,6 +358,46 @@ bool BinlogWriter_c::Fsync()
 }
 
 
+/// takes out all complete transactions collected so far; must be called between transactions
+void BinlogWriter_c::SwapBuffer ( CSphVector<BYTE> & dBuf )
+{
+	assert ( m_iLastCrcPos==m_dBuf.GetLength() );
+	dBuf.Resize(0);
+	m_dBuf.SwapData(dBuf);
+	m_iLastCrcPos = 0;
+	m_iTransactionStartPos = 0;
+}
+
+/// writes a buffer taken out with SwapBuffer and syncs the file; the only writer of the file while it runs
+bool BinlogWriter_c::WriteAndSync ( const CSphVector<BYTE> & dBuf )
+{
+	if ( dBuf.GetLength() )
+	{
+		if ( !sphWriteThrottled ( m_tFile.GetFD(), dBuf.Begin(), dBuf.GetLength(), m_tFile.GetFilename(), m_sError ) )
+		{
+			// whole batch failed; clamp the file at the end of the last written batch
+			sphSeek ( m_tFile.GetFD(), m_iFilePos, SEEK_SET );
+			sphTruncate ( m_tFile.GetFD() );
+			return false;
+		}
+
+		m_iFilePos += dBuf.GetLength();
+	}
+
+	if ( !HasUnsyncedData() )
+		return true;
+
+	if ( fsync ( m_tFile.GetFD() )!=0 )
+	{
+		m_sError.SetSprintf ( "failed to sync %s: %s" , m_tFile.GetFilename(), strerrorm(errno) );
+		return false;
+	}
+
+	m_iLastFsyncPos = m_iFilePos;
+	return true;
+}
+
+
 bool BinlogWriter_c::OpenFile ( const CSphString & sFile, CSphString & sError )
 {
 	m_iFilePos = 0;
@@ -449,6 +518,9 @@ void Binlog_c::NotifyIndexFlush ( int64_t iTID, IndexNameUid_t tIndexName, bool
 	MEMORY ( MEM_BINLOG );
 	assert ( bShutdown || m_dLogFiles.GetLength() );
 
+	// called from disk chunk saves and merges; binlog I/O under the locks must not wait for their I/O budgets
+	ScopedIOClass_c tIOClass ( IOClass_e::QUERY );
+	ScopedMutex_t tSyncLock ( m_tSyncLock ); // no group commit batch may be in flight to a file we close
 	ScopedMutex_t tWriteLock ( m_tWriteLock );
 
 	bool bCurrentLogAbandoned = false;
@@ -557,7 +629,7 @@ void Binlog_c::Replay ( const SmallStringHash_T<CSphIndex*> & hIndexes, Progress
 	int iLastLogState = 0;
 	ARRAY_FOREACH ( i, m_dLogFiles )
 	{
-		iLastLogState = ReplayBinlog ( hIndexes, i );
+		iLastLogState = ReplayBinlog ( hIndexes, i, pfnProgressCallback );
 		if ( pfnProgressCallback ) // on each replayed binlog
 			pfnProgressCallback();
 	}
@@ -827,10 +899,15 @@ void Binlog_c::DoCacheWrite ()
 	}
 }
 
+bool Binlog_c::NeedRestart() const
+{
+	return m_iRestartSize>0 && m_tWriter.GetPos()>m_iRestartSize;
+}
+
 void Binlog_c::CheckDoRestart ()
 {
 	// restart on exceed file size limit
-	if ( m_iRestartSize>0 && m_tWriter.GetPos()>m_iRestartSize )
+	if ( NeedRestart() )
 	{
 		MEMORY ( MEM_BINLOG );
 
@@ -870,7 +947,21 @@ bool Binlog_c::CheckDoFlush()
 	return true;
 }
 
-int Binlog_c::ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int iBinlog )
+static const char* OpName ( Binlog::Blop_e eOp)
+{
+	switch (eOp)
+	{
+		case Binlog::COMMIT: return "commit";
+		case Binlog::UPDATE_ATTRS: return "update";
+		case Binlog::RECONFIGURE: return "reconfigure";
+		case Binlog::PQ_ADD: return "pq-add";
+		case Binlog::PQ_DELETE: return "pq-delete";
+		case Binlog::PQ_ADD_DELETE: return "pq-add-delete";
+		default: return "other";
+	}
+}
+
+int Binlog_c::ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int iBinlog, ProgressCallbackSimple_t * pfnProgressCallback )
 {
 	assert ( iBinlog>=0 && iBinlog<m_dLogFiles.GetLength() );
 	CSphString sError;
@@ -923,6 +1014,12 @@ int Binlog_c::ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int
 	bool bReplayOK = true;
 	bool bHaveCacheOp = false;
 	int64_t iPos = -1;
+	int64_t iFailedPos = -1;
+
+	// with more than one worker thread the log is only parsed and checksummed here, and ops of served tables are queued;
+	// queued ops are then applied per table in parallel (each table keeps its own TID order), before the cache check and at the end
+	const bool bParallel = Threads::NThreads()>1;
+	CSphVector<ReplayJob_t> dJobs;
 
 	int64_t tmReplay = sphMicroTimer();
 
@@ -967,20 +1064,50 @@ int Binlog_c::ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int
 					break;
 				}
 				bHaveCacheOp = true;
+				// cache is verified against replayed tid ranges, so everything queued must be applied first
+				ReplayJobs ( iBinlog, dJobs, dTotal, iFailedPos, pfnProgressCallback );
 				bReplayOK = ReplayCacheAdd ( iBinlog, uVersion, tReader );
 				break;
 
 			case UPDATE_ATTRS:
-				bReplayOK = ReplayUpdateAttributes ( iBinlog, tReader );
-				break;
-
 			case COMMIT:
 			case RECONFIGURE:
 			case PQ_ADD:
 			case PQ_DELETE:
 			case PQ_ADD_DELETE:
-				bReplayOK = ReplayTxn ( Binlog::Blop_e(uOp), iBinlog, tReader );
-				break;
+			{
+				auto eOp = Binlog::Blop_e ( uOp );
+				const int64_t iTxnPos = tReader.GetPos();
+				int iIdx = ReplayIndexID ( tReader, tLog, OpName ( eOp ) );
+				if ( iIdx==-1 )
+				{
+					bReplayOK = false;
+					break;
+				}
+
+				BinlogIndexInfo_t & tIndex = tLog.m_dIndexInfos[iIdx];
+				if ( !bParallel || !tIndex.m_pIndex )
+				{
+					bReplayOK = ReplayOp ( eOp, tIndex, iTxnPos, tReader );
+					break;
+				}
+
+				bReplayOK = SkipOp ( eOp, tIndex, iTxnPos, tReader );
+				if ( !bReplayOK )
+					break;
+
+				// same index could be logged under several ids (different gens); keep all its ops in one job
+				auto * pJob = dJobs.begin();
+				for ( ; pJob!=dJobs.end() && pJob->m_pIndex!=tIndex.m_pIndex; ++pJob );
+				if ( pJob==dJobs.end() )
+				{
+					pJob = &dJobs.Add();
+					pJob->m_pIndex = tIndex.m_pIndex;
+				}
+				pJob->m_dOps.Add ( { iPos, iIdx, eOp } );
+				++dTotal [ TOTAL ];
+				continue; // op itself is counted when applied
+			}
 
 			default:
 				Log ( REPLAY_IGNORE_TRX_ERROR, "binlog: internal error, unhandled entry (blop=%d)", (int)uOp );
@@ -992,6 +1119,9 @@ int Binlog_c::ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int
 		++dTotal [ TOTAL ];
 	}
 
+	// whatever was queued before the end (or before an error) is still good to apply
+	ReplayJobs ( iBinlog, dJobs, dTotal, iFailedPos, pfnProgressCallback );
+
 	tmReplay = sphMicroTimer() - tmReplay;
 
 	if ( tReader.GetErrorFlag() )
@@ -1000,6 +1130,9 @@ int Binlog_c::ReplayBinlog ( const SmallStringHash_T<CSphIndex*> & hIndexes, int
 	if ( !bReplayOK )
 		sphWarning ( "binlog: replay error at pos=" INT64_FMT , iPos );
 
+	if ( iFailedPos>=0 )
+		sphWarning ( "binlog: replay error at pos=" INT64_FMT , iFailedPos );
+
 	// show additional replay statistics
 	for ( const auto& tIndex : tLog.m_dIndexInfos )
 	{
@@ -1174,31 +1307,165 @@ CSphString Binlog_c::GetLogPath() const
 	return m_sLogPath;
 }
 
-static const char* OpName ( Binlog::Blop_e eOp)
+static bool LoadUpdate ( CSphAttrUpdate & tUpd, BinlogReader_c & tReader )
 {
-	switch (eOp)
+	int iAttrs = (int)tReader.UnzipOffset();
+	tUpd.m_dAttributes.Resize ( iAttrs ); // FIXME! sanity check
+	for ( auto & i : tUpd.m_dAttributes )
 	{
-		case Binlog::COMMIT: return "commit";
-		case Binlog::RECONFIGURE: return "reconfigure";
-		case Binlog::PQ_ADD: return "pq-add";
-		case Binlog::PQ_DELETE: return "pq-delete";
-		case Binlog::PQ_ADD_DELETE: return "pq-add-delete";
-		default: return "other";
+		i.m_sName = tReader.GetString();
+		i.m_eType = (ESphAttr) tReader.UnzipOffset(); // safe, we'll crc check later
+	}
+
+	if ( tReader.GetErrorFlag() ) return false;
+
+	if ( !Binlog::LoadVector ( tReader, tUpd.m_dPool ) ) return false;
+	if ( !Binlog::LoadVector ( tReader, tUpd.m_dDocids ) ) return false;
+	if ( !Binlog::LoadVector ( tReader, tUpd.m_dRowOffset ) ) return false;
+	if ( !Binlog::LoadVector ( tReader, tUpd.m_dBlobs ) ) return false;
+	return true;
+}
+
+bool Binlog_c::ReplayOp ( Binlog::Blop_e eOp, BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const
+{
+	if ( eOp==UPDATE_ATTRS )
+		return ReplayUpdateAttributes ( tIndex, iTxnPos, tReader );
+	return ReplayTxn ( eOp, tIndex, iTxnPos, tReader );
+}
+
+// parse op payload and verify its checksum, but apply nothing; used by the sequential pass of parallel replay
+bool Binlog_c::SkipOp ( Binlog::Blop_e eOp, const BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const
+{
+	assert ( tIndex.m_pIndex );
+	auto iTID = (int64_t) tReader.UnzipOffset();
+	tReader.UnzipOffset(); // time
+
+	if ( eOp==UPDATE_ATTRS )
+	{
+		CSphAttrUpdate tUpd;
+		return LoadUpdate ( tUpd, tReader ) && CheckCrc ( OpName ( eOp ), tIndex.m_sName, iTID, iTxnPos, tReader );
 	}
+
+	CSphString sError;
+	CheckTnxResult_t tParsed = tIndex.m_pIndex->ReplayTxn ( eOp, tReader, sError, [ eOp, iTID, iTxnPos, &tReader, &tIndex ] () {
+		CheckTnxResult_t tRes;
+		tRes.m_bValid = CheckCrc ( OpName ( eOp ), tIndex.m_sName, iTID, iTxnPos, tReader );
+		return tRes;
+	});
+
+	if ( !tParsed.m_bValid )
+	{
+		Log ( REPLAY_IGNORE_TRX_ERROR, "binlog: %s (table=%s, logtid=" INT64_FMT ", pos=" INT64_FMT ", error=%s)",
+			OpName ( eOp ), tIndex.m_sName.cstr(), iTID, iTxnPos, sError.cstr() );
+		return false;
+	}
+
+	return true;
 }
 
-// dedicated function for replay attribute update
-bool Binlog_c::ReplayUpdateAttributes ( int iBinlog, BinlogReader_c & tReader ) const
+// apply queued ops; every table is replayed by a single worker, so its TID order and its BinlogIndexInfo_t stay private to that worker
+void Binlog_c::ReplayJobs ( int iBinlog, CSphVector<ReplayJob_t> & dJobs, int * pTotal, int64_t & iFailedPos, ProgressCallbackSimple_t * pfnProgressCallback ) const
 {
-	// load and lookup index
-	const int64_t iTxnPos = tReader.GetPos();
+	if ( dJobs.IsEmpty() )
+		return;
+
 	BinlogFileDesc_t & tLog = m_dLogFiles[iBinlog];
-	
-	int iIdx = ReplayIndexID ( tReader, tLog, "update" );
-	if ( iIdx==-1 )
-		return false;
-	BinlogIndexInfo_t & tIndex = tLog.m_dIndexInfos[iIdx];
+	const CSphString sLog ( MakeBinlogName ( m_sLogPath.cstr(), tLog.m_iExt ) );
 
+	// every job reads the log with its own reader; readers are opened on the first op
+	CSphVector<std::unique_ptr<BinlogReader_c>> dReaders ( dJobs.GetLength() );
+	CSphMutex tProgressLock;
+	int64_t iStopPos = ApplyReplayJobs ( dJobs, Threads::NThreads(), [&] ( int iJob, int iOp )
+	{
+		auto & pReader = dReaders[iJob];
+		if ( !pReader )
+		{
+			CSphString sError;
+			pReader = std::make_unique<BinlogReader_c>();
+			if ( !pReader->Open ( sLog, sError ) )
+			{
+				Log ( REPLAY_IGNORE_OPEN_ERROR, "binlog: log open error: %s", sError.cstr() );
+				return false;
+			}
+		}
+
+		BinlogReader_c & tReader = *pReader;
+		const ReplayOp_t & tOp = dJobs[iJob].m_dOps[iOp];
+		tReader.SeekTo ( tOp.m_iBlopPos, 0 );
+		tReader.GetDword(); // magic, checked by sequential pass
+		tReader.ResetCrc();
+		tReader.UnzipOffset(); // op
+		const int64_t iTxnPos = tReader.GetPos();
+		tReader.UnzipOffset(); // index id
+
+		// infos of other tables are not touched here, and the list itself is not resized until all jobs are done
+		return !tReader.GetErrorFlag() && ReplayOp ( tOp.m_eOp, tLog.m_dIndexInfos[tOp.m_iIdx], iTxnPos, tReader );
+	},
+	[&] ( int )
+	{
+		if ( pfnProgressCallback ) // on each replayed table
+		{
+			ScopedMutex_t tLock ( tProgressLock );
+			pfnProgressCallback();
+		}
+	});
+
+	for ( const auto & tJob : dJobs )
+	{
+		for ( int i = 0; i<tJob.m_iReplayed; ++i )
+			++pTotal [ tJob.m_dOps[i].m_eOp ];
+
+		if ( tJob.m_iReplayed<tJob.m_dOps.GetLength() )
+			sphWarning ( "binlog: table %s: replay stopped after %d of %d ops", tJob.m_pIndex->GetName(), tJob.m_iReplayed, tJob.m_dOps.GetLength() );
+	}
+
+	if ( iStopPos>=0 )
+		iFailedPos = iFailedPos<0 ? iStopPos : Min ( iFailedPos, iStopPos );
+
+	dJobs.Reset();
+}
+
+int64_t Binlog::ApplyReplayJobs ( VecTraits_T<ReplayJob_t> & dJobs, int iThreads, const std::function<bool ( int, int )> & fnApply, const std::function<void ( int )> & fnJobDone )
+{
+	const int iJobs = dJobs.GetLength();
+	if ( !iJobs )
+		return -1;
+
+	std::atomic<int> iNextJob { 0 };
+	std::atomic<int64_t> iStopPos { INT64_MAX };
+	Threads::Coro::ExecuteN ( Max ( Min ( iJobs, iThreads ), 1 ), [&]
+	{
+		for ( int iJob = iNextJob.fetch_add ( 1, std::memory_order_relaxed ); iJob<iJobs; iJob = iNextJob.fetch_add ( 1, std::memory_order_relaxed ) )
+		{
+			ReplayJob_t & tJob = dJobs[iJob];
+			for ( const auto & tOp : tJob.m_dOps )
+			{
+				// a failed op stops the replay at its position for every table, as the sequential replay does
+				if ( tOp.m_iBlopPos>iStopPos.load ( std::memory_order_relaxed ) )
+					break;
+
+				if ( !fnApply ( iJob, tJob.m_iReplayed ) )
+				{
+					int64_t iStop = iStopPos.load ( std::memory_order_relaxed );
+					while ( tOp.m_iBlopPos<iStop && !iStopPos.compare_exchange_weak ( iStop, tOp.m_iBlopPos, std::memory_order_relaxed ) );
+					break;
+				}
+
+				++tJob.m_iReplayed;
+			}
+
+			if ( fnJobDone )
+				fnJobDone ( iJob );
+		}
+	});
+
+	int64_t iStop = iStopPos.load ( std::memory_order_relaxed );
+	return iStop==INT64_MAX ? -1 : iStop;
+}
+
+// dedicated function for replay attribute update
+bool Binlog_c::ReplayUpdateAttributes ( BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const
+{
 	auto iTID = (int64_t) tReader.UnzipOffset();
 	auto tmStamp = (int64_t) tReader.UnzipOffset();
 
@@ -1207,20 +1474,8 @@ bool Binlog_c::ReplayUpdateAttributes ( int iBinlog, BinlogReader_c & tReader )
 	auto& tUpd = *pUpd;
 	tUpd.m_bIgnoreNonexistent = true;
 
-	int iAttrs = (int)tReader.UnzipOffset();
-	tUpd.m_dAttributes.Resize ( iAttrs ); // FIXME! sanity check
-	for ( auto & i : tUpd.m_dAttributes )
-	{
-		i.m_sName = tReader.GetString();
-		i.m_eType = (ESphAttr) tReader.UnzipOffset(); // safe, we'll crc check later
-	}
-
-	if ( tReader.GetErrorFlag() ) return false;
-
-	if ( !Binlog::LoadVector ( tReader, tUpd.m_dPool ) ) return false;
-	if ( !Binlog::LoadVector ( tReader, tUpd.m_dDocids ) ) return false;
-	if ( !Binlog::LoadVector ( tReader, tUpd.m_dRowOffset ) ) return false;
-	if ( !Binlog::LoadVector ( tReader, tUpd.m_dBlobs ) ) return false;
+	if ( !LoadUpdate ( tUpd, tReader ) )
+		return false;
 
 	if (!PerformChecks ( "update", tIndex, iTID, iTxnPos, tmStamp, tReader ))
 		return false;
@@ -1247,18 +1502,8 @@ bool Binlog_c::ReplayUpdateAttributes ( int iBinlog, BinlogReader_c & tReader )
 	return true;
 }
 
-bool Binlog_c::ReplayTxn ( Binlog::Blop_e eOp, int iBinlog, BinlogReader_c & tReader ) const
+bool Binlog_c::ReplayTxn ( Binlog::Blop_e eOp, BinlogIndexInfo_t & tIndex, int64_t iTxnPos, BinlogReader_c & tReader ) const
 {
-	// load and lookup index
-	const int64_t iTxnPos = tReader.GetPos();
-	BinlogFileDesc_t & tLog = m_dLogFiles[iBinlog];
-
-	int iIdx = ReplayIndexID ( tReader, tLog, OpName (eOp) );
-	if ( iIdx==-1 )
-		return false;
-
-	BinlogIndexInfo_t & tIndex = tLog.m_dIndexInfos[iIdx];
-
 	// load transaction data
 	auto iTID = (int64_t) tReader.UnzipOffset();
 	auto tmStamp = (int64_t) tReader.UnzipOffset();
@@ -1325,6 +1570,12 @@ bool Binlog_c::MockDisabled ( bool bNewVal )
 	return std::exchange ( m_bDisabled, bNewVal );
 }
 
+Binlog::FnMockSync Binlog_c::MockGroupSync ( Binlog::FnMockSync fnMock )
+{
+	ScopedMutex_t tSyncLock ( m_tSyncLock );
+	return std::exchange ( m_fnMockSync, std::move ( fnMock ) );
+}
+
 bool Binlog_c::CheckCrc ( const char * sOp, const CSphString & sIndex, int64_t iTID, int64_t iTxnPos, BinlogReader_c & tReader )
 {
 	return !tReader.GetErrorFlag() && tReader.CheckCrc ( sOp, sIndex.cstr(), iTID, iTxnPos );
@@ -1414,36 +1665,139 @@ bool Binlog_c::BinlogCommit ( Blop_e eOp, int64_t * pTID, IndexNameUid_t tIndexN
 		return true;
 
 	MEMORY ( MEM_BINLOG );
-	ScopedMutex_t tWriteLock ( m_tWriteLock );
+	ScopedIOClass_c tIOClass ( IOClass_e::QUERY );
+	int64_t iTxn = 0;
+	{
+		ScopedMutex_t tWriteLock ( m_tWriteLock );
+
+		int64_t iTID = ++(*pTID);
+		const int64_t tmNow = sphMicroTimer();
+		const int uIndex = GetWriteIndexID ( tIndexName, iTID, tmNow );
+
+		{
+			BinlogTransactionGuard_c tGuard ( m_tWriter, m_eOnCommit==ACTION_NONE );
+
+			// header
+			m_tWriter.ZipOffset ( eOp );
+			m_tWriter.ZipOffset ( uIndex );
+			m_tWriter.ZipOffset ( iTID );
+			m_tWriter.ZipOffset ( tmNow );
+
+			// save txn data
+			fnSaver ( m_tWriter );
+		}
+
+		if ( m_eOnCommit!=ACTION_FSYNC )
+		{
+			// finalize
+			if ( !CheckDoFlush() )
+			{
+				sError.SetSprintf ( "unable to write to binlog: %s", m_tWriter.GetError().cstr() );
+				return false;
+			}
+
+			CheckDoRestart();
+			return true;
+		}
+
+		iTxn = ++m_iQueuedTxn;
+	}
+
+	// fsync is done outside of the write lock, so that other committers can queue their txns meanwhile
+	return GroupCommit ( iTxn, sError );
+}
+
+
+bool Binlog_c::GroupCommit ( int64_t iTxn, CSphString & sError )
+{
+	ScopedMutex_t tSyncLock ( m_tSyncLock );
+
+	// somebody already wrote and synced a batch that included our txn
+	if ( iTxn<=m_iSyncedTxn )
+		return GetBatchResult ( iTxn, sError );
+
+	// we lead the next batch: everything queued by now
+	int64_t iFrom = m_iSyncedTxn+1;
+	int64_t iTo;
+	{
+		ScopedMutex_t tWriteLock ( m_tWriteLock );
+		m_tWriter.SwapBuffer ( m_dSyncBuf );
+		iTo = m_iQueuedTxn;
+	}
+
+	assert ( iTxn>=iFrom && iTxn<=iTo );
+	CSphString sSyncError;
+	bool bOk = !m_fnMockSync || m_fnMockSync ( int ( iTo-iFrom+1 ), sSyncError );
+	if ( bOk )
+	{
+		bOk = m_tWriter.WriteAndSync ( m_dSyncBuf );
+		if ( !bOk )
+			sSyncError = m_tWriter.GetError();
+	}
 
-	int64_t iTID = ++(*pTID);
-	const int64_t tmNow = sphMicroTimer();
-	const int uIndex = GetWriteIndexID ( tIndexName, iTID, tmNow );
+	m_dSyncBuf.Resize(0);
+	m_iSyncedTxn = iTo;
 
+	if ( !bOk )
 	{
-		BinlogTransactionGuard_c tGuard ( m_tWriter, m_eOnCommit==ACTION_NONE );
+		sError.SetSprintf ( "unable to write to binlog: %s", sSyncError.cstr() );
+		AddFailedBatch ( iFrom, iTo, iTo-iFrom, sError );
+	}
 
-		// header
-		m_tWriter.ZipOffset ( eOp );
-		m_tWriter.ZipOffset ( uIndex );
-		m_tWriter.ZipOffset ( iTID );
-		m_tWriter.ZipOffset ( tmNow );
+	// rotate with the sync lock held, so that no batch is in flight to the file being closed
+	ScopedMutex_t tWriteLock ( m_tWriteLock );
+	if ( NeedRestart() )
+	{
+		// txns queued while we were syncing have to reach the old file before it is closed
+		int64_t iQueued = m_iQueuedTxn;
+		DoCacheWrite();
+		if ( !m_tWriter.Fsync() && iQueued>m_iSyncedTxn )
+		{
+			CSphString sFsyncError;
+			sFsyncError.SetSprintf ( "unable to write to binlog: %s", m_tWriter.GetError().cstr() );
+			AddFailedBatch ( m_iSyncedTxn+1, iQueued, iQueued-m_iSyncedTxn, sFsyncError );
+		}
 
-		// save txn data
-		fnSaver ( m_tWriter );
+		m_iSyncedTxn = iQueued;
+		m_tWriter.CloseFile();
+		OpenNewLog();
 	}
 
-	// finalize
-	if ( !CheckDoFlush() )
+	return bOk;
+}
+
+
+bool Binlog_c::GetBatchResult ( int64_t iTxn, CSphString & sError )
+{
+	ARRAY_FOREACH ( i, m_dFailedBatches )
 	{
-		sError.SetSprintf ( "unable to write to binlog: %s", m_tWriter.GetError().cstr() );
+		auto & tBatch = m_dFailedBatches[i];
+		if ( iTxn<tBatch.m_iFrom || iTxn>tBatch.m_iTo )
+			continue;
+
+		sError = tBatch.m_sError;
+		if ( !--tBatch.m_iPending )
+			m_dFailedBatches.RemoveFast(i);
+
 		return false;
 	}
 
-	CheckDoRestart();
 	return true;
 }
 
+
+void Binlog_c::AddFailedBatch ( int64_t iFrom, int64_t iTo, int64_t iPending, const CSphString & sError )
+{
+	if ( !iPending )
+		return;
+
+	auto & tBatch = m_dFailedBatches.Add();
+	tBatch.m_iFrom = iFrom;
+	tBatch.m_iTo = iTo;
+	tBatch.m_iPending = iPending;
+	tBatch.m_sError = sError;
+}
+
 static auto & g_bRTChangesAllowed = RTChangesAllowed();
 
 void Binlog::Init ( const CSphConfigSection & hSearchd, bool bTestMode )
@@ -1516,6 +1870,13 @@ bool Binlog::MockDisabled ( bool bNewVal )
 	return bNewVal;
 }
 
+Binlog::FnMockSync Binlog::MockGroupSync ( FnMockSync fnMock )
+{
+	if ( g_pRtBinlog )
+		return g_pRtBinlog->MockGroupSync ( std::move ( fnMock ) );
+	return nullptr;
+}
+
 bool Binlog::Commit ( Blop_e eOp, int64_t * pTID, IndexNameUid_t tIndexName, bool bIncTID, CSphString & sError, FnWriteCommit && fnSaver )
 {
 	if ( !g_pRtBinlog )
@@ -55,6 +55,11 @@ namespace Binlog {
 	bool IsActive();
 	bool MockDisabled ( bool bNewVal );
 
+	/// testing only: called by the leader of each group commit (binlog_flush=1) with the number of txns in its batch,
+	/// before the batch is written and synced; returning false fails the whole batch with sError. Returns the previous hook.
+	using FnMockSync = std::function<bool ( int iTxns, CSphString & sError )>;
+	FnMockSync MockGroupSync ( FnMockSync fnMock );
+
 	bool IsFlushEnabled();
 	void Flush();
 	int64_t NextFlushTimestamp();
@@ -67,6 +72,27 @@ namespace Binlog {
 	/// replay stored binlog
 	void Replay ( const SmallStringHash_T<CSphIndex*> & hIndexes, ProgressCallbackSimple_t * pfnProgressCallback = nullptr );
 
+	/// replay only; one logged op, found by the sequential pass and applied later by its table worker
+	struct ReplayOp_t
+	{
+		int64_t		m_iBlopPos = 0;			///< position of the blop magic
+		int			m_iIdx = 0;				///< index id within the log file
+		Blop_e		m_eOp = COMMIT;
+	};
+
+	/// replay only; all ops of one served table, in log (and so in TID) order
+	struct ReplayJob_t
+	{
+		CSphIndex *				m_pIndex = nullptr;
+		CSphVector<ReplayOp_t>	m_dOps;
+		int						m_iReplayed = 0;	///< ops applied before the replay stopped
+	};
+
+	/// replay only; applies the jobs in up to iThreads workers, ops of every job in their order, via fnApply ( iJob, iOp )
+	/// once an op fails, no job applies ops logged after it (ops that were already applied by then are kept)
+	/// returns the log position of the earliest failed op, or -1
+	int64_t ApplyReplayJobs ( VecTraits_T<ReplayJob_t> & dJobs, int iThreads, const std::function<bool ( int, int )> & fnApply, const std::function<void ( int )> & fnJobDone = nullptr );
+
 	// dedicated for Commit BLOP_UPDATE_ATTRS
 	void CommitUpdateAttributes ( int64_t * pTID, IndexNameUid_t tIndexName, const CSphAttrUpdate & tUpd );
 
@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2023, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include "compressed_http.h"
+#include "compressed_zstd_mysql.h"
+#include "sphinxutils.h"
+
+#if WITH_ZLIB
+#include <zlib.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// gzip
+
+#if WITH_ZLIB
+
+static bool IsGzipAvailable()
+{
+	return true;
+}
+
+class GzipEncoder_c final : public HttpEncoder_i
+{
+public:
+	GzipEncoder_c()
+	{
+		// 15 window bits +16 means gzip header and trailer instead of zlib ones
+		m_bInited = deflateInit2 ( &m_tStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY )==Z_OK;
+	}
+
+	~GzipEncoder_c() final
+	{
+		if ( m_bInited )
+			deflateEnd ( &m_tStream );
+	}
+
+	bool Encode ( ByteBlob_t tData, bool bFinish, CSphVector<BYTE> & dOut ) final
+	{
+		if ( !m_bInited )
+			return false;
+
+		m_tStream.next_in = const_cast<BYTE *> ( tData.first );
+		m_tStream.avail_in = tData.second;
+		int iFlush = bFinish ? Z_FINISH : Z_SYNC_FLUSH;
+
+		while ( true )
+		{
+			auto iStep = Max ( (int)deflateBound ( &m_tStream, m_tStream.avail_in ), HTTP_ENCODE_STEP );
+			auto iUsed = dOut.GetLength();
+			m_tStream.next_out = dOut.AddN ( iStep );
+			m_tStream.avail_out = iStep;
+
+			int iRes = deflate ( &m_tStream, iFlush );
+			dOut.Resize ( iUsed + iStep - m_tStream.avail_out );
+			if ( iRes==Z_STREAM_ERROR )
+				return false;
+
+			if ( bFinish ? iRes==Z_STREAM_END : ( !m_tStream.avail_in && m_tStream.avail_out ) )
+				return true;
+		}
+	}
+
+private:
+	z_stream	m_tStream {};
+	bool		m_bInited = false;
+};
+
+static bool GzipDecode ( ByteBlob_t tData, int iMaxSize, CSphVector<BYTE> & dOut, CSphString & sError )
+{
+	z_stream tStream {};
+	// 15 window bits +32 means auto-detect of gzip or zlib header
+	if ( inflateInit2 ( &tStream, 15+32 )!=Z_OK )
+	{
+		sError = "failed to init gzip decoder";
+		return false;
+	}
+	AT_SCOPE_EXIT ( [&tStream] { inflateEnd ( &tStream ); } );
+
+	tStream.next_in = const_cast<BYTE *> ( tData.first );
+	tStream.avail_in = tData.second;
+
+	int iRes = Z_OK;
+	while ( iRes!=Z_STREAM_END )
+	{
+		if ( dOut.GetLength()>iMaxSize )
+		{
+			sError.SetSprintf ( "decoded body length out of bounds (%d)", iMaxSize );
+			return false;
+		}
+
+		auto iUsed = dOut.GetLength();
+		tStream.next_out = dOut.AddN ( HTTP_ENCODE_STEP );
+		tStream.avail_out = HTTP_ENCODE_STEP;
+
+		iRes = inflate ( &tStream, Z_NO_FLUSH );
+		dOut.Resize ( iUsed + HTTP_ENCODE_STEP - tStream.avail_out );
+
+		if ( iRes==Z_BUF_ERROR && !tStream.avail_in )
+		{
+			sError = "truncated gzip body";
+			return false;
+		}
+
+		if ( iRes!=Z_OK && iRes!=Z_STREAM_END && iRes!=Z_BUF_ERROR )
+		{
+			sError.SetSprintf ( "failed to decode gzip body: %s", tStream.msg ? tStream.msg : "data error" );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#else
+
+static bool IsGzipAvailable()
+{
+	return false;
+}
+
+#endif // WITH_ZLIB
+
+
+//////////////////////////////////////////////////////////////////////////
+
+const char * HttpEncodingName ( HttpEncoding_e eEncoding )
+{
+	switch ( eEncoding )
+	{
+	case HttpEncoding_e::GZIP: return "gzip";
+	case HttpEncoding_e::ZSTD: return "zstd";
+	default: return "identity";
+	}
+}
+
+static HttpEncoding_e ParseEncoding ( CSphString sName )
+{
+	sName.Trim().ToLower();
+	if ( sName=="gzip" || sName=="x-gzip" )
+		return HttpEncoding_e::GZIP;
+	if ( sName=="zstd" )
+		return HttpEncoding_e::ZSTD;
+	return HttpEncoding_e::NONE;
+}
+
+static bool IsAvailable ( HttpEncoding_e eEncoding )
+{
+	switch ( eEncoding )
+	{
+	case HttpEncoding_e::GZIP: return IsGzipAvailable();
+	case HttpEncoding_e::ZSTD: return IsZstdCompressionAvailable();
+	default: return true;
+	}
+}
+
+HttpEncoding_e HttpAcceptedEncoding ( const CSphString & sAcceptEncoding )
+{
+	if ( sAcceptEncoding.IsEmpty() )
+		return HttpEncoding_e::NONE;
+
+	// q-values; negative means the coding is not listed
+	float fGzip = -1.0f;
+	float fZstd = -1.0f;
+	float fAny = -1.0f;
+	for ( const auto & sCoding : sphSplit ( sAcceptEncoding.cstr(), "," ) )
+	{
+		// 'gzip;q=0.5'
+		StrVec_t dParams = sphSplit ( sCoding.cstr(), ";" );
+		if ( dParams.IsEmpty() )
+			continue;
+
+		float fQ = 1.0f;
+		for ( int i = 1; i<dParams.GetLength(); ++i )
+		{
+			CSphString & sParam = dParams[i].Trim().ToLower();
+			if ( sParam.Begins ( "q=" ) )
+				fQ = Max ( (float)strtod ( sParam.cstr()+2, nullptr ), 0.0f );
+		}
+
+		CSphString & sName = dParams[0].Trim();
+		if ( sName=="*" )
+		{
+			fAny = fQ;
+			continue;
+		}
+
+		switch ( ParseEncoding ( sName ) )
+		{
+		case HttpEncoding_e::GZIP: fGzip = fQ; break;
+		case HttpEncoding_e::ZSTD: fZstd = fQ; break;
+		default: break;
+		}
+	}
+
+	// '*' matches any coding not listed explicitly
+	if ( fGzip<0.0f )
+		fGzip = fAny;
+	if ( fZstd<0.0f )
+		fZstd = fAny;
+
+	if ( !IsGzipAvailable() )
+		fGzip = 0.0f;
+	if ( !IsZstdCompressionAvailable() )
+		fZstd = 0.0f;
+
+	if ( fGzip<=0.0f && fZstd<=0.0f )
+		return HttpEncoding_e::NONE;
+
+	// zstd gives similar ratio at a fraction of gzip CPU cost
+	return fZstd>=fGzip ? HttpEncoding_e::ZSTD : HttpEncoding_e::GZIP;
+}
+
+bool HttpContentEncoding ( const CSphString & sContentEncoding, HttpEncoding_e & eEncoding, CSphString & sError )
+{
+	eEncoding = HttpEncoding_e::NONE;
+	CSphString sName = sContentEncoding;
+	sName.Trim().ToLower();
+	if ( sName.IsEmpty() || sName=="identity" )
+		return true;
+
+	eEncoding = ParseEncoding ( sName );
+	if ( eEncoding==HttpEncoding_e::NONE || !IsAvailable ( eEncoding ) )
+	{
+		sError.SetSprintf ( "unsupported Content-Encoding '%s'", sContentEncoding.cstr() );
+		return false;
+	}
+
+	return true;
+}
+
+std::unique_ptr<HttpEncoder_i> CreateHttpEncoder ( HttpEncoding_e eEncoding )
+{
+	if ( !IsAvailable ( eEncoding ) )
+		return nullptr;
+
+	switch ( eEncoding )
+	{
+#if WITH_ZLIB
+	case HttpEncoding_e::GZIP: return std::make_unique<GzipEncoder_c>();
+#endif
+#if WITH_ZSTD
+	case HttpEncoding_e::ZSTD: return CreateZstdHttpEncoder();
+#endif
+	default: return nullptr;
+	}
+}
+
+bool HttpDecode ( HttpEncoding_e eEncoding, ByteBlob_t tData, int iMaxSize, CSphVector<BYTE> & dOut, CSphString & sError )
+{
+	dOut.Resize ( 0 );
+	bool bOk = false;
+	switch ( eEncoding )
+	{
+#if WITH_ZLIB
+	case HttpEncoding_e::GZIP: bOk = GzipDecode ( tData, iMaxSize, dOut, sError ); break;
+#endif
+#if WITH_ZSTD
+	case HttpEncoding_e::ZSTD: bOk = ZstdHttpDecode ( tData, iMaxSize, dOut, sError ); break;
+#endif
+	default:
+		sError.SetSprintf ( "unsupported Content-Encoding '%s'", HttpEncodingName ( eEncoding ) );
+		break;
+	}
+
+	if ( !bOk )
+		return false;
+
+	if ( dOut.GetLength()>iMaxSize )
+	{
+		sError.SetSprintf ( "decoded body length out of bounds (%d)", iMaxSize );
+		return false;
+	}
+
+	// parsers want zero-terminated buffer
+	dOut.Add ( '\0' );
+	dOut.Resize ( dOut.GetLength()-1 );
+	return true;
+}
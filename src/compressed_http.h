@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2023, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#pragma once
+
+#include "sphinxstd.h"
+
+/// HTTP content codings; gzip is available WITH_ZLIB, zstd WITH_ZSTD (and when the library loads)
+enum class HttpEncoding_e
+{
+	NONE,
+	GZIP,
+	ZSTD
+};
+
+// output buffer grows by that step while (de)compressing
+constexpr int HTTP_ENCODE_STEP = 16384;
+
+const char *	HttpEncodingName ( HttpEncoding_e eEncoding );
+
+/// picks the supported coding with the highest q-value from Accept-Encoding header value ('*' stands for
+/// codings not listed; zstd wins ties; q=0 means 'not acceptable')
+HttpEncoding_e	HttpAcceptedEncoding ( const CSphString & sAcceptEncoding );
+
+/// parses Content-Encoding header value; returns false for codings this build can't decode
+bool			HttpContentEncoding ( const CSphString & sContentEncoding, HttpEncoding_e & eEncoding, CSphString & sError );
+
+/// streaming encoder. Every Encode() call flushes, so the output appended so far is decodable on its own;
+/// the last call has to pass bFinish to write the trailer
+class HttpEncoder_i
+{
+public:
+	virtual			~HttpEncoder_i() = default;
+	virtual bool	Encode ( ByteBlob_t tData, bool bFinish, CSphVector<BYTE> & dOut ) = 0;
+};
+
+std::unique_ptr<HttpEncoder_i> CreateHttpEncoder ( HttpEncoding_e eEncoding );
+
+/// decodes whole request body; fails if decoded size exceeds iMaxSize. Result is zero-terminated (terminator not counted)
+bool			HttpDecode ( HttpEncoding_e eEncoding, ByteBlob_t tData, int iMaxSize, CSphVector<BYTE> & dOut, CSphString & sError );
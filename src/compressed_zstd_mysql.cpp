@@ -10,6 +10,7 @@
 
 #include "compressed_zstd_mysql.h"
 #include "compressed_mysql_layer.h"
+#include "compressed_http.h"
 #include <zstd.h>
 
 #if DL_ZSTD
@@ -22,11 +23,16 @@ static decltype ( &ZSTD_compressBound ) sph_ZSTD_compressBound = nullptr;
 static decltype ( &ZSTD_compressCCtx ) sph_ZSTD_compressCCtx = nullptr;
 static decltype ( &ZSTD_decompressDCtx ) sph_ZSTD_decompressDCtx = nullptr;
 static decltype ( &ZSTD_isError ) sph_ZSTD_isError = nullptr;
+static decltype ( &ZSTD_compressStream2 ) sph_ZSTD_compressStream2 = nullptr;
+static decltype ( &ZSTD_decompressStream ) sph_ZSTD_decompressStream = nullptr;
+static decltype ( &ZSTD_getErrorName ) sph_ZSTD_getErrorName = nullptr;
 
 static bool InitDynamicZstd()
 {
-	const char* sFuncs[] = { "ZSTD_createCCtx", "ZSTD_createDCtx", "ZSTD_freeDCtx", "ZSTD_freeCCtx", "ZSTD_compressBound", "ZSTD_compressCCtx", "ZSTD_decompressDCtx", "ZSTD_isError" };
-	void** pFuncs[] = { (void**)&sph_ZSTD_createCCtx, (void**)&sph_ZSTD_createDCtx, (void**)&sph_ZSTD_freeDCtx, (void**)&sph_ZSTD_freeCCtx, (void**)&sph_ZSTD_compressBound, (void**)&sph_ZSTD_compressCCtx, (void**)&sph_ZSTD_decompressDCtx, (void**)&sph_ZSTD_isError };
+	const char* sFuncs[] = { "ZSTD_createCCtx", "ZSTD_createDCtx", "ZSTD_freeDCtx", "ZSTD_freeCCtx", "ZSTD_compressBound", "ZSTD_compressCCtx", "ZSTD_decompressDCtx", "ZSTD_isError",
+		"ZSTD_compressStream2", "ZSTD_decompressStream", "ZSTD_getErrorName" };
+	void** pFuncs[] = { (void**)&sph_ZSTD_createCCtx, (void**)&sph_ZSTD_createDCtx, (void**)&sph_ZSTD_freeDCtx, (void**)&sph_ZSTD_freeCCtx, (void**)&sph_ZSTD_compressBound, (void**)&sph_ZSTD_compressCCtx, (void**)&sph_ZSTD_decompressDCtx, (void**)&sph_ZSTD_isError,
+		(void**)&sph_ZSTD_compressStream2, (void**)&sph_ZSTD_decompressStream, (void**)&sph_ZSTD_getErrorName };
 
 	static CSphDynamicLibrary dLib ( ZSTD_LIB );
 	return dLib.LoadSymbols ( sFuncs, pFuncs, sizeof ( pFuncs ) / sizeof ( void** ) );
@@ -42,6 +48,9 @@ static bool InitDynamicZstd()
 #define sph_ZSTD_compressCCtx ZSTD_compressCCtx
 #define sph_ZSTD_decompressDCtx ZSTD_decompressDCtx
 #define sph_ZSTD_isError ZSTD_isError
+#define sph_ZSTD_compressStream2 ZSTD_compressStream2
+#define sph_ZSTD_decompressStream ZSTD_decompressStream
+#define sph_ZSTD_getErrorName ZSTD_getErrorName
 #define InitDynamicZstd() ( true )
 
 #endif
@@ -116,3 +125,103 @@ void MakeZstdMysqlCompressedLayer ( std::unique_ptr<AsyncNetBuffer_c>& pSource,
 	pCompressed->SetLevel ( iLevel );
 	pSource = std::move ( pCompressed );
 }
+
+//////////////////////////////////////////////////////////////////////////
+// http bodies
+
+class ZstdHttpEncoder_c final : public HttpEncoder_i
+{
+public:
+	ZstdHttpEncoder_c()
+		: m_pCtx { sph_ZSTD_createCCtx() }
+	{}
+
+	~ZstdHttpEncoder_c() final
+	{
+		sph_ZSTD_freeCCtx ( m_pCtx );
+	}
+
+	bool Encode ( ByteBlob_t tData, bool bFinish, CSphVector<BYTE> & dOut ) final
+	{
+		if ( !m_pCtx )
+			return false;
+
+		ZSTD_inBuffer tIn { tData.first, (size_t)tData.second, 0 };
+		ZSTD_EndDirective eMode = bFinish ? ZSTD_e_end : ZSTD_e_flush;
+
+		while ( true )
+		{
+			auto iStep = Max ( tData.second/2, HTTP_ENCODE_STEP );
+			auto iUsed = dOut.GetLength();
+			ZSTD_outBuffer tOut { dOut.AddN ( iStep ), (size_t)iStep, 0 };
+
+			size_t uLeft = sph_ZSTD_compressStream2 ( m_pCtx, &tOut, &tIn, eMode );
+			dOut.Resize ( iUsed + (int)tOut.pos );
+			if ( sph_ZSTD_isError ( uLeft ) )
+				return false;
+
+			// zero means the whole input is consumed and flushed (or the frame is closed)
+			if ( !uLeft )
+				return true;
+		}
+	}
+
+private:
+	ZSTD_CCtx *	m_pCtx = nullptr;
+};
+
+std::unique_ptr<HttpEncoder_i> CreateZstdHttpEncoder()
+{
+	if ( !IsZstdCompressionAvailable() )
+		return nullptr;
+
+	return std::make_unique<ZstdHttpEncoder_c>();
+}
+
+bool ZstdHttpDecode ( ByteBlob_t tData, int iMaxSize, CSphVector<BYTE> & dOut, CSphString & sError )
+{
+	if ( !IsZstdCompressionAvailable() )
+	{
+		sError = "zstd library is not available";
+		return false;
+	}
+
+	ZSTD_DCtx * pCtx = sph_ZSTD_createDCtx();
+	if ( !pCtx )
+	{
+		sError = "failed to init zstd decoder";
+		return false;
+	}
+	AT_SCOPE_EXIT ( [pCtx] { sph_ZSTD_freeDCtx ( pCtx ); } );
+
+	ZSTD_inBuffer tIn { tData.first, (size_t)tData.second, 0 };
+	size_t uLeft = 0;
+	while ( tIn.pos<tIn.size || uLeft )
+	{
+		if ( dOut.GetLength()>iMaxSize )
+		{
+			sError.SetSprintf ( "decoded body length out of bounds (%d)", iMaxSize );
+			return false;
+		}
+
+		auto iUsed = dOut.GetLength();
+		ZSTD_outBuffer tOut { dOut.AddN ( HTTP_ENCODE_STEP ), (size_t)HTTP_ENCODE_STEP, 0 };
+
+		uLeft = sph_ZSTD_decompressStream ( pCtx, &tOut, &tIn );
+		dOut.Resize ( iUsed + (int)tOut.pos );
+		if ( sph_ZSTD_isError ( uLeft ) )
+		{
+			sError.SetSprintf ( "failed to decode zstd body: %s", sph_ZSTD_getErrorName ( uLeft ) );
+			return false;
+		}
+
+		// frame is not complete, output has room, but input is over
+		if ( uLeft && tIn.pos==tIn.size && tOut.pos<tOut.size )
+		{
+			sError = "truncated zstd body";
+			return false;
+		}
+	}
+
+	return true;
+}
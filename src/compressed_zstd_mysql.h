@@ -12,6 +12,8 @@
 
 #include "networking_daemon.h"
 
+class HttpEncoder_i;
+
 #if WITH_ZSTD
 
 bool IsZstdCompressionAvailable();
@@ -20,6 +22,10 @@ bool IsZstdCompressionAvailable();
 // Mysql proto will be wrapped into compressed.
 void MakeZstdMysqlCompressedLayer ( std::unique_ptr<AsyncNetBuffer_c>& pSource, int iLevel );
 
+// zstd coding of http bodies (see compressed_http.h); shares the library loaded for mysql compression
+std::unique_ptr<HttpEncoder_i> CreateZstdHttpEncoder();
+bool ZstdHttpDecode ( ByteBlob_t tData, int iMaxSize, CSphVector<BYTE> & dOut, CSphString & sError );
+
 #else
 inline bool IsZstdCompressionAvailable() { return false; }
 inline void MakeZstdMysqlCompressedLayer ( std::unique_ptr<AsyncNetBuffer_c>& pSource, int iLevel ) { };
@@ -12,14 +12,584 @@
 #include "costestimate.h"
 
 #include "sphinxint.h"
+#include "attribute.h"
 #include "sphinxsort.h"
 #include "columnarfilter.h"
 #include "secondarylib.h"
 #include "geodist.h"
+#include "secondaryindex.h"
+#include "sphinxjson.h"
+#include "sphinxfilter.h"
+#include "threadutils.h"
 #include <math.h>
+#include <atomic>
 #include "std/sys.h"
 
 
+static const CostCoeffs_t g_tDefaultCoeffs =
+{{
+	6.0f,	// PUSH
+	3.0f,	// PUSH_IG
+	8.5f,	// FILTER
+	4.0f,	// COLUMNAR_FILTER
+	4.0f,	// INDEX_READ_SINGLE
+	4.5f,	// INDEX_READ_BITMAP
+	4.0f,	// INDEX_UNION
+	20.0f,	// LOOKUP_READ
+	30.0f,	// INDEX_ITERATOR_INIT
+	20.0f,	// ITERATOR_INTERSECT
+	0.45f,	// MT_K
+	1.40f,	// MT_B
+	0.16f,	// MT_CS_K
+	1.38f,	// MT_CS_B
+	0.10f,	// MT_SI_K
+	1.56f,	// MT_SI_B
+	0.235f,	// MT_SIFT_K
+	1.25f	// MT_SIFT_B
+}};
+
+static const char * g_dCostCoeffNames[(int)CostCoeff_e::TOTAL] =
+{
+	"push",
+	"push_implicit_groupby",
+	"filter",
+	"columnar_filter",
+	"index_read_single",
+	"index_read_bitmap",
+	"index_union",
+	"lookup_read",
+	"index_iterator_init",
+	"iterator_intersect",
+	"mt_k",
+	"mt_b",
+	"mt_columnar_k",
+	"mt_columnar_b",
+	"mt_si_k",
+	"mt_si_b",
+	"mt_si_ft_k",
+	"mt_si_ft_b"
+};
+
+static bool g_bCostFeedback = false;
+
+/// coefficients the planner is using right now: base values (defaults, loaded or calibrated)
+/// multiplied by per-path scales learned from runtime feedback
+class CostModel_c
+{
+public:
+					CostModel_c();
+
+	float			Get ( CostCoeff_e eCoeff ) const { return m_dCoeffs[(int)eCoeff].load ( std::memory_order_relaxed ); }
+	CostCoeffs_t	Get() const;
+	void			SetBase ( const CostCoeffs_t & tCoeffs );
+	void			Feedback ( CostPath_e ePath, float fRatio );
+
+private:
+	static constexpr float MAX_SCALE = 8.0f;
+	static constexpr float FEEDBACK_WEIGHT = 0.05f;
+
+	CSphMutex		m_tLock;
+	CostCoeffs_t	m_tBase GUARDED_BY(m_tLock);
+	float			m_dPathScale[(int)CostPath_e::TOTAL] GUARDED_BY(m_tLock);
+	std::atomic<float> m_dCoeffs[(int)CostCoeff_e::TOTAL];
+
+	void			Publish() REQUIRES(m_tLock);
+	static CostPath_e GetPath ( CostCoeff_e eCoeff );
+};
+
+
+CostModel_c::CostModel_c()
+{
+	ScopedMutex_t tLock(m_tLock);
+	m_tBase = g_tDefaultCoeffs;
+	for ( auto & i : m_dPathScale )
+		i = 1.0f;
+
+	Publish();
+}
+
+
+CostCoeffs_t CostModel_c::Get() const
+{
+	CostCoeffs_t tCoeffs;
+	for ( int i = 0; i < (int)CostCoeff_e::TOTAL; i++ )
+		tCoeffs.m_dCoeffs[i] = m_dCoeffs[i].load ( std::memory_order_relaxed );
+
+	return tCoeffs;
+}
+
+
+void CostModel_c::SetBase ( const CostCoeffs_t & tCoeffs )
+{
+	ScopedMutex_t tLock(m_tLock);
+	m_tBase = tCoeffs;
+	for ( auto & i : m_dPathScale )
+		i = 1.0f;
+
+	Publish();
+}
+
+
+void CostModel_c::Feedback ( CostPath_e ePath, float fRatio )
+{
+	// one query moves the scale by ratio^weight, i.e. it takes a few dozen consistent observations to converge
+	fRatio = Min ( Max ( fRatio, 1.0f/MAX_SCALE ), MAX_SCALE );
+
+	ScopedMutex_t tLock(m_tLock);
+	float & fScale = m_dPathScale[(int)ePath];
+	fScale = Min ( Max ( fScale*powf ( fRatio, FEEDBACK_WEIGHT ), 1.0f/MAX_SCALE ), MAX_SCALE );
+	Publish();
+}
+
+
+void CostModel_c::Publish()
+{
+	for ( int i = 0; i < (int)CostCoeff_e::TOTAL; i++ )
+	{
+		auto eCoeff = (CostCoeff_e)i;
+		auto ePath = GetPath(eCoeff);
+		float fScale = ePath==CostPath_e::TOTAL ? 1.0f : m_dPathScale[(int)ePath];
+		m_dCoeffs[i].store ( m_tBase[eCoeff]*fScale, std::memory_order_relaxed );
+	}
+}
+
+// which path's feedback adjusts a coefficient; TOTAL means the coefficient is shared by all paths and is left alone
+CostPath_e CostModel_c::GetPath ( CostCoeff_e eCoeff )
+{
+	switch ( eCoeff )
+	{
+	case CostCoeff_e::FILTER:				return CostPath_e::SCAN;
+	case CostCoeff_e::COLUMNAR_FILTER:		return CostPath_e::COLUMNAR;
+	case CostCoeff_e::INDEX_READ_SINGLE:
+	case CostCoeff_e::INDEX_READ_BITMAP:
+	case CostCoeff_e::INDEX_UNION:
+	case CostCoeff_e::INDEX_ITERATOR_INIT:	return CostPath_e::SECONDARY;
+	case CostCoeff_e::LOOKUP_READ:			return CostPath_e::LOOKUP;
+	default:								return CostPath_e::TOTAL;
+	}
+}
+
+
+static CostModel_c & CostModel()
+{
+	static CostModel_c tModel;
+	return tModel;
+}
+
+
+const CostCoeffs_t & GetDefaultCostCoeffs()
+{
+	return g_tDefaultCoeffs;
+}
+
+
+CostCoeffs_t GetCostCoeffs()
+{
+	return CostModel().Get();
+}
+
+
+void SetCostCoeffs ( const CostCoeffs_t & tCoeffs )
+{
+	CostModel().SetBase(tCoeffs);
+}
+
+
+const char * GetCostCoeffName ( CostCoeff_e eCoeff )
+{
+	return g_dCostCoeffNames[(int)eCoeff];
+}
+
+
+bool LoadCostCoeffs ( const CSphString & sFile, CSphString & sError )
+{
+	CSphAutoreader tReader;
+	if ( !tReader.Open ( sFile, sError ) )
+		return false;
+
+	int iSize = (int)tReader.GetFilesize();
+	CSphFixedVector<BYTE> dData ( iSize+1 );
+	tReader.GetBytes ( dData.Begin(), iSize );
+	if ( tReader.GetErrorFlag() )
+	{
+		sError = tReader.GetErrorMessage();
+		return false;
+	}
+
+	dData[iSize] = 0; // safe gap
+	JsonObj_c tRoot ( (const char*)dData.Begin() );
+	if ( tRoot.GetError ( (const char *)dData.Begin(), dData.GetLength(), sError ) )
+		return false;
+
+	JsonObj_c tCoeffs = tRoot.GetItem("coeffs");
+	if ( !tCoeffs.IsObj() )
+	{
+		sError.SetSprintf ( "no 'coeffs' object in '%s'", sFile.cstr() );
+		return false;
+	}
+
+	// missing coefficients (e.g. written by an older version) keep their defaults
+	CostCoeffs_t tLoaded = g_tDefaultCoeffs;
+	for ( int i = 0; i < (int)CostCoeff_e::TOTAL; i++ )
+	{
+		JsonObj_c tValue = tCoeffs.GetItem ( g_dCostCoeffNames[i] );
+		if ( !tValue.IsNum() )
+			continue;
+
+		float fValue = tValue.FltVal();
+		if ( fValue<=0.0f )
+		{
+			sError.SetSprintf ( "invalid value %f for coefficient '%s' in '%s'", fValue, g_dCostCoeffNames[i], sFile.cstr() );
+			return false;
+		}
+
+		tLoaded.m_dCoeffs[i] = fValue;
+	}
+
+	SetCostCoeffs(tLoaded);
+	return true;
+}
+
+
+bool SaveCostCoeffs ( const CSphString & sFile, CSphString & sError )
+{
+	CostCoeffs_t tCurrent = GetCostCoeffs();
+
+	JsonObj_c tRoot;
+	JsonObj_c tCoeffs;
+	for ( int i = 0; i < (int)CostCoeff_e::TOTAL; i++ )
+		tCoeffs.AddFlt ( g_dCostCoeffNames[i], tCurrent.m_dCoeffs[i] );
+
+	tRoot.AddItem ( "coeffs", tCoeffs );
+
+	CSphString sNew, sOld;
+	sNew.SetSprintf ( "%s.new", sFile.cstr() );
+	sOld.SetSprintf ( "%s.old", sFile.cstr() );
+
+	CSphWriter tWriter;
+	if ( !tWriter.OpenFile ( sNew, sError ) )
+		return false;
+
+	CSphString sData = tRoot.AsString(true);
+	tWriter.PutBytes ( sData.cstr(), sData.Length() );
+	tWriter.CloseFile();
+	if ( tWriter.IsError() )
+		return false;
+
+	if ( sphIsReadable ( sFile, nullptr ) && rename ( sFile.cstr(), sOld.cstr() ) )
+	{
+		sError.SetSprintf ( "failed to rename current to old, '%s'->'%s', error '%s'", sFile.cstr(), sOld.cstr(), strerror(errno) );
+		return false;
+	}
+
+	if ( rename ( sNew.cstr(), sFile.cstr() ) )
+	{
+		sError.SetSprintf ( "failed to rename new to current, '%s'->'%s', error '%s'", sNew.cstr(), sFile.cstr(), strerror(errno) );
+		if ( sphIsReadable ( sOld, nullptr ) && rename ( sOld.cstr(), sFile.cstr() ) )
+			sError.SetSprintf ( "%s, rollback failed too", sError.cstr() );
+		return false;
+	}
+
+	unlink ( sOld.cstr() );
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+namespace CostCalibration
+{
+
+static const int CALIBRATE_ROWS = 1<<20;
+static const int CALIBRATE_RUNS = 3;
+static volatile int64_t g_iSink = 0;	// keeps the compiler from throwing the benchmark loops away
+
+template <typename FN>
+static float MeasureNsPerDoc ( int64_t iDocs, FN && fnRun )
+{
+	int64_t iBest = INT64_MAX;
+	for ( int i = 0; i < CALIBRATE_RUNS; i++ )
+	{
+		int64_t tmStart = sphMicroTimer();
+		g_iSink = g_iSink + fnRun();
+		iBest = Min ( iBest, sphMicroTimer()-tmStart );
+	}
+
+	return float ( Max ( iBest, (int64_t)1 ) )*1000.0f/iDocs;
+}
+
+/// rowwise attribute filter over a plain row storage; the same work fullscan does per row
+class FilterBench_c
+{
+public:
+	FilterBench_c()
+	{
+		m_tSchema.AddAttr ( CSphColumnInfo ( "gid", SPH_ATTR_INTEGER ), false );
+		m_iStride = m_tSchema.GetRowSize();
+		m_dRows.Reset ( (int64_t)CALIBRATE_ROWS*m_iStride );
+
+		const CSphAttrLocator & tLoc = m_tSchema.GetAttr(0).m_tLocator;
+		for ( int i = 0; i < CALIBRATE_ROWS; i++ )
+			sphSetRowAttr ( &m_dRows[(int64_t)i*m_iStride], tLoc, sphRand() % 1000 );
+
+		CSphFilterSettings tSettings;
+		tSettings.m_sAttrName = "gid";
+		tSettings.m_eType = SPH_FILTER_RANGE;
+		tSettings.m_iMinValue = 100;
+		tSettings.m_iMaxValue = 600;
+
+		CreateFilterContext_t tCtx ( &m_tSchema );
+		CSphString sError, sWarning;
+		m_pFilter = sphCreateFilter ( tSettings, tCtx, sError, sWarning );
+	}
+
+	bool IsValid() const { return !!m_pFilter; }
+
+	int64_t Run ( int iStart, int iEnd ) const
+	{
+		CSphMatch tMatch;
+		int64_t iAccepted = 0;
+		for ( int i = iStart; i < iEnd; i++ )
+		{
+			tMatch.m_tRowID = i;
+			tMatch.m_pStatic = &m_dRows[(int64_t)i*m_iStride];
+			iAccepted += m_pFilter->Eval(tMatch) ? 1 : 0;
+		}
+
+		tMatch.m_pStatic = nullptr;
+		return iAccepted;
+	}
+
+private:
+	CSphSchema					m_tSchema;
+	int							m_iStride = 0;
+	CSphFixedVector<CSphRowitem> m_dRows { 0 };
+	std::unique_ptr<ISphFilter>	m_pFilter;
+};
+
+/// pushes matches with random weights into a default (relevance) sorter
+static float BenchPush()
+{
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( sphGetDocidName(), SPH_ATTR_BIGINT ), false );
+	int iStride = tSchema.GetRowSize();
+	const CSphAttrLocator & tLoc = tSchema.GetAttr(0).m_tLocator;
+
+	CSphFixedVector<CSphRowitem> dRows ( (int64_t)CALIBRATE_ROWS*iStride );
+	CSphFixedVector<int> dWeights ( CALIBRATE_ROWS );
+	for ( int i = 0; i < CALIBRATE_ROWS; i++ )
+	{
+		sphSetRowAttr ( &dRows[(int64_t)i*iStride], tLoc, i+1 );
+		dWeights[i] = sphRand() % 10000;
+	}
+
+	CSphQuery tQuery;
+	SphQueueSettings_t tQueueSettings ( tSchema );
+	SphQueueRes_t tRes;
+	CSphString sError;
+
+	return MeasureNsPerDoc ( CALIBRATE_ROWS, [&]() -> int64_t
+	{
+		std::unique_ptr<ISphMatchSorter> pSorter ( sphCreateQueue ( tQueueSettings, tQuery, sError, tRes ) );
+		if ( !pSorter )
+			return 0;
+
+		CSphMatch tMatch;
+		for ( int i = 0; i < CALIBRATE_ROWS; i++ )
+		{
+			tMatch.m_tRowID = i;
+			tMatch.m_iWeight = dWeights[i];
+			tMatch.m_pStatic = &dRows[(int64_t)i*iStride];
+			pSorter->Push ( tMatch );
+		}
+
+		tMatch.m_pStatic = nullptr;
+		return pSorter->GetTotalCount();
+	} );
+}
+
+/// in-memory rowid list served in blocks, as secondary index iterators do
+class RowidListIterator_c : public RowidIterator_i
+{
+public:
+	explicit RowidListIterator_c ( const CSphVector<RowID_t> & dRowIDs ) : m_dRowIDs ( dRowIDs ) {}
+
+	bool HintRowID ( RowID_t tRowID ) override
+	{
+		while ( m_iPos < m_dRowIDs.GetLength() && m_dRowIDs[m_iPos] < tRowID )
+			m_iPos++;
+
+		return m_iPos < m_dRowIDs.GetLength();
+	}
+
+	bool GetNextRowIdBlock ( RowIdBlock_t & dRowIdBlock ) override
+	{
+		const int BLOCK_SIZE = 1024;
+		int iLeft = m_dRowIDs.GetLength() - m_iPos;
+		if ( iLeft<=0 )
+			return false;
+
+		int iCount = Min ( iLeft, BLOCK_SIZE );
+		dRowIdBlock = { m_dRowIDs.Begin()+m_iPos, iCount };
+		m_iPos += iCount;
+		return true;
+	}
+
+	int64_t	GetNumProcessed() const override { return m_iPos; }
+	void	SetCutoff ( int ) override {}
+	bool	WasCutoffHit() const override { return false; }
+	void	AddDesc ( CSphVector<IteratorDesc_t> & ) const override {}
+
+private:
+	const CSphVector<RowID_t> & m_dRowIDs;
+	int		m_iPos = 0;
+};
+
+/// intersects two rowid lists through the same iterator the query engine uses; cost is per doc of the first (most selective) list
+static float BenchIntersect()
+{
+	CSphVector<RowID_t> dFirst, dSecond;
+	for ( RowID_t i = 0; i < (RowID_t)CALIBRATE_ROWS; i++ )
+	{
+		if ( !( i % 4 ) )
+			dFirst.Add(i);
+
+		if ( i % 3 )
+			dSecond.Add(i);
+	}
+
+	return MeasureNsPerDoc ( dFirst.GetLength(), [&]() -> int64_t
+	{
+		CSphVector<RowidIterator_i *> dIterators;
+		dIterators.Add ( new RowidListIterator_c(dFirst) );
+		dIterators.Add ( new RowidListIterator_c(dSecond) );
+		std::unique_ptr<RowidIterator_i> pIntersect ( CreateIteratorIntersect ( dIterators, nullptr ) );
+
+		int64_t iFound = 0;
+		RowIdBlock_t dBlock;
+		while ( pIntersect->GetNextRowIdBlock(dBlock) )
+			iFound += dBlock.GetLength();
+
+		return iFound;
+	} );
+}
+
+/// speedup of the filter loop when all logical CPUs scan disjoint parts of the rows
+static float BenchScanSpeedup ( const FilterBench_c & tBench, int iThreads )
+{
+	const int REPEAT = 8;	// make per-thread work long enough to hide thread startup
+	auto fnRange = [&tBench] ( int iStart, int iEnd )
+	{
+		int64_t iRes = 0;
+		for ( int i = 0; i < REPEAT; i++ )
+			iRes += tBench.Run ( iStart, iEnd );
+
+		return iRes;
+	};
+
+	float fSingle = MeasureNsPerDoc ( CALIBRATE_ROWS, [&]{ return fnRange ( 0, CALIBRATE_ROWS ); } );
+	float fMulti = MeasureNsPerDoc ( CALIBRATE_ROWS, [&]() -> int64_t
+	{
+		CSphFixedVector<SphThread_t> dThreads ( iThreads );
+		CSphFixedVector<int64_t> dResults ( iThreads );
+		int iCreated = 0;
+		for ( int i = 0; i < iThreads; i++ )
+		{
+			int iStart = int ( (int64_t)CALIBRATE_ROWS*i/iThreads );
+			int iEnd = int ( (int64_t)CALIBRATE_ROWS*(i+1)/iThreads );
+			int64_t & iResult = dResults[i];
+			if ( !Threads::Create ( &dThreads[i], [&fnRange, &iResult, iStart, iEnd]{ iResult = fnRange ( iStart, iEnd ); }, false, "calibrate" ) )
+				break;
+
+			iCreated++;
+		}
+
+		int64_t iRes = 0;
+		for ( int i = 0; i < iCreated; i++ )
+		{
+			Threads::Join ( &dThreads[i] );
+			iRes += dResults[i];
+		}
+
+		return iRes;
+	} );
+
+	return fSingle/fMulti;
+}
+
+
+static float ClampCoeff ( float fValue, float fDefault )
+{
+	// a benchmark can't tell us the box is that different; anything beyond is measurement noise
+	const float MAX_DEVIATION = 8.0f;
+	return Min ( Max ( fValue, fDefault/MAX_DEVIATION ), fDefault*MAX_DEVIATION );
+}
+
+} // namespace CostCalibration
+
+
+CostCoeffs_t CalibrateCostCoeffs()
+{
+	using namespace CostCalibration;
+
+	const CostCoeffs_t & tDef = g_tDefaultCoeffs;
+	CostCoeffs_t tRes = tDef;
+
+	// coefficients with a kernel that runs the real code path are taken as measured;
+	// the rest (columnar, secondary index reads, lookups) need on-disk structures,
+	// so they are scaled by how much faster or slower this box is on the measured ones
+	FilterBench_c tFilterBench;
+	float fFilter = tFilterBench.IsValid() ? MeasureNsPerDoc ( CALIBRATE_ROWS, [&tFilterBench]{ return tFilterBench.Run ( 0, CALIBRATE_ROWS ); } ) : tDef[CostCoeff_e::FILTER];
+	float fPush = BenchPush();
+	float fIntersect = BenchIntersect();
+
+	tRes[CostCoeff_e::FILTER] = ClampCoeff ( fFilter, tDef[CostCoeff_e::FILTER] );
+	tRes[CostCoeff_e::PUSH] = ClampCoeff ( fPush, tDef[CostCoeff_e::PUSH] );
+	tRes[CostCoeff_e::ITERATOR_INTERSECT] = ClampCoeff ( fIntersect, tDef[CostCoeff_e::ITERATOR_INTERSECT] );
+
+	float fSpeed = cbrtf ( tRes[CostCoeff_e::FILTER] / tDef[CostCoeff_e::FILTER] * tRes[CostCoeff_e::PUSH] / tDef[CostCoeff_e::PUSH] * tRes[CostCoeff_e::ITERATOR_INTERSECT] / tDef[CostCoeff_e::ITERATOR_INTERSECT] );
+	for ( auto eCoeff : { CostCoeff_e::PUSH_IG, CostCoeff_e::COLUMNAR_FILTER, CostCoeff_e::INDEX_READ_SINGLE, CostCoeff_e::INDEX_READ_BITMAP, CostCoeff_e::INDEX_UNION, CostCoeff_e::LOOKUP_READ, CostCoeff_e::INDEX_ITERATOR_INIT } )
+		tRes[eCoeff] = tDef[eCoeff]*fSpeed;
+
+	// thread scaling: perf(threads) = K*threads + B; keep B, fit K to the measured speedup at all CPUs
+	// and move the other K's by the same ratio
+	int iThreads = GetNumLogicalCPUs();
+	if ( iThreads>1 && tFilterBench.IsValid() )
+	{
+		float fSpeedup = BenchScanSpeedup ( tFilterBench, iThreads );
+		float fK = Max ( ( fSpeedup - tDef[CostCoeff_e::MT_B] ) / iThreads, 0.01f );
+		float fRatio = ClampCoeff ( fK, tDef[CostCoeff_e::MT_K] ) / tDef[CostCoeff_e::MT_K];
+		for ( auto eCoeff : { CostCoeff_e::MT_K, CostCoeff_e::MT_CS_K, CostCoeff_e::MT_SI_K, CostCoeff_e::MT_SIFT_K } )
+			tRes[eCoeff] = tDef[eCoeff]*fRatio;
+	}
+
+	return tRes;
+}
+
+
+void SetCostFeedback ( bool bEnabled )
+{
+	g_bCostFeedback = bEnabled;
+}
+
+
+bool IsCostFeedbackEnabled()
+{
+	return g_bCostFeedback;
+}
+
+
+void CostFeedback ( const CostPlan_t & tPlan, int64_t iElapsedUs )
+{
+	// short queries are dominated by setup and are too noisy to learn from
+	const float MIN_COST_MS = 1.0f;
+	if ( !g_bCostFeedback || tPlan.m_fCost<MIN_COST_MS || iElapsedUs<=0 )
+		return;
+
+	CostModel().Feedback ( tPlan.m_ePath, float(iElapsedUs)/1000.0f/tPlan.m_fCost );
+}
+
+/////////////////////////////////////////////////////////////////////
+
 static float EstimateMTCost ( float fCost, int iThreads, float fKPerf, float fBPerf )
 {
 	if ( iThreads==1 )
@@ -49,37 +619,46 @@ static float EstimateMTCost ( float fCost, int iThreads, float fKPerf, float fBP
 
 float EstimateMTCost ( float fCost, int iThreads )
 {
-	const float fKPerf = 0.45f;
-	const float fBPerf = 1.40f;
-
-	return EstimateMTCost ( fCost, iThreads, fKPerf, fBPerf );
+	return EstimateMTCost ( fCost, iThreads, CostModel().Get ( CostCoeff_e::MT_K ), CostModel().Get ( CostCoeff_e::MT_B ) );
 }
 
 
 float EstimateMTCostCS ( float fCost, int iThreads )
 {
-	const float fKPerf = 0.16f;
-	const float fBPerf = 1.38f;
-
-	return EstimateMTCost ( fCost, iThreads, fKPerf, fBPerf );
+	return EstimateMTCost ( fCost, iThreads, CostModel().Get ( CostCoeff_e::MT_CS_K ), CostModel().Get ( CostCoeff_e::MT_CS_B ) );
 }
 
 
 float EstimateMTCostSI ( float fCost, int iThreads )
 {
-	const float fKPerf = 0.10f;
-	const float fBPerf = 1.56f;
-
-	return EstimateMTCost ( fCost, iThreads, fKPerf, fBPerf );
+	return EstimateMTCost ( fCost, iThreads, CostModel().Get ( CostCoeff_e::MT_SI_K ), CostModel().Get ( CostCoeff_e::MT_SI_B ) );
 }
 
 
 float EstimateMTCostSIFT ( float fCost, int iThreads )
 {
-	const float fKPerf = 0.235f;
-	const float fBPerf = 1.25f;
+	return EstimateMTCost ( fCost, iThreads, CostModel().Get ( CostCoeff_e::MT_SIFT_K ), CostModel().Get ( CostCoeff_e::MT_SIFT_B ) );
+}
+
+
+CostPath_e GetCostPath ( const CSphVector<SecondaryIndexInfo_t> & dSIInfo )
+{
+	// same precedence CalcQueryCost uses to pick the thread scaling
+	bool bIndex = false;
+	bool bAnalyzer = false;
+	for ( const auto & i : dSIInfo )
+		switch ( i.m_eType )
+		{
+		case SecondaryIndexType_e::LOOKUP:		return CostPath_e::LOOKUP;
+		case SecondaryIndexType_e::INDEX:		bIndex = true; break;
+		case SecondaryIndexType_e::ANALYZER:	bAnalyzer = true; break;
+		default: break;
+		}
 
-	return EstimateMTCost ( fCost, iThreads, fKPerf, fBPerf );
+	if ( bIndex )
+		return CostPath_e::SECONDARY;
+
+	return bAnalyzer ? CostPath_e::COLUMNAR : CostPath_e::SCAN;
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -97,33 +676,24 @@ public:
 private:
 	static constexpr float SCALE = 1.0f/1000000.0f;
 
-	static constexpr float COST_PUSH					= 6.0f;
-	static constexpr float COST_PUSH_IG					= 3.0f;
-	static constexpr float COST_FILTER					= 8.5f;
-	static constexpr float COST_COLUMNAR_FILTER			= 4.0f;
-	static constexpr float COST_INDEX_READ_SINGLE		= 4.0f;
-	static constexpr float COST_INDEX_READ_BITMAP		= 4.5f;
-	static constexpr float COST_INDEX_UNION_COEFF		= 4.0f;
-	static constexpr float COST_LOOKUP_READ				= 20.0f;
-	static constexpr float COST_INDEX_ITERATOR_INIT		= 30.0f;
-	static constexpr float COST_ITERATOR_INTERSECT		= 20.0f;
-
 	const CSphVector<SecondaryIndexInfo_t> &	m_dSIInfo;
 	const SelectIteratorCtx_t &					m_tCtx;
 	int											m_iCutoff = -1;
 	CSphVector<int>								m_dSorted;
 
-	static float	Cost_Filter ( int64_t iDocs, float fComplexity )		{ return COST_FILTER*fComplexity*iDocs*SCALE; }
-	static float	Cost_BlockFilter ( int64_t iDocs, float fComplexity )	{ return Cost_Filter ( iDocs/DOCINFO_INDEX_FREQ, fComplexity ); }
-	static float	Cost_ColumnarFilter ( int64_t iDocs, float fComplexity ){ return COST_COLUMNAR_FILTER*fComplexity*iDocs*SCALE; }
-	static float	Cost_Push ( int64_t iDocs )								{ return COST_PUSH*iDocs*SCALE; }
-	static float	Cost_PushImplicitGroupby ( int64_t iDocs )				{ return COST_PUSH_IG*iDocs*SCALE; }
+	float	Coeff ( CostCoeff_e eCoeff ) const								{ return m_tCtx.m_tCoeffs[eCoeff]; }
 
-	static float	Cost_IndexReadSingle ( int64_t iDocs )					{ return COST_INDEX_READ_SINGLE*iDocs*SCALE; }
-	static float	Cost_IndexReadBitmap ( int64_t iDocs )					{ return COST_INDEX_READ_BITMAP*iDocs*SCALE; }
-	static float	Cost_IndexUnionQueue ( int64_t iDocs )					{ return COST_INDEX_UNION_COEFF*iDocs*log2f(iDocs)*SCALE; }
-	static float	Cost_LookupRead ( int64_t iDocs )						{ return COST_LOOKUP_READ*iDocs*SCALE; }
-	static float	Cost_IndexIteratorInit ( int64_t iNumIterators )		{ return COST_INDEX_ITERATOR_INIT*iNumIterators*SCALE; }
+	float	Cost_Filter ( int64_t iDocs, float fComplexity ) const			{ return Coeff ( CostCoeff_e::FILTER )*fComplexity*iDocs*SCALE; }
+	float	Cost_BlockFilter ( int64_t iDocs, float fComplexity ) const		{ return Cost_Filter ( iDocs/DOCINFO_INDEX_FREQ, fComplexity ); }
+	float	Cost_ColumnarFilter ( int64_t iDocs, float fComplexity ) const	{ return Coeff ( CostCoeff_e::COLUMNAR_FILTER )*fComplexity*iDocs*SCALE; }
+	float	Cost_Push ( int64_t iDocs ) const								{ return Coeff ( CostCoeff_e::PUSH )*iDocs*SCALE; }
+	float	Cost_PushImplicitGroupby ( int64_t iDocs ) const				{ return Coeff ( CostCoeff_e::PUSH_IG )*iDocs*SCALE; }
+
+	float	Cost_IndexReadSingle ( int64_t iDocs ) const					{ return Coeff ( CostCoeff_e::INDEX_READ_SINGLE )*iDocs*SCALE; }
+	float	Cost_IndexReadBitmap ( int64_t iDocs ) const					{ return Coeff ( CostCoeff_e::INDEX_READ_BITMAP )*iDocs*SCALE; }
+	float	Cost_IndexUnionQueue ( int64_t iDocs ) const					{ return Coeff ( CostCoeff_e::INDEX_UNION )*iDocs*log2f(iDocs)*SCALE; }
+	float	Cost_LookupRead ( int64_t iDocs ) const							{ return Coeff ( CostCoeff_e::LOOKUP_READ )*iDocs*SCALE; }
+	float	Cost_IndexIteratorInit ( int64_t iNumIterators ) const			{ return Coeff ( CostCoeff_e::INDEX_ITERATOR_INIT )*iNumIterators*SCALE; }
 
 	float	CalcFilterCost ( const SecondaryIndexInfo_t & tIndex, const CSphFilterSettings & tFilter, bool bFromIterator, bool bFilterOverExpr, float fDocsLeft ) const;
 	float	CalcLookupCost ( const SecondaryIndexInfo_t & tIndex ) const;
@@ -132,9 +702,9 @@ private:
 
 	float	CalcIteratorIntersectCost ( float fFirstIteratorDocs, int iNumIterators );
 	float	CalcPushCost ( float fDocsAfterFilters ) const;
-	float	CalcMTCost ( float fCost ) const	{ return EstimateMTCost ( fCost, m_tCtx.m_iThreads );}
-	float	CalcMTCostCS ( float fCost ) const	{ return EstimateMTCostCS ( fCost, m_tCtx.m_iThreads );}
-	float	CalcMTCostSI ( float fCost ) const	{ return EstimateMTCostSI ( fCost, m_tCtx.m_iThreads ); }
+	float	CalcMTCost ( float fCost ) const	{ return EstimateMTCost ( fCost, m_tCtx.m_iThreads, Coeff ( CostCoeff_e::MT_K ), Coeff ( CostCoeff_e::MT_B ) ); }
+	float	CalcMTCostCS ( float fCost ) const	{ return EstimateMTCost ( fCost, m_tCtx.m_iThreads, Coeff ( CostCoeff_e::MT_CS_K ), Coeff ( CostCoeff_e::MT_CS_B ) ); }
+	float	CalcMTCostSI ( float fCost ) const	{ return EstimateMTCost ( fCost, m_tCtx.m_iThreads, Coeff ( CostCoeff_e::MT_SI_K ), Coeff ( CostCoeff_e::MT_SI_B ) ); }
 
 	bool	IsGeodistFilter ( const CSphFilterSettings & tFilter ) const;
 	float	CalcGetFilterComplexity ( const SecondaryIndexInfo_t & tSIInfo, const CSphFilterSettings & tFilter ) const;
@@ -305,6 +875,11 @@ float CostEstimate_c::CalcIndexCost ( const SecondaryIndexInfo_t & tIndex, const
 		fCost += Cost_IndexReadBitmap(iDocs); // read all docs (when constructing the bitmap), not only the ones left
 
 	fCost += Cost_IndexIteratorInit(uNumIterators);
+
+	// json_columns index returns candidates; the json filter still runs on them
+	if ( sphIsJsonTypedColumnAttr ( tFilter.m_sAttrName ) )
+		fCost += Cost_Filter ( iDocsToRead, CalcGetFilterComplexity ( tIndex, tFilter ) );
+
 	return fCost;
 }
 
@@ -346,7 +921,7 @@ bool CostEstimate_c::IsFilterOverExpr ( int iIndex ) const
 float CostEstimate_c::CalcIteratorIntersectCost ( float fFirstIteratorDocs, int iNumIterators )
 {
 	int64_t iDocs = fFirstIteratorDocs*m_tCtx.m_iTotalDocs;
-	return COST_ITERATOR_INTERSECT*iDocs*(iNumIterators-1)*SCALE;
+	return Coeff ( CostCoeff_e::ITERATOR_INTERSECT )*iDocs*(iNumIterators-1)*SCALE;
 }
 
 
@@ -443,6 +1018,7 @@ SelectIteratorCtx_t::SelectIteratorCtx_t ( const CSphQuery & tQuery, const CSphV
 	, m_iCutoff ( iCutoff )
 	, m_iTotalDocs ( iTotalDocs )
 	, m_iThreads ( iThreads )
+	, m_tCoeffs ( GetCostCoeffs() )
 {}
 
 
@@ -476,6 +1052,10 @@ bool SelectIteratorCtx_t::IsEnabled_SI ( const CSphFilterSettings & tFilter ) co
 
 bool SelectIteratorCtx_t::IsEnabled_Analyzer ( const CSphFilterSettings & tFilter ) const
 {
+	// columnar analyzers can't fetch json_columns candidates that need a re-check against json
+	if ( sphIsJsonTypedColumnAttr ( tFilter.m_sAttrName ) )
+		return false;
+
 	auto pAttr = m_tIndexSchema.GetAttr ( tFilter.m_sAttrName.cstr() );
 	return pAttr && ( pAttr->IsColumnar() || pAttr->IsColumnarExpr() );
 }
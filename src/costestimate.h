@@ -20,6 +20,73 @@ public:
 	virtual float	CalcQueryCost() = 0;
 };
 
+/// cost model coefficients; per-doc costs are in nanoseconds, *_K/*_B describe thread scaling (perf = K*threads + B)
+enum class CostCoeff_e : int
+{
+	PUSH,
+	PUSH_IG,
+	FILTER,
+	COLUMNAR_FILTER,
+	INDEX_READ_SINGLE,
+	INDEX_READ_BITMAP,
+	INDEX_UNION,
+	LOOKUP_READ,
+	INDEX_ITERATOR_INIT,
+	ITERATOR_INTERSECT,
+	MT_K,
+	MT_B,
+	MT_CS_K,
+	MT_CS_B,
+	MT_SI_K,
+	MT_SI_B,
+	MT_SIFT_K,
+	MT_SIFT_B,
+
+	TOTAL
+};
+
+struct CostCoeffs_t
+{
+	float	m_dCoeffs[(int)CostCoeff_e::TOTAL];
+
+	float	operator[] ( CostCoeff_e eCoeff ) const	{ return m_dCoeffs[(int)eCoeff]; }
+	float &	operator[] ( CostCoeff_e eCoeff )		{ return m_dCoeffs[(int)eCoeff]; }
+};
+
+/// access path a query was executed with; runtime feedback is collected per path
+enum class CostPath_e : int
+{
+	SCAN,
+	COLUMNAR,
+	SECONDARY,
+	LOOKUP,
+
+	TOTAL
+};
+
+/// what the planner picked and how long it expected it to run
+struct CostPlan_t
+{
+	CostPath_e	m_ePath = CostPath_e::SCAN;
+	float		m_fCost = 0.0f;	// msec, single-threaded, for the rows this scan covers (i.e. one pseudo-shard)
+};
+
+const CostCoeffs_t &	GetDefaultCostCoeffs();
+CostCoeffs_t		GetCostCoeffs();
+void				SetCostCoeffs ( const CostCoeffs_t & tCoeffs );
+const char *		GetCostCoeffName ( CostCoeff_e eCoeff );
+
+bool				LoadCostCoeffs ( const CSphString & sFile, CSphString & sError );
+bool				SaveCostCoeffs ( const CSphString & sFile, CSphString & sError );
+
+/// run micro-benchmarks on this box and return coefficients derived from them (does not apply them)
+CostCoeffs_t		CalibrateCostCoeffs();
+
+/// runtime feedback: compare the planner's estimate with the actual elapsed time and slowly adjust the path's coefficients
+void				SetCostFeedback ( bool bEnabled );
+bool				IsCostFeedbackEnabled();
+void				CostFeedback ( const CostPlan_t & tPlan, int64_t iElapsedUs );
+
 float EstimateMTCost ( float fCost, int iThreads );
 float EstimateMTCostCS ( float fCost, int iThreads );
 float EstimateMTCostSI ( float fCost, int iThreads );
@@ -37,6 +104,7 @@ struct SecondaryIndexInfo_t
 	bool					m_bHasHistograms = false;
 	bool					m_bUsable = false;
 	bool					m_bCreated = false;
+	bool					m_bKeepFilter = false;	// iterator returns candidates only (json_columns); the filter still runs on them
 };
 
 namespace SI
@@ -58,6 +126,7 @@ struct SelectIteratorCtx_t
 	int										m_iThreads = 1;
 	bool									m_bCalcPushCost = true;
 	bool									m_bFromIterator = false;
+	CostCoeffs_t							m_tCoeffs;
 
 			SelectIteratorCtx_t ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, const HistogramContainer_c * pHistograms, columnar::Columnar_i * pColumnar, SI::Index_i * pSI, int iCutoff, int64_t iTotalDocs, int iThreads );
 
@@ -66,6 +135,8 @@ struct SelectIteratorCtx_t
 	void	IgnorePushCost() { m_bCalcPushCost = false; }
 };
 
+CostPath_e			GetCostPath ( const CSphVector<SecondaryIndexInfo_t> & dSIInfo );
+
 struct NodeEstimate_t;
 CostEstimate_i *	CreateCostEstimate ( const CSphVector<SecondaryIndexInfo_t> & dSIInfo, const SelectIteratorCtx_t & tCtx, int iCutoff );
 float				CalcFTIntersectCost ( const NodeEstimate_t & tEst1, const NodeEstimate_t & tEst2, int64_t iTotalDocs, int iDocsPerBlock1, int iDocsPerBlock2 );
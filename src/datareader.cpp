@@ -152,13 +152,28 @@ SphOffset_t	ThinMMapReader_c::GetOffset()
 
 DWORD ThinMMapReader_c::UnzipInt()
 {
+	// fast path: far enough from the end of map, so range check on every byte is not necessary
+	if ( m_pPointer>=m_pBase && m_pBase+m_iSize-m_pPointer>=ZIPPED_INT_MAXLEN )
+		return UnzipIntBE ( m_pPointer );
+
 	return UnzipValueBE<DWORD> ( [this]() mutable { return GetByte(); } );
 }
 
 
 uint64_t ThinMMapReader_c::UnzipOffset()
 {
-	return UnzipValueBE<uint64_t> ( [this]() mutable { return GetByte(); } );
+	uint64_t uRes = 0;
+	if ( m_pPointer>=m_pBase && m_pBase+m_iSize-m_pPointer>=ZIPPED_OFFSET_MAXLEN && UnzipOffsetBEBounded ( m_pPointer, uRes ) )
+		return uRes;
+
+	// near the end of map, or a corrupted value longer than ZIPPED_OFFSET_MAXLEN; go on with range checks
+	BYTE b;
+	do
+	{
+		b = GetByte();
+		uRes = ( uRes << 7 ) | ( b & 0x7f );
+	} while ( b & 0x80 );
+	return uRes;
 }
 
 //////////////////////////////////////////////////////////////////////////
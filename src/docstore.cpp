@@ -21,6 +21,11 @@
 #include "sphinxint.h"
 #include "exprtraits.h"
 
+#if WITH_ZSTD
+	#include <zstd.h>
+	#include <zdict.h>
+#endif
+
 enum BlockFlags_e : BYTE
 {
 	BLOCK_FLAG_COMPRESSED		= 1 << 0,
@@ -46,7 +51,9 @@ enum FieldFlags_e : BYTE
 	FIELD_FLAG_EMPTY		= 1 << 1
 };
 
-static const int STORAGE_VERSION = 1;
+static const int STORAGE_VERSION = 2;	// v.2 added zstd compression (with the dictionary in the trailing header)
+static const int STORAGE_VERSION_NODICT = 1;
+static const int MAX_DICT_SIZE = 112640;	// compression dictionary size limit; same as zstd cli default
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -57,6 +64,7 @@ static BYTE Compression2Byte ( Compression_e eComp )
 	case Compression_e::NONE:	return 0;
 	case Compression_e::LZ4:	return 1;
 	case Compression_e::LZ4HC:	return 2;
+	case Compression_e::ZSTD:	return 3;
 	default:
 		assert ( 0 && "Unknown compression type" );
 		return 0;
@@ -71,6 +79,7 @@ static Compression_e Byte2Compression ( BYTE uComp )
 	case 0:		return Compression_e::NONE;
 	case 1:		return Compression_e::LZ4;
 	case 2:		return Compression_e::LZ4HC;
+	case 3:		return Compression_e::ZSTD;
 	default:
 		assert ( 0 && "Unknown compression type" );
 		return Compression_e::NONE;
@@ -99,6 +108,12 @@ static void PackData ( CSphVector<BYTE> & dDst, const BYTE * pData, DWORD uSize,
 }
 
 
+/// dictionary size read from the header must fit into the rest of the file, and can't be bigger than we ever write
+static bool IsDictSizeValid ( DWORD uDictSize, SphOffset_t tPos, SphOffset_t tFileSize )
+{
+	return uDictSize<=(DWORD)MAX_DICT_SIZE && tPos+uDictSize<=tFileSize;
+}
+
 //////////////////////////////////////////////////////////////////////////
 class Compressor_i
 {
@@ -107,6 +122,12 @@ public:
 
 	virtual bool	Compress ( const VecTraits_T<BYTE> & dUncompressed, CSphVector<BYTE> & dCompressed ) const = 0;
 	virtual bool	Decompress ( const VecTraits_T<BYTE> & dCompressed, VecTraits_T<BYTE> & dDecompressed ) const = 0;
+
+	// compressors that use a dictionary get it trained by the builder and stored in the docstore header
+	virtual bool	UsesDictionary() const { return false; }
+	virtual bool	TrainDictionary ( const VecTraits_T<BYTE> & dSamples, const VecTraits_T<size_t> & dSampleSizes ) { return false; }
+	virtual bool	SetDictionary ( const VecTraits_T<BYTE> & dDict ) { return false; }
+	virtual VecTraits_T<BYTE> GetDictionary() const { return {}; }
 };
 
 
@@ -184,12 +205,221 @@ int	Compressor_LZ4HC_c::DoCompression ( const VecTraits_T<BYTE> & dUncompressed,
 }
 
 
+#if WITH_ZSTD
+
+#if DL_ZSTD
+
+static decltype ( &ZSTD_createCCtx ) sph_ZSTD_createCCtx = nullptr;
+static decltype ( &ZSTD_createDCtx ) sph_ZSTD_createDCtx = nullptr;
+static decltype ( &ZSTD_freeCCtx ) sph_ZSTD_freeCCtx = nullptr;
+static decltype ( &ZSTD_freeDCtx ) sph_ZSTD_freeDCtx = nullptr;
+static decltype ( &ZSTD_compressBound ) sph_ZSTD_compressBound = nullptr;
+static decltype ( &ZSTD_compressCCtx ) sph_ZSTD_compressCCtx = nullptr;
+static decltype ( &ZSTD_decompressDCtx ) sph_ZSTD_decompressDCtx = nullptr;
+static decltype ( &ZSTD_createCDict ) sph_ZSTD_createCDict = nullptr;
+static decltype ( &ZSTD_createDDict ) sph_ZSTD_createDDict = nullptr;
+static decltype ( &ZSTD_freeCDict ) sph_ZSTD_freeCDict = nullptr;
+static decltype ( &ZSTD_freeDDict ) sph_ZSTD_freeDDict = nullptr;
+static decltype ( &ZSTD_compress_usingCDict ) sph_ZSTD_compress_usingCDict = nullptr;
+static decltype ( &ZSTD_decompress_usingDDict ) sph_ZSTD_decompress_usingDDict = nullptr;
+static decltype ( &ZSTD_isError ) sph_ZSTD_isError = nullptr;
+static decltype ( &ZDICT_trainFromBuffer ) sph_ZDICT_trainFromBuffer = nullptr;
+static decltype ( &ZDICT_isError ) sph_ZDICT_isError = nullptr;
+
+static bool InitDynamicZstd()
+{
+	const char * sFuncs[] = { "ZSTD_createCCtx", "ZSTD_createDCtx", "ZSTD_freeCCtx", "ZSTD_freeDCtx", "ZSTD_compressBound",
+		"ZSTD_compressCCtx", "ZSTD_decompressDCtx", "ZSTD_createCDict", "ZSTD_createDDict", "ZSTD_freeCDict", "ZSTD_freeDDict",
+		"ZSTD_compress_usingCDict", "ZSTD_decompress_usingDDict", "ZSTD_isError", "ZDICT_trainFromBuffer", "ZDICT_isError" };
+
+	void ** pFuncs[] = { (void**)&sph_ZSTD_createCCtx, (void**)&sph_ZSTD_createDCtx, (void**)&sph_ZSTD_freeCCtx, (void**)&sph_ZSTD_freeDCtx, (void**)&sph_ZSTD_compressBound,
+		(void**)&sph_ZSTD_compressCCtx, (void**)&sph_ZSTD_decompressDCtx, (void**)&sph_ZSTD_createCDict, (void**)&sph_ZSTD_createDDict, (void**)&sph_ZSTD_freeCDict, (void**)&sph_ZSTD_freeDDict,
+		(void**)&sph_ZSTD_compress_usingCDict, (void**)&sph_ZSTD_decompress_usingDDict, (void**)&sph_ZSTD_isError, (void**)&sph_ZDICT_trainFromBuffer, (void**)&sph_ZDICT_isError };
+
+	static CSphDynamicLibrary dLib ( ZSTD_LIB );
+	return dLib.LoadSymbols ( sFuncs, pFuncs, sizeof ( pFuncs ) / sizeof ( void** ) );
+}
+
+#else
+
+#define sph_ZSTD_createCCtx ZSTD_createCCtx
+#define sph_ZSTD_createDCtx ZSTD_createDCtx
+#define sph_ZSTD_freeCCtx ZSTD_freeCCtx
+#define sph_ZSTD_freeDCtx ZSTD_freeDCtx
+#define sph_ZSTD_compressBound ZSTD_compressBound
+#define sph_ZSTD_compressCCtx ZSTD_compressCCtx
+#define sph_ZSTD_decompressDCtx ZSTD_decompressDCtx
+#define sph_ZSTD_createCDict ZSTD_createCDict
+#define sph_ZSTD_createDDict ZSTD_createDDict
+#define sph_ZSTD_freeCDict ZSTD_freeCDict
+#define sph_ZSTD_freeDDict ZSTD_freeDDict
+#define sph_ZSTD_compress_usingCDict ZSTD_compress_usingCDict
+#define sph_ZSTD_decompress_usingDDict ZSTD_decompress_usingDDict
+#define sph_ZSTD_isError ZSTD_isError
+#define sph_ZDICT_trainFromBuffer ZDICT_trainFromBuffer
+#define sph_ZDICT_isError ZDICT_isError
+#define InitDynamicZstd() ( true )
+
+#endif
+
+static bool IsZstdAvailable()
+{
+	static bool bZstdLoaded = InitDynamicZstd();
+	return bZstdLoaded;
+}
+
+/// decompression contexts are per-thread, as readers decompress blocks concurrently
+static ZSTD_DCtx * GetThreadZstdDCtx()
+{
+	struct DCtxHolder_t
+	{
+		ZSTD_DCtx * m_pCtx = nullptr;
+		~DCtxHolder_t() { if ( m_pCtx ) sph_ZSTD_freeDCtx ( m_pCtx ); }
+	};
+
+	static thread_local DCtxHolder_t tHolder;
+	if ( !tHolder.m_pCtx )
+		tHolder.m_pCtx = sph_ZSTD_createDCtx();
+
+	return tHolder.m_pCtx;
+}
+
+
+class Compressor_ZSTD_c : public Compressor_i
+{
+public:
+					Compressor_ZSTD_c ( int iCompressionLevel ) : m_iCompressionLevel ( iCompressionLevel ) {}
+					~Compressor_ZSTD_c() override;
+
+	bool			Compress ( const VecTraits_T<BYTE> & dUncompressed, CSphVector<BYTE> & dCompressed ) const final;
+	bool			Decompress ( const VecTraits_T<BYTE> & dCompressed, VecTraits_T<BYTE> & dDecompressed ) const final;
+
+	bool			UsesDictionary() const final { return true; }
+	bool			TrainDictionary ( const VecTraits_T<BYTE> & dSamples, const VecTraits_T<size_t> & dSampleSizes ) final;
+	bool			SetDictionary ( const VecTraits_T<BYTE> & dDict ) final;
+	VecTraits_T<BYTE> GetDictionary() const final { return m_dDict; }
+
+private:
+	int				m_iCompressionLevel = DEFAULT_COMPRESSION_LEVEL;
+	mutable ZSTD_CCtx * m_pCCtx = nullptr;		// compression is only done by the builder (single thread)
+	ZSTD_CDict *	m_pCDict = nullptr;
+	ZSTD_DDict *	m_pDDict = nullptr;
+	CSphVector<BYTE> m_dDict;
+
+	void			ResetDictionary();
+};
+
+
+Compressor_ZSTD_c::~Compressor_ZSTD_c()
+{
+	ResetDictionary();
+	if ( m_pCCtx )
+		sph_ZSTD_freeCCtx ( m_pCCtx );
+}
+
+
+void Compressor_ZSTD_c::ResetDictionary()
+{
+	if ( m_pCDict )
+		sph_ZSTD_freeCDict ( m_pCDict );
+
+	if ( m_pDDict )
+		sph_ZSTD_freeDDict ( m_pDDict );
+
+	m_pCDict = nullptr;
+	m_pDDict = nullptr;
+	m_dDict.Reset();
+}
+
+
+bool Compressor_ZSTD_c::Compress ( const VecTraits_T<BYTE> & dUncompressed, CSphVector<BYTE> & dCompressed ) const
+{
+	const int MIN_COMPRESSIBLE_SIZE = 64;
+	if ( dUncompressed.GetLength() < MIN_COMPRESSIBLE_SIZE )
+		return false;
+
+	if ( !m_pCCtx )
+		m_pCCtx = sph_ZSTD_createCCtx();
+
+	dCompressed.Resize ( (int64_t)sph_ZSTD_compressBound ( dUncompressed.GetLength() ) );
+	size_t uRes;
+	if ( m_pCDict )
+		uRes = sph_ZSTD_compress_usingCDict ( m_pCCtx, dCompressed.Begin(), dCompressed.GetLength(), dUncompressed.Begin(), dUncompressed.GetLength(), m_pCDict );
+	else
+		uRes = sph_ZSTD_compressCCtx ( m_pCCtx, dCompressed.Begin(), dCompressed.GetLength(), dUncompressed.Begin(), dUncompressed.GetLength(), m_iCompressionLevel );
+
+	const float WORST_COMPRESSION_RATIO = 0.95f;
+	if ( sph_ZSTD_isError(uRes) || float(uRes)/dUncompressed.GetLength() > WORST_COMPRESSION_RATIO )
+		return false;
+
+	dCompressed.Resize ( (int64_t)uRes );
+	return true;
+}
+
+
+bool Compressor_ZSTD_c::Decompress ( const VecTraits_T<BYTE> & dCompressed, VecTraits_T<BYTE> & dDecompressed ) const
+{
+	ZSTD_DCtx * pCtx = GetThreadZstdDCtx();
+	if ( !pCtx )
+		return false;
+
+	size_t uRes;
+	if ( m_pDDict )
+		uRes = sph_ZSTD_decompress_usingDDict ( pCtx, dDecompressed.Begin(), dDecompressed.GetLength(), dCompressed.Begin(), dCompressed.GetLength(), m_pDDict );
+	else
+		uRes = sph_ZSTD_decompressDCtx ( pCtx, dDecompressed.Begin(), dDecompressed.GetLength(), dCompressed.Begin(), dCompressed.GetLength() );
+
+	return !sph_ZSTD_isError(uRes) && uRes==(size_t)dDecompressed.GetLength();
+}
+
+
+bool Compressor_ZSTD_c::TrainDictionary ( const VecTraits_T<BYTE> & dSamples, const VecTraits_T<size_t> & dSampleSizes )
+{
+	// zstd needs a decent amount of samples; fall back to plain zstd otherwise
+	const int MIN_SAMPLES = 8;
+	if ( dSampleSizes.GetLength()<MIN_SAMPLES )
+		return false;
+
+	CSphVector<BYTE> dDict ( Min ( MAX_DICT_SIZE, Max ( dSamples.GetLength()/10, 1024 ) ) );
+	size_t uDictSize = sph_ZDICT_trainFromBuffer ( dDict.Begin(), dDict.GetLength(), dSamples.Begin(), dSampleSizes.Begin(), dSampleSizes.GetLength() );
+	if ( sph_ZDICT_isError(uDictSize) )
+		return false;
+
+	dDict.Resize ( (int64_t)uDictSize );
+	return SetDictionary(dDict);
+}
+
+
+bool Compressor_ZSTD_c::SetDictionary ( const VecTraits_T<BYTE> & dDict )
+{
+	ResetDictionary();
+	if ( dDict.IsEmpty() )
+		return true;
+
+	m_dDict.Append(dDict);
+	m_pCDict = sph_ZSTD_createCDict ( m_dDict.Begin(), m_dDict.GetLength(), m_iCompressionLevel );
+	m_pDDict = sph_ZSTD_createDDict ( m_dDict.Begin(), m_dDict.GetLength() );
+	if ( m_pCDict && m_pDDict )
+		return true;
+
+	ResetDictionary();
+	return false;
+}
+
+#endif // WITH_ZSTD
+
+
 std::unique_ptr<Compressor_i> CreateCompressor ( Compression_e eComp, int iCompressionLevel )
 {
 	switch (  eComp )
 	{
 		case Compression_e::LZ4:	return std::make_unique<Compressor_LZ4_c>();
 		case Compression_e::LZ4HC:	return std::make_unique<Compressor_LZ4HC_c> ( iCompressionLevel );
+#if WITH_ZSTD
+		case Compression_e::ZSTD:	return IsZstdAvailable() ? std::make_unique<Compressor_ZSTD_c> ( iCompressionLevel ) : nullptr;
+#else
+		case Compression_e::ZSTD:	return nullptr;
+#endif
 		default:					return std::make_unique<Compressor_None_c>();
 	}
 }
@@ -316,24 +546,212 @@ struct BlockUtil_t
 };
 
 
-class BlockCache_c : public LRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>
+/// TinyLFU-style frequency estimator: a count-min sketch of small saturating counters
+/// counters are halved every m_iSampleSize hits, so the estimate follows recent popularity
+/// updates are relaxed and unlocked; a lost increment only makes an estimate slightly off
+class FrequencySketch_c
+{
+public:
+	explicit	FrequencySketch_c ( int iEntries );
+
+	void		Touch ( DWORD uHash );
+	int			Estimate ( DWORD uHash ) const;
+
+private:
+	static const int	DEPTH = 4;
+	static const BYTE	MAX_COUNTER = 15;
+
+	CSphFixedVector<std::atomic<BYTE>>	m_dCounters {0};	///< DEPTH rows of (m_uMask+1) counters
+	DWORD				m_uMask = 0;
+	int					m_iSampleSize = 0;
+	std::atomic<int>	m_iAdditions {0};
+
+	DWORD		GetIndex ( DWORD uHash, int iRow ) const;
+	void		Age();
+};
+
+
+FrequencySketch_c::FrequencySketch_c ( int iEntries )
 {
-	using BASE = LRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>;
-	using BASE::BASE;
+	int iWidth = 256;
+	while ( iWidth < iEntries )
+		iWidth <<= 1;
+
+	m_uMask = iWidth-1;
+	m_iSampleSize = iWidth*10;
+	m_dCounters.Reset ( iWidth*DEPTH );
+	for ( auto & i : m_dCounters )
+		i.store ( 0, std::memory_order_relaxed );
+}
+
+
+DWORD FrequencySketch_c::GetIndex ( DWORD uHash, int iRow ) const
+{
+	static const DWORD dSeeds[DEPTH] = { 0x9E3779B1, 0x85EBCA77, 0xC2B2AE3D, 0x27D4EB2F };
+	DWORD uRowHash = uHash*dSeeds[iRow];
+	uRowHash ^= uRowHash >> 15;
+	return iRow*( m_uMask+1 ) + ( uRowHash & m_uMask );
+}
+
+
+void FrequencySketch_c::Touch ( DWORD uHash )
+{
+	for ( int i = 0; i < DEPTH; i++ )
+	{
+		auto & tCounter = m_dCounters[GetIndex ( uHash, i )];
+		BYTE uValue = tCounter.load ( std::memory_order_relaxed );
+		if ( uValue < MAX_COUNTER )
+			tCounter.store ( uValue+1, std::memory_order_relaxed );
+	}
+
+	if ( m_iAdditions.fetch_add ( 1, std::memory_order_relaxed )+1==m_iSampleSize )
+	{
+		Age();
+		m_iAdditions.store ( 0, std::memory_order_relaxed );
+	}
+}
+
+
+int FrequencySketch_c::Estimate ( DWORD uHash ) const
+{
+	int iMin = MAX_COUNTER;
+	for ( int i = 0; i < DEPTH; i++ )
+		iMin = Min ( iMin, (int)m_dCounters[GetIndex ( uHash, i )].load ( std::memory_order_relaxed ) );
+
+	return iMin;
+}
+
+
+void FrequencySketch_c::Age()
+{
+	for ( auto & i : m_dCounters )
+		i.store ( i.load ( std::memory_order_relaxed ) >> 1, std::memory_order_relaxed );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/// global cache of uncompressed docstore blocks
+/// split into hash-partitioned shards (each with its own lock and LRU list) to reduce lock contention;
+/// a new block only evicts blocks that were requested less often than itself (TinyLFU admission),
+/// so one-off blocks from a full scan do not flush the frequently reused ones
+class BlockCache_c
+{
+	using LRU_c = LRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>;
 
 public:
-	void					DeleteAll ( int64_t iIndexId ) { BASE::Delete ( [iIndexId]( const HashKey_t & tKey ){ return tKey.m_iIndexId==iIndexId; } ); }
+	explicit				BlockCache_c ( int64_t iCacheSize );
+
+	bool					Find ( const HashKey_t & tKey, BlockData_t & tData );
+	bool					Add ( const HashKey_t & tKey, const BlockData_t & tData );
+	void					Release ( const HashKey_t & tKey );
+	void					DeleteAll ( int64_t iIndexId );
+	void					GetStatus ( DocstoreCacheStatus_t & tStatus );
 
 	static void				Init ( int64_t iCacheSize );
 	static void				Done()	{ SafeDelete(m_pBlockCache); }
 	static BlockCache_c *	Get()	{ return m_pBlockCache; }
 
 private:
-	static BlockCache_c *	m_pBlockCache;
+	static const int64_t	MIN_SHARD_SIZE = 4*1024*1024;
+	static const int		MAX_SHARDS = 16;
+	static const int		AVG_BLOCK_SIZE = 4096;
+
+	struct Shard_t
+	{
+		std::unique_ptr<LRU_c>				m_pLRU;
+		std::unique_ptr<FrequencySketch_c>	m_pSketch;
+	};
+
+	CSphFixedVector<Shard_t>	m_dShards {0};
+	int64_t						m_iCacheSize = 0;
+	std::atomic<int64_t>		m_iHits {0};
+	std::atomic<int64_t>		m_iMisses {0};
+	std::atomic<int64_t>		m_iRejected {0};
+
+	static BlockCache_c *		m_pBlockCache;
+
+	Shard_t &				GetShard ( DWORD uHash ) { return m_dShards[( uHash>>24 ) & ( m_dShards.GetLength()-1 )]; }
 };
 
 BlockCache_c * BlockCache_c::m_pBlockCache = nullptr;
 
+
+BlockCache_c::BlockCache_c ( int64_t iCacheSize )
+	: m_iCacheSize ( iCacheSize )
+{
+	int iShards = 1;
+	while ( iShards < MAX_SHARDS && iCacheSize/( iShards*2 ) >= MIN_SHARD_SIZE )
+		iShards <<= 1;
+
+	int64_t iShardSize = iCacheSize/iShards;
+	m_dShards.Reset(iShards);
+	for ( auto & tShard : m_dShards )
+	{
+		tShard.m_pLRU = std::make_unique<LRU_c>(iShardSize);
+		tShard.m_pSketch = std::make_unique<FrequencySketch_c> ( (int)Min ( iShardSize/AVG_BLOCK_SIZE, 1 << 20 ) );
+	}
+}
+
+
+bool BlockCache_c::Find ( const HashKey_t & tKey, BlockData_t & tData )
+{
+	DWORD uHash = BlockUtil_t::GetHash(tKey);
+	Shard_t & tShard = GetShard(uHash);
+
+	// every lookup counts towards the popularity of a block, cached or not
+	tShard.m_pSketch->Touch(uHash);
+
+	bool bFound = tShard.m_pLRU->Find ( tKey, tData );
+	if ( bFound )
+		m_iHits.fetch_add ( 1, std::memory_order_relaxed );
+	else
+		m_iMisses.fetch_add ( 1, std::memory_order_relaxed );
+
+	return bFound;
+}
+
+
+bool BlockCache_c::Add ( const HashKey_t & tKey, const BlockData_t & tData )
+{
+	DWORD uHash = BlockUtil_t::GetHash(tKey);
+	Shard_t & tShard = GetShard(uHash);
+
+	int iCandidate = tShard.m_pSketch->Estimate(uHash);
+	const FrequencySketch_c & tSketch = *tShard.m_pSketch;
+	bool bAdded = tShard.m_pLRU->Add ( tKey, tData, [iCandidate, &tSketch]( const HashKey_t & tVictim ){ return iCandidate > tSketch.Estimate ( BlockUtil_t::GetHash(tVictim) ); } );
+	if ( !bAdded )
+		m_iRejected.fetch_add ( 1, std::memory_order_relaxed );
+
+	return bAdded;
+}
+
+
+void BlockCache_c::Release ( const HashKey_t & tKey )
+{
+	GetShard ( BlockUtil_t::GetHash(tKey) ).m_pLRU->Release(tKey);
+}
+
+
+void BlockCache_c::DeleteAll ( int64_t iIndexId )
+{
+	for ( auto & tShard : m_dShards )
+		tShard.m_pLRU->Delete ( [iIndexId]( const HashKey_t & tKey ){ return tKey.m_iIndexId==iIndexId; } );
+}
+
+
+void BlockCache_c::GetStatus ( DocstoreCacheStatus_t & tStatus )
+{
+	tStatus.m_iHits = m_iHits.load ( std::memory_order_relaxed );
+	tStatus.m_iMisses = m_iMisses.load ( std::memory_order_relaxed );
+	tStatus.m_iRejected = m_iRejected.load ( std::memory_order_relaxed );
+	tStatus.m_iMaxBytes = m_iCacheSize;
+	tStatus.m_iUsedBytes = 0;
+	tStatus.m_iShards = m_dShards.GetLength();
+	for ( auto & tShard : m_dShards )
+		tStatus.m_iUsedBytes += tShard.m_pLRU->GetMemUsed();
+}
+
+
 void BlockCache_c::Init ( int64_t iCacheSize )
 {
 	assert ( !m_pBlockCache );
@@ -527,6 +945,7 @@ public:
 	void				CreateReader ( int64_t iSessionId ) const final;
 	DocstoreDoc_t		GetDoc ( RowID_t tRowID, const VecTraits_T<int> * pFieldIds, int64_t iSessionId, bool bPack ) const final;
 	DocstoreSettings_t	GetDocstoreSettings() const final;
+	void				GetCacheStats ( int64_t & iHits, int64_t & iMisses ) const final;
 
 private:
 	struct Block_t
@@ -552,6 +971,8 @@ private:
 	CSphFixedVector<Block_t>	m_dBlocks{0};
 	std::unique_ptr<Compressor_i> m_pCompressor;
 	DocstoreFields_c			m_tFields;
+	mutable std::atomic<int64_t> m_iCacheHits {0};
+	mutable std::atomic<int64_t> m_iCacheMisses {0};
 
 	const Block_t *				FindBlock ( RowID_t tRowID ) const;
 	void						ReadFromFile ( BYTE * pData, int iLength, SphOffset_t tOffset, int64_t iSessionId ) const;
@@ -562,6 +983,7 @@ private:
 
 	bool						ProcessSmallBlockDoc ( RowID_t tCurDocRowID, RowID_t tRowID, const VecTraits_T<int> * pFieldIds, const CSphFixedVector<int> & dFieldInRset, bool bPack, MemoryReader2_c & tReader, CSphBitvec & tEmptyFields, DocstoreDoc_t & tResult ) const;
 	void						ProcessBigBlockField ( int iField, const FieldInfo_t & tInfo, int iFieldInRset, bool bPack, int64_t iSessionId, SphOffset_t & tOffset, DocstoreDoc_t & tResult ) const;
+	bool						FindInCache ( BlockCache_c * pBlockCache, SphOffset_t tOffset, BlockData_t & tBlockData ) const;
 };
 
 
@@ -601,7 +1023,10 @@ bool Docstore_c::Init ( CSphString & sError )
 
 	m_pCompressor = CreateCompressor ( m_eCompression, m_iCompressionLevel );
 	if ( !m_pCompressor )
+	{
+		sError.SetSprintf ( "Unable to load docstore: %s uses %s compression which is not available", m_sFilename.cstr(), CompressionToStr(m_eCompression).cstr() );
 		return false;
+	}
 
 	m_tFields.Load(tReader);
 
@@ -613,6 +1038,24 @@ bool Docstore_c::Init ( CSphString & sError )
 
 	tReader.SeekTo ( tHeaderOffset, 0 );
 
+	if ( m_pCompressor->UsesDictionary() )
+	{
+		DWORD uDictSize = tReader.UnzipInt();
+		if ( tReader.GetErrorFlag() || !IsDictSizeValid ( uDictSize, tReader.GetPos(), tReader.GetFilesize() ) )
+		{
+			sError.SetSprintf ( "Unable to load docstore: %s has wrong compression dictionary size (%u)", m_sFilename.cstr(), uDictSize );
+			return false;
+		}
+
+		CSphFixedVector<BYTE> dDict ( uDictSize );
+		tReader.GetBytes ( dDict.Begin(), (int)dDict.GetLengthBytes() );
+		if ( tReader.GetErrorFlag() || !m_pCompressor->SetDictionary(dDict) )
+		{
+			sError.SetSprintf ( "Unable to load docstore: %s has broken compression dictionary", m_sFilename.cstr() );
+			return false;
+		}
+	}
+
 	m_dBlocks.Reset(uNumBlocks);
 	DWORD tPrevBlockRowID = 0;
 	SphOffset_t tPrevBlockOffset = 0;
@@ -808,7 +1251,7 @@ DocstoreDoc_t Docstore_c::ReadDocFromSmallBlock ( const Block_t & tBlock, RowID_
 	BlockCache_c * pBlockCache = BlockCache_c::Get();
 
 	BlockData_t tBlockData;
-	bool bFromCache = pBlockCache && pBlockCache->Find ( { m_iIndexId, tBlock.m_tOffset }, tBlockData );
+	bool bFromCache = FindInCache ( pBlockCache, tBlock.m_tOffset, tBlockData );
 	if ( !bFromCache )
 	{
 		tBlockData = UncompressSmallBlock ( tBlock, iSessionId );
@@ -886,7 +1329,7 @@ void Docstore_c::ProcessBigBlockField ( int iField, const FieldInfo_t & tInfo, i
 	BlockCache_c * pBlockCache = BlockCache_c::Get();
 
 	BlockData_t tBlockData;
-	bool bFromCache = pBlockCache && pBlockCache->Find ( { m_iIndexId, tOffset }, tBlockData );
+	bool bFromCache = FindInCache ( pBlockCache, tOffset, tBlockData );
 	if ( !bFromCache )
 	{
 		tBlockData = UncompressBigBlockField ( tOffset, tInfo, iSessionId );
@@ -969,6 +1412,24 @@ DocstoreSettings_t Docstore_c::GetDocstoreSettings() const
 	return *this;
 }
 
+
+void Docstore_c::GetCacheStats ( int64_t & iHits, int64_t & iMisses ) const
+{
+	iHits = m_iCacheHits.load ( std::memory_order_relaxed );
+	iMisses = m_iCacheMisses.load ( std::memory_order_relaxed );
+}
+
+
+bool Docstore_c::FindInCache ( BlockCache_c * pBlockCache, SphOffset_t tOffset, BlockData_t & tBlockData ) const
+{
+	if ( !pBlockCache )
+		return false;
+
+	bool bFound = pBlockCache->Find ( { m_iIndexId, tOffset }, tBlockData );
+	( bFound ? m_iCacheHits : m_iCacheMisses ).fetch_add ( 1, std::memory_order_relaxed );
+	return bFound;
+}
+
 //////////////////////////////////////////////////////////////////////////
 DocstoreBuilder_i::Doc_t::Doc_t()
 {}
@@ -1002,6 +1463,15 @@ private:
 		CSphVector<CSphVector<BYTE>>	m_dFields;
 	};
 
+	struct PendingBlock_t
+	{
+		CSphVector<StoredDoc_t>			m_dDocs;
+		DWORD							m_uStoredLen = 0;
+	};
+
+	// that much of the data is held back to train the compression dictionary
+	static const int64_t DICT_TRAINING_BYTES = 8*1048576;
+
 	CSphString				m_sFilename;
 	CSphVector<StoredDoc_t>	m_dStoredDocs;
 	CSphVector<BYTE>		m_dHeader;
@@ -1015,6 +1485,9 @@ private:
 	SphOffset_t				m_tHeaderOffset = 0;
 	SphOffset_t				m_tPrevBlockOffset = 0;
 	DWORD					m_tPrevBlockRowID = 0;
+	bool					m_bCollectSamples = false;
+	CSphVector<PendingBlock_t> m_dPendingBlocks;
+	int64_t					m_iPendingBytes = 0;
 
 	using SortedField_t = std::pair<int,int>;
 	CSphVector<SortedField_t>		m_dFieldSort;
@@ -1023,6 +1496,10 @@ private:
 	void	WriteInitialHeader();
 	void	WriteTrailingHeader();
 	void	WriteBlock();
+	void	WriteStoredDocs();
+	void	FlushPendingBlocks();
+	void	TrainDictionary();
+	void	SerializeSmallBlock ( const CSphVector<StoredDoc_t> & dDocs );
 	void	WriteSmallBlockHeader ( SphOffset_t tBlockOffset );
 	void	WriteBigBlockHeader ( SphOffset_t tBlockOffset, SphOffset_t tHeaderSize );
 	void	WriteSmallBlock();
@@ -1042,8 +1519,12 @@ bool DocstoreBuilder_c::Init ( CSphString & sError )
 {
 	m_pCompressor = CreateCompressor ( m_eCompression, m_iCompressionLevel );
 	if ( !m_pCompressor )
+	{
+		sError.SetSprintf ( "%s compression is not available", CompressionToStr(m_eCompression).cstr() );
 		return false;
+	}
 
+	m_bCollectSamples = m_pCompressor->UsesDictionary();
 	return m_tWriter.OpenFile ( m_sFilename, sError );
 }
 
@@ -1081,13 +1562,15 @@ void DocstoreBuilder_c::AddDoc ( RowID_t tRowID, const Doc_t & tDoc )
 void DocstoreBuilder_c::Finalize()
 {
 	WriteBlock();
+	FlushPendingBlocks();
 	WriteTrailingHeader();
 }
 
 
 void DocstoreBuilder_c::WriteInitialHeader()
 {
-	m_tWriter.PutDword ( STORAGE_VERSION );
+	// files without a dictionary are still readable by older binaries
+	m_tWriter.PutDword ( m_pCompressor->UsesDictionary() ? STORAGE_VERSION : STORAGE_VERSION_NODICT );
 	m_tWriter.PutDword ( m_uBlockSize );
 	m_tWriter.PutByte ( Compression2Byte(m_eCompression) );
 	m_tFields.Save(m_tWriter);
@@ -1106,6 +1589,13 @@ void DocstoreBuilder_c::WriteTrailingHeader()
 {
 	SphOffset_t tHeaderPos = m_tWriter.GetPos();
 
+	if ( m_pCompressor->UsesDictionary() )
+	{
+		VecTraits_T<BYTE> dDict = m_pCompressor->GetDictionary();
+		m_tWriter.ZipInt ( dDict.GetLength() );
+		m_tWriter.PutBytes ( dDict.Begin(), dDict.GetLength() );
+	}
+
 	// write header
 	m_tWriter.PutBytes ( m_dHeader.Begin(), m_dHeader.GetLength() );
 
@@ -1141,19 +1631,18 @@ void DocstoreBuilder_c::WriteBigBlockHeader ( SphOffset_t tBlockOffset, SphOffse
 }
 
 
-void DocstoreBuilder_c::WriteSmallBlock()
+void DocstoreBuilder_c::SerializeSmallBlock ( const CSphVector<StoredDoc_t> & dDocs )
 {
-	m_dCompressedBuffers.Resize(1);
 	m_dBuffer.Resize(0);
 	MemoryWriter2_c tMemWriter ( m_dBuffer );
 
 #ifndef NDEBUG
-	for ( int i=1; i < m_dStoredDocs.GetLength(); i++ )
-		assert ( m_dStoredDocs[i].m_tRowID-m_dStoredDocs[i-1].m_tRowID==1 );
+	for ( int i=1; i < dDocs.GetLength(); i++ )
+		assert ( dDocs[i].m_tRowID-dDocs[i-1].m_tRowID==1 );
 #endif // !NDEBUG
 
 	CSphBitvec tEmptyFields ( m_tFields.GetNumFields() );
-	for ( const auto & tDoc : m_dStoredDocs )
+	for ( const auto & tDoc : dDocs )
 	{
 		tEmptyFields.Clear();
 		ARRAY_FOREACH ( iField, tDoc.m_dFields )
@@ -1180,6 +1669,13 @@ void DocstoreBuilder_c::WriteSmallBlock()
 				}
 		}
 	}
+}
+
+
+void DocstoreBuilder_c::WriteSmallBlock()
+{
+	m_dCompressedBuffers.Resize(1);
+	SerializeSmallBlock ( m_dStoredDocs );
 
 	CSphVector<BYTE> & dCompressedBuffer = m_dCompressedBuffers[0];
 	BYTE uBlockFlags = 0;
@@ -1297,6 +1793,77 @@ void DocstoreBuilder_c::WriteBlock()
 	if ( !m_dStoredDocs.GetLength() )
 		return;
 
+	if ( !m_bCollectSamples )
+	{
+		WriteStoredDocs();
+		return;
+	}
+
+	// hold the blocks back until there's enough data to train the dictionary
+	PendingBlock_t & tPending = m_dPendingBlocks.Add();
+	tPending.m_dDocs.SwapData ( m_dStoredDocs );
+	tPending.m_uStoredLen = m_uStoredLen;
+	m_iPendingBytes += m_uStoredLen;
+	m_uStoredLen = 0;
+
+	if ( m_iPendingBytes>=DICT_TRAINING_BYTES )
+		FlushPendingBlocks();
+}
+
+
+void DocstoreBuilder_c::TrainDictionary()
+{
+	// samples are exactly what is going to be compressed: serialized small blocks and separate fields of big blocks
+	CSphVector<BYTE> dSamples;
+	CSphVector<size_t> dSampleSizes;
+	dSamples.Reserve ( m_iPendingBytes );
+	for ( const auto & tPending : m_dPendingBlocks )
+	{
+		bool bBigBlock = tPending.m_dDocs.GetLength()==1 && tPending.m_uStoredLen>=m_uBlockSize;
+		if ( bBigBlock )
+		{
+			for ( const auto & dField : tPending.m_dDocs[0].m_dFields )
+				if ( dField.GetLength() )
+				{
+					dSamples.Append(dField);
+					dSampleSizes.Add ( dField.GetLength() );
+				}
+		}
+		else
+		{
+			SerializeSmallBlock ( tPending.m_dDocs );
+			dSamples.Append(m_dBuffer);
+			dSampleSizes.Add ( m_dBuffer.GetLength() );
+		}
+	}
+
+	// failed training is not fatal; blocks just get compressed without the dictionary
+	m_pCompressor->TrainDictionary ( dSamples, dSampleSizes );
+}
+
+
+void DocstoreBuilder_c::FlushPendingBlocks()
+{
+	if ( !m_bCollectSamples )
+		return;
+
+	m_bCollectSamples = false;
+	TrainDictionary();
+
+	for ( auto & tPending : m_dPendingBlocks )
+	{
+		m_dStoredDocs.SwapData ( tPending.m_dDocs );
+		m_uStoredLen = tPending.m_uStoredLen;
+		WriteStoredDocs();
+	}
+
+	m_dPendingBlocks.Reset();
+	m_iPendingBytes = 0;
+}
+
+
+void DocstoreBuilder_c::WriteStoredDocs()
+{
 	bool bBigBlock = m_dStoredDocs.GetLength()==1 && m_uStoredLen>=m_uBlockSize;
 
 	if ( bBigBlock )
@@ -1328,6 +1895,7 @@ public:
 	int					GetFieldId ( const CSphString & sName, DocstoreDataType_e eType ) const final;
 	DocstoreSettings_t	GetDocstoreSettings() const final;
 	void				CreateReader ( int64_t iSessionId ) const final {}
+	void				GetCacheStats ( int64_t & iHits, int64_t & iMisses ) const final { iHits = iMisses = 0; }
 
 	bool				Load ( CSphReader & tReader ) final;
 	void				Save ( Writer_i & tWriter ) final;
@@ -1625,7 +2193,7 @@ bool DocstoreChecker_c::Check()
 
 	m_tReader.GetDword();	// block size
 	BYTE uCompression = m_tReader.GetByte();
-	if ( uCompression > 2 )
+	if ( uCompression > 3 )
 		return m_tReporter.Fail ( "Unknown docstore compression %u in %s", uCompression, m_szFilename );
 
 	Compression_e eCompression = Byte2Compression(uCompression);
@@ -1633,6 +2201,9 @@ bool DocstoreChecker_c::Check()
 	if ( !m_pCompressor )
 		return m_tReporter.Fail ( "Unable to create compressor in %s", m_szFilename );
 
+	if ( m_pCompressor->UsesDictionary() && uStorageVersion<STORAGE_VERSION )
+		return m_tReporter.Fail ( "Docstore v.%d can't use %s compression in %s", uStorageVersion, CompressionToStr(eCompression).cstr(), m_szFilename );
+
 	DWORD uNumFields = m_tReader.GetDword();
 	const DWORD MAX_SANE_FIELDS = 32768;
 	if ( uNumFields > MAX_SANE_FIELDS )
@@ -1669,6 +2240,18 @@ bool DocstoreChecker_c::Check()
 
 	m_tReader.SeekTo ( tHeaderOffset, 0 );
 
+	if ( m_pCompressor->UsesDictionary() )
+	{
+		DWORD uDictSize = m_tReader.UnzipInt();
+		if ( !IsDictSizeValid ( uDictSize, m_tReader.GetPos(), m_tReader.GetFilesize() ) )
+			return m_tReporter.Fail ( "Wrong docstore compression dictionary size (%u) in %s", uDictSize, m_szFilename );
+
+		CSphFixedVector<BYTE> dDict ( uDictSize );
+		m_tReader.GetBytes ( dDict.Begin(), (int)dDict.GetLengthBytes() );
+		if ( !m_pCompressor->SetDictionary(dDict) )
+			return m_tReporter.Fail ( "Unable to load docstore compression dictionary in %s", m_szFilename );
+	}
+
 	CSphFixedVector<Docstore_c::Block_t> dBlocks(uNumBlocks);
 
 	DWORD tPrevBlockRowID = 0;
@@ -2132,6 +2715,17 @@ void ShutdownDocstore()
 }
 
 
+DocstoreCacheStatus_t GetDocstoreCacheStatus()
+{
+	DocstoreCacheStatus_t tStatus;
+	BlockCache_c * pBlockCache = BlockCache_c::Get();
+	if ( pBlockCache )
+		pBlockCache->GetStatus(tStatus);
+
+	return tStatus;
+}
+
+
 bool CheckDocstore ( CSphAutoreader & tReader, DebugCheckError_i & tReporter, int64_t iRowsCount )
 {
 	DocstoreChecker_c tChecker ( tReader, tReporter, iRowsCount );
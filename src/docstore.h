@@ -46,6 +46,7 @@ public:
 	virtual void				CreateReader ( int64_t iSessionId ) const = 0;
 	virtual DocstoreDoc_t		GetDoc ( RowID_t tRowID, const VecTraits_T<int> * pFieldIds, int64_t iSessionId, bool bPack ) const = 0;
 	virtual DocstoreSettings_t	GetDocstoreSettings() const = 0;
+	virtual void				GetCacheStats ( int64_t & iHits, int64_t & iMisses ) const = 0;	///< block cache lookups made by this docstore
 };
 
 class DocstoreBuilder_i : public DocstoreAddField_i, public DocstoreGetField_i
@@ -122,8 +123,19 @@ std::unique_ptr<DocstoreBuilder_i> CreateDocstoreBuilder ( const CSphString & sF
 std::unique_ptr<DocstoreRT_i>		CreateDocstoreRT();
 std::unique_ptr<DocstoreFields_i>	CreateDocstoreFields();
 
+struct DocstoreCacheStatus_t
+{
+	int64_t		m_iHits = 0;
+	int64_t		m_iMisses = 0;
+	int64_t		m_iRejected = 0;	///< uncompressed blocks that were not admitted to the cache
+	int64_t		m_iUsedBytes = 0;
+	int64_t		m_iMaxBytes = 0;
+	int			m_iShards = 0;
+};
+
 void				InitDocstore ( int64_t iCacheSize );
 void				ShutdownDocstore();
+DocstoreCacheStatus_t GetDocstoreCacheStatus();
 
 class DebugCheckError_i;
 class CSphAutoreader;
@@ -12,6 +12,7 @@
 
 #include "fileio.h"
 #include "sphinxint.h"
+#include "task_info.h"
 
 #define SPH_READ_NOPROGRESS_CHUNK (32768*1024)
 
@@ -296,7 +297,7 @@ void CSphReader::UpdateCache()
 	int iReadLen = Min ( m_iSizeHint, m_iBufSize );
 
 	m_iBuffPos = 0;
-	m_iBuffUsed = sphPread ( m_iFD, m_pBuff, iReadLen, iNewPos ); // FIXME! what about throttling?
+	m_iBuffUsed = sphPread ( m_iFD, m_pBuff, iReadLen, iNewPos );
 
 	if ( m_iBuffUsed<0 )
 	{
@@ -470,13 +471,39 @@ uint64_t CSphReader::UnzipOffset()
 #else
 DWORD CSphReader::UnzipInt()
 {
+	// fast path: value surely fits into the buffered data, so decode it right from there, without refill check on every byte
+	if ( m_iBuffUsed-m_iBuffPos>=ZIPPED_INT_MAXLEN )
+	{
+		const BYTE * pCur = m_pBuff + m_iBuffPos;
+		DWORD uRes = UnzipIntBE ( pCur );
+		m_iBuffPos = int ( pCur - m_pBuff );
+		return uRes;
+	}
+
 	return UnzipValueBE<DWORD> ( [this]() mutable { return GetByte(); } );
 }
 
 
 uint64_t CSphReader::UnzipOffset()
 {
-	return UnzipValueBE<uint64_t> ( [this]() mutable { return GetByte(); } );
+	uint64_t uRes = 0;
+	if ( m_iBuffUsed-m_iBuffPos>=ZIPPED_OFFSET_MAXLEN )
+	{
+		const BYTE * pCur = m_pBuff + m_iBuffPos;
+		bool bDone = UnzipOffsetBEBounded ( pCur, uRes );
+		m_iBuffPos = int ( pCur - m_pBuff );
+		if ( bDone )
+			return uRes;
+	}
+
+	// near the end of buffer, or a corrupted value longer than ZIPPED_OFFSET_MAXLEN; go on byte by byte
+	BYTE b;
+	do
+	{
+		b = GetByte();
+		uRes = ( uRes << 7 ) | ( b & 0x7f );
+	} while ( b & 0x80 );
+	return uRes;
 }
 #endif
 
@@ -812,29 +839,164 @@ void CSphWriter::SeekTo ( SphOffset_t iPos, bool bTruncate )
 
 //////////////////////////////////////////////////////////////////////////
 
-static int g_iIOpsDelay = 0;
-static int g_iMaxIOSize = 0;
-static std::atomic<int64_t> g_tmNextIOTime { 0 };
+// I/O scheduler. Every class has a token bucket: an I/O reserves a time slot, which costs 1/iops or size/bandwidth
+// (whichever is bigger), and waits for it; unused budget accumulates up to IO_BURST_US. Background classes
+// may also yield to queries: wait while there was query I/O within IO_QUIET_US, but no longer than their yield time.
+// Query I/O is marked at most once per IO_MARK_US, so that concurrent queries don't fight over one cache line.
+// Waits are plain sleeps: the waiting task may hold pthread mutexes (e.g. binlog locks), so it must not move
+// to another thread. Binlog writes run in the QUERY class to not stall committers behind background budgets.
+
+// carries I/O class of the task in the task info chain, so that it follows coroutines between threads
+struct IOClassInfo_t : public TaskInfo_t
+{
+	DECLARE_RENDER ( IOClassInfo_t );
+	IOClass_e m_eClass = IOClass_e::QUERY;
+};
+
+DEFINE_RENDER ( IOClassInfo_t ) {}
+
+struct ScopedIOClass_c::Impl_t
+{
+	ScopedInfo_T<IOClassInfo_t, NoRefCount_t> m_tInfo;
+
+	explicit Impl_t ( IOClassInfo_t * pInfo )
+		: m_tInfo ( pInfo )
+	{}
+};
+
+ScopedIOClass_c::ScopedIOClass_c ( IOClass_e eClass )
+{
+	auto * pInfo = new IOClassInfo_t;
+	pInfo->m_eClass = eClass;
+	m_pImpl = std::make_unique<Impl_t> ( pInfo );
+}
+
+ScopedIOClass_c::~ScopedIOClass_c() = default;
+
+IOClass_e GetIOClass()
+{
+	auto * pInfo = (IOClassInfo_t *)myinfo::GetHazardTypedNode ( IOClassInfo_t::Task() );
+	return pInfo ? pInfo->m_eClass : IOClass_e::QUERY;
+}
+
+static const int64_t IO_BURST_US = 100000;
+static const int64_t IO_QUIET_US = 2000;
+static const int64_t IO_MARK_US = 1000;
+
+struct IOBucket_t
+{
+	IOBudget_t				m_tBudget;
+	int64_t					m_iYieldUs = 0;
+	bool					m_bActive = false;	///< has a budget, marks or waits for query I/O
+	std::atomic<int64_t>	m_tmNextIO { 0 };	///< when the next I/O of the class may start
+};
+
+static IOBucket_t g_dIOBuckets[(int)IOClass_e::TOTAL];
+static std::atomic<bool> g_bIOScheduler { false };	///< any budget or yield is set
+static std::atomic<int64_t> g_tmLastQueryIO { 0 };
+static int g_iIOYieldMs = 0;
+
+static void UpdateIOScheduler()
+{
+	bool bEnabled = g_iIOYieldMs>0;
+	for ( int i = 0; i<(int)IOClass_e::TOTAL; ++i )
+	{
+		auto & tBucket = g_dIOBuckets[i];
+		tBucket.m_iYieldUs = (int64_t)g_iIOYieldMs * 1000 * i / ( (int)IOClass_e::TOTAL-1 );
+		tBucket.m_bActive = g_iIOYieldMs>0 || tBucket.m_tBudget.m_iIOps>0 || tBucket.m_tBudget.m_iBandwidth>0;
+		bEnabled |= tBucket.m_bActive;
+	}
+	g_bIOScheduler.store ( bEnabled, std::memory_order_relaxed );
+}
+
+void SetIOBudget ( IOClass_e eClass, const IOBudget_t & tBudget )
+{
+	assert ( eClass<IOClass_e::TOTAL );
+	g_dIOBuckets[(int)eClass].m_tBudget = tBudget;
+	UpdateIOScheduler();
+}
 
 void sphSetThrottling ( int iMaxIOps, int iMaxIOSize )
 {
-	g_iIOpsDelay = iMaxIOps ? 1000000 / iMaxIOps : iMaxIOps;
-	g_iMaxIOSize = iMaxIOSize;
+	IOBudget_t tBudget;
+	tBudget.m_iIOps = iMaxIOps;
+	tBudget.m_iMaxIOSize = iMaxIOSize;
+	for ( auto & tBucket : g_dIOBuckets )
+		tBucket.m_tBudget = tBudget;
+	UpdateIOScheduler();
+}
+
+void SetIOYieldTime ( int iMsec )
+{
+	g_iIOYieldMs = Max ( iMsec, 0 );
+	UpdateIOScheduler();
 }
 
+static inline int GetMaxIOSize ( IOClass_e eClass )
+{
+	return g_dIOBuckets[(int)eClass].m_tBudget.m_iMaxIOSize;
+}
 
-static inline void ThrottleSleep()
+static void WaitIO ( int64_t tmWait )
 {
-	if ( !g_iIOpsDelay )
+	sphSleepMsec ( (int)Max ( tmWait / 1000, 1 ) );
+}
+
+static void ScheduleIO ( IOClass_e eClass, int64_t iBytes )
+{
+	if ( !g_bIOScheduler.load ( std::memory_order_relaxed ) )
+		return;
+
+	auto & tBucket = g_dIOBuckets[(int)eClass];
+	if ( !tBucket.m_bActive )
 		return;
 
-	auto tmTimer = sphMicroTimer();
-	while ( tmTimer < g_tmNextIOTime.load ( std::memory_order_relaxed ) ) // m.b. >1 sleeps if another thread more lucky
+	int64_t tmNow = sphMicroTimer();
+
+	if ( eClass==IOClass_e::QUERY )
 	{
-		sphSleepMsec ( (int)( g_tmNextIOTime.load ( std::memory_order_relaxed ) - tmTimer ) / 1000 );
-		tmTimer = sphMicroTimer();
+		if ( g_iIOYieldMs && tmNow - g_tmLastQueryIO.load ( std::memory_order_relaxed )>=IO_MARK_US )
+			g_tmLastQueryIO.store ( tmNow, std::memory_order_relaxed );
+	} else if ( tBucket.m_iYieldUs )
+	{
+		// let in-progress queries do their I/O first; wake up when they would be quiet for long enough
+		int64_t tmGiveUp = tmNow + tBucket.m_iYieldUs;
+		int64_t tmQuiet;
+		while ( tmNow<tmGiveUp && ( tmQuiet = g_tmLastQueryIO.load ( std::memory_order_relaxed ) + IO_QUIET_US )>tmNow )
+		{
+			WaitIO ( Min ( tmQuiet, tmGiveUp ) - tmNow );
+			tmNow = sphMicroTimer();
+		}
 	}
-	g_tmNextIOTime.store ( tmTimer + g_iIOpsDelay, std::memory_order_relaxed );
+
+	const IOBudget_t & tBudget = tBucket.m_tBudget;
+	int64_t tmCost = 0;
+	if ( tBudget.m_iIOps>0 )
+		tmCost = 1000000 / tBudget.m_iIOps;
+	if ( tBudget.m_iBandwidth>0 )
+		tmCost = Max ( tmCost, iBytes * 1000000 / tBudget.m_iBandwidth );
+	if ( !tmCost )
+		return;
+
+	// reserve the slot
+	int64_t tmNext = tBucket.m_tmNextIO.load ( std::memory_order_relaxed );
+	int64_t tmStart;
+	do
+		tmStart = Max ( tmNext, tmNow - IO_BURST_US );
+	while ( !tBucket.m_tmNextIO.compare_exchange_weak ( tmNext, tmStart + tmCost, std::memory_order_relaxed ) );
+
+	// and wait for it
+	while ( tmNow<tmStart )
+	{
+		WaitIO ( tmStart - tmNow );
+		tmNow = sphMicroTimer();
+	}
+}
+
+void ThrottleIO ( int64_t iBytes )
+{
+	if ( g_bIOScheduler.load ( std::memory_order_relaxed ) )
+		ScheduleIO ( GetIOClass(), iBytes );
 }
 
 
@@ -847,8 +1009,9 @@ bool sphWriteThrottled ( int iFD, const void* pBuf, int64_t iCount, const char*
 	int iChunkSize = ( 1UL << 30 );
 
 	// when there's a sane max_iosize (4K to 1GB), use it
-	if ( g_iMaxIOSize >= 4096 )
-		iChunkSize = Min ( iChunkSize, g_iMaxIOSize );
+	IOClass_e eClass = g_bIOScheduler.load ( std::memory_order_relaxed ) ? GetIOClass() : IOClass_e::QUERY;
+	if ( GetMaxIOSize ( eClass ) >= 4096 )
+		iChunkSize = Min ( iChunkSize, GetMaxIOSize ( eClass ) );
 
 	CSphIOStats* pIOStats = GetIOStats();
 
@@ -856,15 +1019,16 @@ bool sphWriteThrottled ( int iFD, const void* pBuf, int64_t iCount, const char*
 	auto* p = (const BYTE*)pBuf;
 	while ( iCount )
 	{
+		auto iToWrite = (int)Min ( iCount, iChunkSize );
+
 		// wait for a timely occasion
-		ThrottleSleep();
+		ScheduleIO ( eClass, iToWrite );
 
 		// write (and maybe time)
 		int64_t tmTimer = 0;
 		if ( pIOStats )
 			tmTimer = sphMicroTimer();
 
-		auto iToWrite = (int)Min ( iCount, iChunkSize );
 		int iWritten = ::write ( iFD, p, iToWrite );
 
 		if ( pIOStats )
@@ -903,13 +1067,14 @@ size_t sphReadThrottled ( int iFD, void* pBuf, size_t iCount )
 	if ( iCount <= 0 )
 		return iCount;
 
-	auto iStep = g_iMaxIOSize ? Min ( iCount, (size_t)g_iMaxIOSize ) : iCount;
+	IOClass_e eClass = g_bIOScheduler.load ( std::memory_order_relaxed ) ? GetIOClass() : IOClass_e::QUERY;
+	auto iStep = GetMaxIOSize ( eClass ) ? Min ( iCount, (size_t)GetMaxIOSize ( eClass ) ) : iCount;
 	auto* p = (BYTE*)pBuf;
 	size_t nBytesToRead = iCount;
 	while ( iCount && !sphInterrupted() )
 	{
-		ThrottleSleep();
 		auto iChunk = (long)Min ( iCount, iStep );
+		ScheduleIO ( eClass, iChunk );
 		auto iRead = sphRead ( iFD, p, iChunk );
 		p += iRead;
 		iCount -= iRead;
@@ -929,6 +1094,8 @@ int sphPread ( int iFD, void * pBuf, int iBytes, SphOffset_t iOffset )
 	if ( iBytes==0 )
 		return 0;
 
+	ThrottleIO ( iBytes );
+
 	CSphIOStats * pIOStats = GetIOStats();
 	int64_t tmStart = 0;
 	if ( pIOStats )
@@ -971,6 +1138,8 @@ int sphPread ( int iFD, void * pBuf, int iBytes, SphOffset_t iOffset )
 // atomic seek+read for non-Windows systems with pread() call
 int sphPread ( int iFD, void * pBuf, int iBytes, SphOffset_t iOffset )
 {
+	ThrottleIO ( iBytes );
+
 	CSphIOStats * pIOStats = GetIOStats();
 	if ( !pIOStats )
 		return ::pread ( iFD, pBuf, iBytes, iOffset );
@@ -243,9 +243,53 @@ bool SeekAndWarn ( int iFD, SphOffset_t iPos, const char * szWarnPrefix );
 // atomic seek+read wrapper
 int sphPread ( int iFD, void * pBuf, int iBytes, SphOffset_t iOffset );
 
-/// set throttling options
+/// I/O classes of the scheduler, from the highest priority to the lowest
+enum class IOClass_e : BYTE
+{
+	QUERY,		///< foreground: queries and everything not classified
+	FLUSH,		///< saving RAM chunks to disk
+	PREREAD,	///< prereading tables
+	MERGE,		///< optimize: merging, compressing and splitting disk chunks
+
+	TOTAL
+};
+
+/// per-class I/O budget; zeros mean no limit
+struct IOBudget_t
+{
+	int		m_iIOps = 0;		///< max I/O operations per second
+	int		m_iMaxIOSize = 0;	///< reads and writes bigger than this are split into several I/Os
+	int64_t	m_iBandwidth = 0;	///< max bytes per second
+};
+
+/// set throttling options for all I/O classes
 void sphSetThrottling ( int iMaxIOps, int iMaxIOSize );
 
+/// set I/O budget of one class
+void SetIOBudget ( IOClass_e eClass, const IOBudget_t & tBudget );
+
+/// background I/O waits up to this time while queries do I/O (full time for merges, proportionally less for higher priorities); 0 disables
+void SetIOYieldTime ( int iMsec );
+
+/// I/O class of the current task (QUERY if not set)
+IOClass_e GetIOClass();
+
+/// sets I/O class of the current task until going out of scope; follows the task between threads
+class ScopedIOClass_c : public ISphNoncopyable
+{
+public:
+	explicit	ScopedIOClass_c ( IOClass_e eClass );
+				~ScopedIOClass_c();
+
+private:
+	struct Impl_t;
+	std::unique_ptr<Impl_t> m_pImpl;
+};
+
+/// wait until the current I/O class may do an I/O of the given size
+/// (for I/O which goes not through the functions below, like touching mapped memory)
+void ThrottleIO ( int64_t iBytes );
+
 /// write blob to file honoring throttling
 bool sphWriteThrottled ( int iFD, const void * pBuf, int64_t iCount, const char * szName, CSphString & sError );
 
@@ -14,6 +14,7 @@
 
 #include "sphinxfilter.h"
 #include "conversion.h"
+#include "sphinxrt.h"
 
 class filter_block_level : public ::testing::Test
 {
@@ -585,3 +586,59 @@ TEST_F ( filter_block_level, and )
 	*dMax.Begin() = 30;
 	ASSERT_TRUE ( tFilter->EvalBlock ( dMin.Begin(), dMax.Begin() ) );
 }
+
+TEST_F ( filter_block_level, json_columns )
+{
+	CSphString sWarning, sError;
+	CSphConfigSection hIndex;
+	hIndex.AddEntry ( "rt_attr_json", "j" );
+	hIndex.AddEntry ( "json_columns", "j.i:bigint, j.f:float" );
+
+	CSphSchema tSchema;
+	ASSERT_TRUE ( sphRTSchemaConfigure ( hIndex, tSchema, CSphIndexSettings(), nullptr, sError, true, false ) ) << sError.cstr();
+
+	CSphFixedVector<DWORD> dMin ( tSchema.GetRowSize() ), dMax ( tSchema.GetRowSize() );
+	dMin.ZeroVec();
+	dMax.ZeroVec();
+	const CSphAttrLocator & tInt = tSchema.GetAttr ( "$_json:j.i" )->m_tLocator;
+	const CSphAttrLocator & tFloat = tSchema.GetAttr ( "$_json:j.f" )->m_tLocator;
+
+	tCtx.m_pSchema = &tSchema;
+
+	// int copy
+	tOpt.m_sAttrName = "j.i";
+	tOpt.m_iMinValue = 10;
+	tOpt.m_iMaxValue = 40;
+	std::unique_ptr<ISphFilter> tFilter = sphCreateFilter ( tOpt, tCtx, sError, sWarning );
+	ASSERT_TRUE ( tFilter!=nullptr ) << sError.cstr();
+
+	// exact values only, block 1-5 is skipped
+	sphSetRowAttr ( dMin.Begin(), tInt, 1 );
+	sphSetRowAttr ( dMax.Begin(), tInt, 5 );
+	ASSERT_FALSE ( tFilter->EvalBlock ( dMin.Begin(), dMax.Begin() ) );
+
+	// block 1-20
+	sphSetRowAttr ( dMax.Begin(), tInt, 20 );
+	ASSERT_TRUE ( tFilter->EvalBlock ( dMin.Begin(), dMax.Begin() ) );
+
+	// block with inexact copies has to be checked against json
+	sphSetRowAttr ( dMin.Begin(), tInt, LLONG_MIN );
+	sphSetRowAttr ( dMax.Begin(), tInt, 5 );
+	ASSERT_TRUE ( tFilter->EvalBlock ( dMin.Begin(), dMax.Begin() ) );
+
+	// float copy
+	SetDefault();
+	tOpt.m_sAttrName = "j.f";
+	tOpt.m_eType = SPH_FILTER_FLOATRANGE;
+	tOpt.m_fMinValue = 1.0f;
+	tOpt.m_fMaxValue = 2.0f;
+	tFilter = sphCreateFilter ( tOpt, tCtx, sError, sWarning );
+	ASSERT_TRUE ( tFilter!=nullptr ) << sError.cstr();
+
+	sphSetRowAttr ( dMin.Begin(), tFloat, sphF2DW ( 3.0f ) );
+	sphSetRowAttr ( dMax.Begin(), tFloat, sphF2DW ( 4.0f ) );
+	ASSERT_FALSE ( tFilter->EvalBlock ( dMin.Begin(), dMax.Begin() ) );
+
+	sphSetRowAttr ( dMin.Begin(), tFloat, sphF2DW ( -FLT_MAX ) );
+	ASSERT_TRUE ( tFilter->EvalBlock ( dMin.Begin(), dMax.Begin() ) );
+}
@@ -17,9 +17,15 @@
 #include "json/cJSON.h"
 #include "threadutils.h"
 #include <cmath>
+#include <filesystem>
 #include "histogram.h"
+#include "costestimate.h"
+#include "datareader.h"
 #include "conversion.h"
 #include "digest_sha1.h"
+#include "sphinxsort.h"
+#include "docstore.h"
+#include "coroutine.h"
 
 // Miscelaneous short functional tests: TDigest, SpanSearch,
 // stringbuilder, CJson, TaggedHash, Log2
@@ -371,6 +377,156 @@ TEST_F ( TZip, LE64 )
 	}
 }
 
+// readers decode values right from their buffers when there is enough data, and byte by byte near the end.
+// write boundary values of every zipped length, so that they start at any offset in the read buffer (and at the end of file)
+class TZipReaders : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		for ( int iBits=0; iBits<=64; iBits+=7 )
+		{
+			uint64_t uEdge = iBits<64 ? ( 1ULL << iBits ) : 0;
+			for ( uint64_t uValue : { uEdge-1, uEdge, uEdge+1 } )
+			{
+				m_dOffsets.Add ( uValue );
+				m_dInts.Add ( DWORD ( uValue ) );
+			}
+		}
+
+		m_dInts.Add ( 0xFFFFFFFF );
+		m_dOffsets.Add ( 0xFFFFFFFF );
+
+		CSphString sError;
+		CSphWriter tWriter;
+		ASSERT_TRUE ( tWriter.OpenFile ( m_sFile, sError ) ) << sError.cstr();
+		for ( int i=0; i<m_dInts.GetLength(); ++i )
+		{
+			tWriter.ZipInt ( m_dInts[i] );
+			tWriter.ZipOffset ( m_dOffsets[i] );
+		}
+
+		// shortest possible tail: 1-byte int, then 5-byte int ending right at the end of file
+		tWriter.ZipInt ( 1 );
+		tWriter.ZipInt ( 0xFFFFFFFF );
+		tWriter.CloseFile();
+	}
+
+	void TearDown() override
+	{
+		unlink ( m_sFile.cstr() );
+	}
+
+	template<typename READER>
+	void Check ( READER & tReader, const char * szWhat )
+	{
+		for ( int i=0; i<m_dInts.GetLength(); ++i )
+		{
+			ASSERT_EQ ( tReader.UnzipInt(), m_dInts[i] ) << szWhat << ", value " << i;
+			ASSERT_EQ ( tReader.UnzipOffset(), m_dOffsets[i] ) << szWhat << ", value " << i;
+		}
+
+		ASSERT_EQ ( tReader.UnzipInt(), 1u ) << szWhat;
+		ASSERT_EQ ( tReader.UnzipInt(), 0xFFFFFFFF ) << szWhat;
+	}
+
+	CSphString m_sFile { "__zip_readers.tmp" };
+	CSphVector<DWORD> m_dInts;
+	CSphVector<uint64_t> m_dOffsets;
+};
+
+TEST_F ( TZipReaders, file_reader )
+{
+	// odd buffer sizes put the values at every position relative to the buffer end
+	for ( int iBuffer : { 1, 2, 3, 5, 7, 10, 11, 16, 64, DEFAULT_READ_BUFFER } )
+	{
+		CSphString sError;
+		CSphAutoreader tReader;
+		tReader.SetBuffers ( iBuffer, iBuffer );
+		ASSERT_TRUE ( tReader.Open ( m_sFile, sError ) ) << sError.cstr();
+
+		CSphString sWhat;
+		sWhat.SetSprintf ( "buffer %d", iBuffer );
+		Check ( tReader, sWhat.cstr() );
+		ASSERT_FALSE ( tReader.GetErrorFlag() );
+		ASSERT_EQ ( tReader.GetPos(), tReader.GetFilesize() );
+	}
+}
+
+TEST_F ( TZipReaders, mmap_reader )
+{
+	CSphString sError;
+	DataReaderFactoryPtr_c pFactory { NewProxyReader ( m_sFile, sError, DataReaderFactory_c::DOCS, DEFAULT_READ_BUFFER, FileAccess_e::MMAP ) };
+	ASSERT_TRUE ( pFactory ) << sError.cstr();
+
+	FileBlockReaderPtr_c pReader { pFactory->MakeReader ( nullptr, 0 ) };
+	Check ( *pReader, "mmap" );
+	ASSERT_EQ ( pReader->GetPos(), pFactory->GetFilesize() );
+}
+
+TEST_F ( TZipReaders, direct_reader )
+{
+	for ( int iBuffer : { 3, 7, 11 } )
+	{
+		CSphString sError;
+		DataReaderFactoryPtr_c pFactory { NewProxyReader ( m_sFile, sError, DataReaderFactory_c::DOCS, iBuffer, FileAccess_e::FILE ) };
+		ASSERT_TRUE ( pFactory ) << sError.cstr();
+
+		FileBlockReaderPtr_c pReader { pFactory->MakeReader ( nullptr, 0 ) };
+		CSphString sWhat;
+		sWhat.SetSprintf ( "direct, buffer %d", iBuffer );
+		Check ( *pReader, sWhat.cstr() );
+	}
+}
+
+// corrupted offsets longer than ZIPPED_OFFSET_MAXLEN must not make readers run past their buffer or map
+TEST ( functions, UnzipOffsetCorrupted )
+{
+	const CSphString sFile = "__zip_corrupted.tmp";
+	CSphString sError;
+	{
+		CSphWriter tWriter;
+		ASSERT_TRUE ( tWriter.OpenFile ( sFile, sError ) ) << sError.cstr();
+
+		// 16-byte value, then a good one
+		for ( int i=0; i<15; ++i )
+			tWriter.PutByte ( 0x81 );
+		tWriter.PutByte ( 0x01 );
+		tWriter.ZipOffset ( 5 );
+
+		// continuation bits up to the end of file
+		for ( int i=0; i<64; ++i )
+			tWriter.PutByte ( 0xFF );
+		tWriter.CloseFile();
+	}
+
+	for ( int iBuffer : { 7, 16, 64, DEFAULT_READ_BUFFER } )
+	{
+		CSphAutoreader tReader;
+		tReader.SetBuffers ( iBuffer, iBuffer );
+		ASSERT_TRUE ( tReader.Open ( sFile, sError ) ) << sError.cstr();
+		tReader.UnzipOffset();
+		ASSERT_EQ ( tReader.GetPos(), 16 ) << "buffer " << iBuffer;
+		ASSERT_EQ ( tReader.UnzipOffset(), 5u ) << "buffer " << iBuffer;
+		ASSERT_FALSE ( tReader.GetErrorFlag() ) << "buffer " << iBuffer;
+
+		tReader.UnzipOffset();
+		ASSERT_TRUE ( tReader.GetErrorFlag() ) << "buffer " << iBuffer;
+		ASSERT_EQ ( tReader.GetPos(), tReader.GetFilesize() ) << "buffer " << iBuffer;
+	}
+
+	DataReaderFactoryPtr_c pFactory { NewProxyReader ( sFile, sError, DataReaderFactory_c::DOCS, DEFAULT_READ_BUFFER, FileAccess_e::MMAP ) };
+	ASSERT_TRUE ( pFactory ) << sError.cstr();
+	FileBlockReaderPtr_c pReader { pFactory->MakeReader ( nullptr, 0 ) };
+	pReader->UnzipOffset();
+	ASSERT_EQ ( pReader->GetPos(), 16 );
+	ASSERT_EQ ( pReader->UnzipOffset(), 5u );
+	pReader->UnzipOffset();
+	ASSERT_EQ ( pReader->GetPos(), pFactory->GetFilesize() );
+
+	unlink ( sFile.cstr() );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 static int g_iRwlock;
@@ -932,6 +1088,89 @@ TEST ( functions, StridedSort_regressions )
 	ASSERT_EQ ( dUniq1[1], 3 );
 }
 
+static void FillTestHits ( CSphFixedVector<CSphWordHit> & dHits, int iWords, bool bDocOrder, int iRows=1000, int iPositions=100 )
+{
+	ARRAY_FOREACH ( i, dHits )
+	{
+		auto & tHit = dHits[i];
+		tHit.m_uWordID = ( sphRand() % iWords ) * 0x9E3779B97F4A7C15ULL;
+		if ( bDocOrder )
+		{
+			tHit.m_tRowID = i / 37;
+			tHit.m_uWordPos = HITMAN::Create ( i % 37 / 10, i % 37 % 10 + 1, i % 37 % 10==9 );
+		} else
+		{
+			tHit.m_tRowID = sphRand() % iRows;
+			tHit.m_uWordPos = HITMAN::Create ( sphRand() % 4, sphRand() % iPositions + 1, sphRand() % 2 );
+		}
+	}
+}
+
+static void CheckSortedHits ( const CSphWordHit * pSorted, const CSphFixedVector<CSphWordHit> & dSource )
+{
+	CSphVector<CSphWordHit> dRef;
+	dRef.Append ( dSource );
+	sphSort ( dRef.Begin(), dRef.GetLength(), CmpHit_fn() );
+
+	// field end flag is not a part of the order
+	ARRAY_FOREACH ( i, dRef )
+	{
+		ASSERT_EQ ( pSorted[i].m_uWordID, dRef[i].m_uWordID ) << "hit " << i;
+		ASSERT_EQ ( pSorted[i].m_tRowID, dRef[i].m_tRowID ) << "hit " << i;
+		ASSERT_EQ ( HITMAN::GetPosWithField ( pSorted[i].m_uWordPos ), HITMAN::GetPosWithField ( dRef[i].m_uWordPos ) ) << "hit " << i;
+	}
+}
+
+static void TestSortHits ( int iHits, int iWords, bool bDocOrder )
+{
+	CSphFixedVector<CSphWordHit> dHits ( iHits ), dTmp ( iHits );
+	FillTestHits ( dHits, iWords, bDocOrder );
+
+	CSphFixedVector<CSphWordHit> dSource ( iHits );
+	dSource.CopyFrom ( dHits );
+
+	const CSphWordHit * pSorted = sphSortHits ( dHits.Begin(), dTmp.Begin(), iHits );
+	ASSERT_TRUE ( pSorted==dHits.Begin() || pSorted==dTmp.Begin() );
+	CheckSortedHits ( pSorted, dSource );
+}
+
+TEST ( functions, SortHits )
+{
+	SCOPED_TRACE ( "empty" ); TestSortHits ( 0, 1, true );
+	SCOPED_TRACE ( "single word" ); TestSortHits ( 5000, 1, false );
+	SCOPED_TRACE ( "document order" ); TestSortHits ( 50000, 1000, true );
+	SCOPED_TRACE ( "random order" ); TestSortHits ( 50000, 1000, false );
+	SCOPED_TRACE ( "few words, random order" ); TestSortHits ( 50000, 3, false );
+}
+
+static void TestSortHitBlock ( int iHits, int iThreads, int iMinHitsPerThread, int iWords, int iRows=1000, int iPositions=100 )
+{
+	CSphFixedVector<CSphWordHit> dHits ( iHits ), dTmp ( iHits );
+	FillTestHits ( dHits, iWords, false, iRows, iPositions );
+
+	CSphFixedVector<CSphWordHit> dSource ( iHits );
+	dSource.CopyFrom ( dHits );
+
+	SortHits ( dHits, dTmp, iHits, iThreads, iMinHitsPerThread );
+	ASSERT_EQ ( dHits.GetLength(), iHits );
+	CheckSortedHits ( dHits.Begin(), dSource );
+}
+
+// parallel sort of indexer hit blocks must give the same order as the plain sort
+TEST ( functions, SortHitBlocks )
+{
+	SCOPED_TRACE ( "single thread" ); TestSortHitBlock ( 50000, 1, 1, 1000 );
+	SCOPED_TRACE ( "threads" ); TestSortHitBlock ( 100000, 4, 1, 1000 );
+	SCOPED_TRACE ( "uneven slices" ); TestSortHitBlock ( 100003, 7, 1, 1000 );
+	SCOPED_TRACE ( "too small for all threads" ); TestSortHitBlock ( 200000, 8, 65536, 1000 );
+	SCOPED_TRACE ( "duplicates" ); TestSortHitBlock ( 100000, 4, 1, 2, 3, 5 );
+	SCOPED_TRACE ( "all the same" ); TestSortHitBlock ( 10000, 4, 1, 1, 1, 1 );
+	SCOPED_TRACE ( "fewer hits than threads" ); TestSortHitBlock ( 5, 8, 1, 3 );
+	SCOPED_TRACE ( "as many hits as threads" ); TestSortHitBlock ( 8, 8, 1, 3, 2, 2 );
+	SCOPED_TRACE ( "single hit" ); TestSortHitBlock ( 1, 8, 1, 3 );
+	SCOPED_TRACE ( "empty" ); TestSortHitBlock ( 0, 8, 1, 3 );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 TEST ( functions, Writer )
@@ -961,6 +1200,154 @@ TEST ( functions, Writer )
 	delete[] pData;
 }
 
+TEST ( functions, ScopedIOClass )
+{
+	ASSERT_EQ ( GetIOClass(), IOClass_e::QUERY );
+	{
+		ScopedIOClass_c tMerge ( IOClass_e::MERGE );
+		ASSERT_EQ ( GetIOClass(), IOClass_e::MERGE );
+		{
+			ScopedIOClass_c tFlush ( IOClass_e::FLUSH );
+			ASSERT_EQ ( GetIOClass(), IOClass_e::FLUSH );
+		}
+		ASSERT_EQ ( GetIOClass(), IOClass_e::MERGE );
+	}
+	ASSERT_EQ ( GetIOClass(), IOClass_e::QUERY );
+
+	// the class follows the coroutine to other threads and into its child coroutines
+	Threads::CallCoroutine ( [] {
+		ASSERT_EQ ( GetIOClass(), IOClass_e::QUERY );
+		ScopedIOClass_c tPreread ( IOClass_e::PREREAD );
+		Threads::Coro::Reschedule();
+		ASSERT_EQ ( GetIOClass(), IOClass_e::PREREAD );
+
+		std::atomic<int> iPreread { 0 };
+		auto dWaiter = Threads::DefferedContinuator();
+		for ( int i = 0; i<10; ++i )
+			Threads::Coro::Co ( [&iPreread] {
+				Threads::Coro::Reschedule();
+				if ( GetIOClass()==IOClass_e::PREREAD )
+					++iPreread;
+			}, dWaiter );
+		Threads::WaitForDeffered ( std::move ( dWaiter ) );
+		ASSERT_EQ ( iPreread, 10 );
+	} );
+	ASSERT_EQ ( GetIOClass(), IOClass_e::QUERY );
+}
+
+static int64_t TimeThrottledIO ( IOClass_e eClass, int iIOs, int64_t iBytes )
+{
+	ScopedIOClass_c tClass ( eClass );
+	int64_t tmStart = sphMicroTimer();
+	for ( int i = 0; i<iIOs; ++i )
+		ThrottleIO ( iBytes );
+	return sphMicroTimer() - tmStart;
+}
+
+TEST ( functions, IOBudget )
+{
+	auto tResetBudgets = AtScopeExit ( [] { sphSetThrottling ( 0, 0 ); } );
+
+	// 200 iops is 5ms per I/O; first 100ms worth of I/Os (20) go as a burst
+	IOBudget_t tMerge;
+	tMerge.m_iIOps = 200;
+	SetIOBudget ( IOClass_e::MERGE, tMerge );
+	int64_t tmMerge = TimeThrottledIO ( IOClass_e::MERGE, 60, 1 );
+	ASSERT_GE ( tmMerge, 150000 );
+	ASSERT_LT ( tmMerge, 600000 );
+
+	// other classes are not limited by merge budget
+	ASSERT_LT ( TimeThrottledIO ( IOClass_e::QUERY, 1000, 1 ), 50000 );
+	ASSERT_LT ( TimeThrottledIO ( IOClass_e::FLUSH, 1000, 1 ), 50000 );
+
+	// binlog writes of a merge run in the QUERY class, out of the merge budget
+	{
+		ScopedIOClass_c tMergeTask ( IOClass_e::MERGE );
+		ASSERT_LT ( TimeThrottledIO ( IOClass_e::QUERY, 1000, 1 ), 50000 );
+		ASSERT_EQ ( GetIOClass(), IOClass_e::MERGE );
+	}
+
+	// bandwidth dominates when it costs more than iops; 20000 bytes at 1M/sec is 20ms, 5 I/Os go as a burst
+	IOBudget_t tFlush;
+	tFlush.m_iIOps = 1000;
+	tFlush.m_iBandwidth = 1000000;
+	SetIOBudget ( IOClass_e::FLUSH, tFlush );
+	int64_t tmFlush = TimeThrottledIO ( IOClass_e::FLUSH, 10, 20000 );
+	ASSERT_GE ( tmFlush, 70000 );
+	ASSERT_LT ( tmFlush, 400000 );
+
+	// unused budget doesn't accumulate above the burst
+	sphSleepMsec ( 300 );
+	tmMerge = TimeThrottledIO ( IOClass_e::MERGE, 40, 1 );
+	ASSERT_GE ( tmMerge, 70000 );
+
+	// writes bigger than max I/O size are split, and every piece is an I/O; 40 pieces at 100 iops, 10 go as a burst
+	tMerge.m_iIOps = 100;
+	tMerge.m_iMaxIOSize = 4096;
+	SetIOBudget ( IOClass_e::MERGE, tMerge );
+	sphSleepMsec ( 100 );
+
+	const CSphString sTmpWriteout = "__throttled.tmp";
+	CSphString sError;
+	CSphFixedVector<BYTE> dData ( 40*4096 );
+	dData.Fill ( 0xfe );
+	int iFD = ::open ( sTmpWriteout.cstr(), SPH_O_NEW, 0644 );
+	ASSERT_GE ( iFD, 0 );
+	int64_t tmWrite = sphMicroTimer();
+	{
+		ScopedIOClass_c tClass ( IOClass_e::MERGE );
+		ASSERT_TRUE ( sphWriteThrottled ( iFD, dData.Begin(), dData.GetLengthBytes64(), "throttled", sError ) ) << sError.cstr();
+	}
+	tmWrite = sphMicroTimer() - tmWrite;
+	::close ( iFD );
+	unlink ( sTmpWriteout.cstr() );
+	ASSERT_GE ( tmWrite, 250000 );
+	ASSERT_LT ( tmWrite, 1000000 );
+}
+
+TEST ( functions, IOYield )
+{
+	auto tResetYield = AtScopeExit ( [] { SetIOYieldTime ( 0 ); } );
+
+	// merges wait full yield time, saves 1/3 of it
+	SetIOYieldTime ( 30 );
+
+	// no queries - no waiting
+	sphSleepMsec ( 10 );
+	ASSERT_LT ( TimeThrottledIO ( IOClass_e::MERGE, 10, 4096 ), 10000 );
+
+	// right after query I/O, background waits for queries to be quiet for a while
+	sphSleepMsec ( 10 );
+	TimeThrottledIO ( IOClass_e::QUERY, 1, 4096 );
+	ASSERT_GE ( TimeThrottledIO ( IOClass_e::MERGE, 1, 4096 ), 1000 );
+
+	// queries keep reading, and background waits no longer than allowed
+	std::atomic<bool> bStop { false };
+	SphThread_t tQuery;
+	ASSERT_TRUE ( Threads::Create ( &tQuery, [&bStop] {
+		while ( !bStop.load ( std::memory_order_relaxed ) )
+		{
+			ThrottleIO ( 4096 );
+			sphSleepMsec ( 1 );
+		}
+	} ) );
+	sphSleepMsec ( 5 );
+	int64_t tmFlush = TimeThrottledIO ( IOClass_e::FLUSH, 1, 4096 );
+	int64_t tmMerge = TimeThrottledIO ( IOClass_e::MERGE, 1, 4096 );
+	bStop.store ( true, std::memory_order_relaxed );
+	Threads::Join ( &tQuery );
+
+	ASSERT_LT ( tmFlush, 30000 );
+	ASSERT_LT ( tmMerge, 100000 );
+
+	// query I/O is never delayed
+	ASSERT_LT ( TimeThrottledIO ( IOClass_e::QUERY, 1000, 4096 ), 50000 );
+
+	// and once queries are done, background goes on right away
+	sphSleepMsec ( 10 );
+	ASSERT_LT ( TimeThrottledIO ( IOClass_e::MERGE, 10, 4096 ), 10000 );
+}
+
 //////////////////////////////////////////////////////////////////////////
 struct tstcase { float wold; DWORD utimer; float wnew; };
 
@@ -2098,6 +2485,73 @@ TEST ( functions, histogram )
 	}
 }
 
+// estimate of a single filter over 1M rows, with the coefficients currently in effect
+static float EstimateScanCost()
+{
+	CSphQuery tQuery;
+	CSphSchema tSchema;
+	CSphColumnInfo tAttr ( "a", SPH_ATTR_INTEGER );
+	tSchema.AddAttr ( tAttr, false );
+
+	CSphVector<CSphFilterSettings> dFilters;
+	auto & tFilter = dFilters.Add();
+	tFilter.m_eType = SPH_FILTER_RANGE;
+	tFilter.m_sAttrName = "a";
+	tFilter.m_iMinValue = 0;
+	tFilter.m_iMaxValue = 100;
+
+	CSphVector<SecondaryIndexInfo_t> dSIInfo(1);
+	dSIInfo[0].m_eType = SecondaryIndexType_e::FILTER;
+	dSIInfo[0].m_iRsetEstimate = 500000;
+
+	SelectIteratorCtx_t tCtx ( tQuery, dFilters, tSchema, tSchema, nullptr, nullptr, nullptr, -1, 1000000, 1 );
+	tCtx.IgnorePushCost();
+	std::unique_ptr<CostEstimate_i> pEstimate ( CreateCostEstimate ( dSIInfo, tCtx, -1 ) );
+	return pEstimate->CalcQueryCost();
+}
+
+TEST ( functions, cost_feedback_convergence )
+{
+	SetCostCoeffs ( GetDefaultCostCoeffs() );
+	SetCostFeedback ( true );
+
+	float fInitial = EstimateScanCost();
+	ASSERT_GT ( fInitial, 1.0f );
+
+	// the box is 3x slower than the model thinks; the estimate must converge to the measured time
+	float fActual = fInitial*3.0f;
+	for ( int i = 0; i < 300; i++ )
+		CostFeedback ( { CostPath_e::SCAN, EstimateScanCost() }, int64_t ( fActual*1000.0f ) );
+
+	ASSERT_NEAR ( EstimateScanCost()/fActual, 1.0f, 0.02f );
+
+	// other paths are left alone
+	ASSERT_FLOAT_EQ ( GetCostCoeffs()[CostCoeff_e::COLUMNAR_FILTER], GetDefaultCostCoeffs()[CostCoeff_e::COLUMNAR_FILTER] );
+	ASSERT_FLOAT_EQ ( GetCostCoeffs()[CostCoeff_e::INDEX_READ_SINGLE], GetDefaultCostCoeffs()[CostCoeff_e::INDEX_READ_SINGLE] );
+
+	// a single outlier barely moves it
+	float fBefore = EstimateScanCost();
+	CostFeedback ( { CostPath_e::SCAN, fBefore }, int64_t ( fBefore*1000.0f*1000.0f ) );
+	ASSERT_LT ( EstimateScanCost()/fBefore, 1.12f );
+
+	// the correction is bounded to 8x
+	SetCostCoeffs ( GetDefaultCostCoeffs() );
+	for ( int i = 0; i < 1000; i++ )
+		CostFeedback ( { CostPath_e::SCAN, EstimateScanCost() }, int64_t ( fInitial*100.0f*1000.0f ) );
+
+	ASSERT_NEAR ( EstimateScanCost()/fInitial, 8.0f, 0.01f );
+
+	// short scans are not learned from
+	SetCostCoeffs ( GetDefaultCostCoeffs() );
+	CostFeedback ( { CostPath_e::SCAN, 0.5f }, 100000 );
+	ASSERT_FLOAT_EQ ( EstimateScanCost(), fInitial );
+
+	// feedback is off by default
+	SetCostFeedback ( false );
+	CostFeedback ( { CostPath_e::SCAN, fInitial }, int64_t ( fInitial*4000.0f ) );
+	ASSERT_FLOAT_EQ ( EstimateScanCost(), fInitial );
+}
+
 TEST ( functions, field_mask )
 {
 	FieldMask_t foo;
@@ -2241,3 +2695,220 @@ TEST ( functions, mutate_via_ref )
 	ASSERT_EQ ( refData->GetRefcount (), 1 );
 
 }
+
+//////////////////////////////////////////////////////////////////////////
+// exact group-by must give the same groups whether it fits in memory or spills to disk
+
+struct NoopMatchProcessor_t final : MatchProcessor_i
+{
+	void Process ( CSphMatch * ) final {}
+	void Process ( VecTraits_T<CSphMatch *> & ) final {}
+	bool ProcessInRowIdOrder() const final { return false; }
+};
+
+/// iSorters>1 works like pseudo sharding: docs are spread over sorter clones, which are then moved into the first one
+static CSphVector<std::pair<int64_t,int64_t>> RunExactGroupby ( int64_t iMaxBytes, int iSorters, const CSphString & sTmpDir, int64_t & iTotal )
+{
+	const int GROUPS = 30000;
+
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( sphGetDocidName(), SPH_ATTR_BIGINT ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "gid", SPH_ATTR_INTEGER ), false );
+	const CSphAttrLocator & tGidLoc = tSchema.GetAttr ( "gid" )->m_tLocator;
+
+	// group g gets 1+(g*7)%13 docs, spread over the whole doc set
+	CSphVector<int> dGroupOfDoc;
+	for ( int iGroup=0; iGroup<GROUPS; ++iGroup )
+		for ( int i=0; i<=(iGroup*7)%13; ++i )
+			dGroupOfDoc.Add ( iGroup );
+	sphSrand ( 7 );
+	for ( int i=dGroupOfDoc.GetLength()-1; i>0; --i )
+		Swap ( dGroupOfDoc[i], dGroupOfDoc[sphRand()%(i+1)] );
+
+	int iStride = tSchema.GetRowSize();
+	CSphFixedVector<CSphRowitem> dRows ( dGroupOfDoc.GetLength()*iStride );
+	ARRAY_FOREACH ( i, dGroupOfDoc )
+		sphSetRowAttr ( &dRows[i*iStride], tGidLoc, dGroupOfDoc[i] );
+
+	CSphQuery tQuery;
+	tQuery.m_sSelect = "gid, count(*) c";
+	tQuery.m_dItems.Add ( { "gid", "gid" } );
+	tQuery.m_dItems.Add ( { "count(*)", "c" } );
+	tQuery.m_sGroupBy = "gid";
+	tQuery.m_sGroupSortBy = "c desc, gid asc";
+	tQuery.m_iMaxMatches = 20;
+	tQuery.m_bExactGroupby = true;
+
+	SetExactGroupbySettings ( iMaxBytes, sTmpDir );
+	auto tRestore = AtScopeExit ( [] { SetExactGroupbySettings ( 128*1024*1024, "/tmp" ); } );
+
+	SphQueueSettings_t tQueueSettings ( tSchema );
+	tQueueSettings.m_bComputeItems = true;
+	SphQueueRes_t tRes;
+	CSphString sError;
+	std::unique_ptr<ISphMatchSorter> pSorter ( sphCreateQueue ( tQueueSettings, tQuery, sError, tRes ) );
+	EXPECT_TRUE ( pSorter ) << sError.cstr();
+	if ( !pSorter )
+		return {};
+
+	CSphVector<std::unique_ptr<ISphMatchSorter>> dClones;
+	for ( int i=1; i<iSorters; ++i )
+		dClones.Add ( std::unique_ptr<ISphMatchSorter> ( pSorter->Clone() ) );
+
+	auto fnSorter = [&] ( int iDoc ) { int iSorter = iDoc % iSorters; return iSorter ? dClones[iSorter-1].get() : pSorter.get(); };
+
+	CSphMatch tMatch;
+	tMatch.Reset ( pSorter->GetSchema()->GetDynamicSize() );
+	NoopMatchProcessor_t tNoop;
+	ARRAY_FOREACH ( i, dGroupOfDoc )
+	{
+		tMatch.m_tRowID = i;
+		tMatch.m_pStatic = &dRows[i*iStride];
+		fnSorter(i)->Push ( tMatch );
+
+		// not finalizing pass in the middle, like final expressions of one disk chunk; must keep every group
+		if ( i==dGroupOfDoc.GetLength()/2 )
+			fnSorter(i)->Finalize ( tNoop, false, false );
+	}
+
+	// thread sorters are not finalized, and merged into the main one
+	for ( auto & pClone : dClones )
+	{
+		pClone->Finalize ( tNoop, false, false );
+		pClone->MoveTo ( pSorter.get(), false );
+	}
+
+	pSorter->Finalize ( tNoop, false, true );
+	iTotal = pSorter->GetTotalCount();
+
+	CSphFixedVector<CSphMatch> dMatches ( pSorter->GetLength() );
+	int iMatches = pSorter->Flatten ( dMatches.Begin() );
+
+	const ISphSchema & tResSchema = *pSorter->GetSchema();
+	const CSphAttrLocator & tResGid = tResSchema.GetAttr ( "gid" )->m_tLocator;
+	const CSphAttrLocator & tResCount = tResSchema.GetAttr ( "c" )->m_tLocator;
+	CSphVector<std::pair<int64_t,int64_t>> dResult;
+	for ( int i=0; i<iMatches; ++i )
+		dResult.Add ( { dMatches[i].GetAttr ( tResGid ), dMatches[i].GetAttr ( tResCount ) } );
+
+	return dResult;
+}
+
+TEST ( functions, exact_groupby_spill )
+{
+	std::error_code tError;
+	std::filesystem::path tTmpDir = std::filesystem::temp_directory_path ( tError ) / ( "exact_groupby." + std::to_string ( getpid() ) );
+	ASSERT_TRUE ( std::filesystem::create_directories ( tTmpDir, tError ) ) << tError.message();
+	auto tCleanup = AtScopeExit ( [&tTmpDir] { std::error_code tIgnore; std::filesystem::remove_all ( tTmpDir, tIgnore ); } );
+	CSphString sTmpDir = tTmpDir.string().c_str();
+
+	int64_t iTotalInMemory = 0;
+	auto dInMemory = RunExactGroupby ( 1024*1024*1024, 1, sTmpDir, iTotalInMemory );
+	ASSERT_EQ ( iTotalInMemory, 30000 );
+	ASSERT_EQ ( dInMemory.GetLength(), 20 );
+
+	for ( int iSorters : { 1, 3 } )
+	{
+		int64_t iTotalSpilled = 0;
+		auto dSpilled = RunExactGroupby ( 64*1024, iSorters, sTmpDir, iTotalSpilled );
+
+		ASSERT_EQ ( iTotalSpilled, 30000 ) << iSorters << " sorters";
+		ASSERT_EQ ( dSpilled.GetLength(), 20 ) << iSorters << " sorters";
+		ARRAY_FOREACH ( i, dInMemory )
+		{
+			ASSERT_EQ ( dInMemory[i].first, dSpilled[i].first ) << iSorters << " sorters";
+			ASSERT_EQ ( dInMemory[i].second, dSpilled[i].second ) << iSorters << " sorters";
+			ASSERT_EQ ( dInMemory[i].second, 13 );
+		}
+
+		// spill files are temporary
+		ASSERT_TRUE ( std::filesystem::is_empty ( tTmpDir, tError ) ) << iSorters << " sorters";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// zstd docstore: documents must survive the trip through a trained dictionary, and a broken dictionary size must be rejected
+
+static CSphString DocstoreTestDoc ( int iDoc )
+{
+	CSphString sDoc;
+	sDoc.SetSprintf ( "document %d: the quick brown fox %d jumps over the lazy dog %d times, then rests for %d minutes", iDoc, iDoc%17, iDoc%5, iDoc%60 );
+	return sDoc;
+}
+
+TEST ( functions, docstore_zstd_dictionary )
+{
+	const int DOCS = 5000;
+	const char * szFile = "test_docstore_zstd.spds";
+	auto tCleanup = AtScopeExit ( [szFile] { unlink ( szFile ); } );
+
+	DocstoreSettings_t tSettings;
+	tSettings.m_eCompression = Compression_e::ZSTD;
+	tSettings.m_uBlockSize = 4096;
+
+	CSphString sError;
+	{
+		auto pBuilder = CreateDocstoreBuilder ( szFile, tSettings, sError );
+		if ( !pBuilder )
+			GTEST_SKIP() << "zstd is not available: " << sError.cstr();
+
+		pBuilder->AddField ( "title", DOCSTORE_TEXT );
+		for ( int i = 0; i<DOCS; i++ )
+		{
+			CSphString sDoc = DocstoreTestDoc(i);
+			DocstoreBuilder_i::Doc_t tDoc;
+			tDoc.m_dFields.Add ( { (BYTE *)const_cast<char *>( sDoc.cstr() ), sDoc.Length() } );
+			pBuilder->AddDoc ( i, tDoc );
+		}
+		pBuilder->Finalize();
+	}
+
+	// file starts with version, block size, compression, fields (one "title"), number of blocks and the offset of the trailing header
+	CSphAutoreader tReader;
+	ASSERT_TRUE ( tReader.Open ( szFile, sError ) ) << sError.cstr();
+	tReader.SeekTo ( 4+4+1+4+1+4+5+4, sizeof(SphOffset_t) );
+	SphOffset_t tDictPos = tReader.GetOffset();
+	tReader.SeekTo ( tDictPos, 0 );
+	DWORD uDictSize = tReader.UnzipInt();
+	SphOffset_t tAfterDictSize = tReader.GetPos();
+	SphOffset_t tFileSize = tReader.GetFilesize();
+	tReader.Close();
+	ASSERT_GT ( uDictSize, 0u ) << "dictionary must be trained";
+
+	{
+		auto pDocstore = CreateDocstore ( 1, szFile, sError );
+		ASSERT_TRUE ( pDocstore ) << sError.cstr();
+		pDocstore->CreateReader ( 1 );
+		int iField = pDocstore->GetFieldId ( "title", DOCSTORE_TEXT );
+		ASSERT_EQ ( iField, 0 );
+
+		for ( int i = 0; i<DOCS; i += 7 )
+		{
+			DocstoreDoc_t tDoc = pDocstore->GetDoc ( i, nullptr, 1, false );
+			ASSERT_EQ ( tDoc.m_dFields.GetLength(), 1 );
+			CSphString sExpected = DocstoreTestDoc(i);
+			ASSERT_EQ ( tDoc.m_dFields[0].GetLength(), sExpected.Length() ) << "doc " << i;
+			ASSERT_EQ ( memcmp ( tDoc.m_dFields[0].Begin(), sExpected.cstr(), sExpected.Length() ), 0 ) << "doc " << i;
+		}
+	}
+
+	// same file, but the dictionary size is replaced with a huge one (1G); must fail without trying to allocate that much
+	CSphFixedVector<BYTE> dFile ( tFileSize );
+	{
+		CSphAutofile tFile ( szFile, SPH_O_READ, sError );
+		ASSERT_TRUE ( tFile.Read ( dFile.Begin(), tFileSize, sError ) ) << sError.cstr();
+	}
+
+	{
+		CSphWriter tWriter;
+		ASSERT_TRUE ( tWriter.OpenFile ( szFile, sError ) ) << sError.cstr();
+		tWriter.PutBytes ( dFile.Begin(), tDictPos );
+		tWriter.ZipInt ( 1U<<30 );
+		tWriter.PutBytes ( dFile.Begin()+tAfterDictSize, tFileSize-tAfterDictSize );
+		tWriter.CloseFile();
+	}
+
+	auto pBroken = CreateDocstore ( 2, szFile, sError );
+	ASSERT_FALSE ( pBroken );
+	ASSERT_TRUE ( sError.Begins ( "Unable to load docstore" ) ) << sError.cstr();
+}
@@ -0,0 +1,302 @@
+//
+// Copyright (c) 2023, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include <gtest/gtest.h>
+
+#include "searchdhttp.h"
+#include "compressed_http.h"
+#include "compressed_zstd_mysql.h"
+
+// Miscelaneous tests of http replies: streaming and compression
+
+/// collects everything that would be sent to the client
+class MemOutputBuffer_c final : public GenericOutputBuffer_c
+{
+public:
+	CSphVector<BYTE> m_dSent;
+
+	bool SendBuffer ( const VecTraits_T<BYTE> & dData ) final
+	{
+		m_dSent.Append ( dData );
+		return true;
+	}
+
+	void SetWTimeoutUS ( int64_t ) final {}
+	int64_t GetWTimeoutUS () const final { return 0; }
+	int64_t GetTotalSent() const final { return m_dSent.GetLength(); }
+};
+
+
+/// encodes given number of rows the same way search handlers do, flushing after every row
+class RowsHandler_c final : public HttpHandler_c
+{
+public:
+	explicit RowsHandler_c ( int iRows )
+		: m_iRows ( iRows )
+	{}
+
+	bool Process () final
+	{
+		JsonEscapedBuilder tOut;
+		EncodeRows ( tOut, [this] ( JsonEscapedBuilder & tBuf ) { StreamChunk ( tBuf ); } );
+		return StreamFinish ( tOut );
+	}
+
+	void EncodeRows ( JsonEscapedBuilder & tOut, const std::function<void ( JsonEscapedBuilder & )> & fnFlush ) const
+	{
+		tOut.StartBlock ( ",", "[", "]" );
+		for ( int i = 0; i < m_iRows; i++ )
+		{
+			tOut.Sprintf ( R"({"id":%d,"title":"row number %d of the streamed reply"})", i, i );
+			fnFlush ( tOut );
+		}
+		tOut.FinishBlocks();
+	}
+
+private:
+	int m_iRows = 0;
+};
+
+
+static CSphString SentStr ( const CSphVector<BYTE> & dSent )
+{
+	CSphString sSent;
+	sSent.SetBinary ( (const char *)dSent.Begin(), dSent.GetLength() );
+	return sSent;
+}
+
+/// splits chunked reply to the header and the joined body; fails if framing is broken
+static void ParseChunkedReply ( const CSphVector<BYTE> & dSent, CSphString & sHeader, CSphString & sBody, int & iChunks )
+{
+	CSphString sReply = SentStr ( dSent );
+	const char * pEnd = sReply.cstr() + sReply.Length();
+	const char * pBody = strstr ( sReply.cstr(), "\r\n\r\n" );
+	ASSERT_TRUE ( pBody );
+	pBody += 4;
+	sHeader.SetBinary ( sReply.cstr(), int ( pBody-sReply.cstr() ) );
+
+	StringBuilder_c tBody;
+	iChunks = 0;
+	const char * p = pBody;
+	while ( true )
+	{
+		char * pLenEnd = nullptr;
+		int iLen = (int)strtol ( p, &pLenEnd, 16 );
+		ASSERT_NE ( pLenEnd, p ) << "chunk length expected";
+		ASSERT_TRUE ( pLenEnd+2<=pEnd && pLenEnd[0]=='\r' && pLenEnd[1]=='\n' );
+		p = pLenEnd+2;
+
+		// terminating chunk has no data and must be the very last thing sent
+		if ( !iLen )
+		{
+			ASSERT_EQ ( pEnd-p, 2 );
+			ASSERT_EQ ( p[0], '\r' );
+			ASSERT_EQ ( p[1], '\n' );
+			break;
+		}
+
+		ASSERT_LE ( p+iLen+2, pEnd );
+		tBody.AppendRawChunk ( { p, iLen } );
+		p += iLen;
+		ASSERT_EQ ( p[0], '\r' );
+		ASSERT_EQ ( p[1], '\n' );
+		p += 2;
+
+		++iChunks;
+	}
+
+	sBody = tBody.cstr();
+}
+
+
+TEST ( http, stream_chunks )
+{
+	MemOutputBuffer_c tOut;
+	RowsHandler_c tHandler ( 10000 );
+	tHandler.SetErrorFormat ( true );
+	tHandler.SetStreamOutput ( &tOut, HttpEncoding_e::NONE );
+	ASSERT_TRUE ( tHandler.Process() );
+	ASSERT_TRUE ( tHandler.IsStreamed() );
+	ASSERT_TRUE ( tHandler.GetResult().IsEmpty() );
+
+	CSphString sHeader, sBody;
+	int iChunks = 0;
+	ParseChunkedReply ( tOut.m_dSent, sHeader, sBody, iChunks );
+	ASSERT_FALSE ( HasFailure() );
+
+	ASSERT_TRUE ( sHeader.Begins ( "HTTP/1.1 200 OK\r\n" ) );
+	ASSERT_NE ( strstr ( sHeader.cstr(), "Transfer-Encoding: chunked\r\n" ), nullptr );
+	ASSERT_EQ ( strstr ( sHeader.cstr(), "Content-Length" ), nullptr );
+	ASSERT_GT ( iChunks, 2 );
+
+	// same document as without streaming
+	JsonEscapedBuilder tExpected;
+	tHandler.EncodeRows ( tExpected, [] ( JsonEscapedBuilder & ) {} );
+	ASSERT_STREQ ( sBody.cstr(), tExpected.cstr() );
+}
+
+
+TEST ( http, stream_short_reply )
+{
+	// reply shorter than one chunk goes out as a regular one
+	MemOutputBuffer_c tOut;
+	RowsHandler_c tHandler ( 10 );
+	tHandler.SetErrorFormat ( true );
+	tHandler.SetStreamOutput ( &tOut, HttpEncoding_e::NONE );
+	ASSERT_TRUE ( tHandler.Process() );
+	ASSERT_FALSE ( tHandler.IsStreamed() );
+	ASSERT_TRUE ( tOut.m_dSent.IsEmpty() );
+
+	CSphString sReply = SentStr ( tHandler.GetResult() );
+	ASSERT_TRUE ( sReply.Begins ( "HTTP/1.1 200 OK\r\n" ) );
+	ASSERT_NE ( strstr ( sReply.cstr(), "Content-Length: " ), nullptr );
+	ASSERT_EQ ( strstr ( sReply.cstr(), "chunked" ), nullptr );
+}
+
+
+TEST ( http, stream_needs_http11 )
+{
+	auto fnCanChunk = [] ( const char * szRequest )
+	{
+		HttpRequestParser_c tParser;
+		Str_t sRequest = FromSz ( szRequest );
+		EXPECT_TRUE ( tParser.ParseHeader ( S2B ( sRequest ) ) );
+		EXPECT_EQ ( tParser.Error(), nullptr );
+		return tParser.CanChunkReply();
+	};
+
+	ASSERT_TRUE ( fnCanChunk ( "GET /sql?stream=1&query=select HTTP/1.1\r\nHost: localhost\r\n\r\n" ) );
+	ASSERT_FALSE ( fnCanChunk ( "GET /sql?stream=1&query=select HTTP/1.0\r\nHost: localhost\r\n\r\n" ) );
+}
+
+
+TEST ( http, accepted_encoding )
+{
+	ASSERT_EQ ( HttpAcceptedEncoding ( "" ), HttpEncoding_e::NONE );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "identity" ), HttpEncoding_e::NONE );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "br, deflate" ), HttpEncoding_e::NONE );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "*;q=0" ), HttpEncoding_e::NONE );
+
+#if WITH_ZLIB
+	ASSERT_EQ ( HttpAcceptedEncoding ( "gzip" ), HttpEncoding_e::GZIP );
+	ASSERT_EQ ( HttpAcceptedEncoding ( " GZIP ; q=0.5 " ), HttpEncoding_e::GZIP );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "x-gzip" ), HttpEncoding_e::GZIP );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "gzip;q=0" ), HttpEncoding_e::NONE );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "gzip;q=0.0, br" ), HttpEncoding_e::NONE );
+	ASSERT_EQ ( HttpAcceptedEncoding ( "gzip;q=0, *" ), IsZstdCompressionAvailable() ? HttpEncoding_e::ZSTD : HttpEncoding_e::NONE );
+#endif
+
+#if WITH_ZLIB && WITH_ZSTD
+	if ( IsZstdCompressionAvailable() )
+	{
+		ASSERT_EQ ( HttpAcceptedEncoding ( "gzip, zstd" ), HttpEncoding_e::ZSTD );
+		ASSERT_EQ ( HttpAcceptedEncoding ( "gzip;q=1, zstd;q=0.5" ), HttpEncoding_e::GZIP );
+		ASSERT_EQ ( HttpAcceptedEncoding ( "zstd;q=0, gzip;q=0.1" ), HttpEncoding_e::GZIP );
+		ASSERT_EQ ( HttpAcceptedEncoding ( "*" ), HttpEncoding_e::ZSTD );
+		ASSERT_EQ ( HttpAcceptedEncoding ( "zstd;q=0, *" ), HttpEncoding_e::GZIP );
+		ASSERT_EQ ( HttpAcceptedEncoding ( "gzip;q=0.8, *;q=0.5" ), HttpEncoding_e::GZIP );
+		ASSERT_EQ ( HttpAcceptedEncoding ( "gzip;q=0, zstd;q=0, *" ), HttpEncoding_e::NONE );
+	}
+#endif
+}
+
+
+TEST ( http, content_encoding )
+{
+	HttpEncoding_e eEncoding;
+	CSphString sError;
+	ASSERT_TRUE ( HttpContentEncoding ( "identity", eEncoding, sError ) );
+	ASSERT_EQ ( eEncoding, HttpEncoding_e::NONE );
+	ASSERT_FALSE ( HttpContentEncoding ( "br", eEncoding, sError ) );
+	ASSERT_FALSE ( sError.IsEmpty() );
+
+#if WITH_ZLIB
+	ASSERT_TRUE ( HttpContentEncoding ( " Gzip ", eEncoding, sError ) );
+	ASSERT_EQ ( eEncoding, HttpEncoding_e::GZIP );
+#endif
+}
+
+
+static CSphVector<BYTE> HttpTestBody ( int iRows )
+{
+	StringBuilder_c sBody;
+	DWORD uSeed = 1;
+	for ( int i = 0; i < iRows; i++ )
+	{
+		uSeed = uSeed*1103515245 + 12345;
+		sBody.Sprintf ( R"({"insert":{"index":"test","id":%d,"doc":{"title":"row %d","price":%u}}})" "\n", i, i, uSeed>>16 );
+	}
+
+	CSphVector<BYTE> dBody;
+	dBody.Append ( (ByteBlob_t)sBody );
+	return dBody;
+}
+
+
+static void TestHttpCoding ( HttpEncoding_e eEncoding )
+{
+	CSphVector<BYTE> dBody = HttpTestBody ( 5000 );
+
+	// several flushed parts and the final one, like a streamed reply
+	auto pEncoder = CreateHttpEncoder ( eEncoding );
+	ASSERT_TRUE ( pEncoder );
+	CSphVector<BYTE> dEncoded;
+	const int iParts = 7;
+	int iPart = dBody.GetLength() / iParts;
+	for ( int i = 0; i < iParts; i++ )
+	{
+		int iStart = i*iPart;
+		int iLen = i==iParts-1 ? dBody.GetLength()-iStart : iPart;
+		ASSERT_TRUE ( pEncoder->Encode ( { dBody.Begin()+iStart, iLen }, false, dEncoded ) );
+	}
+	ASSERT_TRUE ( pEncoder->Encode ( { nullptr, 0 }, true, dEncoded ) );
+	ASSERT_LT ( dEncoded.GetLength(), dBody.GetLength()/2 );
+
+	CSphVector<BYTE> dDecoded;
+	CSphString sError;
+	ASSERT_TRUE ( HttpDecode ( eEncoding, dEncoded, dBody.GetLength(), dDecoded, sError ) ) << sError.cstr();
+	ASSERT_EQ ( dDecoded.GetLength(), dBody.GetLength() );
+	ASSERT_EQ ( memcmp ( dDecoded.Begin(), dBody.Begin(), dBody.GetLength() ), 0 );
+	ASSERT_EQ ( dDecoded.Begin()[dDecoded.GetLength()], 0 ) << "decoded body must be zero-terminated";
+
+	// decoded size limit
+	ASSERT_FALSE ( HttpDecode ( eEncoding, dEncoded, dBody.GetLength()-1, dDecoded, sError ) );
+	ASSERT_TRUE ( sError.Begins ( "decoded body length out of bounds" ) ) << sError.cstr();
+
+	// truncated body
+	sError = "";
+	ASSERT_FALSE ( HttpDecode ( eEncoding, { dEncoded.Begin(), dEncoded.GetLength()/2 }, dBody.GetLength(), dDecoded, sError ) );
+	ASSERT_FALSE ( sError.IsEmpty() );
+
+	// corrupted header
+	CSphVector<BYTE> dCorrupt = dEncoded;
+	dCorrupt[0] ^= 0xFF;
+	dCorrupt[1] ^= 0xFF;
+	sError = "";
+	ASSERT_FALSE ( HttpDecode ( eEncoding, dCorrupt, dBody.GetLength(), dDecoded, sError ) );
+	ASSERT_FALSE ( sError.IsEmpty() );
+}
+
+#if WITH_ZLIB
+TEST ( http, gzip_round_trip )
+{
+	TestHttpCoding ( HttpEncoding_e::GZIP );
+}
+#endif
+
+#if WITH_ZSTD
+TEST ( http, zstd_round_trip )
+{
+	if ( !IsZstdCompressionAvailable() )
+		GTEST_SKIP() << "zstd library is not available";
+
+	TestHttpCoding ( HttpEncoding_e::ZSTD );
+}
+#endif
@@ -14,6 +14,12 @@
 #include "json/cJSON.h"
 #include "sphinxjson.h"
 #include "sphinxjsonquery.h"
+#include "jsoncolumns.h"
+#include "attribute.h"
+#include "sphinxrt.h"
+#include "searchdsql.h"
+
+#include <random>
 
 // Miscelaneous short tests for json/cjson
 
@@ -287,6 +293,324 @@ TEST_F( TJson, parser )
 	ASSERT_TRUE ( testcase ( R"({"a":{"b":0,"c":0},"d":[2,3333333333333333,45,-235]})" ) );
 }
 
+TEST_F ( TJson, parser_dialect )
+{
+	ASSERT_TRUE ( testcase ( "{ # comment\n a:1, // another\n 'b':'str', C:TRUE, d:.5, e:+3 }" ) );
+	ASSERT_TRUE ( testcase ( "" ) );
+	ASSERT_TRUE ( testcase ( R"({"long":"                                                  \"escaped\" tail"})" ) );
+
+	ASSERT_FALSE ( testcase ( R"({"a":1,})" ) );
+	ASSERT_FALSE ( testcase ( R"({"a":"unterminated})" ) );
+	ASSERT_FALSE ( testcase ( R"({"a":12abc})" ) );
+	ASSERT_FALSE ( testcase ( R"({true:1})" ) );
+	ASSERT_FALSE ( testcase ( "123" ) );
+	ASSERT_STREQ ( sError.cstr(), "P10: syntax error, unexpected TOK_INT near '123'" );
+}
+
+TEST ( CJson, skip_whitespace )
+{
+	const char * sText = "                   \t\n\r  x";
+	auto pEnd = sText+strlen ( sText );
+	ASSERT_EQ ( sphJsonSkipWhitespace ( sText, pEnd ), pEnd-1 );
+	ASSERT_EQ ( sphJsonSkipWhitespace ( pEnd-1, pEnd ), pEnd-1 );
+	ASSERT_EQ ( sphJsonSkipWhitespace ( sText, pEnd-1 ), pEnd-1 );
+
+	const char * sStr = "plain text long enough for a vector step \\n \" tail";
+	auto pStrEnd = sStr+strlen ( sStr );
+	ASSERT_EQ ( sphJsonFindQuoteOrEscape ( sStr, pStrEnd ), strchr ( sStr, '\\' ) );
+	ASSERT_EQ ( sphJsonFindQuoteOrEscape ( sStr, pStrEnd, '\'' ), strchr ( sStr, '\\' ) );
+	ASSERT_EQ ( sphJsonFindQuoteOrEscape ( sStr, sStr+10 ), sStr+10 );
+}
+
+// strict json which old flex/bison parser and cJSON agree on
+static const char * g_dBsonCorpus[] =
+{
+	R"({})",
+	R"([])",
+	R"({"a":1,"B":-2,"c":0,"d":-0})",
+	R"({"i32":2147483647,"i32n":-2147483648,"i64":2147483648,"i64n":-9223372036854775808})",
+	R"({"d":1.5,"e":-3.25e2,"f":1E+2,"g":0.000001,"h":1e-300})",
+	R"({"t":true,"f":false,"n":null})",
+	R"({"s":"","esc":"q\"uote \\ slash\/ \b\f\n\r\t end","u":"é中","pair":"😀 𝄞"})",
+	R"({"ints":[1,2,3],"bigs":[1,5000000000,-7],"dbls":[1.5,2.5],"strs":["a","b\n",""],"mixed":[1,"a",1.5,true,null,{},[]]})",
+	R"({"nested":{"a":{"b":{"c":[[1,2],[3,[4,{"d":"e"}]]]}}},"Upper":{"KEY":"Value"}})",
+	R"([1,[2,[3,[4,[5,[6]]]]],{"x":[{"y":[{"z":1}]}]}])",
+	R"(["one","two","three"])",
+	R"([1.5,2,3])",
+	R"({"key with spaces":1,"ümläut":2,"emoji😀":3})",
+	" \t\r\n{ \"spaced\" : [ 1 , 2 , { \"x\" : \"y\" } ] , \"z\" : { } }\n",
+};
+
+// random strict json documents over all value kinds the parser distinguishes
+struct RandomJson_t
+{
+	std::mt19937 m_tRng { 42 };
+
+	void Scalar ( StringBuilder_c & sOut )
+	{
+		switch ( m_tRng()%9 )
+		{
+		case 0: sOut << int ( m_tRng()%2000 )-1000; break;
+		case 1: sOut << (int64_t)m_tRng()*100000; break;
+		case 2: sOut << "1.5"; break;
+		case 3: sOut << "\"s" << int ( m_tRng()%100 ) << "\""; break;
+		case 4: sOut << "true"; break;
+		case 5: sOut << "null"; break;
+		case 6: sOut << R"("a\nbé\"q😀")"; break;
+		case 7: sOut << "-3.25e2"; break;
+		default: sOut << "false"; break;
+		}
+	}
+
+	void Value ( StringBuilder_c & sOut, int iDepth )
+	{
+		int iKind = m_tRng() % ( iDepth>3 ? 2 : 4 );
+		if ( iKind<2 )
+			return Scalar ( sOut );
+
+		int iItems = m_tRng()%6;
+		if ( iKind==2 )
+		{
+			sOut << "{";
+			for ( int i = 0; i<iItems; ++i )
+			{
+				sOut << ( i ? ", " : "" ) << "\"k" << i << "\" : ";
+				Value ( sOut, iDepth+1 );
+			}
+			sOut << "}";
+			return;
+		}
+
+		// arrays are often homogeneous, which is stored differently
+		int iArray = m_tRng()%3;
+		sOut << "[";
+		for ( int i = 0; i<iItems; ++i )
+		{
+			sOut << ( i ? ",\n " : "" );
+			if ( iArray==0 )
+				sOut << i*7;
+			else if ( iArray==1 )
+				sOut << "\"x" << i << "\"";
+			else
+				Value ( sOut, iDepth+1 );
+		}
+		sOut << "]";
+	}
+
+	CSphString Doc()
+	{
+		StringBuilder_c sOut;
+		if ( m_tRng()%2 )
+		{
+			sOut << "{\"Root\": ";
+			Value ( sOut, 0 );
+			sOut << ", \"z\":1}";
+		} else
+		{
+			sOut << "[";
+			Value ( sOut, 0 );
+			sOut << ",";
+			Value ( sOut, 0 );
+			sOut << "]";
+		}
+		return CSphString ( sOut.cstr() );
+	}
+};
+
+// parser output must be the same bson as cJSON->bson conversion gives (plus the trailing eof byte)
+static void CheckSameBson ( const char * sJson, bool bToLowercase )
+{
+	CSphVector<BYTE> dData, dRef;
+	CSphString sError;
+	CSphString sText ( sJson );
+	ASSERT_TRUE ( sphJsonParse ( dData, (char *)sText.cstr(), false, bToLowercase, false, sError ) ) << sJson << ": " << sError.cstr();
+
+	errno = 0; // cJSON checks errno after strtoull without resetting it
+	cJSON * pRoot = cJSON_Parse ( sJson );
+	ASSERT_TRUE ( pRoot ) << sJson;
+	ASSERT_TRUE ( bson::cJsonToBson ( pRoot, dRef, false, bToLowercase ) );
+	cJSON_Delete ( pRoot );
+
+	ASSERT_EQ ( dData.GetLength(), dRef.GetLength()+1 ) << sJson;
+	ASSERT_EQ ( dData.Last(), 0 ) << sJson;
+	ASSERT_EQ ( memcmp ( dData.Begin(), dRef.Begin(), dRef.GetLength() ), 0 ) << sJson;
+}
+
+TEST ( CJson, parser_same_as_cjson )
+{
+	for ( const char * sJson : g_dBsonCorpus )
+		CheckSameBson ( sJson, false );
+
+	RandomJson_t tGen;
+	for ( int i = 0; i<2000; ++i )
+		CheckSameBson ( tGen.Doc().cstr(), i&1 );
+}
+
+// cJSON turns integers out of int64 range into doubles; the parser clamps them as strtoll did in the flex lexer
+TEST_F ( TJson, parser_int_overflow )
+{
+	auto tst = Bsons ( "[18446744073709551615, -99999999999999999999, 9223372036854775807]" );
+	ASSERT_EQ ( tst[0].GetType(), JSON_INT64 );
+	ASSERT_EQ ( tst[0].Int(), INT64_MAX );
+	ASSERT_EQ ( tst[1].Int(), INT64_MIN );
+	ASSERT_EQ ( tst[2].Int(), INT64_MAX );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// single-pass insert reader vs cJSON
+
+static void CompareInsertStmts ( const SqlStmt_t & tStmt, const SqlStmt_t & tRef, const char * szJson )
+{
+	ASSERT_EQ ( tStmt.m_eStmt, tRef.m_eStmt ) << szJson;
+	ASSERT_STREQ ( tStmt.m_sIndex.scstr(), tRef.m_sIndex.scstr() ) << szJson;
+	ASSERT_STREQ ( tStmt.m_sCluster.scstr(), tRef.m_sCluster.scstr() ) << szJson;
+	ASSERT_STREQ ( tStmt.m_tQuery.m_sIndexes.scstr(), tRef.m_tQuery.m_sIndexes.scstr() ) << szJson;
+
+	ASSERT_EQ ( tStmt.m_dInsertSchema.GetLength(), tRef.m_dInsertSchema.GetLength() ) << szJson;
+	ARRAY_FOREACH ( i, tRef.m_dInsertSchema )
+		ASSERT_STREQ ( tStmt.m_dInsertSchema[i].scstr(), tRef.m_dInsertSchema[i].scstr() ) << szJson;
+
+	ASSERT_EQ ( tStmt.m_dInsertValues.GetLength(), tRef.m_dInsertValues.GetLength() ) << szJson;
+	ARRAY_FOREACH ( i, tRef.m_dInsertValues )
+	{
+		const SqlInsert_t & tVal = tStmt.m_dInsertValues[i];
+		const SqlInsert_t & tRefVal = tRef.m_dInsertValues[i];
+		ASSERT_EQ ( tVal.m_iType, tRefVal.m_iType ) << szJson << " value " << i;
+		switch ( tRefVal.m_iType )
+		{
+		case SqlInsert_t::CONST_INT:
+			ASSERT_EQ ( tVal.GetValueInt(), tRefVal.GetValueInt() ) << szJson << " value " << i;
+			ASSERT_EQ ( tVal.IsNegativeInt(), tRefVal.IsNegativeInt() ) << szJson << " value " << i;
+			break;
+
+		case SqlInsert_t::CONST_FLOAT:
+			ASSERT_EQ ( tVal.m_fVal, tRefVal.m_fVal ) << szJson << " value " << i;
+			break;
+
+		case SqlInsert_t::QUOTED_STRING:
+			ASSERT_STREQ ( tVal.m_sVal.scstr(), tRefVal.m_sVal.scstr() ) << szJson << " value " << i;
+			break;
+
+		case SqlInsert_t::CONST_MVA:
+			ASSERT_TRUE ( tVal.m_pVals && tRefVal.m_pVals ) << szJson << " value " << i;
+			ASSERT_EQ ( tVal.m_pVals->GetLength(), tRefVal.m_pVals->GetLength() ) << szJson << " value " << i;
+			ARRAY_FOREACH ( j, (*tRefVal.m_pVals) )
+				ASSERT_EQ ( (*tVal.m_pVals)[j], (*tRefVal.m_pVals)[j] ) << szJson << " value " << i;
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+// bFast tells whether the single-pass reader must take the request itself (or leave it for cJSON)
+static void CheckJsonInsert ( const char * szJson, bool bFast, bool bCompat = false )
+{
+	SqlStmt_t tProbe;
+	DocID_t tProbeId = 0;
+	ASSERT_EQ ( ReadJsonInsert ( szJson, tProbe, tProbeId, false, bCompat ), bFast ) << szJson;
+
+	SqlStmt_t tStmt;
+	DocID_t tDocId = 0;
+	CSphString sError;
+	bool bOk = sphParseJsonInsert ( szJson, tStmt, tDocId, false, bCompat, sError );
+
+	SqlStmt_t tRef;
+	DocID_t tRefId = 0;
+	CSphString sRefError;
+	bool bRefOk = ParseJsonInsert ( JsonObj_c ( szJson ), tRef, tRefId, false, bCompat, sRefError );
+
+	ASSERT_EQ ( bOk, bRefOk ) << szJson;
+	ASSERT_STREQ ( sError.scstr(), sRefError.scstr() ) << szJson;
+	if ( !bRefOk )
+		return;
+
+	ASSERT_EQ ( tDocId, tRefId ) << szJson;
+	CompareInsertStmts ( tStmt, tRef, szJson );
+}
+
+TEST ( JsonInsert, reader_same_as_cjson )
+{
+	// plain documents, taken by the reader
+	CheckJsonInsert ( R"({"index":"test","id":1,"doc":{"title":"hello","gid":5,"price":1.5,"flag":true,"off":false}})", true );
+	CheckJsonInsert ( R"({"index":"test","id":2,"doc":{"Title":"q\"uote \\ slash\/ \b\f\n\r\t end","té":""}})", true );
+	CheckJsonInsert ( R"({"index":"test","id":3,"doc":{"title":"é 中 😀 𝄞"}})", true );
+	CheckJsonInsert ( R"({"index":"test","id":4,"doc":{"j":{"a":[1,-2,{"b":null,"c":"x\"yé\n\u001f"}],"d":{"e":-1.25e-3,"f":[],"g":0.1},"h":{}},"tags":[1,2,3000000000],"none":[]}})", true );
+	CheckJsonInsert ( R"({"index":"test","id":5,"doc":{"a":0,"b":-0,"c":-9223372036854775,"d":123456789012345678,"e":1e3,"f":-2.5E-3,"g":0.1,"h":1E+2,"i":-0.0}})", true );
+	CheckJsonInsert ( R"({"index":"test","id":6,"doc":{"arr":[1,"two",{"3":[4.5,true,null]}],"o":{"k":"v"}}})", true, true );
+	CheckJsonInsert ( " \n{  \"index\" : \"test\" , \"cluster\":\"c1\" }\t", true );
+	CheckJsonInsert ( R"({"doc":{"s":"x"},"extra":{"x":[1,2,null,"😀"]},"id":7,"INDEX":"test"})", true );
+
+	// valid json the reader leaves to cJSON
+	CheckJsonInsert ( R"({"index":"test","id":1,"doc":{"a":null}})", false );
+	CheckJsonInsert ( R"({"index":"test","id":1,"id":2})", false );
+	CheckJsonInsert ( R"({"index":"test","id":18446744073709551615})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":9223372036854775807}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":-9223372036854775808}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":1e999}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"s":"a\u0000b"}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"s":"\udc00"}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"s":"\ud800x"}})", false );
+	CheckJsonInsert ( R"({"index":"test","id":1.5})", false );
+	CheckJsonInsert ( R"({"index":"test","id":-1})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"m":[1,2.5]}})", false );
+	CheckJsonInsert ( R"({"index":"","id":1})", false );
+	CheckJsonInsert ( R"({"index":"c1:test","id":1})", false );
+	CheckJsonInsert ( R"({"id":1})", false );
+
+	// malformed
+	CheckJsonInsert ( "", false );
+	CheckJsonInsert ( "[1,2]", false );
+	CheckJsonInsert ( R"({"index":"test","id":1,"doc":{"a":1})", false );
+	CheckJsonInsert ( R"({"index":"test",})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":"unterminated}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":[1,2}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":tru}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":1.}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":-}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"a":012}})", false );
+	CheckJsonInsert ( R"({"index":"test","doc":{"s":"\q"}})", false );
+}
+
+static void CheckJsonStatement ( const char * szJson, bool bFast )
+{
+	SqlStmt_t tStmt;
+	DocID_t tDocId = 0;
+	CSphString sStmt, sQuery;
+	ASSERT_EQ ( ReadJsonStatement ( szJson, tStmt, sStmt, sQuery, tDocId ), bFast ) << szJson;
+	if ( !bFast )
+		return;
+
+	JsonObj_c tRoot ( szJson );
+	JsonObj_c tJsonStmt = tRoot[0];
+	CSphString sRefStmt = tJsonStmt.Name();
+	bool bReplace = sRefStmt=="index" || sRefStmt=="replace";
+
+	SqlStmt_t tRef;
+	DocID_t tRefId = 0;
+	CSphString sRefError;
+	ASSERT_TRUE ( ParseJsonInsert ( tJsonStmt, tRef, tRefId, bReplace, false, sRefError ) ) << szJson;
+
+	ASSERT_STREQ ( sStmt.scstr(), sRefStmt.scstr() ) << szJson;
+	ASSERT_STREQ ( sQuery.scstr(), tJsonStmt.AsString().scstr() ) << szJson;
+	ASSERT_EQ ( tDocId, tRefId ) << szJson;
+	CompareInsertStmts ( tStmt, tRef, szJson );
+}
+
+TEST ( JsonInsert, bulk_reader_same_as_cjson )
+{
+	CheckJsonStatement ( R"({"insert":{"index":"test","id":1,"doc":{"title":"aé\"","j":{"x":[1,2.5,-3e-7]},"m":[3,2,1]}}})", true );
+	CheckJsonStatement ( R"({ "replace" : { "index" : "test", "doc" : { "n" : 1 } }, "extra" : [ 1, { "a" : null } ] })", true );
+	CheckJsonStatement ( R"({"index":{"index":"test","id":7}})", true );
+	CheckJsonStatement ( R"({"create":{"index":"test","id":8,"doc":{"s":"😀"}}})", true );
+
+	CheckJsonStatement ( R"({"update":{"index":"test","id":1,"doc":{"n":2}}})", false );
+	CheckJsonStatement ( R"({"delete":{"index":"test","id":1}})", false );
+	CheckJsonStatement ( R"({"insert":{"index":"test","doc":{"n":null}}})", false );
+	CheckJsonStatement ( R"({"insert":{"index":"test"},})", false );
+}
+
 TEST_F ( TJson, accessor )
 {
 
@@ -1297,3 +1621,165 @@ TEST_F ( TBson, bson_mixed_vec )
 	}
 	Check ( R"({"mixed_vec":[{},["one","two"],["one",10],1000000000000,1.123400,true,false,null]})" );
 }
+
+//////////////////////////////////////////////////////////////////////////
+
+TEST ( JsonColumns, option )
+{
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "j", SPH_ATTR_JSON ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "n", SPH_ATTR_INTEGER ), false );
+
+	CSphString sError;
+	ASSERT_TRUE ( AddJsonColumns ( " J.price : FLOAT, j.a.uid:bigint,j.Tag:string, j.tags:Multi ", tSchema, sError ) ) << sError.cstr();
+	ASSERT_STREQ ( FormatJsonColumns ( tSchema ).cstr(), "j.price:float, j.a.uid:bigint, j.Tag:string, j.tags:multi" );
+	ASSERT_TRUE ( sphIsInternalAttr ( sphGetJsonMaskName() ) );
+	ASSERT_TRUE ( HasJsonColumns ( tSchema, "j" ) );
+	ASSERT_FALSE ( HasJsonColumns ( tSchema, "n" ) );
+
+	int iColumn = -1;
+	ASSERT_GE ( GetJsonColumn ( tSchema, "j.Tag", iColumn ), 0 );
+	ASSERT_EQ ( iColumn, 2 );
+	ASSERT_LT ( GetJsonColumn ( tSchema, "j.tag", iColumn ), 0 );
+
+	CSphSchema tBad = tSchema;
+	ASSERT_FALSE ( AddJsonColumns ( "n.x:bigint", tBad, sError ) );
+	ASSERT_FALSE ( AddJsonColumns ( "j.price:float", tBad, sError ) );
+	ASSERT_FALSE ( AddJsonColumns ( "j.x:double", tBad, sError ) );
+	ASSERT_FALSE ( AddJsonColumns ( "j.x[1]:bigint", tBad, sError ) );
+}
+
+
+TEST ( JsonColumns, builder )
+{
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "j", SPH_ATTR_JSON ), false );
+
+	CSphString sError;
+	ASSERT_TRUE ( AddJsonColumns ( "j.i:bigint, j.f:float, j.s:string, j.o.i:bigint", tSchema, sError ) ) << sError.cstr();
+
+	auto fnFill = [&tSchema] ( const char * szJson, uint64_t & uMask, CSphVector<SphAttr_t> & dValues, CSphString & sStr )
+	{
+		CSphVector<BYTE> dBson;
+		CSphString sJson = szJson;
+		CSphString sParseError;
+		ASSERT_TRUE ( sphJsonParse ( dBson, (char *)sJson.cstr(), false, false, true, sParseError ) );
+
+		CSphVector<BYTE> dPacked;
+		dPacked.Resize ( sphCalcPackedLength ( dBson.GetLength() ) );
+		sphPackPtrAttr ( dPacked.Begin(), dBson );
+
+		InsertDocData_t tDoc ( tSchema );
+		tDoc.m_dStrings.Add ( (const char *)dPacked.Begin() );
+		tDoc.m_dStrings.Add ( nullptr );
+
+		StrVec_t dStorage;
+		JsonColumnsBuilder_c tBuilder ( tSchema );
+		ASSERT_FALSE ( tBuilder.IsEmpty() );
+		tBuilder.Fill ( tDoc, dStorage );
+
+		CSphAttrLocator tLoc = tSchema.GetAttr ( sphGetJsonMaskName() )->m_tLocator;
+		tLoc.m_bDynamic = true;
+		uMask = tDoc.m_tDoc.GetAttr ( tLoc );
+
+		dValues.Resize(0);
+		for ( const char * szName : { "$_json:j.i", "$_json:j.f", "$_json:j.o.i" } )
+		{
+			tLoc = tSchema.GetAttr ( szName )->m_tLocator;
+			tLoc.m_bDynamic = true;
+			dValues.Add ( tDoc.m_tDoc.GetAttr ( tLoc ) );
+		}
+
+		sStr = tDoc.m_dStrings[1];
+	};
+
+	uint64_t uMask = 0;
+	CSphVector<SphAttr_t> dValues;
+	CSphString sStr;
+
+	fnFill ( R"({"i":-5,"f":1.5,"s":"abc","o":{"i":10000000000}})", uMask, dValues, sStr );
+	ASSERT_EQ ( uMask, 0xFFULL );
+	ASSERT_EQ ( dValues[0], -5 );
+	ASSERT_EQ ( sphDW2F ( (DWORD)dValues[1] ), 1.5f );
+	ASSERT_EQ ( dValues[2], 10000000000LL );
+	ASSERT_STREQ ( sStr.cstr(), "abc" );
+
+	// present but inexact values fall back to json filtering
+	fnFill ( R"({"i":1.5,"f":"2","s":3,"o":[1]})", uMask, dValues, sStr );
+	ASSERT_EQ ( uMask, 0x15ULL );
+	ASSERT_EQ ( dValues[0], LLONG_MIN );
+	ASSERT_EQ ( sphDW2F ( (DWORD)dValues[1] ), -FLT_MAX );
+	ASSERT_EQ ( dValues[2], LLONG_MIN );
+	ASSERT_STREQ ( sStr.cstr(), "\x01" );
+
+	// missing keys
+	fnFill ( R"({"x":1})", uMask, dValues, sStr );
+	ASSERT_EQ ( uMask, 0ULL );
+}
+
+
+TEST ( JsonColumns, multi )
+{
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "j", SPH_ATTR_JSON ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "m", SPH_ATTR_INT64SET ), false );
+
+	CSphString sError;
+	ASSERT_TRUE ( AddJsonColumns ( "j.t:multi", tSchema, sError ) ) << sError.cstr();
+
+	auto fnFill = [&tSchema] ( const char * szJson, uint64_t & uMask, CSphVector<int64_t> & dMvas )
+	{
+		CSphVector<BYTE> dBson;
+		CSphString sJson = szJson;
+		CSphString sParseError;
+		ASSERT_TRUE ( sphJsonParse ( dBson, (char *)sJson.cstr(), false, false, true, sParseError ) );
+
+		CSphVector<BYTE> dPacked;
+		dPacked.Resize ( sphCalcPackedLength ( dBson.GetLength() ) );
+		sphPackPtrAttr ( dPacked.Begin(), dBson );
+
+		InsertDocData_t tDoc ( tSchema );
+		tDoc.m_dStrings.Add ( (const char *)dPacked.Begin() );
+		for ( int64_t iMva : { 2, 7, 8, 0 } )
+			tDoc.m_dMvas.Add ( iMva );
+
+		StrVec_t dStorage;
+		JsonColumnsBuilder_c tBuilder ( tSchema );
+		tBuilder.Fill ( tDoc, dStorage );
+
+		CSphAttrLocator tLoc = tSchema.GetAttr ( sphGetJsonMaskName() )->m_tLocator;
+		tLoc.m_bDynamic = true;
+		uMask = tDoc.m_tDoc.GetAttr ( tLoc );
+		dMvas = tDoc.m_dMvas;
+	};
+
+	uint64_t uMask = 0;
+	CSphVector<int64_t> dMvas;
+
+	// arrays of integers become sorted sets, regular MVAs stay intact
+	fnFill ( R"({"t":[3,1,2,2]})", uMask, dMvas );
+	ASSERT_EQ ( uMask, 3ULL );
+	const int64_t dExpected[] = { 2, 7, 8, 3, 1, 2, 3 };
+	ASSERT_EQ ( dMvas.GetLength(), 7 );
+	for ( int i = 0; i < 7; i++ )
+		ASSERT_EQ ( dMvas[i], dExpected[i] );
+
+	fnFill ( R"({"t":[1,10000000000,"x"]})", uMask, dMvas );
+	ASSERT_EQ ( uMask, 1ULL );
+	ASSERT_EQ ( dMvas.GetLength(), 5 );
+	ASSERT_EQ ( dMvas[3], 1 );
+	ASSERT_EQ ( dMvas[4], LLONG_MIN );
+
+	fnFill ( R"({"t":5})", uMask, dMvas );
+	ASSERT_EQ ( uMask, 3ULL );
+	ASSERT_EQ ( dMvas.GetLength(), 5 );
+	ASSERT_EQ ( dMvas[4], 5 );
+
+	fnFill ( R"({"x":5})", uMask, dMvas );
+	ASSERT_EQ ( uMask, 0ULL );
+	ASSERT_EQ ( dMvas.GetLength(), 4 );
+	ASSERT_EQ ( dMvas[3], 0 );
+}
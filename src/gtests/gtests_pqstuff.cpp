@@ -12,6 +12,7 @@
 
 #include "sphinxint.h"
 #include "sphinxpq.h"
+#include "binlog.h"
 
 
 class PQ_merge : public ::testing::Test
@@ -343,3 +344,286 @@ TEST_F ( PQ_merge, FullResultWithEverything )
 	for ( auto qid : { 100, 101, 102, 103, 180, 190 } )
 		ASSERT_EQ ( dResult.m_dQueryDesc[j++].m_iQUID, qid );
 }
+
+//////////////////////////////////////////////////////////////////////////
+// term index must never lose a query that may match the batch
+class PQ_term_index : public ::testing::Test
+{
+protected:
+	StoredQuery_t & AddQuery ( std::initializer_list<uint64_t> dTerms, bool bOnlyTerms=true )
+	{
+		auto * pQuery = new StoredQuery_t;
+		pQuery->m_iQUID = m_dQueries.GetLength()+1;
+		pQuery->m_pXQ = std::make_unique<XQQuery_t>();
+		pQuery->m_bOnlyTerms = bOnlyTerms;
+		pQuery->m_dRejectTerms.CopyFrom ( VecTraits_T<uint64_t> ( (uint64_t *)dTerms.begin(), (int64_t)dTerms.size() ) );
+		pQuery->m_dRejectTerms.Sort();
+		m_dQueries.Add ( std::unique_ptr<StoredQuery_i> ( pQuery ) );
+		return *pQuery;
+	}
+
+	void SetBatch ( const VecTraits_T<CSphVector<uint64_t>> & dDocs )
+	{
+		m_tReject.m_iRows = dDocs.GetLength();
+		m_tReject.m_dPerDocTerms.Reset ( dDocs.GetLength() );
+		m_tReject.m_dTerms.Resize ( 0 );
+		ARRAY_FOREACH ( i, dDocs )
+		{
+			m_tReject.m_dPerDocTerms[i] = dDocs[i];
+			m_tReject.m_dPerDocTerms[i].Uniq();
+			m_tReject.m_dTerms.Append ( dDocs[i] );
+		}
+		m_tReject.m_dTerms.Uniq();
+	}
+
+	// every query that passes the early reject must be a candidate
+	void CheckSuperset ( const PercolateTermIndex_c & tIndex ) const
+	{
+		CSphVector<int64_t> dCandidates;
+		tIndex.GetCandidates ( m_tReject.m_dTerms, dCandidates );
+		dCandidates.Uniq();
+
+		for ( const auto & pQuery : m_dQueries )
+		{
+			const auto * pStored = (const StoredQuery_t *)pQuery.get();
+			if ( m_tReject.Filter ( pStored, false ) )
+				continue;
+
+			ASSERT_TRUE ( dCandidates.BinarySearch ( pStored->m_iQUID ) ) << "query " << pStored->m_iQUID << " lost";
+		}
+	}
+
+	CSphVector<std::unique_ptr<StoredQuery_i>> m_dQueries;
+	SegmentReject_t m_tReject;
+};
+
+
+TEST_F ( PQ_term_index, anchors )
+{
+	AddQuery ( { 1 } );
+	AddQuery ( { 1, 2 } );
+	AddQuery ( { 2, 3 } );
+	AddQuery ( { 4, 5 } );
+	AddQuery ( { 3, 5 }, false );	// complex
+	AddQuery ( {} ).m_pXQ->m_bEmpty = true;	// fullscan
+	AddQuery ( { 7 } ).m_dRejectWilds.Reset ( 1 );	// wildcard
+
+	PercolateTermIndex_c tIndex;
+	for ( const auto & pQuery : m_dQueries )
+		tIndex.Add ( (const StoredQuery_t *)pQuery.get() );
+
+	CSphVector<CSphVector<uint64_t>> dDocs ( 2 );
+	dDocs[0].Add ( 2 );
+	dDocs[0].Add ( 3 );
+	dDocs[1].Add ( 5 );
+	SetBatch ( dDocs );
+	CheckSuperset ( tIndex );
+
+	CSphVector<int64_t> dCandidates;
+	tIndex.GetCandidates ( m_tReject.m_dTerms, dCandidates );
+	dCandidates.Uniq();
+
+	// queries anchored by 1 and 4 are skipped, as the batch has neither of these terms
+	ASSERT_FALSE ( dCandidates.BinarySearch ( 1 ) );
+	ASSERT_TRUE ( dCandidates.BinarySearch ( 3 ) );
+	ASSERT_FALSE ( dCandidates.BinarySearch ( 4 ) );
+	ASSERT_TRUE ( dCandidates.BinarySearch ( 5 ) );
+	ASSERT_TRUE ( dCandidates.BinarySearch ( 6 ) );
+	ASSERT_TRUE ( dCandidates.BinarySearch ( 7 ) );
+}
+
+
+TEST_F ( PQ_term_index, random_batches )
+{
+	sphSrand ( 42 );
+	auto fnTerm = [] { return (uint64_t)( sphRand() % 64 ) * 0x9E3779B97F4A7C15ULL + 1; }; // 64 terms vocabulary
+
+	PercolateTermIndex_c tIndex;
+	for ( int i=0; i<2000; ++i )
+	{
+		auto & tQuery = AddQuery ( {}, sphRand()%8!=0 );
+		CSphVector<uint64_t> dTerms;
+		for ( int j=1+sphRand()%4; j>0; --j )
+			dTerms.Add ( fnTerm() );
+		dTerms.Uniq();
+		tQuery.m_dRejectTerms.CopyFrom ( dTerms );
+		tIndex.Add ( &tQuery );
+	}
+
+	for ( int iBatch=0; iBatch<200; ++iBatch )
+	{
+		CSphVector<CSphVector<uint64_t>> dDocs ( 1+sphRand()%8 );
+		for ( auto & dDoc : dDocs )
+			for ( int j=1+sphRand()%6; j>0; --j )
+				dDoc.Add ( fnTerm() );
+
+		SetBatch ( dDocs );
+		CheckSuperset ( tIndex );
+
+		// and that early reject is itself correct: only-terms query that has all its terms in one of the docs is not rejected
+		for ( const auto & pQuery : m_dQueries )
+		{
+			const auto * pStored = (const StoredQuery_t *)pQuery.get();
+			bool bMatch = !pStored->m_bOnlyTerms;
+			for ( const auto & dDoc : m_tReject.m_dPerDocTerms )
+				bMatch |= pStored->m_dRejectTerms.all_of ( [&dDoc] ( uint64_t uTerm ) { return dDoc.Contains ( uTerm ); } );
+
+			if ( bMatch )
+			{
+				ASSERT_FALSE ( m_tReject.Filter ( pStored, false ) );
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// term-only queries matched as bitmaps must give the same docs as the regular full-text matching
+#define PQ_INDEX_FILE_NAME "test_temp_pq"
+
+class PQ_term_tree : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		DeleteIndexFiles();
+		CSphConfigSection tRTConfig;
+		sphRTInit ( tRTConfig, true, nullptr );
+		Binlog::Configure ( tRTConfig, true, 0, false );
+	}
+
+	void TearDown() override
+	{
+		Binlog::Deinit();
+		DeleteIndexFiles();
+	}
+
+	static void DeleteIndexFiles()
+	{
+		CSphString sName;
+		for ( const char * szExt : { "lock", "meta", "settings" } )
+		{
+			sName.SetSprintf ( "%s.%s", PQ_INDEX_FILE_NAME, szExt );
+			unlink ( sName.cstr() );
+		}
+	}
+
+	static CSphString RandomExpr ( int iDepth )
+	{
+		CSphString sRes;
+		int iOp = iDepth>2 ? 0 : sphRand()%4;
+		switch ( iOp )
+		{
+		case 1:		sRes.SetSprintf ( "(%s %s)", RandomExpr ( iDepth+1 ).cstr(), RandomExpr ( iDepth+1 ).cstr() ); break;
+		case 2:		sRes.SetSprintf ( "(%s | %s)", RandomExpr ( iDepth+1 ).cstr(), RandomExpr ( iDepth+1 ).cstr() ); break;
+		case 3:		sRes.SetSprintf ( "(%s -%s)", RandomExpr ( iDepth+1 ).cstr(), RandomExpr ( iDepth+1 ).cstr() ); break;
+		default:	sRes.SetSprintf ( "w%d", sphRand()%12 ); break;
+		}
+		return sRes;
+	}
+};
+
+
+TEST_F ( PQ_term_tree, same_as_fulltext )
+{
+	Threads::CallCoroutine ( [&] {
+
+	CSphString sError;
+	CSphDictSettings tDictSettings;
+	tDictSettings.m_bWordDict = false;
+	TokenizerRefPtr_c pTok = Tokenizer::Detail::CreateUTF8Tokenizer();
+	DictRefPtr_c pDict = sphCreateDictionaryCRC ( tDictSettings, nullptr, pTok, "pq", false, 32, nullptr, sError );
+
+	// all the text goes to 'title', so limiting queries to it changes nothing but the matching path
+	CSphSchema tSchema;
+	tSchema.AddField ( "title" );
+	tSchema.AddField ( "body" );
+	CSphColumnInfo tId ( sphGetDocidName(), SPH_ATTR_BIGINT );
+	tSchema.AddAttr ( tId, false );
+
+	auto pIndex = CreateIndexPercolate ( "testpq", PQ_INDEX_FILE_NAME, tSchema );
+	pIndex->SetTokenizer ( pTok );
+	pIndex->SetDictionary ( pDict );
+	pIndex->PostSetup();
+	StrVec_t dWarnings;
+	ASSERT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+
+	sphSrand ( 1 );
+	RtAccum_t tAcc;
+	CSphVector<CSphFilterSettings> dFilters;
+	CSphVector<FilterTreeItem_t> dFilterTree;
+	int iTermTrees = 0;
+	const int QUERY_PAIRS = 300;
+	for ( int i=0; i<QUERY_PAIRS; ++i )
+	{
+		CSphString sQuery = RandomExpr ( 0 );
+		CSphString sLimited;
+		sLimited.SetSprintf ( "@title %s", sQuery.cstr() );
+
+		for ( int iPass=0; iPass<2; ++iPass )
+		{
+			PercolateQueryArgs_t tArgs ( dFilters, dFilterTree );
+			tArgs.m_sQuery = iPass ? sLimited.cstr() : sQuery.cstr();
+			tArgs.m_iQUID = i*2+iPass+1;
+			auto pStored = pIndex->CreateQuery ( tArgs, sError );
+			ASSERT_TRUE ( pStored ) << sQuery.cstr() << ": " << sError.cstr();
+
+			bool bTermTree = !( (const StoredQuery_t *)pStored.get() )->m_dTermTree.IsEmpty();
+			if ( iPass )
+			{
+				ASSERT_FALSE ( bTermTree ) << sLimited.cstr();
+			} else
+				iTermTrees += bTermTree ? 1 : 0;
+
+			tAcc.AddCommand ( ReplicationCommand_e::PQUERY_ADD, "testpq" )->m_pStored = std::move ( pStored );
+		}
+	}
+	ASSERT_TRUE ( pIndex->Commit ( nullptr, &tAcc ) );
+	ASSERT_GT ( iTermTrees, 0 );
+
+	for ( int iBatch=0; iBatch<20; ++iBatch )
+	{
+		InsertDocData_t tDoc ( pIndex->GetMatchSchema() );
+		CSphString sError, sWarning, sFilter;
+		int iDocs = 1+sphRand()%100; // both less and more than a bitmap word
+		CSphVector<CSphString> dTexts ( iDocs );
+		for ( int iDoc=0; iDoc<iDocs; ++iDoc )
+		{
+			StringBuilder_c sText ( " " );
+			for ( int j=sphRand()%6; j>=0; --j )
+				sText.Sprintf ( "w%d", sphRand()%12 );
+			dTexts[iDoc] = sText.cstr();
+
+			tDoc.m_dFields[0] = VecTraits_T<const char> ( dTexts[iDoc].cstr(), dTexts[iDoc].Length() );
+			tDoc.m_dFields[1] = VecTraits_T<const char>();
+			tDoc.m_tDoc.m_tRowID = iDoc;
+			tDoc.SetID ( iDoc+1 );
+			ASSERT_TRUE ( pIndex->AddDocument ( tDoc, true, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+		}
+
+		PercolateMatchResult_t tRes;
+		tRes.m_bGetDocs = true;
+		ASSERT_TRUE ( pIndex->MatchDocuments ( &tAcc, tRes ) );
+		ASSERT_EQ ( tRes.m_iQueriesFailed, 0 );
+
+		// QUID -> matched docs
+		CSphVector<CSphVector<int>> dMatched ( QUERY_PAIRS*2+1 );
+		const int * pDocs = tRes.m_dDocs.Begin();
+		for ( const auto & tDesc : tRes.m_dQueryDesc )
+		{
+			int iCount = *pDocs++;
+			dMatched[tDesc.m_iQUID].Append ( pDocs, iCount );
+			dMatched[tDesc.m_iQUID].Sort();
+			pDocs += iCount;
+		}
+
+		for ( int i=0; i<QUERY_PAIRS; ++i )
+		{
+			const auto & dBitmap = dMatched[i*2+1];
+			const auto & dFulltext = dMatched[i*2+2];
+			ASSERT_EQ ( dBitmap.GetLength(), dFulltext.GetLength() ) << "batch " << iBatch << ", query " << i*2+1;
+			ARRAY_FOREACH ( j, dBitmap )
+				ASSERT_EQ ( dBitmap[j], dFulltext[j] ) << "batch " << iBatch << ", query " << i*2+1;
+		}
+	}
+	});
+}
@@ -19,8 +19,12 @@
 #include "searchdaemon.h"
 #include "binlog.h"
 #include "accumulator.h"
+#include "killlist.h"
+#include "sphinxsearch.h"
+#include "sphinxqcache.h"
 
 #include <gmock/gmock.h>
+#include <filesystem>
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -654,3 +658,1057 @@ TEST_F ( RT, SendVsMerge )
 	pTok = nullptr; // owned and deleted by index
 	});
 }
+
+// filters over json paths must give the same results with and without json_columns copies
+TEST_F ( RT, JsonColumnsFilters )
+{
+	Threads::CallCoroutine ( [&] {
+	DictRefPtr_c pDict { sphCreateDictionaryCRC ( tDictSettings, nullptr, pTok, "json", false, 32, nullptr, sError ) };
+
+	const char * dDocs[] = {
+		R"({"i":5,"f":1.5,"s":"abc"})",
+		R"({"i":10,"f":2.5,"s":"xyz"})",
+		R"({"i":5.0,"f":"1.5","s":5})",		// inexact copies
+		R"({"x":1})",						// missing keys
+		R"({"i":null,"f":null,"s":null})",
+		R"({"i":7,"f":3,"s":"abc"})",
+		R"({"i":[5],"f":1.5,"s":["abc"]})",
+	};
+	const int iDocs = sizeof(dDocs)/sizeof(dDocs[0]);
+	const DocID_t tMissing = 4;
+
+	auto fnCreate = [&] ( const char * szName, bool bJsonColumns )
+	{
+		DeleteIndexFiles ( szName );
+
+		// same schema as searchd builds, with the blob locator
+		CSphConfigSection hIndex;
+		hIndex.AddEntry ( "rt_field", "title" );
+		hIndex.AddEntry ( "rt_attr_json", "j" );
+		if ( bJsonColumns )
+			hIndex.AddEntry ( "json_columns", "j.i:bigint, j.f:float, j.s:string" );
+
+		CSphSchema tSchema;
+		EXPECT_TRUE ( sphRTSchemaConfigure ( hIndex, tSchema, CSphIndexSettings(), nullptr, sError, false, false ) ) << sError.cstr();
+
+		auto pIndex = sphCreateIndexRT ( szName, szName, tSchema, 32 * 1024 * 1024, false );
+		pIndex->SetTokenizer ( pTok->Clone ( SPH_CLONE_INDEX ) );
+		pIndex->SetDictionary ( pDict->Clone () );
+		pIndex->PostSetup ();
+		StrVec_t dWarnings;
+		EXPECT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+
+		RtAccum_t tAcc;
+		CSphString sFilter;
+		for ( int i = 0; i < iDocs; i++ )
+		{
+			CSphVector<BYTE> dBson;
+			CSphString sJson = dDocs[i];
+			EXPECT_TRUE ( sphJsonParse ( dBson, (char *)sJson.cstr(), false, false, true, sError ) ) << sError.cstr();
+
+			CSphVector<BYTE> dPacked;
+			dPacked.Resize ( sphCalcPackedLength ( dBson.GetLength() ) );
+			sphPackPtrAttr ( dPacked.Begin(), dBson );
+
+			InsertDocData_t tDoc ( pIndex->GetMatchSchema() );
+			tDoc.SetID ( i+1 );
+			tDoc.m_dFields[0] = VecTraits_T<const char> ( "doc", 3 );
+			tDoc.m_dStrings.Add ( (const char *)dPacked.Begin() );
+			if ( bJsonColumns )
+				tDoc.m_dStrings.Add ( nullptr );
+
+			EXPECT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+		}
+		pIndex->Commit ( nullptr, &tAcc );
+		return pIndex;
+	};
+
+	auto fnQuery = [] ( RtIndex_i & tIndex, const CSphFilterSettings & tFilter )
+	{
+		CSphQuery tQuery;
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		auto pParser = sphCreatePlainQueryParser();
+		tQuery.m_pQueryParser = pParser.get();
+		tQuery.m_dFilters.Add ( tFilter );
+
+		SphQueueSettings_t tQueueSettings ( tIndex.GetMatchSchema () );
+		SphQueueRes_t tRes;
+		std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+		CSphVector<DocID_t> dIds;
+		EXPECT_TRUE ( pSorter );
+		if ( !pSorter )
+			return dIds;
+
+		ISphMatchSorter * pRawSorter = pSorter.get();
+		EXPECT_TRUE ( tIndex.MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+		auto & tOneRes = tResult.m_dResults.Add ();
+		tOneRes.FillFromSorter ( pRawSorter );
+
+		const CSphColumnInfo * pId = pSorter->GetSchema()->GetAttr ( sphGetDocidName() );
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+			dIds.Add ( tMatch.GetAttr ( pId->m_tLocator ) );
+
+		dIds.Sort();
+		return dIds;
+	};
+
+	auto pPlain = fnCreate ( RT_INDEX_FILE_NAME "_plain", false );
+	auto pColumns = fnCreate ( RT_INDEX_FILE_NAME "_columns", true );
+
+	CSphVector<CSphFilterSettings> dFilters;
+	auto fnAdd = [&dFilters] ( const char * szAttr, ESphFilter eType )
+	{
+		CSphFilterSettings & tFilter = dFilters.Add();
+		tFilter.m_sAttrName = szAttr;
+		tFilter.m_eType = eType;
+		return &tFilter;
+	};
+
+	fnAdd ( "j.i", SPH_FILTER_VALUES )->m_dValues.Add(5);
+	fnAdd ( "j.i", SPH_FILTER_VALUES )->m_dValues.Add(100);
+	auto * pRange = fnAdd ( "j.i", SPH_FILTER_RANGE );
+	pRange->m_iMinValue = 6;
+	pRange->m_iMaxValue = 20;
+	auto * pFloat = fnAdd ( "j.f", SPH_FILTER_FLOATRANGE );
+	pFloat->m_fMinValue = 1.0f;
+	pFloat->m_fMaxValue = 2.0f;
+	fnAdd ( "j.s", SPH_FILTER_STRING )->m_dStrings.Add ( "abc" );
+
+	// and the same filters inverted
+	for ( int i = 0, iFilters = dFilters.GetLength(); i < iFilters; i++ )
+	{
+		CSphFilterSettings tExclude = dFilters[i];
+		tExclude.m_bExclude = true;
+		dFilters.Add ( tExclude );
+	}
+
+	for ( const auto & tFilter : dFilters )
+	{
+		CSphVector<DocID_t> dExpected = fnQuery ( *pPlain, tFilter );
+		CSphVector<DocID_t> dIds = fnQuery ( *pColumns, tFilter );
+
+		ASSERT_EQ ( dIds.GetLength(), dExpected.GetLength() ) << tFilter.m_sAttrName.cstr() << ( tFilter.m_bExclude ? " exclude" : "" );
+		for ( int i = 0; i < dIds.GetLength(); i++ )
+			ASSERT_EQ ( dIds[i], dExpected[i] ) << tFilter.m_sAttrName.cstr() << ( tFilter.m_bExclude ? " exclude" : "" );
+
+		// documents without the key never match, excluded or not
+		ASSERT_FALSE ( dIds.Contains ( tMissing ) ) << tFilter.m_sAttrName.cstr() << ( tFilter.m_bExclude ? " exclude" : "" );
+	}
+
+	// exact copies are used both ways
+	ASSERT_TRUE ( fnQuery ( *pColumns, dFilters[0] ).Contains ( 1 ) );
+	ASSERT_FALSE ( fnQuery ( *pColumns, dFilters[0] ).Contains ( 2 ) );
+	ASSERT_TRUE ( fnQuery ( *pColumns, dFilters[5] ).Contains ( 2 ) );
+	ASSERT_FALSE ( fnQuery ( *pColumns, dFilters[5] ).Contains ( 1 ) );
+
+	pPlain.reset();
+	pColumns.reset();
+	DeleteIndexFiles ( RT_INDEX_FILE_NAME "_plain" );
+	DeleteIndexFiles ( RT_INDEX_FILE_NAME "_columns" );
+	});
+}
+
+// OPTION dynamic_pruning must not change the top-k, whatever bounds (block maxima, per-term ones) the terms have
+TEST_F ( RT, DynamicPruning )
+{
+	Threads::CallCoroutine ( [&] {
+	DictRefPtr_c pDict { sphCreateDictionaryCRC ( tDictSettings, nullptr, pTok, "pruning", false, 32, nullptr, sError ) };
+
+	CSphConfigSection hIndex;
+	hIndex.AddEntry ( "rt_field", "title" );
+	hIndex.AddEntry ( "rt_field", "content" );
+	CSphSchema tSchema;
+	ASSERT_TRUE ( sphRTSchemaConfigure ( hIndex, tSchema, CSphIndexSettings(), nullptr, sError, false, false ) ) << sError.cstr();
+
+	auto fnOpen = [&]
+	{
+		auto pIndex = sphCreateIndexRT ( "testrt", RT_INDEX_FILE_NAME, tSchema, 32 * 1024 * 1024, false );
+		pIndex->SetTokenizer ( pTok->Clone ( SPH_CLONE_INDEX ) );
+		pIndex->SetDictionary ( pDict->Clone () );
+		pIndex->PostSetup ();
+		StrVec_t dWarnings;
+		EXPECT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) ) << pIndex->GetLastError().cstr();
+		return pIndex;
+	};
+
+	// skewed word frequencies and hit counts, so that both the terms and the doclist blocks have different bounds
+	DWORD uSeed = 1;
+	auto fnRand = [&uSeed] ( DWORD uMax )
+	{
+		uSeed = uSeed*1103515245 + 12345;
+		return ( uSeed>>16 ) % uMax;
+	};
+
+	auto fnText = [&] ( int iWords )
+	{
+		StringBuilder_c sText ( " " );
+		for ( int i = 0; i < iWords; i++ )
+			sText.Sprintf ( "w%d", fnRand(100) * fnRand(100) / 100 );
+		return CSphString ( sText );
+	};
+
+	auto pIndex = fnOpen();
+	RtAccum_t tAcc;
+	CSphString sFilter;
+	const int iDocs = 3000;
+	for ( int i = 0; i < iDocs; i++ )
+	{
+		CSphString sTitle = fnText ( 1 + fnRand(4) );
+		CSphString sContent = fnText ( 5 + fnRand(40) );
+
+		InsertDocData_t tDoc ( pIndex->GetMatchSchema() );
+		tDoc.SetID ( i+1 );
+		tDoc.m_dFields[0] = VecTraits_T<const char> ( sTitle.cstr(), sTitle.Length() );
+		tDoc.m_dFields[1] = VecTraits_T<const char> ( sContent.cstr(), sContent.Length() );
+		ASSERT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+
+		// several ram segments
+		if ( ( i+1 ) % 700==0 )
+			pIndex->Commit ( nullptr, &tAcc );
+	}
+	pIndex->Commit ( nullptr, &tAcc );
+
+	using Match_t = std::pair<DocID_t, int>;
+	auto fnQuery = [] ( RtIndex_i & tIndex, const char * szQuery, bool bPruning, int64_t & iTotal )
+	{
+		CSphQuery tQuery;
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		auto pParser = sphCreatePlainQueryParser();
+		tQuery.m_pQueryParser = pParser.get();
+		tQuery.m_sQuery = szQuery;
+		tQuery.m_eRanker = SPH_RANK_BM25;
+		tQuery.m_iMaxMatches = 20;
+		tQuery.m_bDynamicPruning = bPruning;
+		tQuery.m_dFieldWeights.Add ( { "title", 3 } );
+
+		SphQueueSettings_t tQueueSettings ( tIndex.GetMatchSchema () );
+		tQueueSettings.m_iMaxMatches = tQuery.m_iMaxMatches;
+		SphQueueRes_t tRes;
+		std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+		CSphVector<Match_t> dMatches;
+		EXPECT_TRUE ( pSorter );
+		if ( !pSorter )
+			return dMatches;
+
+		ISphMatchSorter * pRawSorter = pSorter.get();
+		EXPECT_TRUE ( tIndex.MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+		iTotal = pSorter->GetTotalCount();
+		auto & tOneRes = tResult.m_dResults.Add ();
+		tOneRes.FillFromSorter ( pRawSorter );
+
+		const CSphColumnInfo * pId = pSorter->GetSchema()->GetAttr ( sphGetDocidName() );
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+			dMatches.Add ( { tMatch.GetAttr ( pId->m_tLocator ), tMatch.m_iWeight } );
+
+		dMatches.Sort ( Lesser ( [] ( const Match_t & a, const Match_t & b ) { return a.second>b.second || ( a.second==b.second && a.first<b.first ); } ) );
+		return dMatches;
+	};
+
+	const char * dQueries[] = { "w0 | w1 | w5 | w30", "w2 | w3", "w7 | w40 | w60 | w90 | w95", "\"w0 w4 w9 w20\"/1", "@title w1 | w3" };
+
+	// returns how many queries skipped docs
+	auto fnCheck = [&] ( RtIndex_i & tIndex, const char * szStage )
+	{
+		int iPruned = 0;
+		for ( const char * szQuery : dQueries )
+		{
+			int64_t iExpectedTotal = 0, iTotal = 0;
+			CSphVector<Match_t> dExpected = fnQuery ( tIndex, szQuery, false, iExpectedTotal );
+			CSphVector<Match_t> dMatches = fnQuery ( tIndex, szQuery, true, iTotal );
+
+			EXPECT_EQ ( dExpected.GetLength(), 20 ) << szStage << ": " << szQuery;
+			EXPECT_EQ ( dMatches.GetLength(), dExpected.GetLength() ) << szStage << ": " << szQuery;
+			for ( int i = 0; i < Min ( dMatches.GetLength(), dExpected.GetLength() ); i++ )
+			{
+				EXPECT_EQ ( dMatches[i].first, dExpected[i].first ) << szStage << ": " << szQuery << ", match " << i;
+				EXPECT_EQ ( dMatches[i].second, dExpected[i].second ) << szStage << ": " << szQuery << ", match " << i;
+			}
+
+			// total_found is a lower bound
+			EXPECT_LE ( iTotal, iExpectedTotal ) << szStage << ": " << szQuery;
+			iPruned += iTotal<iExpectedTotal;
+		}
+
+		return iPruned;
+	};
+
+	// ram segments have no skiplists; only per-term bounds
+	fnCheck ( *pIndex, "ram segments" );
+
+	// disk chunk has per-block maxima
+	ASSERT_TRUE ( pIndex->ForceDiskChunk() );
+	EXPECT_GT ( fnCheck ( *pIndex, "disk chunk" ), 0 ) << "block maxima must let some docs be skipped";
+
+	// chunk from an older version: the same skiplists without maxima, marked with 1 instead of SKIPLIST_BLOCKMAX
+	pIndex.reset();
+	CSphString sSkiplist;
+	sSkiplist.SetSprintf ( "%s.0.spe", RT_INDEX_FILE_NAME );
+	FILE * pFile = fopen ( sSkiplist.cstr(), "r+b" );
+	ASSERT_TRUE ( pFile ) << sSkiplist.cstr();
+	ASSERT_EQ ( fgetc ( pFile ), SKIPLIST_BLOCKMAX );
+	fseek ( pFile, 0, SEEK_SET );
+	fputc ( 1, pFile );
+	fclose ( pFile );
+
+	pIndex = fnOpen();
+	fnCheck ( *pIndex, "old disk chunk" );
+
+	pIndex.reset();
+	DeleteIndexFiles ( RT_INDEX_FILE_NAME );
+	});
+}
+
+// merging several disk chunks in one pass must give the same table as merging them pairwise, one after another
+TEST_F ( RT, MergeManyChunks )
+{
+	Threads::CallCoroutine ( [&] {
+	DictRefPtr_c pDict { sphCreateDictionaryCRC ( tDictSettings, nullptr, pTok, "merge", false, 32, nullptr, sError ) };
+
+	CSphConfigSection hIndex;
+	hIndex.AddEntry ( "rt_field", "title" );
+	hIndex.AddEntry ( "rt_attr_uint", "gid" );
+	CSphSchema tSchema;
+	ASSERT_TRUE ( sphRTSchemaConfigure ( hIndex, tSchema, CSphIndexSettings(), nullptr, sError, false, false ) ) << sError.cstr();
+
+	auto fnDeleteFiles = [] ( const char * szName )
+	{
+		const char * dExts[] = { "spa", "spb", "spd", "spds", "spe", "sph", "sphi", "spi", "spidx", "spk", "spm", "spp", "spt" };
+		CSphString sFile;
+		for ( const char * szExt : { "kill", "lock", "meta", "ram" } )
+		{
+			sFile.SetSprintf ( "%s.%s", szName, szExt );
+			unlink ( sFile.cstr() );
+		}
+
+		for ( int iChunk = 0; iChunk < 16; iChunk++ )
+			for ( const char * szExt : dExts )
+			{
+				sFile.SetSprintf ( "%s.%d.%s", szName, iChunk, szExt );
+				unlink ( sFile.cstr() );
+			}
+	};
+
+	// docs [first,last] of every batch; later batches replace some docs of the earlier ones
+	struct Batch_t { int m_iFirst; int m_iLast; };
+	const Batch_t dBatches[] = { { 1, 300 }, { 201, 500 }, { 401, 700 }, { 601, 800 } };
+	const Batch_t dDeletes[] = { { 50, 60 }, { 450, 460 }, { 795, 800 } };
+	const int iBatches = sizeof(dBatches)/sizeof(dBatches[0]);
+	const int iMaxDocID = 800;
+
+	auto fnDocText = [] ( int iDoc, int iBatch )
+	{
+		DWORD uSeed = iDoc*31 + iBatch;
+		StringBuilder_c sText ( " " );
+		for ( int i = 0, iWords = 3 + iDoc % 11; i < iWords; i++ )
+		{
+			uSeed = uSeed*1103515245 + 12345;
+			sText.Sprintf ( "w%d", ( uSeed>>16 ) % 40 );
+		}
+		return CSphString ( sText );
+	};
+
+	// the last batch a doc was inserted by; -1 for deleted docs
+	CSphFixedVector<int> dLatest ( iMaxDocID+1 );
+	dLatest.Fill ( -1 );
+
+	auto fnCreate = [&] ( const char * szName )
+	{
+		fnDeleteFiles ( szName );
+		auto pIndex = sphCreateIndexRT ( szName, szName, tSchema, 32 * 1024 * 1024, false );
+		pIndex->SetTokenizer ( pTok->Clone ( SPH_CLONE_INDEX ) );
+		pIndex->SetDictionary ( pDict->Clone () );
+		pIndex->PostSetup ();
+		StrVec_t dWarnings;
+		EXPECT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) ) << pIndex->GetLastError().cstr();
+
+		const CSphColumnInfo * pGid = pIndex->GetMatchSchema().GetAttr ( "gid" );
+		EXPECT_TRUE ( pGid );
+
+		RtAccum_t tAcc;
+		CSphString sFilter;
+		for ( int iBatch = 0; iBatch < iBatches; iBatch++ )
+		{
+			for ( int iDoc = dBatches[iBatch].m_iFirst; iDoc <= dBatches[iBatch].m_iLast; iDoc++ )
+			{
+				CSphString sTitle = fnDocText ( iDoc, iBatch );
+				InsertDocData_t tDoc ( pIndex->GetMatchSchema() );
+				tDoc.SetID ( iDoc );
+				tDoc.m_tDoc.SetAttr ( pGid->m_tLocator, iBatch*1000 + iDoc );
+				tDoc.m_dFields[0] = VecTraits_T<const char> ( sTitle.cstr(), sTitle.Length() );
+				EXPECT_TRUE ( pIndex->AddDocument ( tDoc, true, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+				dLatest[iDoc] = iBatch;
+			}
+			pIndex->Commit ( nullptr, &tAcc );
+			EXPECT_TRUE ( pIndex->ForceDiskChunk() );
+		}
+
+		// kills in disk chunks
+		for ( const auto & tDelete : dDeletes )
+		{
+			CSphVector<DocID_t> dDocs;
+			for ( int iDoc = tDelete.m_iFirst; iDoc <= tDelete.m_iLast; iDoc++ )
+			{
+				dDocs.Add ( iDoc );
+				dLatest[iDoc] = -1;
+			}
+
+			EXPECT_TRUE ( pIndex->DeleteDocument ( dDocs, sError, &tAcc ) ) << sError.cstr();
+			pIndex->Commit ( nullptr, &tAcc );
+		}
+
+		CSphIndexStatus tStatus;
+		pIndex->GetStatus ( &tStatus );
+		EXPECT_EQ ( tStatus.m_iNumChunks, iBatches );
+		return pIndex;
+	};
+
+	struct Match_t
+	{
+		DocID_t		m_tDocID;
+		int			m_iWeight;
+		SphAttr_t	m_tGid;
+	};
+
+	auto fnQuery = [] ( RtIndex_i & tIndex, const char * szQuery )
+	{
+		CSphQuery tQuery;
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		auto pParser = sphCreatePlainQueryParser();
+		tQuery.m_pQueryParser = pParser.get();
+		tQuery.m_sQuery = szQuery;
+		tQuery.m_iMaxMatches = 1000;
+		tQuery.m_iLimit = 1000;
+
+		SphQueueSettings_t tQueueSettings ( tIndex.GetMatchSchema () );
+		tQueueSettings.m_iMaxMatches = tQuery.m_iMaxMatches;
+		SphQueueRes_t tRes;
+		std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+		CSphVector<Match_t> dMatches;
+		EXPECT_TRUE ( pSorter );
+		if ( !pSorter )
+			return dMatches;
+
+		ISphMatchSorter * pRawSorter = pSorter.get();
+		EXPECT_TRUE ( tIndex.MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+		auto & tOneRes = tResult.m_dResults.Add ();
+		tOneRes.FillFromSorter ( pRawSorter );
+
+		const ISphSchema & tResSchema = *pSorter->GetSchema();
+		const CSphAttrLocator & tIdLoc = tResSchema.GetAttr ( sphGetDocidName() )->m_tLocator;
+		const CSphAttrLocator & tGidLoc = tResSchema.GetAttr ( "gid" )->m_tLocator;
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+			dMatches.Add ( { tMatch.GetAttr ( tIdLoc ), tMatch.m_iWeight, tMatch.GetAttr ( tGidLoc ) } );
+
+		dMatches.Sort ( Lesser ( [] ( const Match_t & a, const Match_t & b ) { return a.m_tDocID<b.m_tDocID; } ) );
+		return dMatches;
+	};
+
+	auto pManyWay = fnCreate ( RT_INDEX_FILE_NAME "_many" );
+	auto pPairwise = fnCreate ( RT_INDEX_FILE_NAME "_pairs" );
+
+	// one pass over all 4 chunks
+	OptimizeTask_t tOptimize;
+	tOptimize.m_eVerb = OptimizeTask_t::eAutoOptimize;
+	tOptimize.m_iCutoff = 1;
+	pManyWay->Optimize ( tOptimize );
+
+	// first two chunks at a time; the merged one takes the place of the second
+	for ( int i = 1; i < iBatches; i++ )
+	{
+		OptimizeTask_t tMerge;
+		tMerge.m_eVerb = OptimizeTask_t::eMerge;
+		tMerge.m_iFrom = 0;
+		tMerge.m_iTo = 1;
+		tMerge.m_bByOrder = true;
+		pPairwise->Optimize ( tMerge );
+	}
+
+	for ( auto * pIndex : { pManyWay.get(), pPairwise.get() } )
+	{
+		CSphIndexStatus tStatus;
+		pIndex->GetStatus ( &tStatus );
+		ASSERT_EQ ( tStatus.m_iNumChunks, 1 ) << pIndex->GetName();
+	}
+
+	// full scan: every alive doc once, in its latest version
+	CSphVector<Match_t> dAll = fnQuery ( *pManyWay, "" );
+	int iAlive = 0;
+	for ( int iDoc = 1; iDoc <= iMaxDocID; iDoc++ )
+		iAlive += dLatest[iDoc]>=0;
+
+	ASSERT_EQ ( dAll.GetLength(), iAlive );
+	for ( const auto & tMatch : dAll )
+	{
+		ASSERT_GE ( dLatest[tMatch.m_tDocID], 0 ) << "killed doc " << tMatch.m_tDocID;
+		ASSERT_EQ ( tMatch.m_tGid, dLatest[tMatch.m_tDocID]*1000 + tMatch.m_tDocID ) << "stale doc " << tMatch.m_tDocID;
+	}
+
+	// doclists and hitlists: the same docs with the same weights for every word
+	for ( int iWord = 0; iWord < 40; iWord++ )
+	{
+		CSphString sQuery;
+		sQuery.SetSprintf ( "w%d", iWord );
+		CSphVector<Match_t> dExpected = fnQuery ( *pPairwise, sQuery.cstr() );
+		CSphVector<Match_t> dMatches = fnQuery ( *pManyWay, sQuery.cstr() );
+
+		ASSERT_EQ ( dMatches.GetLength(), dExpected.GetLength() ) << sQuery.cstr();
+		ARRAY_FOREACH ( i, dMatches )
+		{
+			ASSERT_EQ ( dMatches[i].m_tDocID, dExpected[i].m_tDocID ) << sQuery.cstr();
+			ASSERT_EQ ( dMatches[i].m_iWeight, dExpected[i].m_iWeight ) << sQuery.cstr() << ", doc " << dMatches[i].m_tDocID;
+			ASSERT_EQ ( dMatches[i].m_tGid, dExpected[i].m_tGid ) << sQuery.cstr() << ", doc " << dMatches[i].m_tDocID;
+		}
+	}
+
+	// phrases check hit positions too
+	for ( const char * szQuery : { "\"w1 w2\"", "\"w3 w3\"", "\"w5 w7 w11\"~3" } )
+	{
+		CSphVector<Match_t> dExpected = fnQuery ( *pPairwise, szQuery );
+		CSphVector<Match_t> dMatches = fnQuery ( *pManyWay, szQuery );
+		ASSERT_EQ ( dMatches.GetLength(), dExpected.GetLength() ) << szQuery;
+		ARRAY_FOREACH ( i, dMatches )
+		{
+			ASSERT_EQ ( dMatches[i].m_tDocID, dExpected[i].m_tDocID ) << szQuery;
+			ASSERT_EQ ( dMatches[i].m_iWeight, dExpected[i].m_iWeight ) << szQuery;
+		}
+	}
+
+	pManyWay.reset();
+	pPairwise.reset();
+	fnDeleteFiles ( RT_INDEX_FILE_NAME "_many" );
+	fnDeleteFiles ( RT_INDEX_FILE_NAME "_pairs" );
+	});
+}
+
+// cached results of RAM segments must not outlive attribute updates, nor the collection stats they were ranked with
+TEST_F ( RT, QcacheInvalidation )
+{
+	Threads::CallCoroutine ( [&] {
+	DictRefPtr_c pDict { sphCreateDictionaryCRC ( tDictSettings, nullptr, pTok, "qcache", false, 32, nullptr, sError ) };
+
+	CSphConfigSection hIndex;
+	hIndex.AddEntry ( "rt_field", "title" );
+	hIndex.AddEntry ( "rt_attr_uint", "gid" );
+	CSphSchema tSchema;
+	ASSERT_TRUE ( sphRTSchemaConfigure ( hIndex, tSchema, CSphIndexSettings(), nullptr, sError, false, false ) ) << sError.cstr();
+
+	auto pIndex = sphCreateIndexRT ( "testrt", RT_INDEX_FILE_NAME, tSchema, 32 * 1024 * 1024, false );
+	pIndex->SetTokenizer ( pTok->Clone ( SPH_CLONE_INDEX ) );
+	pIndex->SetDictionary ( pDict->Clone () );
+	pIndex->PostSetup ();
+	StrVec_t dWarnings;
+	ASSERT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) ) << pIndex->GetLastError().cstr();
+
+	// cache everything
+	QcacheStatus_t tWas = QcacheGetStatus();
+	QcacheSetup ( 16*1024*1024, 0, 60, 0 );
+	auto tRestore = AtScopeExit ( [&tWas] { QcacheSetup ( tWas.m_iMaxBytes, tWas.m_iThreshMs, tWas.m_iTtlS, tWas.m_iTableMaxBytes ); } );
+
+	const CSphColumnInfo * pGid = pIndex->GetMatchSchema().GetAttr ( "gid" );
+	ASSERT_TRUE ( pGid );
+
+	RtAccum_t tAcc;
+	CSphString sFilter;
+	auto fnInsert = [&] ( int iFirst, int iLast )
+	{
+		for ( int iDoc = iFirst; iDoc<=iLast; iDoc++ )
+		{
+			CSphString sTitle;
+			sTitle.SetSprintf ( "w%d world %s", iDoc % 7, ( iDoc % 5 && iDoc<=100 ) ? "" : "hello" ); // later docs make 'hello' more frequent
+			InsertDocData_t tDoc ( pIndex->GetMatchSchema() );
+			tDoc.SetID ( iDoc );
+			tDoc.m_tDoc.SetAttr ( pGid->m_tLocator, iDoc % 2 );
+			tDoc.m_dFields[0] = VecTraits_T<const char> ( sTitle.cstr(), sTitle.Length() );
+			EXPECT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+		}
+
+		// every batch is a RAM segment of its own
+		pIndex->Commit ( nullptr, &tAcc );
+	};
+
+	fnInsert ( 1, 50 );
+	fnInsert ( 51, 100 );
+
+	using Match_t = std::pair<DocID_t, int>;
+	auto fnQuery = [&pIndex] ( ESphRankMode eRanker, bool bFilter )
+	{
+		CSphQuery tQuery;
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		auto pParser = sphCreatePlainQueryParser();
+		tQuery.m_pQueryParser = pParser.get();
+		tQuery.m_sQuery = "hello | world";
+		tQuery.m_eRanker = eRanker;
+		tQuery.m_iMaxMatches = 1000;
+		tQuery.m_iLimit = 1000;
+		if ( bFilter )
+		{
+			auto & tFilter = tQuery.m_dFilters.Add();
+			tFilter.m_eType = SPH_FILTER_RANGE;
+			tFilter.m_sAttrName = "gid";
+			tFilter.m_iMinValue = 1;
+			tFilter.m_iMaxValue = 1;
+		}
+
+		SphQueueSettings_t tQueueSettings ( pIndex->GetMatchSchema () );
+		tQueueSettings.m_iMaxMatches = tQuery.m_iMaxMatches;
+		SphQueueRes_t tRes;
+		std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+		CSphVector<Match_t> dMatches;
+		EXPECT_TRUE ( pSorter );
+		if ( !pSorter )
+			return dMatches;
+
+		ISphMatchSorter * pRawSorter = pSorter.get();
+		EXPECT_TRUE ( pIndex->MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+		auto & tOneRes = tResult.m_dResults.Add ();
+		tOneRes.FillFromSorter ( pRawSorter );
+
+		const CSphAttrLocator & tIdLoc = pSorter->GetSchema()->GetAttr ( sphGetDocidName() )->m_tLocator;
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+			dMatches.Add ( { tMatch.GetAttr ( tIdLoc ), tMatch.m_iWeight } );
+
+		dMatches.Sort ( Lesser ( [] ( const Match_t & a, const Match_t & b ) { return a.first<b.first; } ) );
+		return dMatches;
+	};
+
+	auto fnHits = [] { return QcacheGetStatus().m_iHits; };
+	auto fnSame = [] ( const VecTraits_T<Match_t> & dA, const VecTraits_T<Match_t> & dB )
+	{
+		if ( dA.GetLength()!=dB.GetLength() )
+			return false;
+
+		ARRAY_FOREACH ( i, dA )
+			if ( dA[i]!=dB[i] )
+				return false;
+
+		return true;
+	};
+
+	// both segments are cached, and hit by the repeated query
+	auto dFiltered = fnQuery ( SPH_RANK_NONE, true );
+	ASSERT_EQ ( dFiltered.GetLength(), 50 );
+	int64_t iHits = fnHits();
+	ASSERT_TRUE ( fnSame ( fnQuery ( SPH_RANK_NONE, true ), dFiltered ) );
+	ASSERT_EQ ( fnHits(), iHits+2 );
+
+	// update: doc 2 now passes the filter that was applied when its segment was cached
+	AttrUpdateSharedPtr_t pUpdate { new CSphAttrUpdate };
+	pUpdate->m_dAttributes.Add ( { "gid", SPH_ATTR_INTEGER } );
+	pUpdate->m_dDocids.Add ( 2 );
+	pUpdate->m_dPool.Add ( 1 );
+	AttrUpdateInc_t tUpdate { pUpdate };
+	bool bCritical = false;
+	ASSERT_EQ ( pIndex->UpdateAttributes ( tUpdate, bCritical, sError, sWarning ), 1 ) << sError.cstr();
+
+	iHits = fnHits();
+	auto dUpdated = fnQuery ( SPH_RANK_NONE, true );
+	ASSERT_EQ ( dUpdated.GetLength(), 51 );
+	ASSERT_EQ ( dUpdated[0].first, 1 );
+	ASSERT_EQ ( dUpdated[1].first, 2 );
+	ASSERT_EQ ( fnHits(), iHits+1 ) << "only the segment that was not updated is served from the cache";
+
+	// inserts don't touch results that are not ranked with collection stats
+	auto dUnranked = fnQuery ( SPH_RANK_NONE, false );
+	auto dRanked = fnQuery ( SPH_RANK_BM25, false );
+	ASSERT_EQ ( dUnranked.GetLength(), 100 );
+	ASSERT_EQ ( dRanked.GetLength(), 100 );
+
+	fnInsert ( 101, 110 );
+
+	iHits = fnHits();
+	auto dUnrankedAfter = fnQuery ( SPH_RANK_NONE, false );
+	ASSERT_EQ ( fnHits(), iHits+2 );
+	ASSERT_EQ ( dUnrankedAfter.GetLength(), 110 );
+	ASSERT_TRUE ( fnSame ( dUnrankedAfter.Slice ( 0, 100 ), dUnranked ) );
+
+	// but bm25 weights change with the stats, and the old segments must not be served from the cache
+	iHits = fnHits();
+	auto dRankedAfter = fnQuery ( SPH_RANK_BM25, false );
+	ASSERT_EQ ( fnHits(), iHits );
+	ASSERT_EQ ( dRankedAfter.GetLength(), 110 );
+
+	QcacheSetup ( 0, 0, 60, 0 );
+	auto dRankedUncached = fnQuery ( SPH_RANK_BM25, false );
+	ASSERT_TRUE ( fnSame ( dRankedAfter, dRankedUncached ) );
+
+	bool bWeightsChanged = false;
+	for ( int i = 0; i<100; i++ )
+		bWeightsChanged |= dRanked[i].second!=dRankedUncached[i].second;
+	ASSERT_TRUE ( bWeightsChanged ) << "inserts must change bm25 weights of the old documents, or the test checks nothing";
+
+	pIndex.reset();
+	DeleteIndexFiles ( RT_INDEX_FILE_NAME );
+	});
+}
+
+// disk chunks and RAM segments of a table share its qcache_table_max_bytes, and don't evict other tables
+TEST_F ( RT, QcacheTableQuota )
+{
+	Threads::CallCoroutine ( [&] {
+	DictRefPtr_c pDict { sphCreateDictionaryCRC ( tDictSettings, nullptr, pTok, "qcache", false, 32, nullptr, sError ) };
+
+	CSphConfigSection hIndex;
+	hIndex.AddEntry ( "rt_field", "title" );
+	CSphSchema tSchema;
+	ASSERT_TRUE ( sphRTSchemaConfigure ( hIndex, tSchema, CSphIndexSettings(), nullptr, sError, false, false ) ) << sError.cstr();
+
+	auto fnOpen = [&] ( const char * szName )
+	{
+		auto pIndex = sphCreateIndexRT ( szName, szName, tSchema, 32 * 1024 * 1024, false );
+		pIndex->SetTokenizer ( pTok->Clone ( SPH_CLONE_INDEX ) );
+		pIndex->SetDictionary ( pDict->Clone () );
+		pIndex->PostSetup ();
+		StrVec_t dWarnings;
+		EXPECT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) ) << pIndex->GetLastError().cstr();
+		return pIndex;
+	};
+
+	RtAccum_t tAcc;
+	CSphString sFilter;
+	auto fnInsert = [&] ( RtIndex_i & tIndex, int iFirst, int iLast )
+	{
+		for ( int iDoc = iFirst; iDoc<=iLast; iDoc++ )
+		{
+			CSphString sTitle;
+			sTitle.SetSprintf ( "w%d w%d hello", iDoc % 7, iDoc % 11 );
+			InsertDocData_t tDoc ( tIndex.GetMatchSchema() );
+			tDoc.SetID ( iDoc );
+			tDoc.m_dFields[0] = VecTraits_T<const char> ( sTitle.cstr(), sTitle.Length() );
+			EXPECT_TRUE ( tIndex.AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+		}
+		tIndex.Commit ( nullptr, &tAcc );
+	};
+
+	// 3 disk chunks and a RAM segment
+	const char * szBusy = RT_INDEX_FILE_NAME "_busy";
+	auto pBusy = fnOpen ( szBusy );
+	for ( int i = 0; i<3; i++ )
+	{
+		fnInsert ( *pBusy, i*100+1, i*100+100 );
+		ASSERT_TRUE ( pBusy->ForceDiskChunk() );
+	}
+	fnInsert ( *pBusy, 301, 400 );
+
+	const char * szQuiet = RT_INDEX_FILE_NAME "_quiet";
+	auto pQuiet = fnOpen ( szQuiet );
+	fnInsert ( *pQuiet, 1, 100 );
+
+	auto fnQuery = [] ( RtIndex_i & tIndex, const char * szQuery )
+	{
+		CSphQuery tQuery;
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		auto pParser = sphCreatePlainQueryParser();
+		tQuery.m_pQueryParser = pParser.get();
+		tQuery.m_sQuery = szQuery;
+		tQuery.m_iMaxMatches = 1000;
+
+		SphQueueSettings_t tQueueSettings ( tIndex.GetMatchSchema () );
+		tQueueSettings.m_iMaxMatches = tQuery.m_iMaxMatches;
+		SphQueueRes_t tRes;
+		std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+		ASSERT_TRUE ( pSorter );
+		ISphMatchSorter * pRawSorter = pSorter.get();
+		EXPECT_TRUE ( tIndex.MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+	};
+
+	const char * dQueries[] = { "w0", "w1", "w2", "w3", "w4", "w5", "w6", "w7 | w8", "w9 | w10", "hello" };
+	auto fnBusyQueries = [&]
+	{
+		for ( const char * szQuery : dQueries )
+			fnQuery ( *pBusy, szQuery );
+	};
+
+	QcacheStatus_t tWas = QcacheGetStatus();
+	auto tRestore = AtScopeExit ( [&tWas] { QcacheSetup ( tWas.m_iMaxBytes, tWas.m_iThreshMs, tWas.m_iTtlS, tWas.m_iTableMaxBytes ); } );
+
+	// no per-table limit: see how much the busy table takes
+	QcacheSetup ( 0, 0, 60, 0 );
+	QcacheSetup ( 64*1024*1024, 0, 60, 0 );
+	fnBusyQueries();
+	QcacheStatus_t tUnlimited = QcacheGetStatus();
+	ASSERT_EQ ( tUnlimited.m_iCachedQueries, 4*(int)( sizeof(dQueries)/sizeof(dQueries[0]) ) ) << "every chunk and segment caches every query";
+
+	// half of that as the quota; every chunk alone stays below it, so only a per-table quota limits them
+	int64_t iQuota = tUnlimited.m_iUsedBytes/2;
+	QcacheSetup ( 0, 0, 60, 0 );
+	QcacheSetup ( 64*1024*1024, 0, 60, iQuota );
+
+	fnQuery ( *pQuiet, "hello" );
+	int64_t iQuietBytes = QcacheGetStatus().m_iUsedBytes;
+	ASSERT_GT ( iQuietBytes, 0 );
+
+	fnBusyQueries();
+	QcacheStatus_t tLimited = QcacheGetStatus();
+	ASSERT_GT ( tLimited.m_iUsedBytes, iQuietBytes );
+	ASSERT_LE ( tLimited.m_iUsedBytes-iQuietBytes, iQuota );
+
+	// the quiet table was not evicted by the busy one
+	int64_t iHits = QcacheGetStatus().m_iHits;
+	fnQuery ( *pQuiet, "hello" );
+	ASSERT_EQ ( QcacheGetStatus().m_iHits, iHits+1 );
+
+	pBusy.reset();
+	pQuiet.reset();
+	DeleteIndexFiles ( szBusy );
+	DeleteIndexFiles ( szQuiet );
+	CSphString sFile;
+	for ( int iChunk = 1; iChunk<3; iChunk++ )
+		for ( const char * szExt : { "spa", "spb", "spd", "spds", "spe", "sph", "sphi", "spi", "spidx", "spk", "spm", "spp", "spt" } )
+		{
+			sFile.SetSprintf ( "%s.%d.%s", szBusy, iChunk, szExt );
+			unlink ( sFile.cstr() );
+		}
+	});
+}
+
+// parallel binlog replay: ops of every table are applied in their order, and a failed op stops all the tables at its position
+static CSphVector<Binlog::ReplayJob_t> MakeReplayJobs ( std::initializer_list<std::initializer_list<int64_t>> dJobPositions )
+{
+	CSphVector<Binlog::ReplayJob_t> dJobs;
+	for ( const auto & dPositions : dJobPositions )
+	{
+		auto & tJob = dJobs.Add();
+		for ( auto iPos : dPositions )
+			tJob.m_dOps.Add ( { iPos, 0, Binlog::COMMIT } );
+	}
+	return dJobs;
+}
+
+TEST ( RT, BinlogReplayOrder )
+{
+	Threads::CallCoroutine ( [&] {
+	auto dJobs = MakeReplayJobs ( { { 10, 40, 70, 100 }, { 20, 50, 80 }, { 30, 60, 90, 110, 120 } } );
+
+	CSphMutex tLock;
+	CSphVector<CSphVector<int64_t>> dApplied ( dJobs.GetLength() );
+	CSphVector<int> dDone;
+	int64_t iStop = Binlog::ApplyReplayJobs ( dJobs, 4, [&] ( int iJob, int iOp )
+	{
+		ScopedMutex_t tGuard ( tLock );
+		dApplied[iJob].Add ( dJobs[iJob].m_dOps[iOp].m_iBlopPos );
+		return true;
+	},
+	[&] ( int iJob )
+	{
+		ScopedMutex_t tGuard ( tLock );
+		dDone.Add ( iJob );
+	});
+
+	ASSERT_EQ ( iStop, -1 );
+	ASSERT_EQ ( dDone.GetLength(), dJobs.GetLength() );
+	ARRAY_FOREACH ( iJob, dJobs )
+	{
+		ASSERT_EQ ( dJobs[iJob].m_iReplayed, dJobs[iJob].m_dOps.GetLength() );
+		ASSERT_EQ ( dApplied[iJob].GetLength(), dJobs[iJob].m_dOps.GetLength() );
+		ARRAY_FOREACH ( iOp, dApplied[iJob] )
+			ASSERT_EQ ( dApplied[iJob][iOp], dJobs[iJob].m_dOps[iOp].m_iBlopPos ) << "job " << iJob << ", op " << iOp;
+	}
+	});
+}
+
+TEST ( RT, BinlogReplayFailure )
+{
+	Threads::CallCoroutine ( [&] {
+	// one worker takes the jobs in turn, so the failure is known before the other tables start
+	auto dJobs = MakeReplayJobs ( { { 20, 50, 80 }, { 10, 40, 70, 100 }, { 30, 60 }, { 5 } } );
+	int64_t iStop = Binlog::ApplyReplayJobs ( dJobs, 1, [&] ( int iJob, int iOp ) { return dJobs[iJob].m_dOps[iOp].m_iBlopPos!=50; } );
+
+	ASSERT_EQ ( iStop, 50 );
+	ASSERT_EQ ( dJobs[0].m_iReplayed, 1 ) << "failed table stops at the broken op";
+	ASSERT_EQ ( dJobs[1].m_iReplayed, 2 ) << "other tables stop at the same position";
+	ASSERT_EQ ( dJobs[2].m_iReplayed, 1 );
+	ASSERT_EQ ( dJobs[3].m_iReplayed, 1 );
+
+	// the earliest failure wins, whatever the order they are found in
+	dJobs = MakeReplayJobs ( { { 20, 50, 80 }, { 10, 40, 70, 100 } } );
+	iStop = Binlog::ApplyReplayJobs ( dJobs, 1, [&] ( int iJob, int iOp ) { auto iPos = dJobs[iJob].m_dOps[iOp].m_iBlopPos; return iPos!=50 && iPos!=40; } );
+
+	ASSERT_EQ ( iStop, 40 );
+	ASSERT_EQ ( dJobs[0].m_iReplayed, 1 );
+	ASSERT_EQ ( dJobs[1].m_iReplayed, 1 );
+
+	// with several workers, a failure still stops its own table, and is reported
+	dJobs = MakeReplayJobs ( { { 20, 50, 80 }, { 10, 40, 70, 100 }, { 30, 60, 90 } } );
+	iStop = Binlog::ApplyReplayJobs ( dJobs, 4, [&] ( int iJob, int iOp ) { return dJobs[iJob].m_dOps[iOp].m_iBlopPos!=50; } );
+
+	ASSERT_EQ ( iStop, 50 );
+	ASSERT_EQ ( dJobs[0].m_iReplayed, 1 );
+	ASSERT_GE ( dJobs[1].m_iReplayed, 2 ) << "ops logged before the failure are applied";
+	ASSERT_GE ( dJobs[2].m_iReplayed, 1 );
+	});
+}
+
+// group commit (binlog_flush=1): committers that queue while a batch is being synced share the next write and fsync
+class BinlogGroupCommit : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		std::error_code tError;
+		m_tDir = std::filesystem::temp_directory_path ( tError ) / ( "binlog_group_commit." + std::to_string ( getpid() ) );
+		ASSERT_TRUE ( std::filesystem::create_directories ( m_tDir, tError ) ) << tError.message();
+
+		CSphConfigSection tConf;
+		tConf.Add ( CSphVariant ( m_tDir.string().c_str() ), "binlog_path" );
+		tConf.Add ( CSphVariant ( "1" ), "binlog_flush" );
+		sphRTInit ( tConf, true, nullptr );
+		Binlog::Configure ( tConf, true, 0, false );
+
+		SmallStringHash_T<CSphIndex *> hIndexes;
+		Binlog::Replay ( hIndexes );
+	}
+
+	void TearDown() override
+	{
+		Binlog::MockGroupSync ( nullptr );
+		Binlog::Deinit();
+
+		std::error_code tIgnore;
+		std::filesystem::remove_all ( m_tDir, tIgnore );
+	}
+
+	bool Commit ( CSphString & sError )
+	{
+		return Binlog::Commit ( Binlog::COMMIT, &m_iTID, { "group_commit", 1 }, false, sError, [] ( Writer_i & tWriter ) { tWriter.ZipOffset ( 0 ); } );
+	}
+
+	/// commits from iCommitters threads at once; fnSync sees the batches, the first one held until everybody has queued behind it
+	void RunCommitters ( int iCommitters, std::function<bool ( int iBatch, CSphString & sError )> fnSync )
+	{
+		m_dBatches.Reset();
+		m_dOk.Resize ( iCommitters );
+		m_dErrors.Reset ( iCommitters );
+
+		std::atomic<int> iStarted { 0 };
+		Binlog::MockGroupSync ( [&] ( int iTxns, CSphString & sError )
+		{
+			if ( m_dBatches.IsEmpty() )
+			{
+				while ( iStarted.load()<iCommitters )
+					sphSleepMsec ( 1 );
+				sphSleepMsec ( 100 );
+			}
+
+			m_dBatches.Add ( iTxns );
+			return fnSync ( m_dBatches.GetLength()-1, sError );
+		});
+
+		CSphFixedVector<SphThread_t> dThreads ( iCommitters );
+		ARRAY_FOREACH ( i, dThreads )
+			ASSERT_TRUE ( Threads::Create ( &dThreads[i], [this, &iStarted, i]
+			{
+				++iStarted;
+				m_dOk[i] = Commit ( m_dErrors[i] );
+			}));
+
+		for ( auto & tThread : dThreads )
+			ASSERT_TRUE ( Threads::Join ( &tThread ) );
+
+		Binlog::MockGroupSync ( nullptr );
+	}
+
+	std::filesystem::path			m_tDir;
+	int64_t							m_iTID = 0;
+	CSphVector<int>					m_dBatches;
+	CSphVector<bool>				m_dOk;
+	CSphFixedVector<CSphString>		m_dErrors { 0 };
+};
+
+TEST_F ( BinlogGroupCommit, SharedSync )
+{
+	const int iCommitters = 8;
+	RunCommitters ( iCommitters, [] ( int, CSphString & ) { return true; } );
+
+	ASSERT_LE ( m_dBatches.GetLength(), 2 ) << "committers queued behind a sync share the next one";
+	int iTotal = 0;
+	for ( int iTxns : m_dBatches )
+		iTotal += iTxns;
+	ASSERT_EQ ( iTotal, iCommitters );
+
+	ARRAY_FOREACH ( i, m_dOk )
+		ASSERT_TRUE ( m_dOk[i] ) << "committer " << i << ": " << m_dErrors[i].cstr();
+	ASSERT_EQ ( m_iTID, iCommitters );
+}
+
+TEST_F ( BinlogGroupCommit, FailedBatch )
+{
+	const int iCommitters = 8;
+	RunCommitters ( iCommitters, [] ( int iBatch, CSphString & sError )
+	{
+		if ( !iBatch )
+			return true;
+
+		sError = "mock sync failure";
+		return false;
+	});
+
+	ASSERT_GE ( m_dBatches.GetLength(), 2 );
+	ASSERT_GT ( m_dBatches[1], 1 ) << "the failed batch has several committers";
+
+	// everybody of the failed batch gets its error, and only them
+	int iFailed = 0;
+	ARRAY_FOREACH ( i, m_dOk )
+	{
+		if ( m_dOk[i] )
+			continue;
+
+		++iFailed;
+		ASSERT_STREQ ( m_dErrors[i].cstr(), "unable to write to binlog: mock sync failure" ) << "committer " << i;
+	}
+
+	ASSERT_EQ ( iFailed, iCommitters-m_dBatches[0] );
+
+	// the failure doesn't stick to the next batch
+	CSphString sError;
+	ASSERT_TRUE ( Commit ( sError ) ) << sError.cstr();
+}
+
+TEST ( RT, DeadRowMapContainers )
+{
+	const DWORD uRows = 200000; // 3 full 64K containers and a partial one
+	DeadRowMap_Ram_c tMap ( uRows );
+	ASSERT_FALSE ( tMap.HasDead() );
+	ASSERT_EQ ( tMap.NextAlive ( 10 ), 10u );
+
+	// sparse kills in the first container
+	ASSERT_TRUE ( tMap.Set ( 0 ) );
+	ASSERT_TRUE ( tMap.Set ( 1 ) );
+	ASSERT_TRUE ( tMap.Set ( 31 ) );
+	ASSERT_TRUE ( tMap.Set ( 32 ) );
+	ASSERT_FALSE ( tMap.Set ( 32 ) );
+
+	// second container is killed completely
+	for ( RowID_t i = 65536; i<131072; ++i )
+		tMap.Set ( i );
+
+	// the tail
+	tMap.Set ( uRows-1 );
+
+	ASSERT_EQ ( tMap.GetNumDeads(), 4u + 65536u + 1u );
+	ASSERT_TRUE ( tMap.IsSet ( 1 ) );
+	ASSERT_FALSE ( tMap.IsSet ( 2 ) );
+	ASSERT_TRUE ( tMap.IsSet ( 100000 ) );
+	ASSERT_FALSE ( tMap.IsSet ( 150000 ) );
+
+	ASSERT_EQ ( tMap.NextAlive ( 0 ), 2u );
+	ASSERT_EQ ( tMap.NextAlive ( 31 ), 33u );
+	ASSERT_EQ ( tMap.NextAlive ( 65535 ), 65535u );
+	ASSERT_EQ ( tMap.NextAlive ( 65536 ), 131072u );
+	ASSERT_EQ ( tMap.NextAlive ( uRows-2 ), uRows-2 );
+	ASSERT_EQ ( tMap.NextAlive ( uRows-1 ), uRows );
+}
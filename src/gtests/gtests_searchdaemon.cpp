@@ -415,6 +415,69 @@ TEST_F ( T_ConfigureMultiAgent, simple_3_hosts )
 	ASSERT_FALSE ( tThird.m_bPersistent );
 }
 
+// HA_LATENCY scores of two mirrors; the lower one gets the query
+class T_LatencyScore : public ::testing::Test
+{
+protected:
+	HostDashboardRefPtr_t m_pFirst { new HostDashboard_t ( HostDesc_t() ) };
+	HostDashboardRefPtr_t m_pSecond { new HostDashboard_t ( HostDesc_t() ) };
+	int64_t m_iNow = sphMicroTimer();
+
+	int64_t Score ( const HostDashboard_t & tDash, int64_t iAfterUS = 0 ) const
+	{
+		return tDash.GetLatencyScore ( m_iNow+iAfterUS, HostDashboard_t::GetLatencyFloor ( *m_pFirst, *m_pSecond ) );
+	}
+};
+
+TEST_F ( T_LatencyScore, equal_mirrors )
+{
+	m_pFirst->UpdateLatency ( 10000, false );
+	m_pSecond->UpdateLatency ( 10000, false );
+	ASSERT_EQ ( Score ( *m_pFirst ), Score ( *m_pSecond ) );
+}
+
+TEST_F ( T_LatencyScore, unmeasured_mirror )
+{
+	// never measured at all: both are at the default floor
+	ASSERT_EQ ( Score ( *m_pFirst ), Score ( *m_pSecond ) );
+	ASSERT_GT ( Score ( *m_pFirst ), 0 );
+
+	// unmeasured mirror is as good as the measured one, not better
+	m_pFirst->UpdateLatency ( 10000, false );
+	ASSERT_EQ ( Score ( *m_pFirst ), Score ( *m_pSecond ) );
+
+	// so the load decides
+	m_pFirst->m_iInFlight = 1;
+	ASSERT_LT ( Score ( *m_pSecond ), Score ( *m_pFirst ) );
+	m_pFirst->m_iInFlight = 0;
+	m_pSecond->m_iInFlight = 1;
+	ASSERT_LT ( Score ( *m_pFirst ), Score ( *m_pSecond ) );
+}
+
+TEST_F ( T_LatencyScore, loaded_mirror )
+{
+	m_pFirst->UpdateLatency ( 10000, false );
+	m_pSecond->UpdateLatency ( 20000, false );
+	ASSERT_LT ( Score ( *m_pFirst ), Score ( *m_pSecond ) );
+
+	// twice as fast, but with 3 queries in flight
+	m_pFirst->m_iInFlight = 3;
+	ASSERT_LT ( Score ( *m_pSecond ), Score ( *m_pFirst ) );
+}
+
+TEST_F ( T_LatencyScore, stale_latency_decays_to_floor )
+{
+	m_pFirst->UpdateLatency ( 100000, false );
+	m_pSecond->UpdateLatency ( 10000, false );
+	ASSERT_LT ( Score ( *m_pSecond ), Score ( *m_pFirst ) );
+
+	// after a while the slow mirror is worth probing again, but never wins over the fast one just by age
+	const int64_t iLater = 10000000;
+	ASSERT_LT ( Score ( *m_pFirst, iLater ), Score ( *m_pFirst ) );
+	ASSERT_EQ ( Score ( *m_pFirst, iLater ), Score ( *m_pSecond ) );
+	ASSERT_EQ ( Score ( *m_pSecond, iLater ), Score ( *m_pSecond ) );
+}
+
 // staging...
 // this classes are here only for tests (to avoid recompiling of a big piece in case of experiments)
 // the most base class we protect.
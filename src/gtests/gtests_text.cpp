@@ -517,6 +517,240 @@ TEST ( Text, expression_parser_many )
 	SafeDeleteArray ( pRow );
 }
 
+// batch eval of every node with a batch form must give the same values as per-match eval
+TEST ( Text, expression_batch_eval )
+{
+	CSphSchema tSchema;
+	for ( const auto & tAttr : { std::make_pair ( "id", SPH_ATTR_BIGINT ), std::make_pair ( "aaa", SPH_ATTR_INTEGER ), std::make_pair ( "bbb", SPH_ATTR_INTEGER ),
+		std::make_pair ( "big", SPH_ATTR_BIGINT ), std::make_pair ( "fff", SPH_ATTR_FLOAT ), std::make_pair ( "flag", SPH_ATTR_BOOL ) } )
+	{
+		CSphColumnInfo tCol ( tAttr.first, tAttr.second );
+		tSchema.AddAttr ( tCol, false );
+	}
+
+	// more than one batch chunk; bbb is often 0
+	const int MATCHES = 300;
+	int iRowSize = tSchema.GetRowSize();
+	CSphFixedVector<CSphRowitem> dRows ( MATCHES*iRowSize );
+	dRows.ZeroVec();
+	CSphFixedVector<CSphMatch> dMatches ( MATCHES );
+	CSphVector<CSphMatch *> dPtrs;
+	sphSrand ( 1 );
+	ARRAY_FOREACH ( i, dMatches )
+	{
+		CSphMatch & tMatch = dMatches[i];
+		tMatch.m_tRowID = i;
+		tMatch.m_pStatic = dRows.Begin() + i*iRowSize;
+		auto * pRow = const_cast<CSphRowitem *> ( tMatch.m_pStatic );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "id" )->m_tLocator, i+1 );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "aaa" )->m_tLocator, DWORD ( int ( sphRand()%26 ) - 5 ) );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "bbb" )->m_tLocator, sphRand()%7 );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "big" )->m_tLocator, ( (SphAttr_t)sphRand() << 8 ) | ( sphRand() & 0xFF ) );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "fff" )->m_tLocator, sphF2DW ( sphRand()%1000 / 100.0f - 2.0f ) );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "flag" )->m_tLocator, sphRand()%2 );
+		dPtrs.Add ( &tMatch );
+	}
+
+	const char * dExprs[] =
+	{
+		// attribute getters and constants
+		"aaa", "big", "fff", "flag", "aaa+7", "aaa*2.5", "big+10000000000",
+		// arithmetic
+		"aaa+bbb", "aaa-bbb", "aaa*bbb", "big+aaa", "big-big*bbb", "fff+aaa", "fff*fff-bbb",
+		"aaa/bbb", "fff/bbb", "big/aaa", "min(aaa,bbb)", "max(fff,aaa)", "min(big,aaa)", "max(big,bbb)",
+		// dividend must not be evaluated where divisor is 0 (mod by zero traps)
+		"(aaa mod bbb)/bbb",
+		// comparisons
+		"aaa<bbb", "aaa>bbb", "aaa<=bbb", "aaa>=bbb", "aaa=bbb", "aaa!=bbb", "fff<bbb", "fff>=aaa", "fff=fff", "big>aaa", "big!=big", "big<=1000",
+		// if; unselected branch must not be evaluated
+		"if(aaa>bbb,aaa,bbb)", "if(bbb=0,0,aaa mod bbb)", "if(fff>0.5,fff,-fff)", "if(big>100,big,aaa)", "if(flag,aaa/bbb,fff)",
+		// in
+		"aaa in (1,3,5,7)", "aaa in (-5,-3,0,2,4,6,8,10,12,14,16,18,20)", "big in (0,100,1000)",
+		// compositions
+		"if(aaa in (1,2,3),aaa*bbb+1,max(aaa,bbb)/2)", "(aaa+bbb)*(fff-1)/(bbb-3)", "min(aaa,bbb)<max(fff,1)+flag",
+	};
+
+	CSphFixedVector<float> dFloat ( MATCHES );
+	CSphFixedVector<int> dInt ( MATCHES );
+	CSphFixedVector<int64_t> dInt64 ( MATCHES );
+
+	for ( const char * szExpr : dExprs )
+	{
+		CSphString sError;
+		ESphAttr eType = SPH_ATTR_NONE;
+		ExprParseArgs_t tExprArgs;
+		tExprArgs.m_pAttrType = &eType;
+		ISphExprRefPtr_c pExpr ( sphExprParse ( szExpr, tSchema, sError, tExprArgs ) );
+		ASSERT_TRUE ( pExpr.Ptr () ) << szExpr << ": " << sError.cstr ();
+
+		// full set, and slices that don't start or end at chunk boundary
+		for ( auto tSlice : { std::make_pair ( 0, MATCHES ), std::make_pair ( 3, 1 ), std::make_pair ( 5, 129 ), std::make_pair ( 100, 200 ) } )
+		{
+			auto dSlice = dPtrs.Slice ( tSlice.first, tSlice.second );
+
+			// float eval works for any tree
+			pExpr->EvalBatch ( dSlice, dFloat.Begin() );
+			ARRAY_FOREACH ( i, dSlice )
+				ASSERT_FLOAT_EQ ( dFloat[i], pExpr->Eval ( *dSlice[i] ) ) << szExpr << ", match " << dSlice[i]->m_tRowID;
+
+			if ( eType==SPH_ATTR_INTEGER || eType==SPH_ATTR_BOOL )
+			{
+				pExpr->IntEvalBatch ( dSlice, dInt.Begin() );
+				ARRAY_FOREACH ( i, dSlice )
+					ASSERT_EQ ( dInt[i], pExpr->IntEval ( *dSlice[i] ) ) << szExpr << ", match " << dSlice[i]->m_tRowID;
+			}
+
+			if ( eType==SPH_ATTR_INTEGER || eType==SPH_ATTR_BOOL || eType==SPH_ATTR_BIGINT )
+			{
+				pExpr->Int64EvalBatch ( dSlice, dInt64.Begin() );
+				ARRAY_FOREACH ( i, dSlice )
+					ASSERT_EQ ( dInt64[i], pExpr->Int64Eval ( *dSlice[i] ) ) << szExpr << ", match " << dSlice[i]->m_tRowID;
+			}
+		}
+	}
+}
+
+
+TEST ( Text, context_batch_filter_sort )
+{
+	CSphSchema tSchema;
+	for ( const auto & tAttr : { std::make_pair ( "id", SPH_ATTR_BIGINT ), std::make_pair ( "aaa", SPH_ATTR_INTEGER ), std::make_pair ( "bbb", SPH_ATTR_INTEGER ),
+		std::make_pair ( "fff", SPH_ATTR_FLOAT ) } )
+	{
+		CSphColumnInfo tCol ( tAttr.first, tAttr.second );
+		tSchema.AddAttr ( tCol, false );
+	}
+
+	// filter items, then sort items; every item reads the one computed before it
+	struct CalcDesc_t { const char * m_szName; ESphAttr m_eType; const char * m_szExpr; bool m_bFilter; };
+	const CalcDesc_t dCalcs[] =
+	{
+		{ "e1", SPH_ATTR_INTEGER, "aaa*2+bbb", true },
+		{ "e2", SPH_ATTR_FLOAT, "e1/2.0+fff", true },
+		{ "e3", SPH_ATTR_BIGINT, "e1*1000000000+bbb", false },
+		{ "e4", SPH_ATTR_FLOAT, "if(e2>fff,e2,fff)-e3", false },
+	};
+
+	for ( const auto & tCalc : dCalcs )
+	{
+		CSphColumnInfo tCol ( tCalc.m_szName, tCalc.m_eType );
+		tSchema.AddAttr ( tCol, true );
+	}
+
+	CSphQuery tQuery;
+	CSphQueryContext tCtx ( tQuery );
+	tCtx.m_iDynamicSize = tSchema.GetDynamicSize();
+	for ( const auto & tCalc : dCalcs )
+	{
+		CSphString sError;
+		ExprParseArgs_t tExprArgs;
+		ISphExprRefPtr_c pExpr ( sphExprParse ( tCalc.m_szExpr, tSchema, sError, tExprArgs ) );
+		ASSERT_TRUE ( pExpr.Ptr() ) << tCalc.m_szExpr << ": " << sError.cstr();
+
+		CSphQueryContext::CalcItem_t tItem;
+		tItem.m_tLoc = tSchema.GetAttr ( tCalc.m_szName )->m_tLocator;
+		tItem.m_eType = tCalc.m_eType;
+		tItem.m_pExpr = pExpr;
+		( tCalc.m_bFilter ? tCtx.m_dCalcFilter : tCtx.m_dCalcSort ).Add ( tItem );
+	}
+
+	// more than one block, and a partial one at the end
+	const int MATCHES = MatchBlock_c::MAX_MATCHES*2+17;
+	int iStaticSize = tSchema.GetStaticSize();
+	CSphFixedVector<CSphRowitem> dRows ( MATCHES*iStaticSize );
+	dRows.ZeroVec();
+	sphSrand ( 2 );
+	for ( int i=0; i<MATCHES; ++i )
+	{
+		CSphRowitem * pRow = dRows.Begin() + i*iStaticSize;
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "id" )->m_tLocator, i+1 );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "aaa" )->m_tLocator, DWORD ( int ( sphRand()%100 ) - 50 ) );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "bbb" )->m_tLocator, sphRand()%9 );
+		sphSetRowAttr ( pRow, tSchema.GetAttr ( "fff" )->m_tLocator, sphF2DW ( sphRand()%1000 / 10.0f - 50.0f ) );
+	}
+
+	// scalar reference
+	CSphFixedVector<CSphMatch> dScalar ( MATCHES );
+	ARRAY_FOREACH ( i, dScalar )
+	{
+		dScalar[i].Reset ( tCtx.m_iDynamicSize );
+		dScalar[i].m_tRowID = i;
+		dScalar[i].m_pStatic = dRows.Begin() + i*iStaticSize;
+		tCtx.CalcFilter ( dScalar[i] );
+		tCtx.CalcSort ( dScalar[i] );
+	}
+
+	auto fnCheck = [&tSchema, &dScalar] ( const CSphMatch & tMatch, const CalcDesc_t & tCalc )
+	{
+		const CSphAttrLocator & tLoc = tSchema.GetAttr ( tCalc.m_szName )->m_tLocator;
+		const CSphMatch & tRef = dScalar[tMatch.m_tRowID];
+		if ( tCalc.m_eType==SPH_ATTR_FLOAT )
+			EXPECT_FLOAT_EQ ( tMatch.GetAttrFloat ( tLoc ), tRef.GetAttrFloat ( tLoc ) ) << tCalc.m_szName << ", match " << tMatch.m_tRowID;
+		else
+			EXPECT_EQ ( tMatch.GetAttr ( tLoc ), tRef.GetAttr ( tLoc ) ) << tCalc.m_szName << ", match " << tMatch.m_tRowID;
+	};
+
+	// same rows through the blocks a full scan uses; every other row is filtered out before sorting
+	int iPushed = 0;
+	int iSorted = 0;
+	MatchBlock_c tBlock ( tCtx.m_iDynamicSize );
+	CSphMatch tProto;
+	auto fnFlush = [&]()
+	{
+		auto dBlock = tBlock.Matches();
+		tCtx.CalcFilterBatch ( dBlock );
+		for ( const CSphMatch * pMatch : dBlock )
+			for ( const auto & tCalc : dCalcs )
+				if ( tCalc.m_bFilter )
+					fnCheck ( *pMatch, tCalc );
+
+		int iPassed = 0;
+		for ( CSphMatch * pMatch : dBlock )
+			if ( pMatch->m_tRowID & 1 )
+				dBlock[iPassed++] = pMatch;
+
+		auto dPassed = dBlock.Slice ( 0, iPassed );
+		tCtx.CalcSortBatch ( dPassed );
+		for ( const CSphMatch * pMatch : dPassed )
+		{
+			for ( const auto & tCalc : dCalcs )
+				fnCheck ( *pMatch, tCalc );
+			++iSorted;
+		}
+
+		tBlock.Clear();
+	};
+
+	for ( int i=0; i<MATCHES; ++i )
+	{
+		tBlock.Add ( i, dRows.Begin() + i*iStaticSize, tProto );
+		++iPushed;
+		if ( tBlock.IsFull() )
+			fnFlush();
+	}
+
+	if ( !tBlock.IsEmpty() )
+		fnFlush();
+
+	ASSERT_EQ ( iPushed, MATCHES );
+	ASSERT_EQ ( iSorted, MATCHES/2 );
+
+	// cutoff stops the pushes but leaves the rest of the block evaluated and freed
+	int iCalls = 0;
+	for ( int i=0; i<20; ++i )
+		tBlock.Add ( i, dRows.Begin() + i*iStaticSize, tProto );
+
+	bool bStop = FilterSortAndPush ( tCtx, tBlock.Matches(), [] ( CSphMatch & ) {}, [&iCalls, &fnCheck, &dCalcs] ( const CSphMatch & tMatch )
+	{
+		for ( const auto & tCalc : dCalcs )
+			fnCheck ( tMatch, tCalc );
+		return ++iCalls==5;
+	} );
+
+	ASSERT_TRUE ( bStop );
+	ASSERT_EQ ( iCalls, 5 );
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 
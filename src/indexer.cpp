@@ -61,6 +61,7 @@ static bool			g_bSendHUP		= true;
 static int				g_iMemLimit				= 128*1024*1024;
 static int				g_iMaxXmlpipe2Field		= 2*1024*1024;
 static int				g_iWriteBuffer			= 1024*1024;
+static int				g_iBuildThreads			= 1;
 static int				g_iMaxFileFieldBuffer	= 8*1024*1024;
 static bool				g_bIgnoreNonPlain	= false;
 
@@ -1236,6 +1237,8 @@ bool DoIndex ( const CSphConfigSection & hIndex, const char * szIndexName, const
 		if ( bInplaceEnable )
 			pIndex->SetInplaceSettings ( iHitGap, fRelocFactor, fWriteFactor );
 
+		pIndex->SetBuildThreads ( g_iBuildThreads );
+
 		pIndex->SetFieldFilter ( std::move ( pFieldFilter ) );
 		pIndex->SetTokenizer ( pTokenizer );
 		pIndex->SetDictionary ( pDict );
@@ -1724,6 +1727,8 @@ static void ShowHelp ()
 		"--print-queries\t\tprint SQL queries (for debugging)\n"
 		"--print-rt\t\tprint processed rows as SQL insert commands and field mapping info for populating an RT table\n"
 		"--keep-attrs\t\tretain attributes from the old table\n"
+		"--threads <N>\t\tsort hits and build secondary indexes with N threads\n"
+		"\t\t\t(default is 1)\n"
 		"\n"
 		"Examples:\n"
 		"indexer --quiet myidx1\tbuild 'myidx1' defined in 'manticore.conf'\n"
@@ -1844,6 +1849,10 @@ int main ( int argc, char ** argv )
 				dWildIndexes.Add ( argv[i] );
 			else
 				dIndexes.Add ( argv[i] );
+		} else if ( strcasecmp ( argv[i], "--threads" )==0 && (i+1)<argc )
+		{
+			g_iBuildThreads = Max ( atoi ( argv[++i] ), 1 );
+
 		} else if ( strcasecmp ( argv[i], "--drop-src" )==0 )
 		{
 			bDropSrc = true;
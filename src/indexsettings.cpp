@@ -19,6 +19,7 @@
 #include "icu.h"
 #include "attribute.h"
 #include "indexfiles.h"
+#include "jsoncolumns.h"
 #include "tokenizer/tokenizer.h"
 #include "client_task_info.h"
 
@@ -78,6 +79,9 @@ CSphString CompressionToStr ( Compression_e eComp )
 	case Compression_e::LZ4HC:
 		return "lz4hc";
 
+	case Compression_e::ZSTD:
+		return "zstd";
+
 	case Compression_e::NONE:
 	default:
 		return "none";
@@ -797,14 +801,23 @@ bool CSphIndexSettings::ParseDocstoreSettings ( const CSphConfigSection & hIndex
 		m_eCompression = Compression_e::LZ4;
 	else if ( sCompression=="lz4hc" )
 		m_eCompression = Compression_e::LZ4HC;
+	else if ( sCompression=="zstd" )
+	{
+#if WITH_ZSTD
+		m_eCompression = Compression_e::ZSTD;
+#else
+		sError = "zstd compression in 'docstore_compression' is not supported by this build";
+		return false;
+#endif
+	}
 	else
 	{
 		sError.SetSprintf ( "unknown compression specified in 'docstore_compression': '%s'\n", sCompression.cstr() ); 
 		return false;
 	}
 
-	if ( hIndex.Exists("docstore_compression_level") && m_eCompression!=Compression_e::LZ4HC )
-		sWarning.SetSprintf ( "docstore_compression_level works only with LZ4HC compression" ); 
+	if ( hIndex.Exists("docstore_compression_level") && m_eCompression!=Compression_e::LZ4HC && m_eCompression!=Compression_e::ZSTD )
+		sWarning.SetSprintf ( "docstore_compression_level works only with LZ4HC and ZSTD compression" ); 
 
 	return true;
 }
@@ -2015,6 +2028,15 @@ CSphString BuildCreateTable ( const CSphString & sName, const CSphIndex * pIndex
 
 	DumpCreateTable ( tBuf, *pIndex, pFilenameBuilder.get() );
 
+	// json columns live in the schema only
+	CSphString sJsonColumns = FormatJsonColumns ( tSchema );
+	if ( !sJsonColumns.IsEmpty() )
+	{
+		if ( tBuf.GetLength() )
+			tBuf << " ";
+		tBuf << "json_columns='" << sJsonColumns.cstr() << "'";
+	}
+
 	if ( tBuf.GetLength() )
 		sRes << " " << tBuf.cstr();
 
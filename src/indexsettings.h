@@ -197,7 +197,8 @@ enum class Compression_e
 {
 	NONE,
 	LZ4,
-	LZ4HC
+	LZ4HC,
+	ZSTD
 };
 
 
@@ -0,0 +1,539 @@
+//
+// Copyright (c) 2023, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include "jsoncolumns.h"
+
+#include "attribute.h"
+#include "conversion.h"
+#include "sphinxint.h"
+#include "sphinxrt.h"
+#include "sphinxutils.h"
+
+static const char * g_szJsonColumnPrefix = "$_json:";
+
+// typed copies of values that exist but can't be copied exactly; filters on these never run against the copy
+// but secondary index lookups fetch the marker together with the filtered values
+static const int64_t	JSON_INEXACT_INT = LLONG_MIN;
+static const float		JSON_INEXACT_FLOAT = -FLT_MAX;
+static const char *		JSON_INEXACT_STRING = "\x01";
+
+
+static bool IsJsonColumn ( const CSphColumnInfo & tAttr )
+{
+	return tAttr.m_sName.Begins ( g_szJsonColumnPrefix );
+}
+
+
+static CSphString GetJsonColumnPath ( const CSphColumnInfo & tAttr )
+{
+	assert ( IsJsonColumn ( tAttr ) );
+	return tAttr.m_sName.SubString ( (int) strlen ( g_szJsonColumnPrefix ), tAttr.m_sName.Length() - (int) strlen ( g_szJsonColumnPrefix ) );
+}
+
+
+static const char * JsonColumnTypeName ( ESphAttr eType )
+{
+	switch ( eType )
+	{
+	case SPH_ATTR_BIGINT:	return "bigint";
+	case SPH_ATTR_FLOAT:	return "float";
+	case SPH_ATTR_STRING:	return "string";
+	case SPH_ATTR_INT64SET:	return "multi";
+	default:				return "";
+	}
+}
+
+
+static bool IsValidJsonKey ( const CSphString & sKey )
+{
+	if ( sKey.IsEmpty() )
+		return false;
+
+	for ( const char * p = sKey.cstr(); *p; ++p )
+		if ( !isalnum ( (BYTE)*p ) && *p!='_' )
+			return false;
+
+	return true;
+}
+
+
+static bool SplitJsonPath ( const CSphString & sPath, CSphString & sAttr, StrVec_t & dKeys )
+{
+	StrVec_t dParts;
+	sphSplit ( dParts, sPath.cstr(), "." );
+	if ( dParts.GetLength()<2 )
+		return false;
+
+	sAttr = dParts[0];
+	dKeys.Resize(0);
+	for ( int i = 1; i < dParts.GetLength(); i++ )
+	{
+		if ( !IsValidJsonKey ( dParts[i] ) )
+			return false;
+
+		dKeys.Add ( dParts[i] );
+	}
+
+	return true;
+}
+
+
+bool AddJsonColumns ( const CSphString & sOption, CSphSchema & tSchema, CSphString & sError )
+{
+	StrVec_t dItems;
+	sphSplit ( dItems, sOption.cstr(), "," );
+
+	int iAdded = 0;
+	for ( auto & sItem : dItems )
+	{
+		sItem.Trim();
+		if ( sItem.IsEmpty() )
+			continue;
+
+		StrVec_t dNameType;
+		sphSplit ( dNameType, sItem.cstr(), ":" );
+		if ( dNameType.GetLength()!=2 )
+		{
+			sError.SetSprintf ( "json_columns: expected 'path:type', got '%s'", sItem.cstr() );
+			return false;
+		}
+
+		CSphString sPath = dNameType[0].Trim();
+		CSphString sType = dNameType[1].Trim();
+		sType.ToLower();
+		sphColumnToLowercase ( const_cast<char *>( sPath.cstr() ) );
+
+		ESphAttr eType = SPH_ATTR_NONE;
+		if ( sType=="bigint" )
+			eType = SPH_ATTR_BIGINT;
+		else if ( sType=="float" )
+			eType = SPH_ATTR_FLOAT;
+		else if ( sType=="string" )
+			eType = SPH_ATTR_STRING;
+		else if ( sType=="multi" )
+			eType = SPH_ATTR_INT64SET;
+		else
+		{
+			sError.SetSprintf ( "json_columns: unknown type '%s' for '%s' (must be bigint, float, string or multi)", sType.cstr(), sPath.cstr() );
+			return false;
+		}
+
+		CSphString sAttr;
+		StrVec_t dKeys;
+		if ( !SplitJsonPath ( sPath, sAttr, dKeys ) )
+		{
+			sError.SetSprintf ( "json_columns: '%s' is not a json path (expected attr.key[.key...])", sPath.cstr() );
+			return false;
+		}
+
+		const CSphColumnInfo * pJson = tSchema.GetAttr ( sAttr.cstr() );
+		if ( !pJson || pJson->m_eAttrType!=SPH_ATTR_JSON )
+		{
+			sError.SetSprintf ( "json_columns: '%s' is not a json attribute", sAttr.cstr() );
+			return false;
+		}
+
+		CSphString sName;
+		sName.SetSprintf ( "%s%s", g_szJsonColumnPrefix, sPath.cstr() );
+		if ( tSchema.GetAttr ( sName.cstr() ) )
+		{
+			sError.SetSprintf ( "json_columns: duplicate path '%s'", sPath.cstr() );
+			return false;
+		}
+
+		if ( ++iAdded>MAX_JSON_COLUMNS )
+		{
+			sError.SetSprintf ( "json_columns: too many paths (max=%d)", MAX_JSON_COLUMNS );
+			return false;
+		}
+
+		tSchema.AddAttr ( CSphColumnInfo ( sName.cstr(), eType ), false );
+	}
+
+	if ( iAdded )
+		tSchema.AddAttr ( CSphColumnInfo ( sphGetJsonMaskName(), SPH_ATTR_BIGINT ), false );
+
+	return true;
+}
+
+
+CSphString FormatJsonColumns ( const ISphSchema & tSchema )
+{
+	StringBuilder_c sRes ( ", " );
+	for ( int i = 0; i < tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tAttr = tSchema.GetAttr(i);
+		if ( IsJsonColumn ( tAttr ) )
+			sRes.Sprintf ( "%s:%s", GetJsonColumnPath ( tAttr ).cstr(), JsonColumnTypeName ( tAttr.m_eAttrType ) );
+	}
+
+	return sRes.cstr();
+}
+
+
+bool HasJsonColumns ( const ISphSchema & tSchema, const CSphString & sJsonAttr )
+{
+	CSphString sPrefix;
+	sPrefix.SetSprintf ( "%s%s.", g_szJsonColumnPrefix, sJsonAttr.cstr() );
+
+	for ( int i = 0; i < tSchema.GetAttrsCount(); i++ )
+		if ( tSchema.GetAttr(i).m_sName.Begins ( sPrefix.cstr() ) )
+			return true;
+
+	return false;
+}
+
+
+int GetJsonColumn ( const ISphSchema & tSchema, const CSphString & sPath, int & iColumn )
+{
+	iColumn = -1;
+	if ( !tSchema.GetAttr ( sphGetJsonMaskName() ) )
+		return -1;
+
+	CSphString sName;
+	sName.SetSprintf ( "%s%s", g_szJsonColumnPrefix, sPath.cstr() );
+	int iAttr = tSchema.GetAttrIndex ( sName.cstr() );
+	if ( iAttr<0 )
+		return -1;
+
+	iColumn = 0;
+	for ( int i = 0; i < iAttr; i++ )
+		if ( IsJsonColumn ( tSchema.GetAttr(i) ) )
+			iColumn++;
+
+	return iAttr;
+}
+
+
+bool CanUseJsonColumn ( const CSphFilterSettings & tSettings, ESphAttr eColumn )
+{
+	ESphFilter eFilter = tSettings.m_eType;
+	switch ( eColumn )
+	{
+	case SPH_ATTR_BIGINT:	return eFilter==SPH_FILTER_VALUES || eFilter==SPH_FILTER_RANGE;
+	case SPH_ATTR_FLOAT:	return eFilter==SPH_FILTER_FLOATRANGE;
+	case SPH_ATTR_STRING:	return eFilter==SPH_FILTER_STRING || eFilter==SPH_FILTER_STRING_LIST;
+
+	// plain filters over json arrays don't look inside; only explicit ANY()/ALL() treat them as MVA
+	case SPH_ATTR_INT64SET:	return ( eFilter==SPH_FILTER_VALUES || eFilter==SPH_FILTER_RANGE ) && tSettings.m_eMvaFunc!=SPH_MVAFUNC_NONE;
+	default:				return false;
+	}
+}
+
+
+bool RemapJsonColumnFilters ( const ISphSchema & tSchema, const CSphVector<CSphFilterSettings> & dFilters, CSphVector<CSphFilterSettings> & dRemapped )
+{
+	if ( !tSchema.GetAttr ( sphGetJsonMaskName() ) )
+		return false;
+
+	bool bRemapped = false;
+	dRemapped = dFilters;
+	for ( auto & tFilter : dRemapped )
+	{
+		// index returns a superset (exact matches and inexact copies) that is filtered later, so it can't be inverted
+		if ( tFilter.m_bExclude )
+			continue;
+
+		bool bString = tFilter.m_eType==SPH_FILTER_STRING || tFilter.m_eType==SPH_FILTER_STRING_LIST;
+		if ( bString && !tFilter.m_bHasEqualMin && !tFilter.m_bHasEqualMax )
+			continue;
+
+		int iColumn = -1;
+		int iAttr = GetJsonColumn ( tSchema, tFilter.m_sAttrName, iColumn );
+		if ( iAttr<0 )
+			continue;
+
+		const CSphColumnInfo & tAttr = tSchema.GetAttr(iAttr);
+		if ( !CanUseJsonColumn ( tFilter, tAttr.m_eAttrType ) )
+			continue;
+
+		tFilter.m_sAttrName = tAttr.m_sName;
+		bRemapped = true;
+	}
+
+	return bRemapped;
+}
+
+
+void CreateJsonColumnInexactFilter ( const CSphColumnInfo & tAttr, CSphFilterSettings & tFilter )
+{
+	assert ( IsJsonColumn ( tAttr ) );
+
+	tFilter = CSphFilterSettings();
+	tFilter.m_sAttrName = tAttr.m_sName;
+	switch ( tAttr.m_eAttrType )
+	{
+	case SPH_ATTR_FLOAT:
+		tFilter.m_eType = SPH_FILTER_FLOATRANGE;
+		tFilter.m_fMinValue = tFilter.m_fMaxValue = JSON_INEXACT_FLOAT;
+		break;
+
+	case SPH_ATTR_STRING:
+		tFilter.m_eType = SPH_FILTER_STRING;
+		tFilter.m_dStrings.Add ( JSON_INEXACT_STRING );
+		break;
+
+	default:
+		tFilter.m_eType = SPH_FILTER_VALUES;
+		tFilter.m_dValues.Add ( JSON_INEXACT_INT );
+		if ( tAttr.m_eAttrType==SPH_ATTR_INT64SET )
+			tFilter.m_eMvaFunc = SPH_MVAFUNC_ANY;
+		break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/// collects integers of a json value (a single integer or an array) as a set; returns false on any non-integer value
+static bool CollectJsonInts ( ESphJsonType eJson, const BYTE * pVal, CSphVector<int64_t> & dValues )
+{
+	switch ( eJson )
+	{
+	case JSON_INT32:
+		dValues.Add ( sphJsonLoadInt ( &pVal ) );
+		break;
+
+	case JSON_INT64:
+		dValues.Add ( sphJsonLoadBigint ( &pVal ) );
+		break;
+
+	case JSON_INT32_VECTOR:
+	case JSON_INT64_VECTOR:
+	{
+		int iLen = sphJsonUnpackInt ( &pVal );
+		for ( int i = 0; i < iLen; i++ )
+			dValues.Add ( eJson==JSON_INT32_VECTOR ? sphJsonLoadInt ( &pVal ) : sphJsonLoadBigint ( &pVal ) );
+	}
+	break;
+
+	case JSON_MIXED_VECTOR:
+	{
+		sphJsonUnpackInt ( &pVal ); // total length
+		int iLen = sphJsonUnpackInt ( &pVal );
+		for ( int i = 0; i < iLen; i++ )
+		{
+			auto eType = (ESphJsonType)*pVal++;
+			if ( eType==JSON_INT32 )
+				dValues.Add ( sphJsonLoadInt ( &pVal ) );
+			else if ( eType==JSON_INT64 )
+				dValues.Add ( sphJsonLoadBigint ( &pVal ) );
+			else
+				return false;
+		}
+	}
+	break;
+
+	default:
+		return false;
+	}
+
+	dValues.Uniq();
+	return true;
+}
+
+JsonColumnsBuilder_c::JsonColumnsBuilder_c ( const ISphSchema & tSchema )
+{
+	const CSphColumnInfo * pMask = tSchema.GetAttr ( sphGetJsonMaskName() );
+	if ( !pMask )
+		return;
+
+	m_tMaskLocator = pMask->m_tLocator;
+	m_tMaskLocator.m_bDynamic = true;
+
+	// slots in InsertDocData_t, same order as in RtAccum_t::AddDocument
+	SmallStringHash_T<int> hJsonSlots;
+	int iStr = 0;
+	int iColumnar = 0;
+	int iMva = 0;
+	for ( int i = 0; i < tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tAttr = tSchema.GetAttr(i);
+		if ( tAttr.m_eAttrType==SPH_ATTR_JSON )
+			hJsonSlots.Add ( iStr, tAttr.m_sName );
+
+		if ( IsJsonColumn ( tAttr ) )
+		{
+			Column_t & tCol = m_dColumns.Add();
+			CSphString sAttr;
+			Verify ( SplitJsonPath ( GetJsonColumnPath ( tAttr ), sAttr, tCol.m_dKeys ) );
+			for ( const auto & sKey : tCol.m_dKeys )
+				tCol.m_dKeyMasks.Add ( sphJsonKeyMask ( sKey.cstr(), sKey.Length() ) );
+
+			tCol.m_eType = tAttr.m_eAttrType;
+			int * pSlot = hJsonSlots ( sAttr );
+			tCol.m_iJsonStr = pSlot ? *pSlot : -1;
+			tCol.m_tLocator = tAttr.m_tLocator;
+			tCol.m_tLocator.m_bDynamic = true;
+			if ( tAttr.m_eAttrType==SPH_ATTR_STRING )
+				tCol.m_iStr = iStr;
+			if ( tAttr.IsColumnar() )
+				tCol.m_iColumnar = iColumnar;
+			if ( tAttr.m_eAttrType==SPH_ATTR_INT64SET )
+				tCol.m_iMva = iMva;
+		}
+
+		if ( tAttr.m_eAttrType==SPH_ATTR_STRING || tAttr.m_eAttrType==SPH_ATTR_JSON )
+			iStr++;
+
+		if ( tAttr.m_eAttrType==SPH_ATTR_UINT32SET || tAttr.m_eAttrType==SPH_ATTR_INT64SET )
+		{
+			m_dMvaColumns.Add ( IsJsonColumn ( tAttr ) ? m_dColumns.GetLength()-1 : -1 );
+			iMva++;
+		}
+
+		if ( tAttr.IsColumnar() )
+			iColumnar++;
+	}
+}
+
+
+ESphJsonType JsonColumnsBuilder_c::FindValue ( const Column_t & tCol, const InsertDocData_t & tDoc, const BYTE ** ppValue ) const
+{
+	if ( tCol.m_iJsonStr<0 || tCol.m_iJsonStr>=tDoc.m_dStrings.GetLength() || !tDoc.m_dStrings[tCol.m_iJsonStr] )
+		return JSON_EOF;
+
+	ByteBlob_t dJson = sphUnpackPtrAttr ( (const BYTE *)tDoc.m_dStrings[tCol.m_iJsonStr] );
+	if ( !dJson.second )
+		return JSON_EOF;
+
+	// same lookup as json field expressions do
+	const BYTE * pVal = dJson.first;
+	ESphJsonType eJson = sphJsonFindFirst ( &pVal );
+	ARRAY_FOREACH_COND ( i, tCol.m_dKeys, eJson!=JSON_EOF )
+		eJson = sphJsonFindByKey ( eJson, &pVal, tCol.m_dKeys[i].cstr(), tCol.m_dKeys[i].Length(), tCol.m_dKeyMasks[i] );
+
+	*ppValue = pVal;
+	return eJson;
+}
+
+
+void JsonColumnsBuilder_c::StoreMvas ( InsertDocData_t & tDoc, const CSphFixedVector<CSphVector<int64_t>> & dValues ) const
+{
+	// rebuild the (count, values...) pool replacing entries of multi columns
+	CSphVector<int64_t> dMvas;
+	int iSrc = 0;
+	for ( int iColumn : m_dMvaColumns )
+	{
+		int iValues = iSrc<tDoc.m_dMvas.GetLength() ? (int)tDoc.m_dMvas[iSrc] : 0;
+		if ( iColumn<0 )
+		{
+			dMvas.Add ( iValues );
+			for ( int i = 0; i < iValues && iSrc+1+i<tDoc.m_dMvas.GetLength(); i++ )
+				dMvas.Add ( tDoc.m_dMvas[iSrc+1+i] );
+		}
+		else
+		{
+			dMvas.Add ( dValues[iColumn].GetLength() );
+			dMvas.Append ( dValues[iColumn] );
+		}
+
+		iSrc += iValues+1;
+	}
+
+	tDoc.m_dMvas.SwapData ( dMvas );
+}
+
+
+void JsonColumnsBuilder_c::Fill ( InsertDocData_t & tDoc, StrVec_t & dStorage ) const
+{
+	dStorage.Resize ( m_dColumns.GetLength() );
+	CSphFixedVector<CSphVector<int64_t>> dMvaValues ( m_dColumns.GetLength() );
+	bool bHaveMva = false;
+
+	uint64_t uMask = 0;
+	ARRAY_FOREACH ( i, m_dColumns )
+	{
+		const Column_t & tCol = m_dColumns[i];
+		const BYTE * pVal = nullptr;
+		ESphJsonType eJson = FindValue ( tCol, tDoc, &pVal );
+
+		// typed copy is exact only when filtering it can't differ from filtering the json value
+		bool bExact = false;
+		SphAttr_t tValue = 0;
+		dStorage[i] = "";
+		switch ( tCol.m_eType )
+		{
+		case SPH_ATTR_BIGINT:
+			bExact = eJson==JSON_INT32 || eJson==JSON_INT64;
+			if ( eJson==JSON_INT32 )
+				tValue = sphJsonLoadInt ( &pVal );
+			else if ( eJson==JSON_INT64 )
+				tValue = sphJsonLoadBigint ( &pVal );
+			else if ( eJson!=JSON_EOF )
+				tValue = JSON_INEXACT_INT;
+			break;
+
+		case SPH_ATTR_FLOAT:
+			bExact = eJson==JSON_INT32 || eJson==JSON_INT64 || eJson==JSON_DOUBLE;
+			if ( eJson==JSON_INT32 )
+				tValue = sphF2DW ( (float)sphJsonLoadInt ( &pVal ) );
+			else if ( eJson==JSON_INT64 )
+				tValue = sphF2DW ( (float)sphJsonLoadBigint ( &pVal ) );
+			else if ( eJson==JSON_DOUBLE )
+				tValue = sphF2DW ( (float)sphQW2D ( sphJsonLoadBigint ( &pVal ) ) );
+			else if ( eJson!=JSON_EOF )
+				tValue = sphF2DW ( JSON_INEXACT_FLOAT );
+			break;
+
+		case SPH_ATTR_STRING:
+			if ( eJson==JSON_STRING )
+			{
+				int iLen = sphJsonUnpackInt ( &pVal );
+				bExact = !memchr ( pVal, 0, iLen ); // string attributes are zero-terminated
+				if ( bExact )
+					dStorage[i].SetBinary ( (const char *)pVal, iLen );
+			}
+
+			if ( !bExact && eJson!=JSON_EOF )
+				dStorage[i] = JSON_INEXACT_STRING;
+			break;
+
+		case SPH_ATTR_INT64SET:
+			bHaveMva = true;
+			if ( eJson!=JSON_EOF )
+			{
+				bExact = CollectJsonInts ( eJson, pVal, dMvaValues[i] );
+				if ( !bExact )
+				{
+					dMvaValues[i].Resize(0);
+					dMvaValues[i].Add ( JSON_INEXACT_INT );
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if ( eJson!=JSON_EOF )
+			uMask |= 1ULL << ( i*2 );
+
+		if ( bExact )
+			uMask |= 1ULL << ( i*2+1 );
+
+		if ( tCol.m_eType==SPH_ATTR_INT64SET )
+			continue;
+
+		if ( tCol.m_eType==SPH_ATTR_STRING )
+		{
+			if ( tCol.m_iStr<tDoc.m_dStrings.GetLength() )
+				tDoc.m_dStrings[tCol.m_iStr] = dStorage[i].IsEmpty() ? nullptr : dStorage[i].cstr();
+		}
+		else if ( tCol.m_iColumnar>=0 )
+			tDoc.m_dColumnarAttrs[tCol.m_iColumnar] = tValue;
+		else
+			tDoc.m_tDoc.SetAttr ( tCol.m_tLocator, tValue );
+	}
+
+	if ( bHaveMva )
+		StoreMvas ( tDoc, dMvaValues );
+
+	tDoc.m_tDoc.SetAttr ( m_tMaskLocator, (SphAttr_t)uMask );
+}
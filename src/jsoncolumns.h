@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2023, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#ifndef _jsoncolumns_
+#define _jsoncolumns_
+
+#include "sphinx.h"
+#include "sphinxjson.h"
+
+struct InsertDocData_t;
+
+/// json_columns keep typed copies of frequently filtered json paths in hidden "$_json:<path>" attributes
+/// (bigint, float, string or multi; columnar when the table is columnar). A rowwise "$_json_mask" bigint stores
+/// two bits per path: bit 2*i is set when the path exists in the document, bit 2*i+1 when the typed copy
+/// is exact, i.e. filtering the copy gives the same result as filtering the json value itself.
+/// 'multi' copies keep integer arrays as a bigint MVA and serve ANY()/ALL() filters over the path.
+/// Copies get histograms and secondary indexes; inexact copies hold a marker value that a secondary
+/// index lookup can find, so that the json filter could re-check these documents.
+constexpr int MAX_JSON_COLUMNS = 32;
+
+/// parse json_columns option ('j.price:float, j.uid:bigint, j.tag:string, j.tags:multi') and append hidden attributes
+bool		AddJsonColumns ( const CSphString & sOption, CSphSchema & tSchema, CSphString & sError );
+
+/// format json_columns option back from the schema; returns empty string if there are no json columns
+CSphString	FormatJsonColumns ( const ISphSchema & tSchema );
+
+/// returns true if any json column is built over the given json attribute
+bool		HasJsonColumns ( const ISphSchema & tSchema, const CSphString & sJsonAttr );
+
+/// returns hidden attribute index that keeps the given json path (or -1), and its number in the mask
+int			GetJsonColumn ( const ISphSchema & tSchema, const CSphString & sPath, int & iColumn );
+
+/// returns true if a filter over a json path may use a typed copy of the given type
+bool		CanUseJsonColumn ( const CSphFilterSettings & tSettings, ESphAttr eColumn );
+
+/// copies filters, renaming json paths that have typed copies to these copies (only for filters a secondary index can serve)
+/// returns false if there was nothing to rename
+bool		RemapJsonColumnFilters ( const ISphSchema & tSchema, const CSphVector<CSphFilterSettings> & dFilters, CSphVector<CSphFilterSettings> & dRemapped );
+
+/// creates a filter that matches the marker value of documents with inexact copies
+void		CreateJsonColumnInexactFilter ( const CSphColumnInfo & tAttr, CSphFilterSettings & tFilter );
+
+/// fills json columns of a document that is about to be inserted
+class JsonColumnsBuilder_c
+{
+public:
+	explicit	JsonColumnsBuilder_c ( const ISphSchema & tSchema );
+
+	bool		IsEmpty() const { return m_dColumns.IsEmpty(); }
+
+	/// dStorage keeps string values until the document is added to the accumulator
+	void		Fill ( InsertDocData_t & tDoc, StrVec_t & dStorage ) const;
+
+private:
+	struct Column_t
+	{
+		StrVec_t			m_dKeys;
+		CSphVector<DWORD>	m_dKeyMasks;
+		ESphAttr			m_eType = SPH_ATTR_NONE;
+		int					m_iJsonStr = -1;	///< json attribute slot in InsertDocData_t::m_dStrings
+		int					m_iStr = -1;		///< own slot for string columns
+		int					m_iColumnar = -1;	///< columnar attribute id, -1 for rowwise
+		int					m_iMva = -1;		///< MVA slot in InsertDocData_t::m_dMvas for multi columns
+		CSphAttrLocator		m_tLocator;
+	};
+
+	CSphVector<Column_t>	m_dColumns;
+	CSphAttrLocator			m_tMaskLocator;
+	CSphVector<int>			m_dMvaColumns;	///< json column for every MVA slot, -1 for regular MVAs
+
+	ESphJsonType			FindValue ( const Column_t & tCol, const InsertDocData_t & tDoc, const BYTE ** ppValue ) const;
+	void					StoreMvas ( InsertDocData_t & tDoc, const CSphFixedVector<CSphVector<int64_t>> & dValues ) const;
+};
+
+#endif // _jsoncolumns_
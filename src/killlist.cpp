@@ -49,6 +49,18 @@ bool DeadRowMap_c::Set ( RowID_t tRowID, DWORD * pData )
 #endif
 
 	bool bSet = !( uPrev & uMask );
+	if ( bSet )
+	{
+		DWORD * pDeads = &m_dContainerDeads[tRowID>>CONTAINER_SHIFT];
+#ifdef HAVE_SYNC_FETCH
+		__sync_fetch_and_add ( pDeads, 1 );
+#elif _WIN32
+		_InterlockedIncrement ( (long*)pDeads );
+#else
+		++*pDeads;
+#endif
+	}
+
 	m_bHaveDead |= bSet;
 	if ( bSet && m_iNumDeads>=0 )
 		++m_iNumDeads;
@@ -63,16 +75,153 @@ static DWORD CountBits ( const VecTraits_T<DWORD>& dData )
 	return U;
 }
 
-void DeadRowMap_c::CheckForDead ( const DWORD * pData, const DWORD * pDataEnd )
+DWORD DeadRowMap_c::ContainerRows ( int iContainer ) const
 {
-	m_bHaveDead = false;
-	while ( pData<pDataEnd && !m_bHaveDead )
-		m_bHaveDead |= !!*pData++;
+	return (DWORD)Min ( (int64_t)CONTAINER_ROWS, (int64_t)m_uRows - ( (int64_t)iContainer << CONTAINER_SHIFT ) );
+}
+
+
+void DeadRowMap_c::ResetContainers ( DWORD uValue )
+{
+	m_dContainerDeads.Reset ( int ( ( (int64_t)m_uRows + CONTAINER_ROWS - 1 ) >> CONTAINER_SHIFT ) );
+	m_dContainerDeads.Fill ( uValue );
+}
+
+
+void DeadRowMap_c::BuildContainers ( const DWORD * pData )
+{
+	ResetContainers ( 0 );
+
+	const int64_t iWords = ( (int64_t)m_uRows + 31 ) / 32;
+	int64_t iTotal = 0;
+	ARRAY_FOREACH ( i, m_dContainerDeads )
+	{
+		const DWORD * pWord = pData + (int64_t)i*CONTAINER_WORDS;
+		const DWORD * pEnd = pData + Min ( iWords, (int64_t)(i+1)*CONTAINER_WORDS );
+		DWORD uDeads = 0;
+		for ( ; pWord<pEnd; ++pWord )
+			uDeads += sphBitCount ( *pWord );
+
+		m_dContainerDeads[i] = uDeads;
+		iTotal += uDeads;
+	}
+
+	m_iNumDeads = iTotal;
+	m_bHaveDead = iTotal>0;
+}
+
 
+RowID_t DeadRowMap_c::NextAlive ( RowID_t tRowID, const DWORD * pData ) const
+{
 	if ( !m_bHaveDead )
-		m_iNumDeads = 0;
-	else if ( pData==pDataEnd )
-		m_iNumDeads = sphBitCount ( *( pData-1 ) );
+		return Min ( tRowID, m_uRows );
+
+	int64_t iRow = tRowID;
+	while ( iRow<m_uRows )
+	{
+		int iContainer = int ( iRow>>CONTAINER_SHIFT );
+		DWORD uDeads = m_dContainerDeads[iContainer];
+		if ( !uDeads )
+			return RowID_t(iRow);
+
+		int64_t iContainerEnd = Min ( (int64_t)m_uRows, ( (int64_t)iContainer+1 ) << CONTAINER_SHIFT );
+		if ( uDeads==ContainerRows(iContainer) )
+		{
+			iRow = iContainerEnd;
+			continue;
+		}
+
+		for ( ; iRow<iContainerEnd; iRow = ( iRow | 31 ) + 1 )
+		{
+			DWORD uAlive = ~pData[iRow>>5] >> ( iRow&31 );
+			if ( uAlive )
+				return RowID_t ( Min ( iRow + sphLog2 ( uAlive & ( 0U-uAlive ) ) - 1, (int64_t)m_uRows ) );
+		}
+	}
+
+	return m_uRows;
+}
+
+
+int DeadRowMap_c::CollectAlive ( RowID_t & tRowID, RowID_t tMaxRowID, RowID_t * pOut, int iMaxOut, const DWORD * pData ) const
+{
+	RowID_t * pStart = pOut;
+	RowID_t * pMax = pOut + iMaxOut;
+	int64_t iRow = tRowID;
+	int64_t iEnd = Min ( (int64_t)tMaxRowID+1, (int64_t)m_uRows );
+
+	while ( pOut<pMax && iRow<iEnd )
+	{
+		int iContainer = int ( iRow>>CONTAINER_SHIFT );
+		int64_t iContainerEnd = Min ( iEnd, ( (int64_t)iContainer+1 ) << CONTAINER_SHIFT );
+		DWORD uDeads = m_bHaveDead ? m_dContainerDeads[iContainer] : 0;
+
+		// nothing killed here; don't even look at the bitmap
+		if ( !uDeads )
+		{
+			int64_t iTake = Min ( iContainerEnd-iRow, int64_t(pMax-pOut) );
+			for ( int64_t i = 0; i<iTake; ++i )
+				*pOut++ = RowID_t(iRow++);
+			continue;
+		}
+
+		if ( uDeads==ContainerRows(iContainer) )
+		{
+			iRow = iContainerEnd;
+			continue;
+		}
+
+		// mixed container; jump over dead bits word by word
+		while ( pOut<pMax && iRow<iContainerEnd )
+		{
+			DWORD uAlive = ~pData[iRow>>5] >> ( iRow&31 );
+			if ( !uAlive )
+			{
+				iRow = ( iRow | 31 ) + 1;
+				continue;
+			}
+
+			iRow += sphLog2 ( uAlive & ( 0U-uAlive ) ) - 1;
+			if ( iRow<iContainerEnd )
+				*pOut++ = RowID_t(iRow++);
+		}
+	}
+
+	tRowID = RowID_t ( Min ( iRow, iEnd ) );
+	return int ( pOut-pStart );
+}
+
+
+int DeadRowMap_c::FilterAlive ( const VecTraits_T<RowID_t> & dRows, RowID_t * pOut, const DWORD * pData ) const
+{
+	RowID_t * pStart = pOut;
+	const RowID_t * pRow = dRows.Begin();
+	const RowID_t * pEnd = pRow + dRows.GetLength();
+
+	while ( pRow<pEnd )
+	{
+		// rows of a block are sorted, so rows of one container come together
+		RowID_t tContainer = *pRow>>CONTAINER_SHIFT;
+		const RowID_t * pRunEnd = pRow+1;
+		while ( pRunEnd<pEnd && ( *pRunEnd>>CONTAINER_SHIFT )==tContainer )
+			++pRunEnd;
+
+		DWORD uDeads = m_bHaveDead ? m_dContainerDeads[tContainer] : 0;
+		if ( !uDeads )
+		{
+			memcpy ( pOut, pRow, ( pRunEnd-pRow )*sizeof(RowID_t) );
+			pOut += pRunEnd-pRow;
+		} else if ( uDeads!=ContainerRows(tContainer) )
+		{
+			for ( ; pRow<pRunEnd; ++pRow )
+				if ( !( pData [ *pRow>>5U ] & ( 1UL<<( *pRow&31U ) ) ) )
+					*pOut++ = *pRow;
+		}
+
+		pRow = pRunEnd;
+	}
+
+	return int ( pOut-pStart );
 }
 
 
@@ -104,7 +253,7 @@ int64_t DeadRowMap_Ram_c::GetLengthBytes() const
 
 uint64_t DeadRowMap_Ram_c::GetCoreSize () const
 {
-	return m_dData.GetLengthBytes64 ();
+	return m_dData.GetLengthBytes64 () + m_dContainerDeads.GetLengthBytes64();
 }
 
 void DeadRowMap_Ram_c::Reset ( DWORD uRows )
@@ -112,6 +261,7 @@ void DeadRowMap_Ram_c::Reset ( DWORD uRows )
 	m_uRows = uRows;
 	m_dData.Reset ( (uRows+31)/32 );
 	m_dData.Fill(0);
+	ResetContainers(0);
 	m_bHaveDead = false;
 	m_iNumDeads = 0;
 }
@@ -124,8 +274,7 @@ void DeadRowMap_Ram_c::Load ( DWORD uRows, CSphReader & tReader, CSphString & sE
 	if ( uRows & 0x1F )
 		m_dData[m_dData.GetLength()-1] = 0; // ensure tail bits after the end are zeroed
 	tReader.GetBytes ( m_dData.Begin(), m_dData.GetLength()*sizeof(m_dData[0]) );
-	m_iNumDeads = -1;
-	CheckForDead ( m_dData.Begin(), m_dData.Begin()+m_dData.GetLength() );
+	BuildContainers ( m_dData.Begin() );
 }
 
 
@@ -170,17 +319,18 @@ bool DeadRowMap_Disk_c::Flush ( bool bWaitComplete, CSphString & sError ) const
 
 bool DeadRowMap_Disk_c::Prealloc ( DWORD uRows, const CSphString & sFilename, CSphString & sError )
 {
-	// we'll reset this flag after preread
+	// we'll reset this flag (and count containers) after preread
 	m_bHaveDead = true;
 	m_uRows = uRows;
+	ResetContainers ( NOT_COUNTED );
 	return m_tData.Setup ( sFilename.cstr(), sError, true );
 }
 
 
 void DeadRowMap_Disk_c::Preread ( const char * sIndexName, const char * sFor, bool bMlock )
 {
-	m_iNumDeads = PrereadMappingCountingBits ( sIndexName, sFor, bMlock, false, m_tData );
-	m_bHaveDead = m_iNumDeads>0;
+	PrereadMapping ( sIndexName, sFor, bMlock, false, m_tData );
+	BuildContainers ( m_tData.GetReadPtr() );
 }
 
 
@@ -197,7 +347,7 @@ int64_t DeadRowMap_Disk_c::GetLengthBytes() const
 
 uint64_t DeadRowMap_Disk_c::GetCoreSize () const
 {
-	return m_tData.GetCoreSize();
+	return m_tData.GetCoreSize() + m_dContainerDeads.GetLengthBytes64();
 }
 
 DWORD DeadRowMap_Disk_c::CountDeads () const
@@ -18,6 +18,10 @@ class CSphReader;
 class CSphWriter;
 
 
+/// flat dead-row bitmap (one bit per row, the .spm layout) split into roaring-style containers of 64K rows.
+/// every container keeps its dead-row counter, so containers with no kills never touch the bitmap,
+/// fully dead ones are skipped in bulk, and only mixed ones are scanned word by word.
+/// containers are not compressed (no array/run encodings): memory stays one bit per row plus 4 bytes per container
 class DeadRowMap_c
 {
 public:
@@ -29,11 +33,18 @@ public:
 	virtual uint64_t GetCoreSize () const = 0;
 
 protected:
+	static const DWORD CONTAINER_SHIFT = 16;
+	static const DWORD CONTAINER_ROWS = 1U<<CONTAINER_SHIFT;
+	static const DWORD CONTAINER_WORDS = CONTAINER_ROWS/32;
+	static const DWORD NOT_COUNTED = 0x80000000;	// above any real counter; such container is always checked by bitmap
+
 	bool			m_bHaveDead {false};
 	mutable int64_t	m_iNumDeads = -1;		// means 'not initialized'
 	DWORD			m_uRows {0};
+	CSphFixedVector<DWORD> m_dContainerDeads {0};	// dead rows per container
 
-	void			CheckForDead ( const DWORD * pData, const DWORD * pDataEnd );
+	void			ResetContainers ( DWORD uValue );
+	void			BuildContainers ( const DWORD * pData );
 	bool			Set ( RowID_t tRowID, DWORD * pData );
 	inline bool		IsSet ( RowID_t tRowID, const DWORD * pData ) const
 	{
@@ -41,11 +52,19 @@ protected:
 			return false;
 
 		assert ( tRowID < m_uRows );
+		if ( !m_dContainerDeads[tRowID>>CONTAINER_SHIFT] )
+			return false;
+
 		return ( pData [ tRowID>>5U ] & ( 1UL<<( tRowID&31U ) ) )!=0;
 	}
 
+	RowID_t			NextAlive ( RowID_t tRowID, const DWORD * pData ) const;
+	int				CollectAlive ( RowID_t & tRowID, RowID_t tMaxRowID, RowID_t * pOut, int iMaxOut, const DWORD * pData ) const;
+	int				FilterAlive ( const VecTraits_T<RowID_t> & dRows, RowID_t * pOut, const DWORD * pData ) const;
+
 private:
 	virtual DWORD CountDeads () const = 0;	// heavy doc-by-doc counting
+	DWORD		ContainerRows ( int iContainer ) const;
 #if !(_WIN32) && !(HAVE_SYNC_FETCH)
 	CSphMutex		m_tLock;
 #endif
@@ -66,6 +85,15 @@ public:
 		return DeadRowMap_c::IsSet ( tRowID, m_tData.GetReadPtr() );
 	}
 
+	/// first alive row starting from tRowID, or total rows if there is none
+	RowID_t		NextAlive ( RowID_t tRowID ) const { return DeadRowMap_c::NextAlive ( tRowID, m_tData.GetReadPtr() ); }
+
+	/// put up to iMaxOut alive rows from [tRowID, tMaxRowID] into pOut; tRowID is advanced past the last examined row
+	int			CollectAlive ( RowID_t & tRowID, RowID_t tMaxRowID, RowID_t * pOut, int iMaxOut ) const { return DeadRowMap_c::CollectAlive ( tRowID, tMaxRowID, pOut, iMaxOut, m_tData.GetReadPtr() ); }
+
+	/// copy alive rows of a sorted rowid block into pOut, returns how many
+	int			FilterAlive ( const VecTraits_T<RowID_t> & dRows, RowID_t * pOut ) const { return DeadRowMap_c::FilterAlive ( dRows, pOut, m_tData.GetReadPtr() ); }
+
 	int64_t		GetLengthBytes() const override;
 	uint64_t	GetCoreSize () const override;
 	bool		Flush ( bool bWaitComplete, CSphString & sError ) const;
@@ -86,6 +114,7 @@ public:
 
 	bool		Set ( RowID_t tRowID );
 	bool		IsSet ( RowID_t tRowID ) const;
+	RowID_t		NextAlive ( RowID_t tRowID ) const { return DeadRowMap_c::NextAlive ( tRowID, m_dData.Begin() ); }
 	void		Reset ( DWORD uRows );
 
 	int64_t		GetLengthBytes() const override;
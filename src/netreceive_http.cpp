@@ -151,7 +151,7 @@ void HttpServe ( std::unique_ptr<AsyncNetBuffer_c> pBuf )
 		}
 
 //		tracer.Instant ( [&tIn](StringBuilder_c& sOut) {sOut<< ",\"args\":{\"step\":"<<tIn.HasBytes()<<"}";} );
-		bOk = tParser.ProcessClientHttp ( tIn, dResult );
+		bOk = tParser.ProcessClientHttp ( tIn, dResult, &tOut );
 
 		tOut.SwapData (dResult);
 		if ( !tOut.Flush () )
@@ -511,7 +511,9 @@ void CSphSchema::SetupColumnarFlags ( const CSphSourceSettings & tSettings, StrV
 			}
 		}
 
-		if ( sphIsInternalAttr ( tAttr ) )
+		// typed json_columns copies follow the table engine; other internal attrs are always rowwise
+		bool bJsonColumn = sphIsJsonTypedColumnAttr ( tAttr.m_sName );
+		if ( sphIsInternalAttr ( tAttr ) && !bJsonColumn )
 			tAttr.m_eEngine = AttrEngine_e::ROWWISE;
 		else
 		{
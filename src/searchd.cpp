@@ -54,6 +54,8 @@
 #include "queryfilter.h"
 #include "pseudosharding.h"
 #include "geodist.h"
+#include "costestimate.h"
+#include "jsoncolumns.h"
 
 // services
 #include "taskping.h"
@@ -172,6 +174,7 @@ static CSphVector<Listener_t>	g_dListeners;
 static int				g_iQueryLogFile	= -1;
 static CSphString		g_sQueryLogFile;
 static CSphString		g_sPidFile;
+static CSphString		g_sCostModelFile;	// where planner cost coefficients are persisted; empty means don't persist
 static bool				g_bPidIsMine = false;		// if PID is not mine, don't unlink it on fail
 static int				g_iPidFD		= -1;
 
@@ -696,6 +699,15 @@ void Shutdown () REQUIRES ( MainThread ) NO_THREAD_SAFETY_ANALYSIS
 	SHUTINFO << "Shut down flushing mutable ...";
 	ShutdownFlushingMutable();
 
+	// coefficients adjusted by query feedback would be lost otherwise
+	if ( IsCostFeedbackEnabled() && !g_sCostModelFile.IsEmpty() )
+	{
+		SHUTINFO << "Save cost model ...";
+		CSphString sError;
+		if ( !SaveCostCoeffs ( g_sCostModelFile, sError ) )
+			sphWarning ( "failed to save cost model: %s", sError.cstr() );
+	}
+
 	// stop search threads; up to shutdown_timeout seconds
 	SHUTINFO << "Wait preread (if any) finished ...";
 	WaitPrereadFinished ( g_iShutdownTimeoutUs );
@@ -1670,7 +1682,8 @@ enum
 	QFLAG_FACET					= 1UL << 9,
 	QFLAG_FACET_HEAD			= 1UL << 10,
 	QFLAG_JSON_QUERY			= 1UL << 11,
-	QFLAG_NOT_ONLY_ALLOWED		= 1UL << 12
+	QFLAG_NOT_ONLY_ALLOWED		= 1UL << 12,
+	QFLAG_DYNAMIC_PRUNING		= 1UL << 13
 };
 
 void operator<< ( ISphOutputBuffer & tOut, const CSphNamedInt & tValue )
@@ -1702,6 +1715,7 @@ void SearchRequestBuilder_c::SendQuery ( const char * sIndexes, ISphOutputBuffer
 	uFlags |= QFLAG_FACET * q.m_bFacet;
 	uFlags |= QFLAG_FACET_HEAD * q.m_bFacetHead;
 	uFlags |= QFLAG_NOT_ONLY_ALLOWED * q.m_bNotOnlyAllowed;
+	uFlags |= QFLAG_DYNAMIC_PRUNING * q.m_bDynamicPruning;
 
 	if ( q.m_eQueryType==QUERY_JSON )
 		uFlags |= QFLAG_JSON_QUERY;
@@ -2614,6 +2628,7 @@ bool ParseSearchQuery ( InputBuffer_c & tReq, ISphOutputBuffer & tOut, CSphQuery
 		tQuery.m_bFacetHead = !!( uFlags & QFLAG_FACET_HEAD );
 		tQuery.m_eQueryType = (uFlags & QFLAG_JSON_QUERY) ? QUERY_JSON : QUERY_API;
 		tQuery.m_bNotOnlyAllowed = !!( uFlags & QFLAG_NOT_ONLY_ALLOWED );
+		tQuery.m_bDynamicPruning = !!( uFlags & QFLAG_DYNAMIC_PRUNING );
 
 		if ( uMasterVer>0 || uVer==0x11E )
 			tQuery.m_bNormalizedTFIDF = !!( uFlags & QFLAG_NORMALIZED_TF );
@@ -9100,11 +9115,24 @@ void BuildStatus ( VectorLike & dStatus )
 
 	const QcacheStatus_t & s = QcacheGetStatus();
 	dStatus.MatchTupletf ( "qcache_max_bytes", "%l", s.m_iMaxBytes );
+	dStatus.MatchTupletf ( "qcache_table_max_bytes", "%l", s.m_iTableMaxBytes );
 	dStatus.MatchTupletf ( "qcache_thresh_msec", "%d", s.m_iThreshMs );
 	dStatus.MatchTupletf ( "qcache_ttl_sec", "%d", s.m_iTtlS );
 	dStatus.MatchTupletf ( "qcache_cached_queries", "%d", s.m_iCachedQueries );
 	dStatus.MatchTupletf ( "qcache_used_bytes", "%l", s.m_iUsedBytes );
 	dStatus.MatchTupletf ( "qcache_hits", "%l", s.m_iHits );
+	dStatus.MatchTupletf ( "qcache_misses", "%l", s.m_iMisses );
+	dStatus.MatchTupletf ( "qcache_evictions", "%l", s.m_iEvictions );
+	dStatus.MatchTupletf ( "qcache_lock_waits", "%l", s.m_iLockWaits );
+	dStatus.MatchTupletf ( "qcache_lock_wait_usec", "%l", s.m_iLockWaitUs );
+
+	DocstoreCacheStatus_t tDocstoreCache = GetDocstoreCacheStatus();
+	dStatus.MatchTupletf ( "docstore_cache_max_bytes", "%l", tDocstoreCache.m_iMaxBytes );
+	dStatus.MatchTupletf ( "docstore_cache_used_bytes", "%l", tDocstoreCache.m_iUsedBytes );
+	dStatus.MatchTupletf ( "docstore_cache_shards", "%d", tDocstoreCache.m_iShards );
+	dStatus.MatchTupletf ( "docstore_cache_hits", "%l", tDocstoreCache.m_iHits );
+	dStatus.MatchTupletf ( "docstore_cache_misses", "%l", tDocstoreCache.m_iMisses );
+	dStatus.MatchTupletf ( "docstore_cache_rejected", "%l", tDocstoreCache.m_iRejected );
 
 	// clusters
 	ReplicateClustersStatus ( dStatus );
@@ -14096,21 +14124,28 @@ static bool HandleSetGlobal ( CSphString& sError, const CSphString& sName, int64
 	if ( sName == "qcache_max_bytes" )
 	{
 		const QcacheStatus_t& s = QcacheGetStatus();
-		QcacheSetup ( iSetValue, s.m_iThreshMs, s.m_iTtlS );
+		QcacheSetup ( iSetValue, s.m_iThreshMs, s.m_iTtlS, s.m_iTableMaxBytes );
+		return true;
+	}
+
+	if ( sName == "qcache_table_max_bytes" )
+	{
+		const QcacheStatus_t& s = QcacheGetStatus();
+		QcacheSetup ( s.m_iMaxBytes, s.m_iThreshMs, s.m_iTtlS, iSetValue );
 		return true;
 	}
 
 	if ( sName == "qcache_thresh_msec" )
 	{
 		const QcacheStatus_t& s = QcacheGetStatus();
-		QcacheSetup ( s.m_iMaxBytes, (int)iSetValue, s.m_iTtlS );
+		QcacheSetup ( s.m_iMaxBytes, (int)iSetValue, s.m_iTtlS, s.m_iTableMaxBytes );
 		return true;
 	}
 
 	if ( sName == "qcache_ttl_sec" )
 	{
 		const QcacheStatus_t& s = QcacheGetStatus();
-		QcacheSetup ( s.m_iMaxBytes, s.m_iThreshMs, (int)iSetValue );
+		QcacheSetup ( s.m_iMaxBytes, s.m_iThreshMs, (int)iSetValue, s.m_iTableMaxBytes );
 		return true;
 	}
 
@@ -14983,6 +15018,35 @@ void HandleSched ( RowBuffer_i & tOut )
 	tOut.Eof ();
 }
 
+static void HandleCalibrate ( RowBuffer_i & tOut, const DebugCmd::DebugCommand_t & tCmd )
+{
+	CostCoeffs_t tPrev = GetCostCoeffs();
+	CostCoeffs_t tNew = CalibrateCostCoeffs();
+	SetCostCoeffs ( tNew );
+
+	CSphString sError;
+	if ( !g_sCostModelFile.IsEmpty() && !SaveCostCoeffs ( g_sCostModelFile, sError ) )
+	{
+		tOut.Error ( tCmd.m_szStmt, sError.cstr() );
+		return;
+	}
+
+	if ( !tOut.HeadOfStrings ( { "Coefficient", "Previous", "Calibrated" } ) )
+		return;
+
+	for ( int i = 0; i < (int)CostCoeff_e::TOTAL; i++ )
+	{
+		auto eCoeff = (CostCoeff_e)i;
+		tOut.PutString ( GetCostCoeffName(eCoeff) );
+		tOut.PutFloatAsString ( tPrev[eCoeff] );
+		tOut.PutFloatAsString ( tNew[eCoeff] );
+		if ( !tOut.Commit() )
+			return;
+	}
+
+	tOut.Eof();
+}
+
 void HandleMysqlDebug ( RowBuffer_i &tOut, const DebugCmd::DebugCommand_t* pCommand, const QueryProfile_c & tProfile )
 {
 	using namespace DebugCmd;
@@ -14997,6 +15061,7 @@ void HandleMysqlDebug ( RowBuffer_i &tOut, const DebugCmd::DebugCommand_t* pComm
 		{
 		case Cmd_e::SHUTDOWN:
 		case Cmd_e::CRASH: HandleShutdownCrash ( tOut, tCmd.m_sParam, tCmd.m_eCommand ); return;
+		case Cmd_e::CALIBRATE: HandleCalibrate ( tOut, tCmd ); return;
 #if !_WIN32
 		case Cmd_e::PROCDUMP: HandleProcDump ( tOut ); return;
 		case Cmd_e::SETGDB: HandleSetGdb ( tOut, tCmd.m_iPar1!=0 ); return;
@@ -15591,6 +15656,17 @@ static void AddDiskIndexStatus ( VectorLike & dStatus, const CSphIndex * pIndex,
 				sPercent << "0.00%";
 			return CSphString ( sPercent.cstr () );
 		} );
+		dStatus.MatchTupletf ( "docstore_cache_hits", "%l", tStatus.m_iDocstoreCacheHits );
+		dStatus.MatchTupletf ( "docstore_cache_misses", "%l", tStatus.m_iDocstoreCacheMisses );
+		dStatus.MatchTupletFn ( "docstore_cache_hit_rate", [&tStatus] {
+			StringBuilder_c sPercent;
+			auto iLookups = tStatus.m_iDocstoreCacheHits + tStatus.m_iDocstoreCacheMisses;
+			if ( iLookups )
+				sPercent.Sprintf ( "%0.2F%%", tStatus.m_iDocstoreCacheHits * 10000 / iLookups );
+			else
+				sPercent << "0.00%";
+			return CSphString ( sPercent.cstr () );
+		} );
 	}
 	if ( bRt )
 	{
@@ -15998,6 +16074,12 @@ static void RemoveAttrFromIndex ( const SqlStmt_t& tStmt, CSphIndex* pIdx, CSphS
 		return;
 	}
 
+	if ( pAttr && pAttr->m_eAttrType==SPH_ATTR_JSON && HasJsonColumns ( pIdx->GetMatchSchema(), sAttrToRemove ) )
+	{
+		sError.SetSprintf ( "unable to remove attribute '%s' used by json_columns", sAttrToRemove.cstr() );
+		return;
+	}
+
 	if ( pAttr && pIdx->GetMatchSchema().GetAttrsCount()==1 )
 	{
 		sError.SetSprintf ( "unable to remove last attribute '%s'", sAttrToRemove.cstr() );
@@ -16337,6 +16419,14 @@ static void HandleMysqlAlterIndexSettings ( RowBuffer_i & tOut, const SqlStmt_t
 	IndexSettingsContainer_c tContainer;
 	tContainer.Populate ( dCreateTableStmts[0].m_tCreateTable );
 
+	// json columns are part of the schema and can only be set on CREATE TABLE
+	for ( const auto & i : tStmt.m_tCreateTable.m_dOpts )
+		if ( i.m_sName=="json_columns" )
+		{
+			tOut.Error ( tStmt.m_sStmt, "json_columns can not be changed with ALTER TABLE" );
+			return;
+		}
+
 	// force override for old options
 	for ( const auto & i : tStmt.m_tCreateTable.m_dOpts )
 		tContainer.RemoveKeys ( i.m_sName );
@@ -19727,7 +19817,25 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 	g_iMaxFilterValues = hSearchd.GetInt ( "max_filter_values", g_iMaxFilterValues );
 	g_iMaxBatchQueries = hSearchd.GetInt ( "max_batch_queries", g_iMaxBatchQueries );
 	g_iDistThreads = hSearchd.GetInt ( "max_threads_per_query", g_iDistThreads );
-	sphSetThrottling ( hSearchd.GetInt ( "rt_merge_iops", 0 ), hSearchd.GetSize ( "rt_merge_maxiosize", 0 ) );
+
+	IOBudget_t tMergeIO;
+	tMergeIO.m_iIOps = hSearchd.GetInt ( "rt_merge_iops", 0 );
+	tMergeIO.m_iMaxIOSize = hSearchd.GetSize ( "rt_merge_maxiosize", 0 );
+	tMergeIO.m_iBandwidth = hSearchd.GetSize64 ( "rt_merge_bandwidth", 0 );
+	SetIOBudget ( IOClass_e::MERGE, tMergeIO );
+
+	IOBudget_t tFlushIO;
+	tFlushIO.m_iIOps = hSearchd.GetInt ( "rt_flush_iops", 0 );
+	tFlushIO.m_iMaxIOSize = hSearchd.GetSize ( "rt_flush_maxiosize", 0 );
+	tFlushIO.m_iBandwidth = hSearchd.GetSize64 ( "rt_flush_bandwidth", 0 );
+	SetIOBudget ( IOClass_e::FLUSH, tFlushIO );
+
+	IOBudget_t tPrereadIO;
+	tPrereadIO.m_iBandwidth = hSearchd.GetSize64 ( "preread_bandwidth", 0 );
+	SetIOBudget ( IOClass_e::PREREAD, tPrereadIO );
+
+	SetIOYieldTime ( hSearchd.GetMsTimeMs ( "background_io_yield", 0 ) );
+
 	g_iPingIntervalUs = hSearchd.GetUsTime64Ms ( "ha_ping_interval", 1000000 );
 	g_uHAPeriodKarmaS = hSearchd.GetSTimeS ( "ha_period_karma", 60 );
 	g_iQueryLogMinMs = hSearchd.GetMsTimeMs ( "query_log_min_msec", g_iQueryLogMinMs );
@@ -19824,7 +19932,8 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 	s.m_iMaxBytes = hSearchd.GetSize64 ( "qcache_max_bytes", s.m_iMaxBytes );
 	s.m_iThreshMs = hSearchd.GetMsTimeMs ( "qcache_thresh_msec", s.m_iThreshMs );
 	s.m_iTtlS = hSearchd.GetSTimeS ( "qcache_ttl_sec", s.m_iTtlS );
-	QcacheSetup ( s.m_iMaxBytes, s.m_iThreshMs, s.m_iTtlS );
+	s.m_iTableMaxBytes = hSearchd.GetSize64 ( "qcache_table_max_bytes", s.m_iTableMaxBytes );
+	QcacheSetup ( s.m_iMaxBytes, s.m_iThreshMs, s.m_iTtlS, s.m_iTableMaxBytes );
 
 	// hostname_lookup = {config_load | request}
 	g_bHostnameLookup = ( hSearchd.GetStr ( "hostname_lookup" ) == "request" );
@@ -19879,6 +19988,7 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 	g_bAutoSchema = ( hSearchd.GetInt ( "auto_schema", g_bAutoSchema ? 1 : 0 )!=0 );
 
 	SetAccurateAggregationDefault ( hSearchd.GetInt ( "accurate_aggregation", GetAccurateAggregationDefault() )!=0 );
+	SetExactGroupbySettings ( hSearchd.GetSize64 ( "exact_groupby_max_bytes", 128*1024*1024 ), hSearchd.GetStr ( "exact_groupby_tmpdir" ) );
 	SetDistinctThreshDefault ( hSearchd.GetInt ( "distinct_precision_threshold", GetDistinctThreshDefault() ) );
 }
 
@@ -21129,6 +21239,32 @@ int WINAPI ServiceMain ( int argc, char **argv ) EXCLUDES (MainThread)
 
 	ServeAutoOptimize();
 
+	{
+		CSphString sCostModelDefault;
+		if ( IsConfigless() )
+			sCostModelDefault.SetSprintf ( "%s/cost_model.json", GetDataDirInt().cstr() );
+		g_sCostModelFile = hSearchd.GetStr ( "cost_model_file", sCostModelDefault.scstr() );
+		FixPathAbsolute ( g_sCostModelFile );
+		SetCostFeedback ( hSearchd.GetInt ( "cost_model_feedback", 0 )!=0 );
+
+		bool bLoaded = false;
+		if ( !g_sCostModelFile.IsEmpty() && sphIsReadable ( g_sCostModelFile ) )
+		{
+			bLoaded = LoadCostCoeffs ( g_sCostModelFile, sError );
+			if ( !bLoaded )
+				sphWarning ( "failed to load cost model, using defaults: %s", sError.cstr() );
+		}
+
+		if ( hSearchd.GetInt ( "cost_model_calibrate", 0 )!=0 && !bLoaded )
+		{
+			int64_t tmStart = sphMicroTimer();
+			SetCostCoeffs ( CalibrateCostCoeffs() );
+			sphInfo ( "cost model calibrated in %.3f sec", float ( sphMicroTimer()-tmStart )/1000000.0f );
+			if ( !g_sCostModelFile.IsEmpty() && !SaveCostCoeffs ( g_sCostModelFile, sError ) )
+				sphWarning ( "failed to save cost model: %s", sError.cstr() );
+		}
+	}
+
 	PrereadIndexes ( bForcedPreread );
 
 	// almost ready, time to start listening
@@ -1375,6 +1375,7 @@ enum ESphHttpStatus
 	SPH_HTTP_STATUS_405,
 	SPH_HTTP_STATUS_409,
 	SPH_HTTP_STATUS_413,
+	SPH_HTTP_STATUS_415,
 	SPH_HTTP_STATUS_500,
 	SPH_HTTP_STATUS_501,
 	SPH_HTTP_STATUS_503,
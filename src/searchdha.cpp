@@ -99,6 +99,53 @@ int64_t HostDashboard_t::EngageTime () const NO_THREAD_SAFETY_ANALYSIS
 	return m_iLastAnswerTime + g_iPingIntervalUs;
 }
 
+// EWMA weight of the new sample is 1/2^LATENCY_EWMA_SHIFT (as TCP smoothed RTT does)
+static const int LATENCY_EWMA_SHIFT = 3;
+
+// latency which is not refreshed by the queries decays by half every such period (but not below the floor),
+// so that once slow (and therefore avoided) mirror is probed again sooner or later
+static const int64_t LATENCY_HALFLIFE_US = 1000000;
+
+// latency floor when none of the compared mirrors has been measured yet
+static const int64_t LATENCY_DEFAULT_FLOOR_US = 1000;
+
+void HostDashboard_t::UpdateLatency ( int64_t iSampleUS, bool bFailed )
+{
+	int64_t iOld = m_iLatencyUS.load ( std::memory_order_relaxed );
+
+	// failure has no meaningful latency; punish the host as if it became twice slower
+	if ( bFailed )
+		iSampleUS = Max ( iSampleUS, iOld*2 );
+
+	iSampleUS = Max ( iSampleUS, (int64_t)1 );
+	int64_t iNew = iOld ? iOld + ( ( iSampleUS-iOld ) >> LATENCY_EWMA_SHIFT ) : iSampleUS;
+	m_iLatencyUS.store ( Max ( iNew, (int64_t)1 ), std::memory_order_relaxed );
+	m_iLatencyStamp.store ( sphMicroTimer(), std::memory_order_relaxed );
+}
+
+// expected cost of sending one more query to the host.
+// Unmeasured (or long unused) host is assumed to be as fast as the floor, not faster; otherwise it would win every choice
+int64_t HostDashboard_t::GetLatencyScore ( int64_t iNow, int64_t iFloorUS ) const
+{
+	int64_t iLatency = m_iLatencyUS.load ( std::memory_order_relaxed );
+	int64_t iAge = iNow - m_iLatencyStamp.load ( std::memory_order_relaxed );
+	if ( iLatency>iFloorUS && iAge>LATENCY_HALFLIFE_US )
+		iLatency >>= Min ( iAge / LATENCY_HALFLIFE_US, (int64_t)62 );
+
+	return Max ( iLatency, iFloorUS ) * ( m_iInFlight.load ( std::memory_order_relaxed )+1 );
+}
+
+// the lowest measured latency of the compared hosts
+int64_t HostDashboard_t::GetLatencyFloor ( const HostDashboard_t & tFirst, const HostDashboard_t & tSecond )
+{
+	int64_t iFirst = tFirst.m_iLatencyUS.load ( std::memory_order_relaxed );
+	int64_t iSecond = tSecond.m_iLatencyUS.load ( std::memory_order_relaxed );
+	if ( !iFirst || !iSecond )
+		return iFirst+iSecond ? iFirst+iSecond : LATENCY_DEFAULT_FLOOR_US;
+
+	return Min ( iFirst, iSecond );
+}
+
 DWORD HostDashboard_t::GetCurSeconds()
 {
 	int64_t iNow = sphMicroTimer()/1000000;
@@ -880,6 +927,51 @@ const AgentDesc_t &MultiAgentDesc_c::StLowErrors ()
 }
 
 
+// power of two choices: take 2 random mirrors, use the one with less latency*outstanding queries.
+// mirrors considered dead (too many errors a row) lose to any alive one.
+const AgentDesc_t &MultiAgentDesc_c::StLowLatency ()
+{
+	if ( !IsHA() )
+		return *m_pData;
+
+	// threshold errors-a-row to be counted as dead
+	const int64_t iDeadThr = 3;
+
+	int iFirst = sphRand () % GetLength ();
+	int iSecond = sphRand () % ( GetLength ()-1 );
+	if ( iSecond>=iFirst )
+		++iSecond;
+
+	auto fnIsDead = [iDeadThr] ( const HostDashboard_t & tDash )
+	{
+		ScRL_t tRguard ( tDash.m_dMetricsLock );
+		return tDash.m_iErrorsARow>iDeadThr;
+	};
+
+	const HostDashboard_t & tFirst = *m_pData[iFirst].m_pDash;
+	const HostDashboard_t & tSecond = *m_pData[iSecond].m_pDash;
+	int iBestAgent;
+	bool bFirstDead = fnIsDead ( tFirst );
+	if ( bFirstDead!=fnIsDead ( tSecond ) )
+		iBestAgent = bFirstDead ? iSecond : iFirst;
+	else
+	{
+		int64_t iNow = sphMicroTimer ();
+		int64_t iFloor = HostDashboard_t::GetLatencyFloor ( tFirst, tSecond );
+		int64_t iFirstScore = tFirst.GetLatencyScore ( iNow, iFloor );
+		int64_t iSecondScore = tSecond.GetLatencyScore ( iNow, iFloor );
+		iBestAgent = iSecondScore<iFirstScore ? iSecond : iFirst;
+	}
+
+	sphLogDebugv ( "client=%s, HA selected %d node by latency (" INT64_FMT " uS, %d in flight)"
+				   , m_pData[iBestAgent].GetMyUrl ().cstr (), iBestAgent
+				   , m_pData[iBestAgent].m_pDash->m_iLatencyUS.load ( std::memory_order_relaxed )
+				   , m_pData[iBestAgent].m_pDash->m_iInFlight.load ( std::memory_order_relaxed ) );
+
+	return m_pData[iBestAgent];
+}
+
+
 const AgentDesc_t &MultiAgentDesc_c::ChooseAgent ()
 {
 	if ( !IsHA() )
@@ -900,6 +992,8 @@ const AgentDesc_t &MultiAgentDesc_c::ChooseAgent ()
 		return StLowErrors();
 	case HA_ROUNDROBIN:
 		return RRAgent();
+	case HA_LATENCY:
+		return StLowLatency();
 	default:
 		return RandAgent();
 	}
@@ -982,6 +1076,8 @@ static void agent_stats_inc ( AgentConn_t &tAgent, AgentStats_e iCountID )
 	{
 		tAgentMetrics.m_dMetrics[ehTotalMsecs] += tAgent.m_iEndQuery - tAgent.m_iStartQuery;
 		tAgent.m_tDesc.m_pMetrics->m_dMetrics[ehTotalMsecs] += tAgent.m_iEndQuery - tAgent.m_iStartQuery;
+		if ( tAgent.m_iStartQuery )
+			tIndexDash.UpdateLatency ( tAgent.m_iEndQuery - tAgent.m_iStartQuery, iCountID<eNetworkCritical );
 	}
 }
 
@@ -1098,6 +1194,8 @@ bool ParseStrategyHA ( const char * sName, HAStrategies_e & eStrategy )
 		eStrategy = HA_AVOIDDEAD;
 	else if ( sphStrMatchStatic ( "noerrors", sName ) )
 		eStrategy = HA_AVOIDERRORS;
+	else if ( sphStrMatchStatic ( "latency", sName ) )
+		eStrategy = HA_LATENCY;
 	else
 		return false;
 
@@ -1112,6 +1210,7 @@ CSphString HAStrategyToStr ( HAStrategies_e eStrategy )
 	case HA_ROUNDROBIN:		return "roundrobin";
 	case HA_AVOIDDEAD:		return "nodeads";
 	case HA_AVOIDERRORS:	return "noerrors";
+	case HA_LATENCY:		return "latency";
 	}
 
 	return "";
@@ -1524,6 +1623,7 @@ AgentConn_t::~AgentConn_t ()
 	sphLogDebugv ( "AgentConn %p destroyed", this );
 	if ( m_iSock>=0 )
 		Finish ();
+	TrackInFlight ( false );
 }
 
 void AgentConn_t::State ( Agent_e eState )
@@ -1593,10 +1693,26 @@ void AgentConn_t::Finish ( bool bFail )
 	m_pPollerTask = nullptr;
 
 	ReturnPersist ();
+	TrackInFlight ( false );
 	if ( m_iStartQuery )
 		m_iWall += sphMicroTimer () - m_iStartQuery; // imitated old behaviour
 }
 
+void AgentConn_t::TrackInFlight ( bool bStart )
+{
+	if ( m_pInFlightDash )
+	{
+		m_pInFlightDash->m_iInFlight.fetch_sub ( 1, std::memory_order_relaxed );
+		m_pInFlightDash = nullptr;
+	}
+
+	if ( bStart && m_tDesc.m_pDash && !IsBlackhole () )
+	{
+		m_pInFlightDash = m_tDesc.m_pDash;
+		m_pInFlightDash->m_iInFlight.fetch_add ( 1, std::memory_order_relaxed );
+	}
+}
+
 //! Failure from successfully ended session
 //! (i.e. no network issues, but error in packet itself - like bad syntax, or simple 'try again').
 //! so, we don't have to corrupt agent's stat in the case.
@@ -1653,6 +1769,7 @@ bool AgentConn_t::StartNextRetry ()
 		return m_bManyTries ? Fail ( "retries limit exceeded" ) : false;
 
 	sphLogDebugA ( "%d Connection %p, host %s, pers=%d", m_iStoreTag, this, m_tDesc.GetMyUrl().cstr(), m_tDesc.m_bPersistent );
+	TrackInFlight ( true );
 
 	if ( IsPersistent() )
 	{
@@ -105,6 +105,7 @@ enum HAStrategies_e
 	HA_ROUNDROBIN,
 	HA_AVOIDDEAD,
 	HA_AVOIDERRORS,
+	HA_LATENCY,
 
 	HA_DEFAULT = HA_RANDOM
 };
@@ -236,9 +237,17 @@ struct HostDashboard_t : public ISphRefcountedMT
 	int64_t m_iErrorsARow GUARDED_BY ( m_dMetricsLock ) = 0;        // num of errors a row, updated when we update the general statistic.
 	DWORD m_uPingTripUS = 0;		// round-trip in uS. We send ping with current time, on receive answer compare with current time and fix that difference
 
+	// lock-free latency tracking for HA_LATENCY (races are benign, it is just a hint)
+	std::atomic<int> m_iInFlight { 0 };			// queries sent to the host and not yet finished
+	std::atomic<int64_t> m_iLatencyUS { 0 };	// EWMA of query latency, uS; 0 if no data yet
+	std::atomic<int64_t> m_iLatencyStamp { 0 };	// when m_iLatencyUS was updated last time
+
 public:
 	explicit HostDashboard_t ( const HostDesc_t &tAgent );
 	int64_t EngageTime () const;
+	void UpdateLatency ( int64_t iSampleUS, bool bFailed );
+	int64_t GetLatencyScore ( int64_t iNow, int64_t iFloorUS ) const;
+	static int64_t GetLatencyFloor ( const HostDashboard_t & tFirst, const HostDashboard_t & tSecond );
 	MetricsAndCounters_t &GetCurrentMetrics () REQUIRES ( m_dMetricsLock );
 	void GetCollectedMetrics ( HostMetricsSnapshot_t &dResult, int iPeriods = 1 ) const REQUIRES ( !m_dMetricsLock );
 
@@ -384,6 +393,7 @@ private:
 	const AgentDesc_t &RandAgent ();
 	const AgentDesc_t &StDiscardDead () REQUIRES ( !m_dWeightLock );
 	const AgentDesc_t &StLowErrors () REQUIRES ( !m_dWeightLock );
+	const AgentDesc_t &StLowLatency ();
 
 	void ChooseWeightedRandAgent ( int * pBestAgent, CSphVector<int> &dCandidates ) REQUIRES ( !m_dWeightLock );
 	void CheckRecalculateWeights ( const CSphFixedVector<int64_t> &dTimers ) REQUIRES ( !m_dWeightLock );
@@ -575,6 +585,7 @@ private:
 
 	// active timeout (directly used by poller)
 	int64_t			m_iPoolerTimeoutUS = -1;	///< m.b. query, or connect+query when TCP_FASTOPEN
+	HostDashboardRefPtr_t m_pInFlightDash;		///< host whose in-flight counter accounts this connection
 	ETimeoutKind 	m_eTimeoutKind { TIMEOUT_UNKNOWN };
 
 	// receiving buffer stuff
@@ -611,6 +622,7 @@ private:
 	bool Fail ( const char * sFmt, ... ) __attribute__ ( ( format ( printf, 2, 3 ) ) );
 	bool Fatal ( AgentStats_e eStat, const char * sMessage, ... ) __attribute__ ( ( format ( printf, 3, 4 ) ) );
 	void Finish ( bool bFailed = false ); /// finish the task, stat time.
+	void TrackInFlight ( bool bStart ); /// release in-flight slot of the previous host, and take one of the current (if bStart)
 	bool BadResult ( int iError = 0 );	/// always return false
 	void ReportFinish ( bool bSuccess = true );
 	void SendingState (); ///< from CONNECTING state go to HEALTHY and switch timer to QUERY timeout.
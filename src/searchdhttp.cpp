@@ -32,7 +32,7 @@ static bool LOG_LEVEL_HTTP = val_from_env ( "MANTICORE_LOG_HTTP", false ); // ve
 #define LOG_COMPONENT_HTTP ""
 #define HTTPINFO LOGMSG ( VERBOSE_DEBUG, HTTP, HTTP )
 
-static const char * g_dHttpStatus[] = { "100 Continue", "200 OK", "206 Partial Content", "400 Bad Request", "403 Forbidden", "404 Not Found", "405 Method Not Allowed", "409 Conflict", "413 Request Entity Too Large", "500 Internal Server Error", "501 Not Implemented", "503 Service Unavailable", "526 Invalid SSL Certificate" };
+static const char * g_dHttpStatus[] = { "100 Continue", "200 OK", "206 Partial Content", "400 Bad Request", "403 Forbidden", "404 Not Found", "405 Method Not Allowed", "409 Conflict", "413 Request Entity Too Large", "415 Unsupported Media Type", "500 Internal Server Error", "501 Not Implemented", "503 Service Unavailable", "526 Invalid SSL Certificate" };
 
 STATIC_ASSERT ( sizeof(g_dHttpStatus)/sizeof(g_dHttpStatus[0])==SPH_HTTP_STATUS_TOTAL, SPH_HTTP_STATUS_SHOULD_BE_SAME_AS_SPH_HTTP_STATUS_TOTAL );
 
@@ -55,6 +55,7 @@ int HttpGetStatusCodes ( ESphHttpStatus eStatus )
 	case SPH_HTTP_STATUS_405: return 405;
 	case SPH_HTTP_STATUS_409: return 409;
 	case SPH_HTTP_STATUS_413: return 413;
+	case SPH_HTTP_STATUS_415: return 415;
 	case SPH_HTTP_STATUS_500: return 500;
 	case SPH_HTTP_STATUS_501: return 501;
 	case SPH_HTTP_STATUS_503: return 503;
@@ -167,6 +168,11 @@ public:
 		, m_sData { FromStr ( sData ) }
 	{}
 
+	BlobStream_c ( Str_t sData )
+		: CharStream_c ( nullptr )
+		, m_sData { sData }
+	{}
+
 	Str_t Read() final
 	{
 		if ( m_bDone )
@@ -442,6 +448,8 @@ void HttpRequestParser_c::Reinit()
 	m_sCurField.Clear();
 	m_sCurValue.Clear();
 	m_hOptions.Reset();
+	m_sContentEncoding = "";
+	m_sAcceptEncoding = "";
 	m_eType = HTTP_GET;
 	m_sUrl.Clear();
 	m_bHeaderDone = false;
@@ -490,6 +498,12 @@ bool HttpRequestParser_c::KeepAlive() const
 	return m_bKeepAlive;
 }
 
+// chunked transfer encoding is HTTP/1.1 only
+bool HttpRequestParser_c::CanChunkReply() const
+{
+	return m_tParser.http_major>1 || ( m_tParser.http_major==1 && m_tParser.http_minor>=1 );
+}
+
 const char* HttpRequestParser_c::Error() const
 {
 	return m_szError;
@@ -697,6 +711,10 @@ inline void HttpRequestParser_c::FinishParserKeyVal()
 
 	CSphString sField = (CSphString)m_sCurField;
 	sField.ToLower();
+	if ( sField=="content-encoding" )
+		m_sContentEncoding = (CSphString)m_sCurValue;
+	else if ( sField=="accept-encoding" )
+		m_sAcceptEncoding = (CSphString)m_sCurValue;
 	m_hOptions.Add ( (CSphString)m_sCurValue, sField );
 	m_sCurField.Clear();
 	m_sCurValue.Clear();
@@ -955,6 +973,12 @@ void HttpHandler_c::SetErrorFormat ( bool bNeedHttpResponse )
 {
 	m_bNeedHttpResponse = bNeedHttpResponse;
 }
+
+void HttpHandler_c::SetStreamOutput ( GenericOutputBuffer_c * pOut, HttpEncoding_e eEncoding )
+{
+	m_pStreamOut = pOut;
+	m_eStreamEncoding = eEncoding;
+}
 	
 CSphVector<BYTE> & HttpHandler_c::GetResult()
 {
@@ -1021,6 +1045,91 @@ void HttpHandler_c::BuildReply ( Str_t sResult, ESphHttpStatus eStatus )
 	ReplyBuf ( sResult, eStatus, m_bNeedHttpResponse, m_dData );
 }
 
+// streamed reply is sent in chunks of (at least) that size
+static const int HTTP_STREAM_CHUNK = 65536;
+
+static void HttpBuildChunkedReplyHeader ( ISphOutputBuffer & tOut, ESphHttpStatus eCode, HttpEncoding_e eEncoding )
+{
+	StringBuilder_c sHttp;
+	sHttp.Sprintf ( "HTTP/1.1 %s\r\nServer: %s\r\nContent-Type: application/json; charset=UTF-8\r\nTransfer-Encoding: chunked\r\n", g_dHttpStatus[eCode], g_sStatusVersion.cstr() );
+	if ( eEncoding!=HttpEncoding_e::NONE )
+		sHttp.Sprintf ( "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n", HttpEncodingName ( eEncoding ) );
+	sHttp << "\r\n";
+	tOut.SendBytes ( sHttp );
+}
+
+static void HttpSendChunk ( ISphOutputBuffer & tOut, ByteBlob_t tChunk )
+{
+	if ( IsEmpty ( tChunk ) )
+		return;
+
+	char sLen[16];
+	int iLen = snprintf ( sLen, sizeof ( sLen ), "%x\r\n", tChunk.second );
+	tOut.SendBytes ( sLen, iLen );
+	tOut.SendBytes ( tChunk );
+	tOut.SendBytes ( "\r\n", 2 );
+}
+
+// encoder flushes on every call, so every chunk is decodable as soon as it arrives
+bool HttpHandler_c::StreamSend ( StringBuilder_c & sResult, bool bFinish )
+{
+	if ( !m_pStreamEncoder )
+	{
+		HttpSendChunk ( *m_pStreamOut, (ByteBlob_t)sResult );
+		return true;
+	}
+
+	m_dStreamEncoded.Resize ( 0 );
+	if ( !m_pStreamEncoder->Encode ( (ByteBlob_t)sResult, bFinish, m_dStreamEncoded ) )
+		return false;
+
+	HttpSendChunk ( *m_pStreamOut, m_dStreamEncoded );
+	return true;
+}
+
+// sends accumulated data out as a chunk (and the reply header before the very first one) once there is enough of it
+void HttpHandler_c::StreamChunk ( StringBuilder_c & sResult )
+{
+	if ( !m_pStreamOut || sResult.GetLength()<HTTP_STREAM_CHUNK )
+		return;
+
+	if ( !m_bStreamFailed )
+	{
+		if ( !m_bStreamed )
+		{
+			if ( m_eStreamEncoding!=HttpEncoding_e::NONE )
+				m_pStreamEncoder = CreateHttpEncoder ( m_eStreamEncoding );
+			HttpBuildChunkedReplyHeader ( *m_pStreamOut, SPH_HTTP_STATUS_200, m_pStreamEncoder ? m_eStreamEncoding : HttpEncoding_e::NONE );
+		}
+
+		m_bStreamed = true;
+		m_bStreamFailed = !StreamSend ( sResult, false ) || !m_pStreamOut->Flush();
+	}
+
+	// the client is gone, but the reply still has to be walked through to the end; keep memory low
+	sResult.Rewind();
+}
+
+// sends the rest of the reply and terminating chunk; reply that was never streamed goes out as a regular one
+bool HttpHandler_c::StreamFinish ( StringBuilder_c & sResult )
+{
+	if ( !m_bStreamed )
+	{
+		BuildReply ( sResult, SPH_HTTP_STATUS_200 );
+		return true;
+	}
+
+	if ( !m_bStreamFailed && StreamSend ( sResult, true ) )
+	{
+		m_pStreamOut->SendBytes ( "0\r\n\r\n", 5 );
+		m_bStreamFailed = !m_pStreamOut->Flush();
+	} else
+		m_bStreamFailed = true;
+
+	sResult.Rewind();
+	return !m_bStreamFailed;
+}
+
 // check whether given served index is exist and has requested type
 bool HttpHandler_c::CheckValid ( const ServedIndex_c* pServed, const CSphString& sIndex, IndexType_e eType )
 {
@@ -1189,10 +1298,13 @@ public:
 		ARRAY_FOREACH ( i, m_tQuery.m_dAggs )
 			dAggsRes[i+1] = tHandler->GetResult ( i+1 );
 
-		CSphString sResult = EncodeResult ( dAggsRes, m_bProfile ? &tProfile : nullptr );
-		BuildReply ( sResult, SPH_HTTP_STATUS_200 );
+		JsonEscapedBuilder tResult;
+		JsonFlush_fn fnFlush;
+		if ( m_pStreamOut )
+			fnFlush = [this] ( JsonEscapedBuilder & tOut ) { StreamChunk ( tOut ); };
 
-		return true;
+		EncodeResult ( dAggsRes, m_bProfile ? &tProfile : nullptr, tResult, fnFlush );
+		return StreamFinish ( tResult );
 	}
 
 protected:
@@ -1202,7 +1314,7 @@ protected:
 	CSphString				m_sWarning;
 
 	virtual std::unique_ptr<QueryParser_i> PreParseQuery() = 0;
-	virtual CSphString		EncodeResult ( const VecTraits_T<AggrResult_t *> & dRes, QueryProfile_c * pProfile ) = 0;
+	virtual void			EncodeResult ( const VecTraits_T<AggrResult_t *> & dRes, QueryProfile_c * pProfile, JsonEscapedBuilder & tOut, const JsonFlush_fn & fnFlush ) = 0;
 	virtual void			SetStmt ( PubSearchHandler_c & tHandler ) {};
 };
 
@@ -1275,9 +1387,9 @@ protected:
 		return sphCreatePlainQueryParser();
 	}
 
-	CSphString EncodeResult ( const VecTraits_T<AggrResult_t *> & dRes, QueryProfile_c * pProfile ) final
+	void EncodeResult ( const VecTraits_T<AggrResult_t *> & dRes, QueryProfile_c * pProfile, JsonEscapedBuilder & tOut, const JsonFlush_fn & fnFlush ) final
 	{
-		return sphEncodeResultJson ( dRes, m_tQuery, pProfile, false );
+		sphEncodeResultJson ( dRes, m_tQuery, pProfile, false, tOut, fnFlush );
 	}
 
 	void SetStmt ( PubSearchHandler_c & tHandler ) final
@@ -1405,6 +1517,8 @@ public:
 	bool Commit() override
 	{
 		m_dBuf.FinishBlock ( false ); // finish previous item
+		if ( m_fnFlush )
+			m_fnFlush ( m_dBuf );
 		m_dBuf.ObjectBlock(); // start new item
 		++m_iTotalRows;
 		m_iCol = 0;
@@ -1413,16 +1527,21 @@ public:
 
 	void Eof ( bool bMoreResults, int iWarns, const char* ) override
 	{
-		m_dBuf.FinishBlock ( true ); // last doc, allow empty
-		m_dBuf.FinishBlock ( false ); // docs section
-		DataFinish ( m_iTotalRows, nullptr, nullptr );
-		m_dBuf.FinishBlock ( false ); // root object
+		FinishData ( nullptr );
 	}
 
 	void Error ( const char *, const char * szError, MysqlErrors_e iErr ) override
 	{
-		auto _ = m_dBuf.Object ( false );
-		DataFinish ( 0, szError, nullptr );
+		// rows of the current result set might already be streamed out with status 200;
+		// close that result set with the error, so the client sees it before the terminating chunk
+		if ( m_bInData )
+			FinishData ( szError );
+		else
+		{
+			auto _ = m_dBuf.Object ( false );
+			DataFinish ( 0, szError, nullptr );
+		}
+
 		m_bError = true;
 		m_sError = szError;
 	}
@@ -1449,6 +1568,7 @@ public:
 		m_dBuf.Named ( "data" );
 		m_dBuf.ArrayWBlock();
 		m_dBuf.ObjectBlock();
+		m_bInData = true;
 		return true;
 	}
 
@@ -1467,18 +1587,35 @@ public:
 
 	void Add ( BYTE ) override {}
 
-	const JsonEscapedBuilder & Finish()
+	JsonEscapedBuilder & Finish()
 	{
 		m_dBuf.FinishBlocks();
 		return m_dBuf;
 	}
 
+	// called after every row; streamed reply sends rows out from here
+	void SetFlush ( JsonFlush_fn fnFlush )
+	{
+		m_fnFlush = std::move ( fnFlush );
+	}
+
 private:
 	JsonEscapedBuilder m_dBuf;
+	JsonFlush_fn m_fnFlush;
 	CSphVector<ColumnNameType_t> m_dColumns;
 	int m_iExpectedColumns = 0;
 	int m_iTotalRows = 0;
 	int m_iCol = 0;
+	bool m_bInData = false;
+
+	void FinishData ( const char * szError )
+	{
+		m_dBuf.FinishBlock ( true ); // last doc, allow empty
+		m_dBuf.FinishBlock ( false ); // docs section
+		DataFinish ( m_iTotalRows, szError, nullptr );
+		m_dBuf.FinishBlock ( false ); // root object
+		m_bInData = false;
+	}
 
 	void AddDataColumn()
 	{
@@ -1604,14 +1741,19 @@ public:
 		}
 
 		JsonRowBuffer_c tOut;
+		if ( m_pStreamOut )
+			tOut.SetFlush ( [this] ( JsonEscapedBuilder & tBuf ) { StreamChunk ( tBuf ); } );
+
 		session::Execute ( m_sQuery, tOut );
-		if ( tOut.IsError() )
+
+		// once the rows are streamed, the status is already sent; error goes to the reply itself then
+		if ( tOut.IsError() && !m_bStreamed )
 		{
 			ReportError ( tOut.GetError().scstr(), SPH_HTTP_STATUS_500 );
 			return false;
 		}
-		BuildReply ( tOut.Finish(), SPH_HTTP_STATUS_200 );
-		return true;
+		m_sError = tOut.GetError();
+		return StreamFinish ( tOut.Finish() ) && !tOut.IsError();
 	}
 };
 
@@ -1641,9 +1783,9 @@ public:
 	}
 
 protected:
-	CSphString EncodeResult ( const VecTraits_T<AggrResult_t *> & dRes, QueryProfile_c * pProfile ) override
+	void EncodeResult ( const VecTraits_T<AggrResult_t *> & dRes, QueryProfile_c * pProfile, JsonEscapedBuilder & tOut, const JsonFlush_fn & fnFlush ) override
 	{
-		return sphEncodeResultJson ( dRes, m_tQuery, pProfile, false );
+		sphEncodeResultJson ( dRes, m_tQuery, pProfile, false, tOut, fnFlush );
 	}
 };
 
@@ -2299,7 +2441,63 @@ static std::unique_ptr<HttpHandler_c> CreateHttpHandler ( ESphHttpEndpoint eEndp
 	return nullptr;
 }
 
-HttpProcessResult_t ProcessHttpQuery ( CharStream_c & tSource, Str_t & sSrcQuery, OptionsHash_t & hOptions, CSphVector<BYTE> & dResult, bool bNeedHttpResponse, http_method eRequestType )
+// replies shorter than that are not worth compressing
+static const int HTTP_ENCODE_MIN_BODY = 1024;
+
+// compresses body of already built reply, replacing its Content-Length header
+static void HttpEncodeReply ( CSphVector<BYTE> & dReply, HttpEncoding_e eEncoding )
+{
+	if ( eEncoding==HttpEncoding_e::NONE || dReply.GetLength()<HTTP_ENCODE_MIN_BODY )
+		return;
+
+	const char sHeaderEnd[] = "\r\n\r\n";
+	auto pHeaderEnd = std::search ( dReply.begin(), dReply.end(), sHeaderEnd, sHeaderEnd+4 );
+	if ( pHeaderEnd==dReply.end() )
+		return;
+
+	int iHeaderLen = int ( pHeaderEnd-dReply.begin() );
+	ByteBlob_t tBody { dReply.begin()+iHeaderLen+4, dReply.GetLength()-iHeaderLen-4 };
+	if ( tBody.second<HTTP_ENCODE_MIN_BODY )
+		return;
+
+	StringBuilder_c sHeader;
+	bool bHasLength = false;
+	bool bEncoded = false;
+	sph::Split ( (const char *)dReply.begin(), iHeaderLen, "\r\n", [&] ( const char * sLine, int iLen ) {
+		Str_t tLine { sLine, iLen };
+		if ( IsEmpty ( tLine ) )
+			return;
+
+		if ( iLen>=15 && !strncasecmp ( sLine, "Content-Length:", 15 ) )
+			bHasLength = true;
+		else
+		{
+			bEncoded |= ( iLen>=17 && !strncasecmp ( sLine, "Content-Encoding:", 17 ) );
+			sHeader << tLine << "\r\n";
+		}
+	});
+
+	if ( !bHasLength || bEncoded )
+		return;
+
+	auto pEncoder = CreateHttpEncoder ( eEncoding );
+	CSphVector<BYTE> dBody;
+	if ( !pEncoder || !pEncoder->Encode ( tBody, true, dBody ) )
+		return;
+
+	sHeader.Sprintf ( "Content-Encoding: %s\r\nVary: Accept-Encoding\r\nContent-Length: %d\r\n\r\n", HttpEncodingName ( eEncoding ), dBody.GetLength() );
+	dReply.Resize ( 0 );
+	dReply.Append ( (Str_t)sHeader );
+	dReply.Append ( dBody );
+}
+
+static bool IsStreamRequested ( const OptionsHash_t & hOptions )
+{
+	const CSphString * pStream = hOptions ( "stream" );
+	return pStream && ( *pStream=="1" || *pStream=="true" );
+}
+
+HttpProcessResult_t ProcessHttpQuery ( CharStream_c & tSource, Str_t & sSrcQuery, OptionsHash_t & hOptions, CSphVector<BYTE> & dResult, bool bNeedHttpResponse, http_method eRequestType, GenericOutputBuffer_c * pStreamOut, HttpEncoding_e eStreamEncoding )
 {
 	TRACE_CONN ( "conn", "ProcessHttpQuery" );
 
@@ -2336,7 +2534,11 @@ HttpProcessResult_t ProcessHttpQuery ( CharStream_c & tSource, Str_t & sSrcQuery
 		return tRes;
 
 	pHandler->SetErrorFormat ( bNeedHttpResponse );
+	if ( bNeedHttpResponse && pStreamOut && IsStreamRequested ( hOptions ) )
+		pHandler->SetStreamOutput ( pStreamOut, eStreamEncoding );
+
 	tRes.m_bOk = pHandler->Process();
+	tRes.m_bStreamed = pHandler->IsStreamed();
 	tRes.m_sError = pHandler->GetError();
 	dResult = std::move ( pHandler->GetResult() );
 
@@ -2354,7 +2556,7 @@ void sphProcessHttpQueryNoResponce ( const CSphString & sEndpoint, const CSphStr
 	ProcessHttpQueryBuddy ( tRes, sSrcQuery, hOptions, dResult, false );
 }
 
-bool HttpRequestParser_c::ProcessClientHttp ( AsyncNetInputBuffer_c& tIn, CSphVector<BYTE>& dResult )
+bool HttpRequestParser_c::ProcessClientHttp ( AsyncNetInputBuffer_c& tIn, CSphVector<BYTE>& dResult, GenericOutputBuffer_c * pStreamOut )
 {
 	assert ( !m_szError );
 	std::unique_ptr<CharStream_c> pSource;
@@ -2375,8 +2577,48 @@ bool HttpRequestParser_c::ProcessClientHttp ( AsyncNetInputBuffer_c& tIn, CSphVe
 		eEndpoint = SPH_HTTP_ENDPOINT_ES_BULK;
 
 	Str_t sSrcQuery;
-	HttpProcessResult_t tRes = ProcessHttpQuery ( *pSource, sSrcQuery, m_hOptions, dResult, true, m_eType );
-	return ProcessHttpQueryBuddy ( tRes, sSrcQuery, m_hOptions, dResult, true );
+	// compressed body is decoded as a whole, then handlers read it as usual
+	CSphVector<BYTE> dDecoded;
+	std::unique_ptr<CharStream_c> pDecoded;
+	if ( !m_sContentEncoding.IsEmpty() )
+	{
+		HttpEncoding_e eEncoding;
+		CSphString sError;
+		if ( !HttpContentEncoding ( m_sContentEncoding, eEncoding, sError ) )
+		{
+			sphHttpErrorReply ( dResult, SPH_HTTP_STATUS_415, sError.cstr() );
+			return false;
+		}
+
+		if ( eEncoding!=HttpEncoding_e::NONE )
+		{
+			Str_t sBody = pSource->ReadAll();
+			if ( pSource->GetError() )
+			{
+				sphHttpErrorReply ( dResult, SPH_HTTP_STATUS_400, pSource->GetErrorMessage().cstr() );
+				return false;
+			}
+
+			if ( !HttpDecode ( eEncoding, S2B ( sBody ), g_iMaxPacketSize, dDecoded, sError ) )
+			{
+				sphHttpErrorReply ( dResult, sError.Begins ( "decoded body length out of bounds" ) ? SPH_HTTP_STATUS_413 : SPH_HTTP_STATUS_400, sError.cstr() );
+				return false;
+			}
+
+			pDecoded = std::make_unique<BlobStream_c> ( Str_t { (const char *)dDecoded.Begin(), dDecoded.GetLength() } );
+		}
+	}
+
+	if ( !CanChunkReply() )
+		pStreamOut = nullptr;
+
+	HttpEncoding_e eAccepted = HttpAcceptedEncoding ( m_sAcceptEncoding );
+	HttpProcessResult_t tRes = ProcessHttpQuery ( pDecoded ? *pDecoded : *pSource, sSrcQuery, m_hOptions, dResult, true, m_eType, pStreamOut, eAccepted );
+	bool bOk = ProcessHttpQueryBuddy ( tRes, sSrcQuery, m_hOptions, dResult, true );
+	if ( !tRes.m_bStreamed )
+		HttpEncodeReply ( dResult, eAccepted );
+
+	return bOk;
 }
 
 void sphHttpErrorReply ( CSphVector<BYTE> & dData, ESphHttpStatus eCode, const char * szError )
@@ -15,6 +15,7 @@
 #include "sphinxstd.h"
 #include "searchdaemon.h"
 #include "http/http_parser.h"
+#include "compressed_http.h"
 
 using OptionsHash_t = SmallStringHash_T<CSphString>;
 class AsyncNetInputBuffer_c;
@@ -25,11 +26,12 @@ public:
 	HttpRequestParser_c();
 	void Reinit();
 	bool ParseHeader ( ByteBlob_t tData );
-	bool ProcessClientHttp ( AsyncNetInputBuffer_c& tIn, CSphVector<BYTE>& dResult );
+	bool ProcessClientHttp ( AsyncNetInputBuffer_c& tIn, CSphVector<BYTE>& dResult, GenericOutputBuffer_c * pStreamOut = nullptr );
 
 	int ParsedBodyLength() const;
 	bool Expect100() const;
 	bool KeepAlive() const;
+	bool CanChunkReply() const;
 	const char* Error() const;
 
 	static void ParseList ( Str_t sData, OptionsHash_t & hOptions );
@@ -67,6 +69,8 @@ private:
 	StringBuilder_c m_sCurField;
 	StringBuilder_c m_sCurValue;
 	OptionsHash_t m_hOptions;
+	CSphString m_sContentEncoding;	///< taken from headers only; url params are merged into m_hOptions and can't override them
+	CSphString m_sAcceptEncoding;
 
 	http_method m_eType = HTTP_GET;
 	bool m_bHeaderDone = false;
@@ -113,11 +117,12 @@ struct HttpProcessResult_t
 {
 	ESphHttpEndpoint m_eEndpoint { SPH_HTTP_ENDPOINT_TOTAL };
 	bool m_bOk { false };
+	bool m_bStreamed { false };	///< reply was already sent with chunked encoding, nothing left in the result
 	CSphString m_sError;
 };
 
 void ReplyBuf ( Str_t sResult, ESphHttpStatus eStatus, bool bNeedHttpResponse, CSphVector<BYTE> & dData );
-HttpProcessResult_t ProcessHttpQuery ( CharStream_c & tSource, Str_t & sSrcQuery, OptionsHash_t & hOptions, CSphVector<BYTE> & dResult, bool bNeedHttpResponse, http_method eRequestType );
+HttpProcessResult_t ProcessHttpQuery ( CharStream_c & tSource, Str_t & sSrcQuery, OptionsHash_t & hOptions, CSphVector<BYTE> & dResult, bool bNeedHttpResponse, http_method eRequestType, GenericOutputBuffer_c * pStreamOut = nullptr, HttpEncoding_e eStreamEncoding = HttpEncoding_e::NONE );
 
 namespace bson {
 class Bson_c;
@@ -138,13 +143,21 @@ public:
 	virtual ~HttpHandler_c() = default;
 	virtual bool Process () = 0;
 	void SetErrorFormat ( bool bNeedHttpResponse );
+	void SetStreamOutput ( GenericOutputBuffer_c * pOut, HttpEncoding_e eEncoding );
 	CSphVector<BYTE> & GetResult();
 	const CSphString & GetError () const;
+	bool IsStreamed() const { return m_bStreamed; }
 
 protected:
 	bool				m_bNeedHttpResponse {false};
 	CSphVector<BYTE>	m_dData;
 	CSphString			m_sError;
+	GenericOutputBuffer_c * m_pStreamOut = nullptr;	///< set when client asked for stream=1 and could take chunked reply
+	bool				m_bStreamed = false;
+	bool				m_bStreamFailed = false;
+	HttpEncoding_e		m_eStreamEncoding = HttpEncoding_e::NONE;
+	std::unique_ptr<HttpEncoder_i> m_pStreamEncoder;	///< compresses streamed chunks when client accepts gzip/zstd
+	CSphVector<BYTE>	m_dStreamEncoded;
 
 	void ReportError ( const char * szError, ESphHttpStatus eStatus );
 	void ReportError ( ESphHttpStatus eStatus );
@@ -153,6 +166,9 @@ protected:
 	void BuildReply ( const char* szResult, ESphHttpStatus eStatus );
 	void BuildReply ( Str_t sResult, ESphHttpStatus eStatus );
 	void BuildReply ( const StringBuilder_c & sResult, ESphHttpStatus eStatus );
+	bool StreamSend ( StringBuilder_c & sResult, bool bFinish );
+	void StreamChunk ( StringBuilder_c & sResult );
+	bool StreamFinish ( StringBuilder_c & sResult );
 	bool CheckValid ( const ServedIndex_c* pServed, const CSphString& sIndex, IndexType_e eType );
 };
 
@@ -253,6 +253,8 @@ public:
 	void				SetCollectHits() override { m_bCollectHits = true; }
 	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override { return { float(m_pQword->m_iDocs)*COST_SCALE*60.0f, m_pQword->m_iDocs, 1 }; }
 	void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) override;
+	bool				GetMaxBound ( TermBound_t & tBound ) const override;
+	bool				GetBlockBound ( RowID_t tRowID, TermBound_t & tBound ) const override;
 
 	void				DebugDump ( int iLevel ) override;
 
@@ -276,6 +278,9 @@ protected:
 	RowIdBoundaries_t	m_tBoundaries;
 
 	CSphVector<StoredHit_t> m_dStoredHits;
+
+private:
+	void				FillBound ( const SkipBlockMax_t & tMax, TermBound_t & tBound ) const;
 };
 
 
@@ -851,6 +856,57 @@ private:
 };
 
 
+/// OR over plain terms that supports dynamic pruning (block-max WAND)
+/// returns the same docs as ExtOr_c until the ranker sets a weight threshold; after that it skips docs
+/// (and whole skiplist blocks) whose bm25 upper bound can't reach the threshold
+class ExtWand_c : public ExtNode_c
+{
+public:
+						ExtWand_c ( const CSphVector<ExtNode_i*> & dTerms, const ISphQwordSetup & tSetup );
+						~ExtWand_c() override;
+
+	void				Reset ( const ISphQwordSetup & tSetup ) override;
+	const ExtDoc_t *	GetDocsChunk() override;
+	int					GetQwords ( ExtQwordsHash_t & hQwords ) override;
+	void				SetQwordsIDF ( const ExtQwordsHash_t & hQwords ) override;
+	void				GetTerms ( const ExtQwordsHash_t & hQwords, CSphVector<TermPos_t> & dTermDupes ) const override;
+	uint64_t			GetWordID () const override;
+	bool				GotHitless () override { return false; }
+	void				HintRowID ( RowID_t tRowID ) override;
+	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override;
+	void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) override;
+	void				SetWeightThreshold ( float fThreshold ) override { m_fThreshold = Max ( m_fThreshold, fThreshold ); m_bPruning = true; }
+	void				DebugDump ( int iLevel ) override;
+
+protected:
+	void				CollectHits ( const ExtDoc_t * pDocs ) final { assert ( 0 && "ExtWand_c doesn't collect hits" ); }
+
+private:
+	struct Cursor_t
+	{
+		ExtNode_i *			m_pTerm = nullptr;
+		const ExtDoc_t *	m_pDoc = nullptr;		///< current doc in the current chunk of the term; nullptr when the term is over
+		TermBound_t			m_tMax;					///< bounds over the whole doclist
+
+		RowID_t				GetRowID() const { return m_pDoc ? m_pDoc->m_tRowID : INVALID_ROWID; }
+	};
+
+	CSphVector<Cursor_t>	m_dCursors;
+	CSphVector<Cursor_t *>	m_dOrder;					///< cursors sorted by current rowid; finished ones at the end
+	float					m_dWeights[32];				///< positive field weights (ranker only counts the lowest 32 fields)
+	float					m_fThreshold = -FLT_MAX;
+	bool					m_bPruning = false;
+	bool					m_bWarmup = true;
+	RowID_t					m_tHintRowID = 0;
+
+	void				Warmup();
+	void				Next ( Cursor_t & tCursor );
+	void				Advance ( Cursor_t & tCursor, RowID_t tRowID );
+	void				SortCursors();
+	float				GetRankBound ( DWORD uFields ) const;
+};
+
+
 /// A-B-C-in-this-order streamer
 class ExtOrder_c : public ExtNode_c, public BufferedNode_c
 {
@@ -1299,6 +1355,63 @@ ExtNode_i * ExtNode_i::Create ( const XQKeyword_t & tWord, const ISphQwordSetup
 	return CreateTermNode ( CreateQueryWord ( tWord, tSetup, std::move (pZonesDict) ), tSetup, bUseBM25, bRowidLimits );
 }
 
+
+static bool IsPlainWand ( const XQKeyword_t & tWord, const XQNode_t * pNode )
+{
+	return !tWord.m_bFieldStart && !tWord.m_bFieldEnd && !tWord.m_pPayload && !tWord.m_bExcluded
+		&& !pNode->m_dSpec.m_iFieldMaxPos && pNode->m_dSpec.m_dZones.IsEmpty() && !pNode->m_dSpec.m_bZoneSpan;
+}
+
+
+ExtNode_i * ExtNode_i::CreateWand ( const XQNode_t * pNode, const ISphQwordSetup & tSetup, bool bRowidLimits )
+{
+	if ( !pNode || !tSetup.m_pCtx )
+		return nullptr;
+
+	// AND/OR with a single child evaluate as that child
+	while ( pNode->m_dWords.IsEmpty() && pNode->m_dChildren.GetLength()==1 && ( pNode->GetOp()==SPH_QUERY_AND || pNode->GetOp()==SPH_QUERY_OR ) )
+		pNode = pNode->m_dChildren[0];
+
+	// either OR of single-word nodes, or an OR-like quorum
+	using Word_t = std::pair<const XQKeyword_t *, const XQNode_t *>;
+	CSphVector<Word_t> dWords;
+	if ( pNode->GetOp()==SPH_QUERY_OR && pNode->m_dWords.IsEmpty() )
+	{
+		for ( const XQNode_t * pChild : pNode->m_dChildren )
+		{
+			if ( pChild->m_dWords.GetLength()!=1 || pChild->m_dChildren.GetLength() || pChild->m_bVirtuallyPlain )
+				return nullptr;
+
+			dWords.Add ( { &pChild->m_dWords[0], pChild } );
+		}
+	} else if ( pNode->GetOp()==SPH_QUERY_QUORUM && pNode->m_dChildren.IsEmpty() && ExtQuorum_c::GetThreshold ( *pNode, pNode->m_dWords.GetLength() )==1 )
+	{
+		for ( const XQKeyword_t & tWord : pNode->m_dWords )
+			dWords.Add ( { &tWord, pNode } );
+	}
+
+	if ( dWords.GetLength()<2 || !dWords.all_of ( []( const Word_t & tWord ){ return IsPlainWand ( *tWord.first, tWord.second ); } ) )
+		return nullptr;
+
+	CSphVector<ExtNode_i*> dTerms;
+	bool bBounded = true;
+	for ( const auto & tWord : dWords )
+	{
+		dTerms.Add ( Create ( *tWord.first, tWord.second, tSetup, true, bRowidLimits ) );
+		TermBound_t tBound;
+		bBounded &= dTerms.Last() && dTerms.Last()->GetMaxBound ( tBound );
+	}
+
+	if ( !bBounded )
+	{
+		for ( auto & pTerm : dTerms )
+			SafeDelete ( pTerm );
+		return nullptr;
+	}
+
+	return new ExtWand_c ( dTerms, tSetup );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 ExtNode_c::ExtNode_c()
@@ -2313,6 +2426,50 @@ void ExtTerm_T<USE_BM25,ROWID_LIMITS>::SetRowidBoundaries ( const RowIdBoundarie
 	HintRowID ( tBoundaries.m_tMinRowID );
 }
 
+template<bool USE_BM25, bool ROWID_LIMITS>
+void ExtTerm_T<USE_BM25,ROWID_LIMITS>::FillBound ( const SkipBlockMax_t & tMax, TermBound_t & tBound ) const
+{
+	// same math as in GetDocsChunk(), so that the bound is never below the actual value
+	tBound.m_fTFIDF = m_fIDF>0.0f ? float(tMax.m_uMaxHits) / float(tMax.m_uMaxHits+SPH_BM25_K1) * m_fIDF : 0.0f;
+	tBound.m_uFields = tMax.m_uFields & m_dQueriedFields.GetMask32();
+}
+
+template<bool USE_BM25, bool ROWID_LIMITS>
+bool ExtTerm_T<USE_BM25,ROWID_LIMITS>::GetMaxBound ( TermBound_t & tBound ) const
+{
+	if_const ( !USE_BM25 )
+		return false;
+
+	SkipBlockMax_t tMax;
+	if ( m_pQword->GetTermMax(tMax) )
+		FillBound ( tMax, tBound );
+	else
+	{
+		// no block maxima (short doclist, ram segment, old index); tf part never reaches 1
+		tBound.m_fTFIDF = Max ( m_fIDF, 0.0f );
+		tBound.m_uFields = m_dQueriedFields.GetMask32();
+	}
+
+	tBound.m_tLastRowID = INVALID_ROWID;
+	return true;
+}
+
+template<bool USE_BM25, bool ROWID_LIMITS>
+bool ExtTerm_T<USE_BM25,ROWID_LIMITS>::GetBlockBound ( RowID_t tRowID, TermBound_t & tBound ) const
+{
+	if_const ( !USE_BM25 )
+		return false;
+
+	SkipBlockMax_t tMax;
+	RowID_t tLastRowID;
+	if ( !m_pQword->GetBlockMax ( tRowID, tMax, tLastRowID ) )
+		return GetMaxBound ( tBound );
+
+	FillBound ( tMax, tBound );
+	tBound.m_tLastRowID = tLastRowID;
+	return true;
+}
+
 template<bool USE_BM25, bool ROWID_LIMITS>
 void ExtTerm_T<USE_BM25,ROWID_LIMITS>::DebugDump ( int iLevel )
 {
@@ -4954,6 +5111,282 @@ bool ExtQuorum_c::CollectMatchingHits ( RowID_t tRowID, int iThreshold )
 
 //////////////////////////////////////////////////////////////////////////
 
+ExtWand_c::ExtWand_c ( const CSphVector<ExtNode_i*> & dTerms, const ISphQwordSetup & tSetup )
+{
+	assert ( dTerms.GetLength()>1 );
+	assert ( tSetup.m_pCtx );
+
+	m_iAtomPos = dTerms[0]->GetAtomPos();
+	for ( auto * pTerm : dTerms )
+		m_dCursors.Add().m_pTerm = pTerm;
+
+	// same weights the ranker uses; negative ones can only lower the weight, so bounds ignore them
+	int iWeights = Min ( tSetup.m_pCtx->m_iWeights, 32 );
+	for ( int i=0; i<32; i++ )
+		m_dWeights[i] = i<iWeights ? float ( Max ( tSetup.m_pCtx->m_dWeights[i], 0 ) ) : 0.0f;
+}
+
+ExtWand_c::~ExtWand_c()
+{
+	for ( auto & tCursor : m_dCursors )
+		SafeDelete ( tCursor.m_pTerm );
+}
+
+void ExtWand_c::Reset ( const ISphQwordSetup & tSetup )
+{
+	// threshold comes from the same sorter, so it holds for any chunk
+	for ( auto & tCursor : m_dCursors )
+	{
+		tCursor.m_pTerm->Reset ( tSetup );
+		tCursor.m_pDoc = nullptr;
+	}
+
+	m_dOrder.Resize ( 0 );
+	m_tHintRowID = 0;
+	m_bWarmup = true;
+}
+
+void ExtWand_c::Warmup()
+{
+	m_dOrder.Resize ( 0 );
+	for ( auto & tCursor : m_dCursors )
+	{
+		// idfs are known by now
+		tCursor.m_pDoc = tCursor.m_pTerm->GetDocsChunk();
+		Verify ( tCursor.m_pTerm->GetMaxBound ( tCursor.m_tMax ) );
+		m_dOrder.Add ( &tCursor );
+	}
+
+	m_bWarmup = false;
+}
+
+void ExtWand_c::Next ( Cursor_t & tCursor )
+{
+	assert ( HasDocs ( tCursor.m_pDoc ) );
+	tCursor.m_pDoc++;
+	if ( !HasDocs ( tCursor.m_pDoc ) )
+		tCursor.m_pDoc = tCursor.m_pTerm->GetDocsChunk();
+}
+
+void ExtWand_c::Advance ( Cursor_t & tCursor, RowID_t tRowID )
+{
+	if ( tRowID==INVALID_ROWID )
+	{
+		tCursor.m_pDoc = nullptr;
+		return;
+	}
+
+	const ExtDoc_t * pDoc = tCursor.m_pDoc;
+	while ( pDoc )
+	{
+		while ( HasDocs(pDoc) && pDoc->m_tRowID<tRowID )
+			pDoc++;
+
+		if ( HasDocs(pDoc) )
+			break;
+
+		// chunk is over; let the term skip whole doclist blocks unless the target is right next to the chunk end
+		if ( tRowID > pDoc[-1].m_tRowID+1 )
+			tCursor.m_pTerm->HintRowID ( tRowID );
+
+		pDoc = tCursor.m_pTerm->GetDocsChunk();
+	}
+
+	tCursor.m_pDoc = pDoc;
+}
+
+void ExtWand_c::SortCursors()
+{
+	// insertion sort; the order barely changes between calls
+	for ( int i=1; i<m_dOrder.GetLength(); i++ )
+	{
+		Cursor_t * pCursor = m_dOrder[i];
+		RowID_t tRowID = pCursor->GetRowID();
+		int j = i-1;
+		for ( ; j>=0 && m_dOrder[j]->GetRowID()>tRowID; j-- )
+			m_dOrder[j+1] = m_dOrder[j];
+		m_dOrder[j+1] = pCursor;
+	}
+
+	while ( m_dOrder.GetLength() && m_dOrder.Last()->GetRowID()==INVALID_ROWID )
+		m_dOrder.Pop();
+}
+
+float ExtWand_c::GetRankBound ( DWORD uFields ) const
+{
+	// ranker uses 1 instead of an empty field mask
+	float fRank = 0.0f;
+	for ( int i=0; uFields; i++, uFields >>= 1 )
+		if ( uFields & 1 )
+			fRank += m_dWeights[i];
+
+	return Max ( fRank, 1.0f );
+}
+
+const ExtDoc_t * ExtWand_c::GetDocsChunk()
+{
+	if ( m_bWarmup )
+		Warmup();
+
+	if ( m_tHintRowID )
+		for ( auto * pCursor : m_dOrder )
+			if ( pCursor->GetRowID()<m_tHintRowID )
+				Advance ( *pCursor, m_tHintRowID );
+
+	int iDoc = 0;
+	while ( iDoc<MAX_BLOCK_DOCS-1 )
+	{
+		SortCursors();
+		if ( m_dOrder.IsEmpty() )
+			break;
+
+		int iPivot = 0;
+		if ( m_bPruning )
+		{
+			// pivot is the first term such that docs before it can't reach the threshold
+			float fTFIDF = 0.0f;
+			DWORD uFields = 0;
+			for ( ; iPivot<m_dOrder.GetLength(); iPivot++ )
+			{
+				fTFIDF += m_dOrder[iPivot]->m_tMax.m_fTFIDF;
+				uFields |= m_dOrder[iPivot]->m_tMax.m_uFields;
+				if ( fTFIDF + GetRankBound(uFields)>=m_fThreshold )
+					break;
+			}
+
+			// nothing left can make it
+			if ( iPivot==m_dOrder.GetLength() )
+			{
+				for ( auto * pCursor : m_dOrder )
+					pCursor->m_pDoc = nullptr;
+				m_dOrder.Resize ( 0 );
+				break;
+			}
+
+			// terms at the same rowid as the pivot also count for the block check
+			RowID_t tPivot = m_dOrder[iPivot]->GetRowID();
+			while ( iPivot+1<m_dOrder.GetLength() && m_dOrder[iPivot+1]->GetRowID()==tPivot )
+				iPivot++;
+
+			// check the (tighter) bounds of the blocks that hold the pivot doc
+			float fBlockTFIDF = 0.0f;
+			DWORD uBlockFields = 0;
+			RowID_t tBlocksEnd = INVALID_ROWID;
+			for ( int i=0; i<=iPivot; i++ )
+			{
+				TermBound_t tBound;
+				Verify ( m_dOrder[i]->m_pTerm->GetBlockBound ( tPivot, tBound ) );
+				fBlockTFIDF += tBound.m_fTFIDF;
+				uBlockFields |= tBound.m_uFields;
+				tBlocksEnd = Min ( tBlocksEnd, tBound.m_tLastRowID );
+			}
+
+			if ( fBlockTFIDF + GetRankBound(uBlockFields)<m_fThreshold )
+			{
+				// no doc up to the end of these blocks (or up to the next term) can make it; skip them all
+				RowID_t tNext = tBlocksEnd==INVALID_ROWID ? INVALID_ROWID : tBlocksEnd+1;
+				if ( iPivot+1<m_dOrder.GetLength() )
+					tNext = Min ( tNext, m_dOrder[iPivot+1]->GetRowID() );
+
+				tNext = Max ( tNext, tPivot+1 );
+				for ( int i=0; i<=iPivot; i++ )
+					Advance ( *m_dOrder[i], tNext );
+				continue;
+			}
+
+			// lagging terms go to the pivot doc first
+			if ( m_dOrder[0]->GetRowID()!=tPivot )
+			{
+				for ( int i=0; i<iPivot && m_dOrder[i]->GetRowID()<tPivot; i++ )
+					Advance ( *m_dOrder[i], tPivot );
+				continue;
+			}
+		}
+
+		// all the terms at the current rowid are in front; merge them
+		// (summed in query order like ExtOr_c does, so that weights are the same to the last bit)
+		ExtDoc_t tDoc { m_dOrder[0]->GetRowID(), 0, 0.0f };
+		for ( auto & tCursor : m_dCursors )
+		{
+			if ( tCursor.GetRowID()!=tDoc.m_tRowID )
+				continue;
+
+			tDoc.m_uDocFields |= tCursor.m_pDoc->m_uDocFields;
+			tDoc.m_fTFIDF += tCursor.m_pDoc->m_fTFIDF;
+			Next ( tCursor );
+		}
+
+		if ( !m_bPruning || tDoc.m_fTFIDF + GetRankBound(tDoc.m_uDocFields)>=m_fThreshold )
+			m_dDocs[iDoc++] = tDoc;
+	}
+
+	return ReturnDocsChunk ( iDoc, "wand" );
+}
+
+int ExtWand_c::GetQwords ( ExtQwordsHash_t & hQwords )
+{
+	int iMax = -1;
+	for ( auto & tCursor : m_dCursors )
+		iMax = Max ( iMax, tCursor.m_pTerm->GetQwords ( hQwords ) );
+
+	return iMax;
+}
+
+void ExtWand_c::SetQwordsIDF ( const ExtQwordsHash_t & hQwords )
+{
+	for ( auto & tCursor : m_dCursors )
+		tCursor.m_pTerm->SetQwordsIDF ( hQwords );
+}
+
+void ExtWand_c::GetTerms ( const ExtQwordsHash_t & hQwords, CSphVector<TermPos_t> & dTermDupes ) const
+{
+	for ( auto & tCursor : m_dCursors )
+		tCursor.m_pTerm->GetTerms ( hQwords, dTermDupes );
+}
+
+uint64_t ExtWand_c::GetWordID() const
+{
+	uint64_t uHash = SPH_FNV64_SEED;
+	for ( auto & tCursor : m_dCursors )
+	{
+		uint64_t uCur = tCursor.m_pTerm->GetWordID();
+		uHash = sphFNV64 ( &uCur, sizeof(uCur), uHash );
+	}
+
+	return uHash;
+}
+
+void ExtWand_c::HintRowID ( RowID_t tRowID )
+{
+	// applied to the cursors on the next GetDocsChunk()
+	m_tHintRowID = Max ( m_tHintRowID, tRowID );
+}
+
+NodeEstimate_t ExtWand_c::Estimate ( int64_t iTotalDocs ) const
+{
+	NodeEstimate_t tEst;
+	for ( auto & tCursor : m_dCursors )
+		tEst += tCursor.m_pTerm->Estimate(iTotalDocs);
+
+	return tEst;
+}
+
+void ExtWand_c::SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries )
+{
+	for ( auto & tCursor : m_dCursors )
+		tCursor.m_pTerm->SetRowidBoundaries(tBoundaries);
+}
+
+void ExtWand_c::DebugDump ( int iLevel )
+{
+	DebugIndent ( iLevel );
+	printf ( "ExtWand (threshold %f)\n", m_bPruning ? m_fThreshold : 0.0f );
+	for ( auto & tCursor : m_dCursors )
+		tCursor.m_pTerm->DebugDump ( iLevel+1 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 ExtOrder_c::ExtOrder_c ( const CSphVector<ExtNode_i *> & dChildren, const ISphQwordSetup & tSetup )
 	: m_dChildren ( dChildren )
 	, m_bDone ( false )
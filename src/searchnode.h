@@ -60,6 +60,14 @@ struct ExtHit_t;
 struct ExtDoc_t;
 struct RowIdBoundaries_t;
 
+/// upper bounds of a term's contribution to bm25 weight (for dynamic pruning)
+struct TermBound_t
+{
+	float		m_fTFIDF = 0.0f;				///< max tf*idf
+	DWORD		m_uFields = 0;					///< fields that might match (lowest 32)
+	RowID_t		m_tLastRowID = INVALID_ROWID;	///< last rowid these bounds hold for (INVALID_ROWID means up to the end)
+};
+
 /// generic match streamer
 class ExtNode_i
 {
@@ -71,6 +79,9 @@ public:
 	static ExtNode_i *			Create ( ISphQword * pQword, const XQNode_t * pNode, const ISphQwordSetup & tSetup, bool bUseBM25, bool bRowidLimits );
 	static ExtNode_i *			Create ( const XQKeyword_t & tWord, const ISphQwordSetup & tSetup, DictRefPtr_c pZonesDict, bool bUseBM25, bool bRowidLimits );
 
+	/// block-max WAND over OR-of-terms queries; returns nullptr if the query tree doesn't fit
+	static ExtNode_i *			CreateWand ( const XQNode_t * pNode, const ISphQwordSetup & tSetup, bool bRowidLimits );
+
 	virtual void				Reset ( const ISphQwordSetup & tSetup ) = 0;
 	virtual void				HintRowID ( RowID_t tRowID ) = 0;
 	virtual const ExtDoc_t *	GetDocsChunk() = 0;
@@ -89,6 +100,11 @@ public:
 	virtual NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const = 0;
 	virtual void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) = 0;
 
+	// dynamic pruning
+	virtual bool				GetMaxBound ( TermBound_t & tBound ) const { return false; }						///< bounds over the whole doclist
+	virtual bool				GetBlockBound ( RowID_t tRowID, TermBound_t & tBound ) const { return false; }	///< bounds of the doclist block that has tRowID
+	virtual void				SetWeightThreshold ( float fThreshold ) {}										///< skip docs with bm25+rank below that
+
 	virtual void				DebugDump ( int iLevel ) = 0;
 };
 
@@ -18,6 +18,7 @@
 #include "killlist.h"
 #include "attribute.h"
 #include "columnarfilter.h"
+#include "jsoncolumns.h"
 #include <queue>
 
 #include "util/util.h"
@@ -1349,7 +1350,24 @@ RowIteratorsWithEstimates_t SIIteratorCreator_c::Create()
 		std::vector<common::BlockIterator_i *> dFilterIt;
 		if ( !CreateSIIterators ( dFilterIt, tFilter, iRsetSize ) )
 			continue;
-		
+
+		// typed json copies: also fetch documents whose copy is inexact, the json filter decides on them
+		const CSphColumnInfo * pAttr = m_tSchema.GetAttr ( tFilter.m_sAttrName.cstr() );
+		if ( pAttr && sphIsJsonTypedColumnAttr ( pAttr->m_sName ) )
+		{
+			CSphFilterSettings tInexact;
+			CreateJsonColumnInexactFilter ( *pAttr, tInexact );
+			std::vector<common::BlockIterator_i *> dInexactIt;
+			if ( !CreateSIIterators ( dInexactIt, tInexact, iRsetSize ) )
+			{
+				for ( auto * pIt : dFilterIt ) { SafeDelete ( pIt ); }
+				continue;
+			}
+
+			dFilterIt.insert ( dFilterIt.end(), dInexactIt.begin(), dInexactIt.end() );
+			tSIInfo.m_bKeepFilter = true;
+		}
+
 		RowidIterator_i * pIt = CreateRowIdIteratorFromSI ( dFilterIt, tFilter );
 		dRes.Add ( { pIt, iRsetSize } );
 		tSIInfo.m_bCreated = true;
@@ -1369,6 +1387,11 @@ RowIteratorsWithEstimates_t CreateSecondaryIndexIterator ( const SI::Index_i * p
 	if ( iNumIterators > 1 )
 		iCutoff = -1;
 
+	// iterators over json_columns return candidates that are filtered later, so cutoff can't be applied to them either
+	ARRAY_FOREACH ( i, dSIInfo )
+		if ( dSIInfo[i].m_eType==SecondaryIndexType_e::INDEX && sphIsJsonTypedColumnAttr ( dFilters[i].m_sAttrName ) )
+			iCutoff = -1;
+
 	SIIteratorCreator_c tCreator ( pSIIndex, dSIInfo, dFilters, eCollation, tSchema, uRowsCount, iCutoff );
 	return tCreator.Create();
 }
@@ -1379,8 +1402,8 @@ static void ConvertSchema ( const CSphSchema & tSchema, common::Schema_t & tSISc
 	for ( int iAttr=0; iAttr<tSchema.GetAttrsCount(); iAttr++ )
 	{
 		const CSphColumnInfo & tCol = tSchema.GetAttr ( iAttr );
-		// skip special / iternal attributes
-		if ( sphIsInternalAttr ( tCol.m_sName ) )
+		// skip special / iternal attributes; typed json_columns copies are indexed to speed up json filters
+		if ( sphIsInternalAttr ( tCol.m_sName ) && !sphIsJsonTypedColumnAttr ( tCol.m_sName ) )
 			continue;
 
 		if ( tCol.m_eAttrType==SPH_ATTR_JSON )
@@ -51,6 +51,7 @@
 #include "task_dispatcher.h"
 #include "secondarylib.h"
 #include "attrindex_merge.h"
+#include "jsoncolumns.h"
 
 #include <errno.h>
 #include <ctype.h>
@@ -198,7 +199,7 @@ struct SkipCacheUtil_t
 		return sphCRC32 ( &tKey.m_tWordId, sizeof(tKey.m_tWordId), uCRC32 );
 	}
 
-	static DWORD GetSize ( SkipData_t * pValue )	{ return pValue ? pValue->m_dSkiplist.GetLengthBytes() : 0; }
+	static DWORD GetSize ( SkipData_t * pValue )	{ return pValue ? pValue->m_dSkiplist.GetLengthBytes() + pValue->m_dBlockMax.GetLengthBytes() : 0; }
 	static void Reset ( SkipData_t * & pValue )		{ SafeDelete(pValue); }
 };
 
@@ -757,6 +758,13 @@ bool Update_CheckAttributes ( const CSphAttrUpdate & tUpd, const ISphSchema & tS
 			return false;
 		}
 
+		// typed json_columns copies are only built on insert
+		if ( tCol.m_eAttrType==SPH_ATTR_JSON && HasJsonColumns ( tSchema, tCol.m_sName ) )
+		{
+			sError.SetSprintf ( "attribute '%s' can not be updated (it is used by json_columns; use REPLACE instead)", sUpdAttrName.cstr() );
+			return false;
+		}
+
 		bool bSrcMva = ( tCol.m_eAttrType==SPH_ATTR_UINT32SET || tCol.m_eAttrType==SPH_ATTR_INT64SET );
 		bool bDstMva = ( tUpdAttr.m_eType==SPH_ATTR_UINT32SET || tUpdAttr.m_eType==SPH_ATTR_INT64SET );
 		if ( bSrcMva!=bDstMva )
@@ -1216,6 +1224,9 @@ public:
 	template <class QWORDDST, class QWORDSRC>
 	static bool			MergeWords ( const CSphIndex_VLN * pDstIndex, const CSphIndex_VLN * pSrcIndex, VecTraits_T<RowID_t> dDstRows, VecTraits_T<RowID_t> dSrcRows, CSphHitBuilder * pHitBuilder, CSphString & sError, CSphIndexProgress & tProgress);
 	static bool			DoMerge ( const CSphIndex_VLN * pDstIndex, const CSphIndex_VLN * pSrcIndex, const ISphFilter * pFilter, CSphString & sError, CSphIndexProgress & tProgress, bool bSrcSettings, bool bSupressDstDocids );
+	template <class QWORD>
+	static bool			MergeWordsMany ( const VecTraits_T<const CSphIndex_VLN *> & dIndexes, const VecTraits_T<VecTraits_T<RowID_t>> & dRows, CSphHitBuilder * pHitBuilder, CSphString & sError, CSphIndexProgress & tProgress );
+	static bool			DoMergeMany ( const VecTraits_T<const CSphIndex_VLN *> & dIndexes, CSphString & sError, CSphIndexProgress & tProgress );
 	std::unique_ptr<ISphFilter>		CreateMergeFilters ( const VecTraits_T<CSphFilterSettings> & dSettings ) const;
 	template <class QWORD>
 	static bool			DeleteField ( const CSphIndex_VLN * pIndex, CSphHitBuilder * pHitBuilder, CSphString & sError, CSphSourceStats & tStat, int iKillField );
@@ -1341,7 +1352,7 @@ private:
 	bool						MultiScan ( CSphQueryResult& tResult, const CSphQuery& tQuery, const VecTraits_T<ISphMatchSorter*>& dSorters, const CSphMultiQueryArgs& tArgs, int64_t tmMaxTimer ) const;
 
 	template<bool USE_KLIST, bool RANDOMIZE, bool USE_FACTORS, bool HAS_SORT_CALC, bool HAS_WEIGHT_FILTER, bool HAS_FILTER_CALC, bool HAS_CUTOFF>
-	void						MatchExtended ( CSphQueryContext & tCtx, const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *>& dSorters, ISphRanker * pRanker, int iTag, int iIndexWeight, int iCutoff ) const;
+	void						MatchExtended ( CSphQueryContext & tCtx, const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *>& dSorters, ISphRanker * pRanker, int iTag, int iIndexWeight, int iCutoff, ISphMatchSorter * pPruningSorter ) const;
 
 	const CSphRowitem *			FindDocinfo ( DocID_t tDocID ) const;
 
@@ -1359,6 +1370,8 @@ private:
 	bool						JuggleFile ( ESphExt eExt, CSphString & sError, bool bNeedSrc=true, bool bNeedDst=true ) const;
 	XQNode_t *					ExpandPrefix ( XQNode_t * pNode, CSphQueryResultMeta & tMeta, CSphScopedPayload * pPayloads, DWORD uQueryDebugFlags, int iQueryExpansionLimit ) const;
 
+	template <typename MERGEWORDS>
+	static bool			MergeDictionaries ( const CSphIndex_VLN * pDstIndex, const CSphIndex_VLN * pSettings, BuildHeader_t & tBuildHeader, StrVec_t & dDeleteOnInterrupt, CSphString & sError, MergeCb_c & tMonitor, MERGEWORDS && fnMergeWords );
 	static std::pair<DWORD,DWORD>		CreateRowMapsAndCountTotalDocs ( const CSphIndex_VLN* pSrcIndex, const CSphIndex_VLN* pDstIndex, CSphFixedVector<RowID_t>& dSrcRowMap, CSphFixedVector<RowID_t>& dDstRowMap, const ISphFilter* pFilter, bool bSupressDstDocids, MergeCb_c& tMonitor );
 	RowsToUpdateData_t			Update_CollectRowPtrs ( const UpdateContext_t & tCtx );
 	RowsToUpdate_t				Update_PrepareGatheredRowPtrs ( RowsToUpdate_t & dWRows, const VecTraits_T<DocID_t> & dDocids );
@@ -1389,7 +1402,7 @@ private:
 
 	template<typename RUN>
 	bool						SplitQuery ( RUN && tRun, CSphQueryResult & tResult, const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *> & dAllSorters, const CSphMultiQueryArgs & tArgs, int64_t tmMaxTimer ) const;
-	RowidIterator_i *			SpawnIterators ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const;
+	RowidIterator_i *			SpawnIterators ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker, CostPlan_t * pPlan = nullptr ) const;
 	bool						SelectIteratorsFT ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, const ISphSchema & tSorterSchema, ISphRanker * pRanker, CSphVector<SecondaryIndexInfo_t> & dSIInfo, int iCutoff, int iThreads, StrVec_t & dWarnings ) const;
 
 	bool						IsQueryFast ( const CSphQuery & tQuery, const CSphVector<SecondaryIndexInfo_t> & dEnabledIndexes, float fCost ) const;
@@ -2111,6 +2124,11 @@ bool CSphIndex::MustRunInSingleThread ( const VecTraits_T<const CSphQuery> & dQu
 		if ( DetectPrecalcSorters ( tQuery, m_tSchema, bHasSI ) )
 			return true;
 
+		// exact group-by never drops groups, so it doesn't need a single thread to stay accurate
+		// thread sorters hand their spilled partitions over on merge, and those are merged back one partition at a time
+		if ( tQuery.m_bExactGroupby )
+			continue;
+
 		// at this point we are trying to decide how many threads this index gets
 		// we did not correct max_matches yet (to achieve max grouping accuracy)
 		// but if increasing max_matches would be enough to achieve max accuracy, there's no need to turn off multithreading
@@ -2465,6 +2483,9 @@ int CSphIndex_VLN::CheckThenUpdateAttributes ( AttrUpdateInc_t& tUpd, bool& bCri
 
 	MaybeAddPostponedUpdate ( dRowsToUpdate, tCtx );
 
+	if ( tCtx.m_uUpdateMask )
+		m_iAttrUpdates.fetch_add ( 1, std::memory_order_relaxed );
+
 	if ( tCtx.m_uUpdateMask && m_bBinlog )
 		Binlog::CommitUpdateAttributes ( &m_iTID, { GetName(), m_iIndexId }, *tUpd.m_pUpdate );
 
@@ -2506,6 +2527,7 @@ void CSphIndex_VLN::UpdateAttributesOffline ( VecTraits_T<PostponedUpdate_t> & d
 			break;
 		}
 		m_uAttrsStatus |= tCtx.m_uUpdateMask; // FIXME! add lock/atomic?
+		m_iAttrUpdates.fetch_add ( 1, std::memory_order_relaxed );
 	}
 }
 
@@ -3070,7 +3092,9 @@ CSphVector<SecondaryIndexInfo_t> CSphIndex_VLN::GetEnabledIndexes ( const CSphQu
 	int iCutoff = ApplyImplicitCutoff ( tQuery, {} );
 
 	StrVec_t dWarnings;
-	SelectIteratorCtx_t tCtx ( tQuery, tQuery.m_dFilters, m_tSchema, m_tSchema, m_pHistograms, m_pColumnar.get(), m_pSIdx.get(), iCutoff, m_iDocinfo, iThreads );
+	CSphVector<CSphFilterSettings> dJsonColumnFilters;
+	const CSphVector<CSphFilterSettings> & dFilters = RemapJsonColumnFilters ( m_tSchema, tQuery.m_dFilters, dJsonColumnFilters ) ? dJsonColumnFilters : tQuery.m_dFilters;
+	SelectIteratorCtx_t tCtx ( tQuery, dFilters, m_tSchema, m_tSchema, m_pHistograms, m_pColumnar.get(), m_pSIdx.get(), iCutoff, m_iDocinfo, iThreads );
 	return SelectIterators ( tCtx, fCost, dWarnings );
 }
 
@@ -3158,15 +3182,41 @@ int64_t CSphIndex_VLN::GetCount() const
 
 /////////////////////////////////////////////////////////////////////////////
 
-struct CmpHit_fn
+CSphWordHit * sphSortHits ( CSphWordHit * pHits, CSphWordHit * pTmp, int iHits )
 {
-	inline static bool IsLess ( const CSphWordHit & a, const CSphWordHit & b )
+	// hits are collected document by document, so they mostly come in (rowid, position) order already,
+	// and after a stable sort by word id alone most of the words have their hits in order
+	CSphWordHit * pSorted = sphRadixSort ( pHits, pTmp, iHits, sizeof(SphWordID_t), [] ( const CSphWordHit & tHit, int iByte ) { return BYTE ( tHit.m_uWordID >> ( iByte*8 ) ); } );
+
+	// sort the rest by rowid and position (e.g. joined fields come after all the documents)
+	CSphWordHit * pScratch = pSorted==pHits ? pTmp : pHits;
+	for ( int iStart = 0; iStart<iHits; )
 	{
-		return ( a.m_uWordID<b.m_uWordID ) ||
-				( a.m_uWordID==b.m_uWordID && a.m_tRowID<b.m_tRowID ) ||
-				( a.m_uWordID==b.m_uWordID && a.m_tRowID==b.m_tRowID && HITMAN::GetPosWithField ( a.m_uWordPos )<HITMAN::GetPosWithField ( b.m_uWordPos ) );
+		bool bSorted = true;
+		int iEnd = iStart+1;
+		for ( ; iEnd<iHits && pSorted[iEnd].m_uWordID==pSorted[iStart].m_uWordID; ++iEnd )
+			bSorted &= !CmpHit_fn::IsLess ( pSorted[iEnd], pSorted[iEnd-1] );
+
+		CSphWordHit * pWord = pSorted + iStart;
+		int iWordHits = iEnd - iStart;
+		iStart = iEnd;
+		if ( bSorted )
+			continue;
+
+		if ( iWordHits<1024 )
+		{
+			sphSort ( pWord, iWordHits, CmpHit_fn() );
+			continue;
+		}
+
+		auto fnByte = [] ( const CSphWordHit & tHit, int iByte ) { return BYTE ( iByte<4 ? HITMAN::GetPosWithField ( tHit.m_uWordPos ) >> ( iByte*8 ) : tHit.m_tRowID >> ( ( iByte-4 )*8 ) ); };
+		const CSphWordHit * pWordSorted = sphRadixSort ( pWord, pScratch + ( pWord-pSorted ), iWordHits, sizeof(DWORD) + sizeof(RowID_t), fnByte );
+		if ( pWordSorted!=pWord )
+			memcpy ( pWord, pWordSorted, iWordHits*sizeof(CSphWordHit) );
 	}
-};
+
+	return pSorted;
+}
 
 void CSphIndex_VLN::GetIndexFiles ( StrVec_t& dFiles, StrVec_t& dExt, const FilenameBuilder_i* pParentFilenameBuilder ) const
 {
@@ -3283,6 +3333,7 @@ private:
 	ESphHitless					m_eHitless;
 
 	CSphVector<SkiplistEntry_t>	m_dSkiplist;
+	CSphVector<SkipBlockMax_t>	m_dSkipBlockMax;		///< per skiplist block maxima
 	StrVec_t *					m_pCreatedFiles { nullptr };
 #ifndef NDEBUG
 	bool m_bMerging;
@@ -3347,10 +3398,11 @@ bool CSphHitBuilder::CreateIndexFiles ( const CSphString& sDocName, const CSphSt
 
 	// put dummy byte (otherwise offset would start from 0, first delta would be 0
 	// and VLB encoding of offsets would fuckup)
+	// skiplist dummy also tells that block maxima are there
 	BYTE bDummy = 1;
 	m_wrDoclist.PutBytes ( &bDummy, 1 );
 	m_wrHitlist.PutBytes ( &bDummy, 1 );
-	m_wrSkiplist.PutBytes ( &bDummy, 1 );
+	m_wrSkiplist.PutByte ( SKIPLIST_BLOCKMAX );
 	return true;
 }
 
@@ -3394,6 +3446,7 @@ void CSphHitBuilder::DoclistBeginEntry ( RowID_t tRowid )
 		tBlock.m_tBaseRowIDPlus1 = m_tLastHit.m_tRowID+1;
 		tBlock.m_iOffset = m_wrDoclist.GetPos();
 		tBlock.m_iBaseHitlistPos = m_iLastHitlistPos;
+		m_dSkipBlockMax.Add();
 	}
 
 	// begin doclist entry
@@ -3433,6 +3486,12 @@ void CSphHitBuilder::DoclistEndEntry ( Hitpos_t uLastPos )
 		m_wrDoclist.ZipInt ( m_dLastDocFields.GetMask32() );
 		m_wrDoclist.ZipInt ( m_uLastDocHits );
 	}
+
+	assert ( m_dSkipBlockMax.GetLength() );
+	SkipBlockMax_t & tBlockMax = m_dSkipBlockMax.Last();
+	tBlockMax.m_uMaxHits = Max ( tBlockMax.m_uMaxHits, m_uLastDocHits );
+	tBlockMax.m_uFields |= m_dLastDocFields.GetMask32();
+
 	m_dLastDocFields.UnsetAll();
 	m_uLastDocHits = 0;
 
@@ -3479,10 +3538,19 @@ void CSphHitBuilder::DoclistEndList ()
 			m_wrSkiplist.ZipOffset ( t.m_iBaseHitlistPos - tLast.m_iBaseHitlistPos );
 			tLast = t;
 		}
+
+		// 4) per-block maxima follow the entries, for every block (including the first one)
+		assert ( m_dSkipBlockMax.GetLength()==m_dSkiplist.GetLength() );
+		for ( const auto & tMax : m_dSkipBlockMax )
+		{
+			m_wrSkiplist.ZipInt ( tMax.m_uMaxHits );
+			m_wrSkiplist.ZipInt ( tMax.m_uFields );
+		}
 	}
 
 	// in any event, reset skiplist
 	m_dSkiplist.Resize ( 0 );
+	m_dSkipBlockMax.Resize ( 0 );
 }
 
 static int strcmpp (const char* l, const char* r)
@@ -5366,6 +5434,129 @@ void CSphIndex_VLN::Build_AddToDocstore ( DocstoreBuilder_i * pDocstoreBuilder,
 }
 
 
+/// runs fnJob(0)..fnJob(iJobs-1) on separate threads (job 0 on the calling one) and waits for all of them
+template<typename JOB>
+static void RunBuildJobs ( int iJobs, JOB && fnJob )
+{
+	CSphFixedVector<SphThread_t> dThreads ( iJobs );
+	int iCreated = 1;
+	for ( ; iCreated<iJobs; ++iCreated )
+		if ( !Threads::Create ( &dThreads[iCreated], [&fnJob, iCreated] { fnJob ( iCreated ); }, false, "build", iCreated ) )
+			break;
+
+	// jobs that failed to get a thread run here
+	for ( int i = iCreated; i<iJobs; ++i )
+		fnJob(i);
+
+	fnJob(0);
+
+	for ( int i = 1; i<iCreated; ++i )
+		Threads::Join ( &dThreads[i] );
+}
+
+
+struct HitRun_t
+{
+	const CSphWordHit * m_pHit;
+	const CSphWordHit * m_pEnd;
+};
+
+
+struct CmpHitRun_fn
+{
+	static inline bool IsLess ( const HitRun_t & a, const HitRun_t & b )
+	{
+		return CmpHit_fn::IsLess ( *a.m_pHit, *b.m_pHit );
+	}
+};
+
+/// with several threads, slices of the block are sorted separately, then the key space is split into ranges
+/// by regular sampling, and every thread merges its range of all the slices into dTmp
+void SortHits ( CSphFixedVector<CSphWordHit> & dHits, CSphFixedVector<CSphWordHit> & dTmp, int iHits, int iThreads, int iMinHitsPerThread )
+{
+	assert ( dTmp.GetLength()>=iHits );
+	assert ( iMinHitsPerThread>0 );
+
+	// don't spin up threads for small blocks (e.g. the tail of the last source)
+	iThreads = Min ( iThreads, iHits/iMinHitsPerThread );
+	if ( iThreads<2 )
+	{
+		if ( sphSortHits ( dHits.Begin(), dTmp.Begin(), iHits )!=dHits.Begin() )
+			dHits.SwapData ( dTmp );
+		return;
+	}
+
+	CSphWordHit * pHits = dHits.Begin();
+	auto fnSlice = [pHits, iHits, iThreads] ( int i ) { return pHits + int64_t(iHits)*i/iThreads; };
+
+	RunBuildJobs ( iThreads, [&] ( int i )
+	{
+		CSphWordHit * pSlice = fnSlice(i);
+		int iLen = int ( fnSlice(i+1)-pSlice );
+		const CSphWordHit * pSorted = sphSortHits ( pSlice, dTmp.Begin() + ( pSlice-pHits ), iLen );
+		if ( pSorted!=pSlice )
+			memcpy ( pSlice, pSorted, iLen*sizeof(CSphWordHit) );
+	} );
+
+	// every slice contributes iThreads evenly spaced samples; every iThreads-th sample splits the key space
+	CSphVector<CSphWordHit> dSamples;
+	dSamples.Reserve ( iThreads*iThreads );
+	for ( int i = 0; i<iThreads; ++i )
+	{
+		int iLen = int ( fnSlice(i+1)-fnSlice(i) );
+		for ( int j = 0; j<iThreads; ++j )
+			dSamples.Add ( fnSlice(i)[int64_t(iLen)*j/iThreads] );
+	}
+	dSamples.Sort ( CmpHit_fn() );
+
+	// range r takes hits from dBounds[r*iThreads+s] to dBounds[(r+1)*iThreads+s] of every slice s
+	// and lands in dTmp starting from dOutput[r]
+	CSphFixedVector<const CSphWordHit *> dBounds ( ( iThreads+1 )*iThreads );
+	CSphFixedVector<int64_t> dOutput ( iThreads+1 );
+	for ( int iRange = 0; iRange<=iThreads; ++iRange )
+	{
+		dOutput[iRange] = 0;
+		for ( int s = 0; s<iThreads; ++s )
+		{
+			const CSphWordHit * & pBound = dBounds[iRange*iThreads+s];
+			if ( iRange==0 || iRange==iThreads )
+				pBound = fnSlice ( iRange ? s+1 : s );
+			else
+				pBound = std::lower_bound ( fnSlice(s), fnSlice(s+1), dSamples[iRange*iThreads], [] ( const CSphWordHit & a, const CSphWordHit & b ) { return CmpHit_fn::IsLess ( a, b ); } );
+
+			dOutput[iRange] += pBound - fnSlice(s);
+		}
+	}
+
+	assert ( dOutput[iThreads]==iHits );
+
+	RunBuildJobs ( iThreads, [&] ( int iRange )
+	{
+		CSphQueue<HitRun_t, CmpHitRun_fn> tQueue ( iThreads );
+		for ( int s = 0; s<iThreads; ++s )
+		{
+			HitRun_t tRun { dBounds[iRange*iThreads+s], dBounds[(iRange+1)*iThreads+s] };
+			if ( tRun.m_pHit<tRun.m_pEnd )
+				tQueue.Push ( tRun );
+		}
+
+		CSphWordHit * pOut = dTmp.Begin() + dOutput[iRange];
+		while ( tQueue.GetLength() )
+		{
+			HitRun_t tRun = tQueue.Root();
+			tQueue.Pop();
+			*pOut++ = *tRun.m_pHit++;
+			if ( tRun.m_pHit<tRun.m_pEnd )
+				tQueue.Push ( tRun );
+		}
+
+		assert ( pOut==dTmp.Begin() + dOutput[iRange+1] );
+	} );
+
+	dHits.SwapData ( dTmp );
+}
+
+
 int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemoryLimit, int iWriteBuffer, CSphIndexProgress& tProgress )
 {
 	assert ( dSources.GetLength() );
@@ -5476,17 +5667,20 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 
 	iMemoryLimit -= iDocidLookupSize+iDictSize;
 
-	// do we have enough left for hits?
+	const int iBuildThreads = m_iBuildThreads;
+
+	// do we have enough left for hits? (hits are sorted into a second buffer of the same size)
 	int iHitsMax = 1048576;
-	if ( iMemoryLimit < iHitsMax*(int)sizeof(CSphWordHit) )
+	if ( iMemoryLimit < iHitsMax*2*(int)sizeof(CSphWordHit) )
 	{
-		iMemoryLimit = iOldLimit + iHitsMax*sizeof(CSphWordHit) - iMemoryLimit;
+		iMemoryLimit = iOldLimit + iHitsMax*2*sizeof(CSphWordHit) - iMemoryLimit;
 		sphWarn ( "collect_hits: mem_limit=%d kb too low, increasing to %d kb",	iOldLimit/1024, iMemoryLimit/1024 );
 	} else
-		iHitsMax = iMemoryLimit / sizeof(CSphWordHit);
+		iHitsMax = iMemoryLimit / 2 / sizeof(CSphWordHit);
 
 	// allocate raw hits block
 	CSphFixedVector<CSphWordHit> dHits ( iHitsMax + MAX_SOURCE_HITS );
+	CSphFixedVector<CSphWordHit> dSortBuffer ( dHits.GetLength() );
 	CSphWordHit * pHits = dHits.Begin();
 	CSphWordHit * pHitsMax = dHits.Begin() + iHitsMax;
 
@@ -5563,6 +5757,24 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	RowID_t tRowID = 0;
 	int64_t iHitsTotal = 0;
 
+	// sort collected hits, flush them as a new raw block and reset hits pool
+	// that's the only step of the collect phase that uses build threads; fetching, tokenizing, attribute
+	// and docstore writing all stay on this thread and don't overlap with each other or with the sort
+	auto fnFlushHits = [&]() -> bool
+	{
+		int iHits = int ( pHits - dHits.Begin() );
+		SortHits ( dHits, dSortBuffer, iHits, iBuildThreads );
+		m_pDict->HitblockPatch ( dHits.Begin(), iHits );
+
+		pHits = dHits.Begin();
+		pHitsMax = dHits.Begin() + iHitsMax;
+		iHitsTotal += iHits;
+
+		dHitBlocks.Add ( tHitBuilder.cidxWriteRawVLB ( fdHits.GetFD(), dHits.Begin(), iHits ) );
+		m_pDict->HitblockReset ();
+		return dHitBlocks.Last()>=0;
+	};
+
 	ARRAY_FOREACH ( iSource, dSources )
 	{
 		// connect and check schema
@@ -5664,24 +5876,11 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 				g_iIndexerPoolStartDocID = tDocID;
 				g_iIndexerPoolStartHit = pHits-dHits.Begin();
 
-				// sort hits
-				int iHits = int ( pHits - dHits.Begin() );
-				{
-					sphSort ( dHits.Begin(), iHits, CmpHit_fn() );
-					m_pDict->HitblockPatch ( dHits.Begin(), iHits );
-				}
-				pHits = dHits.Begin();
-
-				// flush hits, docs are flushed independently
-				dHitBlocks.Add ( tHitBuilder.cidxWriteRawVLB ( fdHits.GetFD(), dHits.Begin(), iHits ) );
-
-				m_pDict->HitblockReset ();
-
-				if ( dHitBlocks.Last()<0 )
+				// sort and flush hits, docs are flushed independently
+				if ( !fnFlushHits() )
 					return 0;
 
 				// progress bar
-				iHitsTotal += iHits;
 				tProgress.m_iDocuments = m_tStats.m_iTotalDocuments + pSource->GetStats().m_iTotalDocuments;
 				tProgress.m_iBytes = m_tStats.m_iTotalBytes + pSource->GetStats().m_iTotalBytes;
 				tProgress.Show();
@@ -5738,18 +5937,8 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		if ( bHaveJoined )
 		{
 			// flush tail of regular hits
-			int iHits = int ( pHits - dHits.Begin() );
-			if ( iDictSize && m_pDict->HitblockGetMemUse() && iHits )
-			{
-				sphSort ( dHits.Begin(), iHits, CmpHit_fn() );
-				m_pDict->HitblockPatch ( dHits.Begin(), iHits );
-				pHits = dHits.Begin();
-				iHitsTotal += iHits;
-				dHitBlocks.Add ( tHitBuilder.cidxWriteRawVLB ( fdHits.GetFD(), dHits.Begin(), iHits ) );
-				if ( dHitBlocks.Last()<0 )
-					return 0;
-				m_pDict->HitblockReset ();
-			}
+			if ( iDictSize && m_pDict->HitblockGetMemUse() && pHits>dHits.Begin() && !fnFlushHits() )
+				return 0;
 
 			tJoinedReader.SeekTo(0,0);
 
@@ -5773,17 +5962,8 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 					continue;
 
 				// store hits
-				int iStoredHits = int ( pHits - dHits.Begin() );
-				sphSort ( dHits.Begin(), iStoredHits, CmpHit_fn() );
-				m_pDict->HitblockPatch ( dHits.Begin(), iStoredHits );
-
-				pHits = dHits.Begin();
-				iHitsTotal += iStoredHits;
-
-				dHitBlocks.Add ( tHitBuilder.cidxWriteRawVLB ( fdHits.GetFD(), dHits.Begin(), iStoredHits ) );
-				if ( dHitBlocks.Last()<0 )
+				if ( !fnFlushHits() )
 					return 0;
-				m_pDict->HitblockReset ();
 			}
 		}
 
@@ -5801,25 +5981,12 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	}
 
 	// flush last hit block
-	if ( pHits>dHits.Begin() )
-	{
-		int iHits = int ( pHits - dHits.Begin() );
-		{
-			sphSort ( dHits.Begin(), iHits, CmpHit_fn() );
-			m_pDict->HitblockPatch ( dHits.Begin(), iHits );
-		}
-		iHitsTotal += iHits;
-
-		dHitBlocks.Add ( tHitBuilder.cidxWriteRawVLB ( fdHits.GetFD(), dHits.Begin(), iHits ) );
-
-		m_pDict->HitblockReset ();
-
-		if ( dHitBlocks.Last()<0 )
-			return 0;
-	}
+	if ( pHits>dHits.Begin() && !fnFlushHits() )
+		return 0;
 
 	// reset hits pool
 	dHits.Reset(0);
+	dSortBuffer.Reset(0);
 
 	if ( nDocidLookup )
 	{
@@ -5865,16 +6032,27 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		return 0;
 	}
 
-	if ( pCidxBuilder )
+	// secondary index builder only works with its own files, so with several build threads
+	// it runs in background while docid lookup gets sorted and hits get merged
+	SphThread_t tSIThread;
+	bool bSIThread = false;
+	bool bSiDone = true;
+	std::string sSIError;
+	AT_SCOPE_EXIT ( [&] { if ( bSIThread ) Threads::Join ( &tSIThread ); } );
+
+	if ( pCidxBuilder && iBuildThreads>1 )
+		bSIThread = Threads::Create ( &tSIThread, [&] { bSiDone = pCidxBuilder->Done ( sSIError ); }, false, "build_si" );
+
+	if ( pCidxBuilder && !bSIThread )
 	{
 		tProgress.PhaseBegin ( CSphIndexProgress::PHASE_SI_BUILD );
 		tProgress.Show();
-		bool bSiDone = pCidxBuilder->Done ( sError );
+		bSiDone = pCidxBuilder->Done ( sSIError );
 		tProgress.PhaseEnd();
 
 		if ( !bSiDone )
 		{
-			m_sLastError = sError.c_str();
+			m_sLastError = sSIError.c_str();
 			return 0;
 		}
 	}
@@ -6094,6 +6272,17 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 
 	dRelocationBuffer.Reset(0);
 
+	if ( bSIThread )
+	{
+		Threads::Join ( &tSIThread );
+		bSIThread = false;
+		if ( !bSiDone )
+		{
+			m_sLastError = sSIError.c_str();
+			return 0;
+		}
+	}
+
 	tBuildHeader.m_iDocinfo = m_tStats.m_iTotalDocuments;
 	tBuildHeader.m_iDocinfoIndex = m_iDocinfoIndex;
 	tBuildHeader.m_iMinMaxIndex = m_iMinMaxIndex;
@@ -6599,6 +6788,152 @@ bool CSphIndex_VLN::MergeWords ( const CSphIndex_VLN * pDstIndex, const CSphInde
 	return true;
 }
 
+template < typename QWORD >
+bool CSphIndex_VLN::MergeWordsMany ( const VecTraits_T<const CSphIndex_VLN *> & dIndexes, const VecTraits_T<VecTraits_T<RowID_t>> & dRows, CSphHitBuilder * pHitBuilder, CSphString & sError, CSphIndexProgress & tProgress )
+{
+	auto & tMonitor = tProgress.GetMergeCb();
+	const CSphIndex_VLN * pDstIndex = dIndexes.First();
+	CSphAutofile tDummy;
+	pHitBuilder->CreateIndexFiles ( pDstIndex->GetTmpFilename ( SPH_EXT_SPD ), pDstIndex->GetTmpFilename ( SPH_EXT_SPP ), pDstIndex->GetTmpFilename ( SPH_EXT_SPE ), false, 0, tDummy );
+
+	using DictReader_c = CSphDictReader<QWORD::is_worddict::value>;
+	struct Source_t
+	{
+		std::unique_ptr<DictReader_c>	m_pReader;
+		std::unique_ptr<QWORD>			m_pQword;
+		DataReaderFactoryPtr_c			m_pDocs;
+		DataReaderFactoryPtr_c			m_pHits;
+		bool							m_bWord = false;
+	};
+
+	CSphFixedVector<Source_t> dSources ( dIndexes.GetLength() );
+	ARRAY_FOREACH ( i, dSources )
+	{
+		const CSphIndex_VLN * pIndex = dIndexes[i];
+		auto & tSource = dSources[i];
+
+		tSource.m_pReader = std::make_unique<DictReader_c> ( pIndex->GetSettings().m_iSkiplistBlockSize );
+		if ( !tSource.m_pReader->Setup ( pIndex->GetFilename ( SPH_EXT_SPI ), pIndex->m_tWordlist.GetWordsEnd(), pIndex->m_tSettings.m_eHitless, sError ) )
+			return false;
+
+		tSource.m_pDocs = NewProxyReader ( pIndex->GetFilename ( SPH_EXT_SPD ), sError, DataReaderFactory_c::DOCS, pIndex->m_tMutableSettings.m_tFileAccess.m_iReadBufferDocList, FileAccess_e::FILE );
+		if ( !tSource.m_pDocs )
+			return false;
+
+		tSource.m_pHits = NewProxyReader ( pIndex->GetFilename ( SPH_EXT_SPP ), sError, DataReaderFactory_c::HITS, pIndex->m_tMutableSettings.m_tFileAccess.m_iReadBufferHitList, FileAccess_e::FILE );
+		if ( !tSource.m_pHits )
+			return false;
+
+		if ( !sError.IsEmpty() || tMonitor.NeedStop() )
+			return false;
+
+		tSource.m_pQword = std::make_unique<QWORD> ( false, false, pIndex->GetIndexId() );
+		QwordIteration::ConfigureQword<QWORD> ( *tSource.m_pQword, tSource.m_pHits, tSource.m_pDocs, pIndex->m_tSchema.GetDynamicSize() );
+		tSource.m_bWord = tSource.m_pReader->Read();
+	}
+
+	/// prepare for indexing
+	pHitBuilder->HitblockBegin();
+	pHitBuilder->HitReset();
+
+	CSphMerger tMerger ( pHitBuilder );
+
+	tProgress.PhaseBegin ( CSphIndexProgress::PHASE_MERGE );
+	tProgress.Show();
+
+	// sources are few (one per merged chunk), so plain scan for the least word is enough
+	CSphVector<int> dSame;
+	int iWords = 0;
+	int iHitlistsDiscarded = 0;
+	while ( true )
+	{
+		if ( tMonitor.NeedStop () || !sError.IsEmpty () )
+			return false;
+
+		dSame.Resize ( 0 );
+		ARRAY_FOREACH ( i, dSources )
+		{
+			if ( !dSources[i].m_bWord )
+				continue;
+
+			int iCmp = dSame.IsEmpty() ? -1 : dSources[i].m_pReader->CmpWord ( *dSources[dSame[0]].m_pReader );
+			if ( iCmp<0 )
+				dSame.Resize ( 0 );
+			if ( iCmp<=0 )
+				dSame.Add ( i );
+		}
+
+		if ( dSame.IsEmpty() )
+			break;
+
+		if ( ++iWords==1000 )
+		{
+			tProgress.m_iWords += 1000;
+			tProgress.Show();
+			iWords = 0;
+		}
+
+		const DictReader_c & tFirst = *dSources[dSame[0]].m_pReader;
+		if ( dSame.GetLength()==1 )
+		{
+			int iSource = dSame[0];
+			auto & tQword = *dSources[iSource].m_pQword;
+			QwordIteration::PrepareQword<QWORD> ( tQword, tFirst );
+			tMerger.TransferData<QWORD> ( tQword, tFirst.m_uWordID, tFirst.GetWord(), dIndexes[iSource], dRows[iSource], tMonitor );
+		} else
+		{
+			// merge documents and hits inside the word; sources go in order of their rowid ranges,
+			// and we assume that all the duplicates have been removed
+			bool bHitless = !tFirst.m_bHasHitlist;
+			if ( dSame.any_of ( [&dSources, &tFirst] ( int i ) { return dSources[i].m_pReader->m_bHasHitlist!=tFirst.m_bHasHitlist; } ) )
+			{
+				++iHitlistsDiscarded;
+				bHitless = true;
+			}
+
+			AggregateHit_t tHit;
+			tHit.m_uWordID = tFirst.m_uWordID;
+			tHit.m_sKeyword = tFirst.GetWord();
+			tHit.m_dFieldMask.UnsetAll();
+
+			for ( int iSource : dSame )
+			{
+				auto & tQword = *dSources[iSource].m_pQword;
+				const auto & dSourceRows = dRows[iSource];
+				QwordIteration::PrepareQword<QWORD> ( tQword, *dSources[iSource].m_pReader );
+				while ( QwordIteration::NextDocument ( tQword, dIndexes[iSource], dSourceRows ) )
+				{
+					if ( tMonitor.NeedStop () || !sError.IsEmpty () )
+						return false;
+
+					if ( bHitless )
+					{
+						while ( tQword.m_bHasHitlist && tQword.GetNextHit()!=EMPTY_HIT );
+
+						tHit.m_tRowID = dSourceRows[tQword.m_tDoc.m_tRowID];
+						tHit.m_dFieldMask = tQword.m_dQwordFields;
+						tHit.SetAggrCount ( tQword.m_uMatchHits );
+						pHitBuilder->cidxHit ( &tHit );
+					} else
+						tMerger.TransferHits ( tQword, tHit, dSourceRows );
+				}
+			}
+		}
+
+		// next word
+		for ( int iSource : dSame )
+			dSources[iSource].m_bWord = dSources[iSource].m_pReader->Read();
+	}
+
+	tProgress.m_iWords += iWords;
+	tProgress.Show();
+
+	if ( iHitlistsDiscarded )
+		sphWarning ( "discarded hitlists for %u words", iHitlistsDiscarded );
+
+	return true;
+}
+
 // called only from indexer
 bool CSphIndex_VLN::Merge ( CSphIndex * pSource, const VecTraits_T<CSphFilterSettings> & dFilters, bool bSupressDstDocids, CSphIndexProgress& tProgress )
 {
@@ -6694,6 +7029,62 @@ std::pair<DWORD,DWORD> CSphIndex_VLN::CreateRowMapsAndCountTotalDocs ( const CSp
 }
 
 
+template<typename MERGEWORDS>
+bool CSphIndex_VLN::MergeDictionaries ( const CSphIndex_VLN * pDstIndex, const CSphIndex_VLN * pSettings, BuildHeader_t & tBuildHeader, StrVec_t & dDeleteOnInterrupt, CSphString & sError, MergeCb_c & tMonitor, MERGEWORDS && fnMergeWords )
+{
+	CSphAutofile tTmpDict ( pDstIndex->GetFilename("spi.tmp"), SPH_O_NEW, sError, true ); // that is huge file with bins
+	CSphAutofile tDict ( pDstIndex->GetTmpFilename ( SPH_EXT_SPI ), SPH_O_NEW, sError, true );
+
+	if ( !sError.IsEmpty() || tTmpDict.GetFD()<0 || tDict.GetFD()<0 || tMonitor.NeedStop() )
+		return false;
+
+	DictRefPtr_c pDict { pSettings->m_pDict->Clone() };
+
+	int iHitBufferSize = 8 * 1024 * 1024;
+	CSphVector<SphWordID_t> dDummy;
+	CSphHitBuilder tHitBuilder ( pSettings->m_tSettings, dDummy, true, iHitBufferSize, pDict, &sError, &dDeleteOnInterrupt );
+
+	// FIXME? is this magic dict block constant any good?..
+	pDict->DictBegin ( tTmpDict, tDict, iHitBufferSize );
+
+	// merge dictionaries, doclists and hitlists
+	if ( !fnMergeWords ( &tHitBuilder ) )
+		return false;
+
+	if ( tMonitor.NeedStop () || !sError.IsEmpty() )
+		return false;
+
+	// finalize
+	AggregateHit_t tFlush;
+	tFlush.m_tRowID = INVALID_ROWID;
+	tFlush.m_uWordID = 0;
+	tFlush.m_sKeyword = (const BYTE*)""; // tricky: assertion in cidxHit calls strcmp on this in case of empty index!
+	tFlush.m_iWordPos = EMPTY_HIT;
+	tFlush.m_dFieldMask.UnsetAll();
+	tHitBuilder.cidxHit ( &tFlush );
+
+	int iMinInfixLen = pSettings->m_tSettings.m_iMinInfixLen;
+	if ( !tHitBuilder.cidxDone ( iHitBufferSize, iMinInfixLen, pSettings->m_pTokenizer->GetMaxCodepointLength(), &tBuildHeader ) )
+		return false;
+
+	WriteHeader_t tWriteHeader;
+	tWriteHeader.m_pSettings = &pSettings->m_tSettings;
+	tWriteHeader.m_pSchema = &pSettings->m_tSchema;
+	tWriteHeader.m_pTokenizer = pSettings->m_pTokenizer;
+	tWriteHeader.m_pDict = pSettings->m_pDict;
+	tWriteHeader.m_pFieldFilter = pSettings->m_pFieldFilter.get();
+	tWriteHeader.m_pFieldLens = pSettings->m_dFieldLens.Begin();
+
+	IndexBuildDone ( tBuildHeader, tWriteHeader, pDstIndex->GetTmpFilename ( SPH_EXT_SPH ), sError );
+
+	// we're done; clean all deferred deletes
+	tDict.SetPersistent();
+	dDeleteOnInterrupt.Reset();
+
+	return true;
+}
+
+
 bool CSphIndex_VLN::DoMerge ( const CSphIndex_VLN * pDstIndex, const CSphIndex_VLN * pSrcIndex, const ISphFilter * pFilter, CSphString & sError, CSphIndexProgress & tProgress,
 	bool bSrcSettings, bool bSupressDstDocids )
 {
@@ -6763,79 +7154,147 @@ bool CSphIndex_VLN::DoMerge ( const CSphIndex_VLN * pDstIndex, const CSphIndex_V
 	}
 
 	const CSphIndex_VLN* pSettings = ( bSrcSettings ? pSrcIndex : pDstIndex );
-	CSphAutofile tTmpDict ( pDstIndex->GetFilename("spi.tmp"), SPH_O_NEW, sError, true ); // that is huge file with bins
-	CSphAutofile tDict ( pDstIndex->GetTmpFilename ( SPH_EXT_SPI ), SPH_O_NEW, sError, true );
+	return MergeDictionaries ( pDstIndex, pSettings, tBuildHeader, dDeleteOnInterrupt, sError, tMonitor, [&] ( CSphHitBuilder * pHitBuilder )
+	{
+		bool bOk = false;
+		if ( pSettings->m_pDict->GetSettings().m_bWordDict )
+		{
+			WITH_QWORD ( pDstIndex, false, QwordDst,
+				WITH_QWORD ( pSrcIndex, false, QwordSrc,
+					bOk = ( CSphIndex_VLN::MergeWords < QwordDst, QwordSrc > ( pDstIndex, pSrcIndex, dDstRows, dSrcRows, pHitBuilder, sError, tProgress ) );
+			));
+		} else
+		{
+			WITH_QWORD ( pDstIndex, true, QwordDst,
+				WITH_QWORD ( pSrcIndex, true, QwordSrc,
+					bOk = ( CSphIndex_VLN::MergeWords < QwordDst, QwordSrc > ( pDstIndex, pSrcIndex, dDstRows, dSrcRows, pHitBuilder, sError, tProgress ) );
+			));
+		}
+		return bOk;
+	});
+}
 
-	if ( !sError.IsEmpty() || tTmpDict.GetFD()<0 || tDict.GetFD()<0 || tMonitor.NeedStop() )
-		return false;
 
-	DictRefPtr_c pDict { pSettings->m_pDict->Clone() };
+bool sphMerge ( const CSphIndex * pDst, const CSphIndex * pSrc, VecTraits_T<CSphFilterSettings> dFilters, CSphIndexProgress & tProgress, CSphString& sError )
+{
+	auto pDstIndex = (const CSphIndex_VLN*) pDst;
+	auto pSrcIndex = (const CSphIndex_VLN*) pSrc;
 
-	int iHitBufferSize = 8 * 1024 * 1024;
-	CSphVector<SphWordID_t> dDummy;
-	CSphHitBuilder tHitBuilder ( pSettings->m_tSettings, dDummy, true, iHitBufferSize, pDict, &sError, &dDeleteOnInterrupt );
+	std::unique_ptr<ISphFilter> pFilter = pDstIndex->CreateMergeFilters ( dFilters );
+	return CSphIndex_VLN::DoMerge ( pDstIndex, pSrcIndex, pFilter.get(), sError, tProgress, dFilters.IsEmpty(), false );
+}
 
-	// FIXME? is this magic dict block constant any good?..
-	pDict->DictBegin ( tTmpDict, tDict, iHitBufferSize );
+bool CSphIndex_VLN::DoMergeMany ( const VecTraits_T<const CSphIndex_VLN *> & dIndexes, CSphString & sError, CSphIndexProgress & tProgress )
+{
+	auto & tMonitor = tProgress.GetMergeCb();
+	assert ( dIndexes.GetLength()>=2 );
 
-	// merge dictionaries, doclists and hitlists
-	if ( pDict->GetSettings().m_bWordDict )
-	{
-		WITH_QWORD ( pDstIndex, false, QwordDst,
-			WITH_QWORD ( pSrcIndex, false, QwordSrc,
-				if ( !CSphIndex_VLN::MergeWords < QwordDst, QwordSrc > ( pDstIndex, pSrcIndex, dDstRows, dSrcRows, &tHitBuilder, sError, tProgress ) )
-					return false;
-		));
-	} else
+	// same as 2-way merge: files are named after the first (oldest) index, settings are taken from the last one
+	const CSphIndex_VLN * pDstIndex = dIndexes.First();
+	const CSphIndex_VLN * pSettings = dIndexes.Last();
+
+	for ( const CSphIndex_VLN * pIndex : dIndexes.Slice ( 1 ) )
 	{
-		WITH_QWORD ( pDstIndex, true, QwordDst,
-			WITH_QWORD ( pSrcIndex, true, QwordSrc,
-				if ( !CSphIndex_VLN::MergeWords < QwordDst, QwordSrc > ( pDstIndex, pSrcIndex, dDstRows, dSrcRows, &tHitBuilder, sError, tProgress ) )
-					return false;
-		));
+		assert ( pIndex!=pDstIndex );
+		if ( !pDstIndex->m_tSchema.CompareTo ( pIndex->m_tSchema, sError ) )
+			return false;
+
+		if ( pDstIndex->m_tSettings.m_eHitless!=pIndex->m_tSettings.m_eHitless )
+		{
+			sError = "hitless settings must be the same on merged tables";
+			return false;
+		}
+
+		if ( pDstIndex->m_pDict->GetSettings().m_bWordDict!=pIndex->m_pDict->GetSettings().m_bWordDict )
+		{
+			sError = "dictionary types must be the same on merged tables";
+			return false;
+		}
+
+		if ( pDstIndex->m_tSettings.m_eHitFormat!=pIndex->m_tSettings.m_eHitFormat )
+		{
+			sError = "hit formats must be the same on merged tables";
+			return false;
+		}
 	}
 
-	if ( tMonitor.NeedStop () || !sError.IsEmpty() )
-		return false;
+	// alive rows of every source get consecutive rowids, sources follow each other in the given order
+	int64_t iTotalRows = 0;
+	for ( const CSphIndex_VLN * pIndex : dIndexes )
+		iTotalRows += pIndex->m_iDocinfo;
 
-	// finalize
-	AggregateHit_t tFlush;
-	tFlush.m_tRowID = INVALID_ROWID;
-	tFlush.m_uWordID = 0;
-	tFlush.m_sKeyword = (const BYTE*)""; // tricky: assertion in cidxHit calls strcmp on this in case of empty index!
-	tFlush.m_iWordPos = EMPTY_HIT;
-	tFlush.m_dFieldMask.UnsetAll();
-	tHitBuilder.cidxHit ( &tFlush );
+	CSphFixedVector<RowID_t> dRowMap { iTotalRows };
+	CSphFixedVector<VecTraits_T<RowID_t>> dRows { dIndexes.GetLength() };
+	CSphFixedVector<DWORD> dAlive { dIndexes.GetLength() };
+	dRowMap.Fill ( INVALID_ROWID );
 
-	int iMinInfixLen = pSettings->m_tSettings.m_iMinInfixLen;
-	if ( !tHitBuilder.cidxDone ( iHitBufferSize, iMinInfixLen, pSettings->m_pTokenizer->GetMaxCodepointLength(), &tBuildHeader ) )
-		return false;
+	int64_t iTotalDocs = 0;
+	int64_t iOffset = 0;
+	ARRAY_FOREACH ( i, dIndexes )
+	{
+		const CSphIndex_VLN * pIndex = dIndexes[i];
+		dRows[i] = dRowMap.Slice ( iOffset, pIndex->m_iDocinfo );
+		iOffset += pIndex->m_iDocinfo;
 
-	WriteHeader_t tWriteHeader;
-	tWriteHeader.m_pSettings = &pSettings->m_tSettings;
-	tWriteHeader.m_pSchema = &pSettings->m_tSchema;
-	tWriteHeader.m_pTokenizer = pSettings->m_pTokenizer;
-	tWriteHeader.m_pDict = pSettings->m_pDict;
-	tWriteHeader.m_pFieldFilter = pSettings->m_pFieldFilter.get();
-	tWriteHeader.m_pFieldLens = pSettings->m_dFieldLens.Begin();
+		// kills directed to the index while we collect alive rows must be reapplied at the finish
+		tMonitor.SetEvent ( MergeCb_c::E_COLLECT_START, pIndex->m_iChunk );
+		int64_t iDocsBefore = iTotalDocs;
+		ARRAY_FOREACH ( iRow, dRows[i] )
+			if ( !pIndex->m_tDeadRowMap.IsSet ( iRow ) )
+				dRows[i][iRow] = (RowID_t)iTotalDocs++;
+		tMonitor.SetEvent ( MergeCb_c::E_COLLECT_FINISHED, pIndex->m_iChunk );
 
-	IndexBuildDone ( tBuildHeader, tWriteHeader, pDstIndex->GetTmpFilename ( SPH_EXT_SPH ), sError );
+		dAlive[i] = DWORD ( iTotalDocs - iDocsBefore );
+		if ( iTotalDocs >= INVALID_ROWID )
+			return false; // too many docs in merged segment (>4G even with killed), abort.
+	}
 
-	// we're done; clean all deferred deletes
-	tDict.SetPersistent();
-	dDeleteOnInterrupt.Reset();
+	BuildHeader_t tBuildHeader ( pDstIndex->m_tStats );
 
-	return true;
+	StrVec_t dDeleteOnInterrupt;
+	AT_SCOPE_EXIT ( [&dDeleteOnInterrupt]
+	{
+		dDeleteOnInterrupt.for_each ( [] ( const auto & sFile )
+		{
+			if ( !sFile.IsEmpty() && sphFileExists ( sFile.cstr() ) )
+				::unlink ( sFile.cstr() );
+		} );
+	});
+
+	// merging attributes, docstore and secondary indexes of all the sources in one pass
+	{
+		AttrMerger_c tAttrMerger { tMonitor, sError, iTotalDocs };
+		if ( !tAttrMerger.Prepare ( pSettings, pDstIndex ) )
+			return false;
+
+		ARRAY_FOREACH ( i, dIndexes )
+			if ( !tAttrMerger.CopyAttributes ( *dIndexes[i], dRows[i], dAlive[i] ) )
+				return false;
+
+		if ( !tAttrMerger.FinishMergeAttributes ( pDstIndex, tBuildHeader, &dDeleteOnInterrupt ) )
+			return false;
+	}
+
+	// N-way merge of dictionaries, doclists and hitlists
+	return MergeDictionaries ( pDstIndex, pSettings, tBuildHeader, dDeleteOnInterrupt, sError, tMonitor, [&] ( CSphHitBuilder * pHitBuilder )
+	{
+		bool bOk = false;
+		if ( pSettings->m_pDict->GetSettings().m_bWordDict )
+			WITH_QWORD ( pDstIndex, false, Qword, bOk = CSphIndex_VLN::MergeWordsMany<Qword> ( dIndexes, dRows, pHitBuilder, sError, tProgress ) );
+		else
+			WITH_QWORD ( pDstIndex, true, Qword, bOk = CSphIndex_VLN::MergeWordsMany<Qword> ( dIndexes, dRows, pHitBuilder, sError, tProgress ) );
+		return bOk;
+	});
 }
 
 
-bool sphMerge ( const CSphIndex * pDst, const CSphIndex * pSrc, VecTraits_T<CSphFilterSettings> dFilters, CSphIndexProgress & tProgress, CSphString& sError )
+bool sphMerge ( const VecTraits_T<const CSphIndex *> & dIndexes, CSphIndexProgress & tProgress, CSphString & sError )
 {
-	auto pDstIndex = (const CSphIndex_VLN*) pDst;
-	auto pSrcIndex = (const CSphIndex_VLN*) pSrc;
+	CSphFixedVector<const CSphIndex_VLN *> dVlnIndexes { dIndexes.GetLength() };
+	ARRAY_FOREACH ( i, dIndexes )
+		dVlnIndexes[i] = (const CSphIndex_VLN *)dIndexes[i];
 
-	std::unique_ptr<ISphFilter> pFilter = pDstIndex->CreateMergeFilters ( dFilters );
-	return CSphIndex_VLN::DoMerge ( pDstIndex, pSrcIndex, pFilter.get(), sError, tProgress, dFilters.IsEmpty(), false );
+	return CSphIndex_VLN::DoMergeMany ( dVlnIndexes, sError, tProgress );
 }
 
 template < typename QWORD >
@@ -7298,6 +7757,68 @@ void CSphQueryContext::CalcItem ( CSphMatch & tMatch, const CalcItem_t & tCalc )
 	CalcContextItem ( tMatch, tCalc );
 }
 
+/// evaluate item in blocks via batch expression interface, then store results into matches
+template<typename T, typename EVAL, typename STORE>
+static void CalcContextItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, EVAL && fnEval, STORE && fnStore )
+{
+	const int BATCH_SIZE = 128;
+	T dValues[BATCH_SIZE];
+	for ( int iStart = 0; iStart<dMatches.GetLength(); iStart += BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, BATCH_SIZE );
+		fnEval ( dChunk, dValues );
+		ARRAY_FOREACH ( i, dChunk )
+			fnStore ( *dChunk[i], dValues[i] );
+	}
+}
+
+
+void CSphQueryContext::CalcFilterBatch ( const VecTraits_T<CSphMatch *> & dMatches ) const
+{
+	// item by item, so that any item sees the values of the preceding ones, as with per-match evaluation
+	for ( const auto & tItem : m_dCalcFilter )
+		CalcItemBatch ( dMatches, tItem );
+}
+
+
+void CSphQueryContext::CalcSortBatch ( const VecTraits_T<CSphMatch *> & dMatches ) const
+{
+	for ( const auto & tItem : m_dCalcSort )
+		CalcItemBatch ( dMatches, tItem );
+}
+
+
+void CSphQueryContext::CalcItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, const CalcItem_t & tCalc ) const
+{
+	const ISphExpr * pExpr = tCalc.m_pExpr;
+	const CSphAttrLocator & tLoc = tCalc.m_tLoc;
+	switch ( tCalc.m_eType )
+	{
+	case SPH_ATTR_BOOL:
+	case SPH_ATTR_INTEGER:
+	case SPH_ATTR_TIMESTAMP:
+		CalcContextItemBatch<int> ( dMatches, [pExpr] ( auto & dChunk, int * pOut ) { pExpr->IntEvalBatch ( dChunk, pOut ); },
+			[&tLoc] ( CSphMatch & tMatch, int iValue ) { tMatch.SetAttr ( tLoc, iValue ); } );
+		break;
+
+	case SPH_ATTR_BIGINT:
+	case SPH_ATTR_UINT64:
+		CalcContextItemBatch<int64_t> ( dMatches, [pExpr] ( auto & dChunk, int64_t * pOut ) { pExpr->Int64EvalBatch ( dChunk, pOut ); },
+			[&tLoc] ( CSphMatch & tMatch, int64_t iValue ) { tMatch.SetAttr ( tLoc, iValue ); } );
+		break;
+
+	case SPH_ATTR_FLOAT:
+		CalcContextItemBatch<float> ( dMatches, [pExpr] ( auto & dChunk, float * pOut ) { pExpr->EvalBatch ( dChunk, pOut ); },
+			[&tLoc] ( CSphMatch & tMatch, float fValue ) { tMatch.SetAttrFloat ( tLoc, fValue ); } );
+		break;
+
+	default: // strings, mvas, factors etc have no batch form
+		for ( CSphMatch * pMatch : dMatches )
+			CalcContextItem ( *pMatch, tCalc );
+		break;
+	}
+}
+
 
 static inline void FreeDataPtrAttrs ( CSphMatch & tMatch, const CSphVector<CSphQueryContext::CalcItem_t> & dItems, const IntVec_t & dItemIndexes )
 {
@@ -7436,7 +7957,7 @@ void CSphQueryContext::SetupExtraData ( ISphRanker * pRanker, ISphMatchSorter *
 
 
 template<bool USE_KLIST, bool RANDOMIZE, bool USE_FACTORS, bool HAS_SORT_CALC, bool HAS_WEIGHT_FILTER, bool HAS_FILTER_CALC, bool HAS_CUTOFF>
-void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *> & dSorters, ISphRanker * pRanker, int iTag, int iIndexWeight, int iCutoff ) const
+void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *> & dSorters, ISphRanker * pRanker, int iTag, int iIndexWeight, int iCutoff, ISphMatchSorter * pPruningSorter ) const
 {
 	if ( !iCutoff )
 		return;
@@ -7449,6 +7970,8 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 
 	// do searching
 	CSphMatch * pMatch = pRanker->GetMatchesBuffer();
+	CSphVector<CSphMatch *> dBlock;
+	int iMinWeight = INT_MIN;
 	while (true)
 	{
 		// ranker does profile switches internally in GetMatches()
@@ -7458,6 +7981,7 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 
 		SwitchProfile ( pProfile, SPH_QSTATE_SORT );
 
+		dBlock.Resize(0);
 		for ( int i=0; i<iMatches; i++ )
 		{
 			CSphMatch & tMatch = pMatch[i];
@@ -7468,9 +7992,16 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 			}
 
 			tMatch.m_iWeight *= iIndexWeight;
+			dBlock.Add ( &tMatch );
+		}
 
-			if constexpr ( HAS_SORT_CALC )
-				tCtx.CalcSort ( tMatch );
+		// sort expressions are evaluated over the whole block, one batch call per expression node
+		if constexpr ( HAS_SORT_CALC )
+			tCtx.CalcSortBatch ( dBlock );
+
+		ARRAY_FOREACH ( iMatch, dBlock )
+		{
+			CSphMatch & tMatch = *dBlock[iMatch];
 
 			if constexpr ( HAS_WEIGHT_FILTER )
 			{
@@ -7526,7 +8057,12 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 			if constexpr ( HAS_CUTOFF )
 			{
 				if ( bNewMatch && --iCutoff==0 )
+				{
+					if constexpr ( HAS_SORT_CALC )
+						dBlock.Slice ( iMatch+1 ).for_each ( [&tCtx] ( CSphMatch * pRest ) { tCtx.FreeDataSort ( *pRest ); } );
+
 					break;
+				}
 			}
 		}
 
@@ -7535,6 +8071,9 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 			if ( !iCutoff )
 				break;
 		}
+
+		if ( pPruningSorter )
+			UpdatePruningThreshold ( pPruningSorter, pRanker, iIndexWeight, iMinWeight );
 	}
 }
 
@@ -7575,43 +8114,28 @@ struct SphFinalMatchCalc_t final : MatchProcessor_i, ISphNoncopyable
 
 	void Process ( VecTraits_T<CSphMatch *> & dMatches ) final
 	{
-		CSphVector<CSphQueryContext::CalcItem_t *> dColumnWise, dRowWise;
-
-		// process columnar items in column-wise order (and the rest in rowwise order)
-		for ( auto & i : m_tCtx.m_dCalcFinal )
-			if ( i.m_pExpr->IsColumnar() )
-				dColumnWise.Add(&i);
-			else
-				dRowWise.Add(&i);
-
-		for ( const auto & pItem : dColumnWise )
-			for ( auto & pMatch : dMatches )
-			{
-				assert(pMatch);
-				if ( pMatch->m_iTag>=0 )
-					continue;
-
-				m_tCtx.CalcItem ( *pMatch, *pItem );
-			}
-
-		for ( auto & pMatch : dMatches )
-			for ( const auto & pItem : dRowWise )
-			{
-				assert(pMatch);
-				if ( pMatch->m_iTag>=0 )
-					continue;
-
-				m_tCtx.CalcItem ( *pMatch, *pItem );
-			}
-
+		CSphVector<CSphMatch *> dPending;
+		dPending.Reserve ( dMatches.GetLength() );
 		for ( auto & pMatch : dMatches )
 		{
 			assert(pMatch);
-			if ( pMatch->m_iTag>=0 )
-				continue;
+			if ( pMatch->m_iTag<0 )
+				dPending.Add ( pMatch );
+		}
+
+		// process columnar items first, in column-wise order; then the rest, in batches, item by item
+		// rowwise items keep their relative order, so any of them sees the values of the preceding ones
+		for ( const auto & tItem : m_tCtx.m_dCalcFinal )
+			if ( tItem.m_pExpr->IsColumnar() )
+				for ( auto & pMatch : dPending )
+					m_tCtx.CalcItem ( *pMatch, tItem );
 
+		for ( const auto & tItem : m_tCtx.m_dCalcFinal )
+			if ( !tItem.m_pExpr->IsColumnar() )
+				m_tCtx.CalcItemBatch ( dPending, tItem );
+
+		for ( auto & pMatch : dPending )
 			pMatch->m_iTag = m_iTag;
-		}
 	}
 };
 
@@ -7696,16 +8220,9 @@ template <>
 bool RowIterator_T<true>::GetNextRowIdBlock ( RowIdBlock_t & dRowIdBlock )
 {
 	RowID_t * pRowIdStart = m_dCollected.Begin();
-	RowID_t * pRowIdMax = pRowIdStart + Min ( m_iRowsLeft, m_dCollected.GetLength() );
 	RowID_t * pRowID = pRowIdStart;
-
-	while ( pRowID<pRowIdMax && m_tRowID<=m_tBoundaries.m_tMaxRowID )
-	{
-		if ( !m_tDeadRowMap.IsSet(m_tRowID) )
-			*pRowID++ = m_tRowID;
-
-		m_tRowID++;
-	}
+	if ( m_tRowID<=m_tBoundaries.m_tMaxRowID )
+		pRowID += m_tDeadRowMap.CollectAlive ( m_tRowID, m_tBoundaries.m_tMaxRowID, pRowIdStart, Min ( m_iRowsLeft, m_dCollected.GetLength() ) );
 
 	m_iRowsLeft = Max ( m_iRowsLeft - int(pRowID-pRowIdStart), 0 );
 	return ReturnIteratorResult ( pRowID, pRowIdStart, dRowIdBlock );
@@ -7747,17 +8264,7 @@ public:
 			return false;
 
 		m_dCollected.Resize ( dIteratorRowIDs.GetLength() );
-
-		RowID_t * pRowIdStart = m_dCollected.Begin();
-		RowID_t * pRowID = pRowIdStart;
-
-		for ( auto i : dIteratorRowIDs )
-		{
-			if ( !m_tDeadRowMap.IsSet(i) )
-				*pRowID++ = i;
-		}
-
-		dRowIdBlock = RowIdBlock_t ( pRowIdStart, pRowID - pRowIdStart );
+		dRowIdBlock = RowIdBlock_t ( m_dCollected.Begin(), m_tDeadRowMap.FilterAlive ( dIteratorRowIDs, m_dCollected.Begin() ) );
 		return true;	// always return true, even if all values were filtered out. next call will fetch more values
 	}
 
@@ -7781,50 +8288,61 @@ bool Fullscan ( ITERATOR & tIterator, TO_STATIC && fnToStatic, const CSphQueryCo
 	Threads::Coro::HighFreqChecker_c fnHeavyCheck;
 	const int64_t& iCheckTimePoint { Threads::Coro::GetNextTimePointUS() };
 
-	while ( tIterator.GetNextRowIdBlock(dRowIDs) )
-	{
-		for ( auto i : dRowIDs )
-		{
-			tMatch.m_tRowID = i;
-			tMatch.m_pStatic = fnToStatic(i);
-
-			// early filter only (no late filters in full-scan because of no @weight)
-			if constexpr ( HAS_FILTER_CALC )
-				tCtx.CalcFilter(tMatch);
+	// expressions are evaluated over blocks of rows, one batch call per expression node
+	std::unique_ptr<MatchBlock_c> pBlock;
+	if constexpr ( HAS_FILTER_CALC || HAS_SORT_CALC )
+		pBlock = std::make_unique<MatchBlock_c> ( tCtx.m_iDynamicSize );
 
-			if constexpr ( HAS_FILTER )
-			{
-				if ( !tCtx.m_pFilter->Eval(tMatch) )
-				{
-					if_const ( HAS_FILTER_CALC )
-						tCtx.FreeDataFilter ( tMatch );
+	auto fnSetWeight = [iIndexWeight] ( CSphMatch & tMatch )
+	{
+		if constexpr ( HAS_RANDOMIZE )
+			tMatch.m_iWeight = ( sphRand() & 0xffff ) * iIndexWeight;
+	};
 
-					continue;
-				}
-			}
+	auto fnPush = [&dSorters, &iCutoff] ( CSphMatch & tMatch )
+	{
+		bool bNewMatch = false;
+		if constexpr  ( SINGLE_SORTER )
+			bNewMatch = dSorters[0]->Push(tMatch);
+		else
+			dSorters.for_each( [&tMatch, &bNewMatch] ( ISphMatchSorter * p ) { bNewMatch |= p->Push ( tMatch ); } );
 
-			if constexpr ( HAS_RANDOMIZE )
-				tMatch.m_iWeight = ( sphRand() & 0xffff ) * iIndexWeight;
+		if constexpr ( HAS_CUTOFF )
+			return bNewMatch && --iCutoff==0;
 
-			if constexpr ( HAS_SORT_CALC )
-				tCtx.CalcSort(tMatch);
+		return false;
+	};
 
-			bool bNewMatch = false;
-			if constexpr  ( SINGLE_SORTER )
-				bNewMatch = dSorters[0]->Push(tMatch);
-			else
-				dSorters.for_each( [&tMatch, &bNewMatch] ( ISphMatchSorter * p ) { bNewMatch |= p->Push ( tMatch ); } );
+	while ( tIterator.GetNextRowIdBlock(dRowIDs) )
+	{
+		if constexpr ( HAS_FILTER_CALC || HAS_SORT_CALC )
+		{
+			for ( int iStart = 0; iStart<dRowIDs.GetLength(); iStart += MatchBlock_c::MAX_MATCHES )
+			{
+				pBlock->Clear();
+				for ( auto i : dRowIDs.Slice ( iStart, MatchBlock_c::MAX_MATCHES ) )
+					pBlock->Add ( i, fnToStatic(i), tMatch );
 
-			// stringptr expressions should be duplicated (or taken over) at this point
-			if constexpr ( HAS_FILTER_CALC )
-				tCtx.FreeDataFilter ( tMatch );
+				if ( FilterSortAndPush ( tCtx, pBlock->Matches(), fnSetWeight, fnPush ) )
+					return true;
+			}
+		}
+		else
+		{
+			for ( auto i : dRowIDs )
+			{
+				tMatch.m_tRowID = i;
+				tMatch.m_pStatic = fnToStatic(i);
 
-			if constexpr ( HAS_SORT_CALC )
-				tCtx.FreeDataSort ( tMatch );
+				// early filter only (no late filters in full-scan because of no @weight)
+				if constexpr ( HAS_FILTER )
+				{
+					if ( !tCtx.m_pFilter->Eval(tMatch) )
+						continue;
+				}
 
-			if constexpr ( HAS_CUTOFF )
-			{
-				if ( bNewMatch && --iCutoff==0 )
+				fnSetWeight ( tMatch );
+				if ( fnPush ( tMatch ) )
 					return true;
 			}
 		}
@@ -8029,7 +8547,7 @@ static void RecreateFilters ( const CSphVector<SecondaryIndexInfo_t> & dSIInfo,
 	ARRAY_FOREACH ( i, dSIInfo )
 	{
 		bool bRemovedOptional = dFilters[i].m_bOptional && dSIInfo[i].m_eType==SecondaryIndexType_e::NONE;
-		if (  !dSIInfo[i].m_bCreated && !bRemovedOptional )
+		if ( ( !dSIInfo[i].m_bCreated || dSIInfo[i].m_bKeepFilter ) && !bRemovedOptional )
 			dModifiedFilters.Add ( dFilters[i] );
 	}
 
@@ -8131,7 +8649,7 @@ static void RemoveOptionalFilters ( const CSphVector<CSphFilterSettings> & dFilt
 }
 
 
-RowidIterator_i * CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const
+RowidIterator_i * CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker, CostPlan_t * pPlan ) const
 {
 	if ( !dFilters.GetLength() )
 		return nullptr;
@@ -8139,6 +8657,11 @@ RowidIterator_i * CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, cons
 	CSphVector<SecondaryIndexInfo_t> dSIInfo;
 	StrVec_t dWarnings;
 
+	// filters over json paths with typed json_columns copies are estimated (and served by secondary indexes) as filters over these copies
+	// filters themselves are not replaced, so dIteratorFilters matches dFilters one to one
+	CSphVector<CSphFilterSettings> dJsonColumnFilters;
+	const CSphVector<CSphFilterSettings> & dIteratorFilters = RemapJsonColumnFilters ( m_tSchema, dFilters, dJsonColumnFilters ) ? dJsonColumnFilters : dFilters;
+
 	if ( !pRanker )
 	{
 		// In order to maintain some consistency with GetPseudoShardingMetric() we need to do one of the following:
@@ -8146,14 +8669,30 @@ RowidIterator_i * CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, cons
 		// b. Run this with the same number of docs and number of threads as in GetPseudoShardingMetric()
 		// For now we use approach b) as it is simpler
  		float fBestCost = FLT_MAX;
-		SelectIteratorCtx_t tSelectIteratorCtx ( tQuery, dFilters, m_tSchema, tMaxSorterSchema, m_pHistograms, m_pColumnar.get(), m_pSIdx.get(), iCutoff, m_iDocinfo, iThreads );
+		SelectIteratorCtx_t tSelectIteratorCtx ( tQuery, dIteratorFilters, m_tSchema, tMaxSorterSchema, m_pHistograms, m_pColumnar.get(), m_pSIdx.get(), iCutoff, m_iDocinfo, iThreads );
 		dSIInfo = SelectIterators ( tSelectIteratorCtx, fBestCost, dWarnings );
 		if ( dWarnings.GetLength() )
 			tMeta.m_sWarning = ConcatWarnings(dWarnings);
+
+		if ( pPlan && IsCostFeedbackEnabled() )
+		{
+			// fBestCost is the multi-threaded estimate for the whole index, but this call scans a single pseudo-shard
+			// (or the whole index) on one thread. Feedback compares against the single-thread cost of the rows we actually scan
+			SelectIteratorCtx_t tSingleCtx ( tQuery, dIteratorFilters, m_tSchema, tMaxSorterSchema, m_pHistograms, m_pColumnar.get(), m_pSIdx.get(), iCutoff, m_iDocinfo, 1 );
+			std::unique_ptr<CostEstimate_i> pEstimate ( CreateCostEstimate ( dSIInfo, tSingleCtx, dSIInfo.GetLength()>1 ? -1 : iCutoff ) );
+
+			float fFraction = 1.0f;
+			RowIdBoundaries_t tBoundaries;
+			if ( m_iDocinfo && GetRowIdFilter ( dFilters, RowID_t(m_iDocinfo), tBoundaries ) )
+				fFraction = Min ( float ( tBoundaries.m_tMaxRowID-tBoundaries.m_tMinRowID+1 ) / m_iDocinfo, 1.0f );
+
+			pPlan->m_ePath = GetCostPath(dSIInfo);
+			pPlan->m_fCost = pEstimate->CalcQueryCost()*fFraction;
+		}
 	}
 	else
 	{
-		bool bRes = SelectIteratorsFT ( tQuery, dFilters, tMaxSorterSchema, pRanker, dSIInfo, iCutoff, iThreads, dWarnings );
+		bool bRes = SelectIteratorsFT ( tQuery, dIteratorFilters, tMaxSorterSchema, pRanker, dSIInfo, iCutoff, iThreads, dWarnings );
 		if ( dWarnings.GetLength() )
 			tMeta.m_sWarning = ConcatWarnings(dWarnings);
 
@@ -8170,7 +8709,7 @@ RowidIterator_i * CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, cons
 	int iRemovedOptional = CalcRemovedOptionalFilters ( dFilters, dSIInfo );
 
 	// secondary index iterators
-	dSIIterators = CreateSecondaryIndexIterator ( m_pSIdx.get(), dSIInfo, dFilters, tQuery.m_eCollation, tMaxSorterSchema, RowID_t(m_iDocinfo), iCutoff );
+	dSIIterators = CreateSecondaryIndexIterator ( m_pSIdx.get(), dSIInfo, dIteratorFilters, tQuery.m_eCollation, tMaxSorterSchema, RowID_t(m_iDocinfo), iCutoff );
 
 	// lookup-by-id (.SPT) iterators
 	dLookupIterators = CreateLookupIterator ( dSIInfo, dFilters, m_tDocidLookup.GetReadPtr(), RowID_t(m_iDocinfo) );
@@ -8188,6 +8727,10 @@ RowidIterator_i * CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, cons
 	int iCreatedAfterColumnar = 0;
 	dSIInfo.for_each ( [&]( const SecondaryIndexInfo_t & tInfo ){ if ( tInfo.m_bCreated ) iCreatedAfterColumnar++; } );
 
+	// the plan we estimated is not what is going to run; don't learn from it
+	if ( pPlan && dSIInfo.any_of ( []( const SecondaryIndexInfo_t & tInfo ){ return tInfo.m_eType!=SecondaryIndexType_e::FILTER && tInfo.m_eType!=SecondaryIndexType_e::NONE && !tInfo.m_bCreated; } ) )
+		pPlan->m_fCost = 0.0f;
+
 	// if we created an analyzer, we need to recreate filters
 	if ( ( !m_pColumnar && iCreated>0 ) || iCreatedAfterColumnar!=iCreated )
 		RecreateFilters ( dSIInfo, dFilters, tCtx, tFlx, tMeta, dModifiedFilters );
@@ -8367,13 +8910,16 @@ bool CSphIndex_VLN::MultiScan ( CSphQueryResult & tResult, const CSphQuery & tQu
 	// try to spawn an iterator from a secondary index
 	CSphVector<CSphFilterSettings> dFiltersAfterIterator; // holds filter settings if they were modified. filters hold pointers to those settings
 	std::unique_ptr<RowidIterator_i> pIterator;
+	CostPlan_t tPlan;
 	if ( bAllPrecalc )
 		tCtx.m_pFilter.reset();
 	else
-		pIterator = std::unique_ptr<RowidIterator_i> ( SpawnIterators ( tQuery, dTransformedFilters, tCtx, tFlx, tMaxSorterSchema, tMeta, iCutoff, tArgs.m_iTotalThreads, dFiltersAfterIterator, nullptr ) );
+		pIterator = std::unique_ptr<RowidIterator_i> ( SpawnIterators ( tQuery, dTransformedFilters, tCtx, tFlx, tMaxSorterSchema, tMeta, iCutoff, tArgs.m_iTotalThreads, dFiltersAfterIterator, nullptr, &tPlan ) );
 	
 	SwitchProfile ( tMeta.m_pProfile, SPH_QSTATE_FULLSCAN );
 
+	int64_t tmScanStart = sphMicroTimer();
+
 	bool bCutoffHit =  false;
 	if ( pIterator )
 	{
@@ -8410,6 +8956,11 @@ bool CSphIndex_VLN::MultiScan ( CSphQueryResult & tResult, const CSphQuery & tQu
 
 	tMeta.m_bTotalMatchesApprox = bCutoffHit && !bAllPrecalc;
 
+	// feed the time of this scan (filtering and pushing to sorters, the same work the estimate covers; final calc is not included)
+	// back to the cost model; cut off or interrupted scans say nothing about the estimate
+	if ( IsCostFeedbackEnabled() && !bCutoffHit && !sphInterrupted() && ( !tmMaxTimer || sphMicroTimer()<tmMaxTimer ) )
+		CostFeedback ( tPlan, sphMicroTimer()-tmScanStart );
+
 	SwitchProfile ( tMeta.m_pProfile, SPH_QSTATE_FINALIZE );
 
 	// do final expression calculations
@@ -9602,6 +10153,8 @@ void CSphIndex_VLN::Preread()
 	if ( m_bPassedRead )
 		return;
 
+	ScopedIOClass_c tIOClass ( IOClass_e::PREREAD );
+
 	///////////////////
 	// read everything
 	///////////////////
@@ -9725,6 +10278,8 @@ bool CSphQueryContext::SetupCalc ( CSphQueryResultMeta & tMeta, const ISphSchema
 	m_dCalcFilterPtrAttrs.Resize(0);
 	m_dCalcSortPtrAttrs.Resize(0);
 
+	m_iDynamicSize = tInSchema.GetDynamicSize();
+
 	// quickly verify that all my real attributes can be stashed there
 	if ( tInSchema.GetAttrsCount() < tSchema.GetAttrsCount() )
 	{
@@ -10872,6 +11427,7 @@ static bool RunSplitQuery ( RUN && tRun, const CSphQuery & tQuery, CSphQueryResu
 			tMultiArgs.m_uPackedFactorFlags = tArgs.m_uPackedFactorFlags;
 			tMultiArgs.m_pLocalDocs = pLocalDocs;
 			tMultiArgs.m_iTotalDocs = iTotalDocs;
+			tMultiArgs.m_iQcacheTableId = tArgs.m_iQcacheTableId;
 			tMultiArgs.m_bModifySorterSchemas = false;
 			tMultiArgs.m_iTotalThreads = tArgs.m_iTotalThreads;
 
@@ -11353,6 +11909,7 @@ bool CSphIndex_VLN::ParsedMultiQuery ( const CSphQuery & tQuery, CSphQueryResult
 	tCtx.m_pLocalDocs = tArgs.m_pLocalDocs;
 	tCtx.m_iTotalDocs = ( tArgs.m_iTotalDocs ? tArgs.m_iTotalDocs : m_tStats.m_iTotalDocuments );
 	tCtx.m_iIndexTotalDocs = m_iDocinfo;
+	tCtx.m_iQcacheTableId = tArgs.m_iQcacheTableId;
 
 	if ( !tCtx.SetupCalc ( tMeta, tMaxSorterSchema, m_tSchema, m_tBlobAttrs.GetReadPtr(), m_pColumnar.get(), dSorterSchemas ) )
 		return false;
@@ -11400,6 +11957,9 @@ bool CSphIndex_VLN::ParsedMultiQuery ( const CSphQuery & tQuery, CSphQueryResult
 	tTermSetup.m_bHasWideFields = ( m_tSchema.GetFieldsCount()>32 );
 	tMeta.m_bBigram = ( m_tSettings.m_eBigramIndex!=SPH_BIGRAM_NONE );
 
+	ISphMatchSorter * pPruningSorter = GetPruningSorter ( tQuery, dSorters, tArgs.m_iIndexWeight );
+	tTermSetup.m_bDynamicPruning = !!pPruningSorter;
+
 	// setup prediction constrain
 	CSphQueryStats tQueryStats;
 	bool bCollectPredictionCounters = ( tQuery.m_iMaxPredictedMsec>0 );
@@ -11509,13 +12069,15 @@ bool CSphIndex_VLN::ParsedMultiQuery ( const CSphQuery & tQuery, CSphQueryResult
 	bool bHasWeightFilter = !!tCtx.m_pWeightFilter;
 	bool bHasFilterCalc = !tCtx.m_dCalcFilter.IsEmpty();
 	bool bHasCutoff = iCutoff!=-1;
+	if ( bHasCutoff )
+		pPruningSorter = nullptr;
 
 	int iIndex = bUseKlist*64 + bHaveRandom*32 + bUseFactors*16 + bHasSortCalc*8 + bHasWeightFilter*4 + bHasFilterCalc*2 + bHasCutoff;
 
 	switch ( iIndex )
 	{
 #define DECL_FNSCAN( _, n, params ) case n: MatchExtended<!!(n&64), !!(n&32), !!(n&16), !!(n&8), !!(n&4), !!(n&2), !!(n&1)> params; break;
-	BOOST_PP_REPEAT ( 128, DECL_FNSCAN, ( tCtx, tQuery, dSorters, pRanker.get(), iMyTag, tArgs.m_iIndexWeight, iCutoff ) )
+	BOOST_PP_REPEAT ( 128, DECL_FNSCAN, ( tCtx, tQuery, dSorters, pRanker.get(), iMyTag, tArgs.m_iIndexWeight, iCutoff, pPruningSorter ) )
 #undef DECL_FNSCAN
 		default:
 			assert ( 0 && "Internal error" );
@@ -11651,6 +12213,9 @@ void CSphIndex_VLN::GetStatus ( CSphIndexStatus* pRes ) const
 
 	pRes->m_iDead = m_tDeadRowMap.GetNumDeads();
 
+	if ( m_pDocstore )
+		m_pDocstore->GetCacheStats ( pRes->m_iDocstoreCacheHits, pRes->m_iDocstoreCacheMisses );
+
 	if ( m_pDoclistFile )
 	{
 		pRes->m_iMappedDocs = m_pDoclistFile->GetMappedsize ();
@@ -494,12 +494,14 @@ struct CSphQuery
 	bool			m_bNormalizedTFIDF = true;	///< whether to scale IDFs by query word count, so that TF*IDF is normalized
 	bool			m_bLocalDF = false;			///< whether to use calculate DF among local indexes
 	bool			m_bLowPriority = false;		///< set low thread priority for this query
+	bool			m_bDynamicPruning = false;	///< whether bm25-ranked top-k full-text queries may skip docs that can't make it into the result set
 	DWORD			m_uDebugFlags = 0;
 	QueryOption_e	m_eExpandKeywords = QUERY_OPT_DEFAULT;	///< control automatic query-time keyword expansion
 	int				m_iExpansionLimit = DEFAULT_QUERY_EXPANSION_LIMIT;	///< whether to limit wildcard expansion, default use index settings
 
 	bool			m_bAccurateAggregation = false;			///< setting via options
 	bool			m_bExplicitAccurateAggregation = false; ///< whether anything was set via options
+	bool			m_bExactGroupby = false;				///< never drop groups; grow the group table and spill it to disk instead
 
 	int				m_iDistinctThresh = 3500;			///< distinct accuracy thresh
 	bool			m_bExplicitDistinctThresh = false;	///< whether thresh was set via options
@@ -891,6 +893,8 @@ struct CSphIndexStatus
 	int64_t			m_iTID = 0;
 	int64_t			m_iSavedTID = 0;
 	int64_t 		m_iDead = 0;
+	int64_t			m_iDocstoreCacheHits = 0;	// docstore block cache lookups
+	int64_t			m_iDocstoreCacheMisses = 0;
 	double			m_fSaveRateLimit {0.0};	 // not used for plain. Part of m_iMemLimit to be achieved before flushing
 };
 
@@ -903,6 +907,7 @@ struct CSphMultiQueryArgs : public ISphNoncopyable
 	bool									m_bLocalDF = false;
 	const SmallStringHash_T<int64_t> *		m_pLocalDocs = nullptr;
 	int64_t									m_iTotalDocs = 0;
+	int64_t									m_iQcacheTableId = 0;	///< query cache quota owner (RT table of a disk chunk); 0 means the index itself
 	bool									m_bModifySorterSchemas = true;
 	bool									m_bFinalizeSorters = true;
 	int										m_iThreads = 1;
@@ -1104,6 +1109,7 @@ public:
 	virtual const CSphSchema &	GetMatchSchema() const { return m_tSchema; }			///< match schema as returned in result set (possibly different from internal storage schema!)
 
 	void						SetInplaceSettings ( int iHitGap, float fRelocFactor, float fWriteFactor ); // fixme! build only
+	void						SetBuildThreads ( int iThreads ) { m_iBuildThreads = Max ( iThreads, 1 ); } // fixme! build only
 	void						SetFieldFilter ( std::unique_ptr<ISphFieldFilter> pFilter );
 	const ISphFieldFilter *		GetFieldFilter() const { return m_pFieldFilter.get(); }
 	void						SetTokenizer ( TokenizerRefPtr_c pTokenizer );
@@ -1122,6 +1128,7 @@ public:
 	virtual int64_t *			GetFieldLens() const { return nullptr; }
 	virtual bool				IsStarDict ( bool bWordDict ) const;
 	int64_t						GetIndexId() const { return m_iIndexId; }
+	int64_t						GetAttrUpdates() const { return m_iAttrUpdates.load ( std::memory_order_relaxed ); }
 	void						SetMutableSettings ( const MutableIndexSettings_c & tSettings );
 	const MutableIndexSettings_c & GetMutableSettings () const { return m_tMutableSettings; }
 
@@ -1266,6 +1273,7 @@ public:
 
 protected:
 	int64_t						m_iIndexId;				///< internal (per daemon) unique index id, introduced for caching
+	std::atomic<int64_t>		m_iAttrUpdates { 0 };	///< attribute updates counter; query cache results of older versions are never hit
 
 	CSphSchema					m_tSchema;
 	CSphString					m_sLastError;
@@ -1275,6 +1283,7 @@ protected:
 	int							m_iHitGap = 0; // fixme! build only
 	float						m_fRelocFactor { 0.0f }; // fixme! build only
 	float						m_fWriteFactor { 0.0f }; // fixme! build only
+	int							m_iBuildThreads = 1; // fixme! build only
 
 	bool						m_bBinlog = true;
 
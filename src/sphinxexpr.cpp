@@ -135,6 +135,86 @@ protected:
 };
 
 
+void ISphExpr::EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const
+{
+	for ( const CSphMatch * pMatch : dMatches )
+		*pOut++ = Eval ( *pMatch );
+}
+
+
+void ISphExpr::IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const
+{
+	for ( const CSphMatch * pMatch : dMatches )
+		*pOut++ = IntEval ( *pMatch );
+}
+
+
+void ISphExpr::Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const
+{
+	for ( const CSphMatch * pMatch : dMatches )
+		*pOut++ = Int64Eval ( *pMatch );
+}
+
+/// batch eval dispatched by type of the result
+static inline void ExprEvalBatch ( const ISphExpr * pExpr, const VecTraits_T<CSphMatch *> & dMatches, float * pOut )		{ pExpr->EvalBatch ( dMatches, pOut ); }
+static inline void ExprEvalBatch ( const ISphExpr * pExpr, const VecTraits_T<CSphMatch *> & dMatches, int * pOut )			{ pExpr->IntEvalBatch ( dMatches, pOut ); }
+static inline void ExprEvalBatch ( const ISphExpr * pExpr, const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut )		{ pExpr->Int64EvalBatch ( dMatches, pOut ); }
+
+/// max matches evaluated at once by composite nodes (args are kept on stack)
+static const int EXPR_BATCH_SIZE = 128;
+
+/// evaluate arg in batches, then transform values with a tight loop
+template<typename T, typename ARG, typename OP>
+static void UnaryBatch ( const ISphExpr * pArg, const VecTraits_T<CSphMatch *> & dMatches, T * pOut, OP && fnOp )
+{
+	ARG dArg[EXPR_BATCH_SIZE];
+	for ( int iStart = 0; iStart<dMatches.GetLength(); iStart += EXPR_BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, EXPR_BATCH_SIZE );
+		ExprEvalBatch ( pArg, dChunk, dArg );
+
+		T * pChunkOut = pOut + iStart;
+		for ( int i = 0, iLen = (int)dChunk.GetLength(); i<iLen; ++i )
+			pChunkOut[i] = fnOp ( dArg[i] );
+	}
+}
+
+/// evaluate both args in batches, then combine them with a tight loop (which compiler is able to auto-vectorize)
+template<typename T, typename OP>
+static void BinaryBatch ( const ISphExpr * pFirst, const ISphExpr * pSecond, const VecTraits_T<CSphMatch *> & dMatches, T * pOut, OP && fnOp )
+{
+	T dSecond[EXPR_BATCH_SIZE];
+	for ( int iStart = 0; iStart<dMatches.GetLength(); iStart += EXPR_BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, EXPR_BATCH_SIZE );
+		T * pChunkOut = pOut + iStart;
+		ExprEvalBatch ( pFirst, dChunk, pChunkOut );
+		ExprEvalBatch ( pSecond, dChunk, dSecond );
+
+		for ( int i = 0, iLen = (int)dChunk.GetLength(); i<iLen; ++i )
+			pChunkOut[i] = fnOp ( pChunkOut[i], dSecond[i] );
+	}
+}
+
+/// same as above, but args are evaluated in the type other than the result (i.e. comparisons)
+template<typename T, typename ARG, typename OP>
+static void BinaryBatchArg ( const ISphExpr * pFirst, const ISphExpr * pSecond, const VecTraits_T<CSphMatch *> & dMatches, T * pOut, OP && fnOp )
+{
+	ARG dFirst[EXPR_BATCH_SIZE];
+	ARG dSecond[EXPR_BATCH_SIZE];
+	for ( int iStart = 0; iStart<dMatches.GetLength(); iStart += EXPR_BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, EXPR_BATCH_SIZE );
+		ExprEvalBatch ( pFirst, dChunk, dFirst );
+		ExprEvalBatch ( pSecond, dChunk, dSecond );
+
+		T * pChunkOut = pOut + iStart;
+		for ( int i = 0, iLen = (int)dChunk.GetLength(); i<iLen; ++i )
+			pChunkOut[i] = fnOp ( dFirst[i], dSecond[i] );
+	}
+}
+
+
 const BYTE * ISphExpr::StringEvalPacked ( const CSphMatch & tMatch ) const
 {
 	const BYTE * pStr = nullptr;
@@ -185,6 +265,10 @@ public:
 	int IntEval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int64_t)tMatch.GetAttr ( m_tLocator ); }
 
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ for ( const CSphMatch * p : dMatches ) *pOut++ = (float)p->GetAttr ( m_tLocator ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final			{ for ( const CSphMatch * p : dMatches ) *pOut++ = (int)p->GetAttr ( m_tLocator ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ for ( const CSphMatch * p : dMatches ) *pOut++ = (int64_t)p->GetAttr ( m_tLocator ); }
+
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
 		EXPR_CLASS_NAME("Expr_GetInt_c");
@@ -209,6 +293,10 @@ public:
 	int IntEval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int64_t)tMatch.GetAttr ( m_tLocator ); }
 
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ for ( const CSphMatch * p : dMatches ) *pOut++ = (float)p->GetAttr ( m_tLocator ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final			{ for ( const CSphMatch * p : dMatches ) *pOut++ = (int)p->GetAttr ( m_tLocator ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ for ( const CSphMatch * p : dMatches ) *pOut++ = (int64_t)p->GetAttr ( m_tLocator ); }
+
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
 		EXPR_CLASS_NAME("Expr_GetBits_c");
@@ -233,6 +321,10 @@ public:
 	int IntEval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ for ( const CSphMatch * p : dMatches ) *pOut++ = (float)(int)p->GetAttr ( m_tLocator ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final			{ for ( const CSphMatch * p : dMatches ) *pOut++ = (int)p->GetAttr ( m_tLocator ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ for ( const CSphMatch * p : dMatches ) *pOut++ = (int)p->GetAttr ( m_tLocator ); }
+
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
 		EXPR_CLASS_NAME("Expr_GetSint_c");
@@ -254,6 +346,7 @@ class Expr_GetFloat_c : public Expr_WithLocator_c
 public:
 	Expr_GetFloat_c ( const CSphAttrLocator & tLocator, int iLocator ) : Expr_WithLocator_c ( tLocator, iLocator ) {}
 	float Eval ( const CSphMatch & tMatch ) const final { return tMatch.GetAttrFloat ( m_tLocator ); }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final { for ( const CSphMatch * p : dMatches ) *pOut++ = p->GetAttrFloat ( m_tLocator ); }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
@@ -404,6 +497,9 @@ public:
 	float Eval ( const CSphMatch & ) const final { return m_fValue; }
 	int IntEval ( const CSphMatch & ) const final { return (int)m_fValue; }
 	int64_t Int64Eval ( const CSphMatch & ) const final { return (int64_t)m_fValue; }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ VecTraits_T<float> ( pOut, dMatches.GetLength() ).Fill ( m_fValue ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final			{ VecTraits_T<int> ( pOut, dMatches.GetLength() ).Fill ( (int)m_fValue ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ VecTraits_T<int64_t> ( pOut, dMatches.GetLength() ).Fill ( (int64_t)m_fValue ); }
 	bool IsConst () const final { return true; }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -435,6 +531,9 @@ public:
 	float Eval ( const CSphMatch & ) const final { return (float) m_iValue; } // no assert() here cause generic float Eval() needs to work even on int-evaluator tree
 	int IntEval ( const CSphMatch & ) const final { return m_iValue; }
 	int64_t Int64Eval ( const CSphMatch & ) const final { return m_iValue; }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ VecTraits_T<float> ( pOut, dMatches.GetLength() ).Fill ( (float)m_iValue ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final			{ VecTraits_T<int> ( pOut, dMatches.GetLength() ).Fill ( m_iValue ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ VecTraits_T<int64_t> ( pOut, dMatches.GetLength() ).Fill ( (int64_t)m_iValue ); }
 	bool IsConst () const final { return true; }
 	
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -466,6 +565,8 @@ public:
 	float Eval ( const CSphMatch & ) const final { return (float) m_iValue; } // no assert() here cause generic float Eval() needs to work even on int-evaluator tree
 	int IntEval ( const CSphMatch & ) const final { assert ( 0 ); return (int)m_iValue; }
 	int64_t Int64Eval ( const CSphMatch & ) const final { return m_iValue; }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ VecTraits_T<float> ( pOut, dMatches.GetLength() ).Fill ( (float)m_iValue ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ VecTraits_T<int64_t> ( pOut, dMatches.GetLength() ).Fill ( m_iValue ); }
 	bool IsConst () const final { return true; }
 	
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -3322,13 +3423,96 @@ DECLARE_END()
 #define IFFLT(_expr)	( (_expr) ? 1.0f : 0.0f )
 #define IFINT(_expr)	( (_expr) ? 1 : 0 )
 
-DECLARE_BINARY_INT ( Expr_Add_c,	FIRST + SECOND,						(DWORD)INTFIRST + (DWORD)INTSECOND,				(uint64_t)INT64FIRST + (uint64_t)INT64SECOND )
-DECLARE_BINARY_INT ( Expr_Sub_c,	FIRST - SECOND,						(DWORD)INTFIRST - (DWORD)INTSECOND,				(uint64_t)INT64FIRST - (uint64_t)INT64SECOND )
-DECLARE_BINARY_INT ( Expr_Mul_c,	FIRST * SECOND,						(DWORD)INTFIRST * (DWORD)INTSECOND,				(uint64_t)INT64FIRST * (uint64_t)INT64SECOND )
+// batch forms; ops are written in terms of evaluated args 'a' and 'b'
+#define DECLARE_BINARY_BATCH_FLT(_op) \
+		void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final { BinaryBatch ( m_pFirst, m_pSecond, dMatches, pOut, [] ( float a, float b ) -> float { return _op; } ); }
+
+#define DECLARE_BINARY_BATCH_INT(_op) \
+		void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final { BinaryBatch ( m_pFirst, m_pSecond, dMatches, pOut, [] ( int a, int b ) -> int { return _op; } ); }
+
+#define DECLARE_BINARY_BATCH_INT64(_op) \
+		void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final { BinaryBatch ( m_pFirst, m_pSecond, dMatches, pOut, [] ( int64_t a, int64_t b ) -> int64_t { return _op; } ); }
+
+#define DECLARE_BINARY_BATCH_CMP(_argtype,_op) \
+		void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final { BinaryBatchArg<int,_argtype> ( m_pFirst, m_pSecond, dMatches, pOut, [] ( _argtype a, _argtype b ) -> int { return _op; } ); }
+
+// arithmetic with batch forms
+#define DECLARE_BINARY_OP(_classname,_op,_op2,_op3) \
+		DECLARE_BINARY_TRAITS ( _classname ) \
+		float Eval ( const CSphMatch & tMatch ) const final { float a = FIRST; float b = SECOND; return _op; } \
+		int IntEval ( const CSphMatch & tMatch ) const final { int a = INTFIRST; int b = INTSECOND; return _op2; } \
+		int64_t Int64Eval ( const CSphMatch & tMatch ) const final { int64_t a = INT64FIRST; int64_t b = INT64SECOND; return _op3; } \
+		DECLARE_BINARY_BATCH_FLT ( _op ) \
+		DECLARE_BINARY_BATCH_INT ( _op2 ) \
+		DECLARE_BINARY_BATCH_INT64 ( _op3 ) \
+	};
+
+// comparison with batch forms; args are evaluated in the type of the node, result is 0 or 1
+#define DECLARE_BINARY_CMP(_classname,_op,_op2,_op3) \
+	DECLARE_BINARY_TRAITS ( _classname##Float_c ) \
+		float Eval ( const CSphMatch & tMatch ) const final { float a = FIRST; float b = SECOND; return IFFLT ( _op ); } \
+		int IntEval ( const CSphMatch & tMatch ) const final { return (int)Eval(tMatch); } \
+		int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int64_t)Eval(tMatch); } \
+		DECLARE_BINARY_BATCH_FLT ( IFFLT ( _op ) ) \
+		DECLARE_BINARY_BATCH_CMP ( float, IFINT ( _op ) ) \
+	}; \
+	DECLARE_BINARY_TRAITS ( _classname##Int_c ) \
+		float Eval ( const CSphMatch & tMatch ) const final { return (float)IntEval(tMatch); } \
+		int IntEval ( const CSphMatch & tMatch ) const final { int a = INTFIRST; int b = INTSECOND; return IFINT ( _op2 ); } \
+		int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int64_t)IntEval(tMatch); } \
+		DECLARE_BINARY_BATCH_INT ( IFINT ( _op2 ) ) \
+	}; \
+	DECLARE_BINARY_TRAITS ( _classname##Int64_c ) \
+		float Eval ( const CSphMatch & tMatch ) const final { return (float)Int64Eval(tMatch); } \
+		int IntEval ( const CSphMatch & tMatch ) const final { return (int)Int64Eval(tMatch); } \
+		int64_t Int64Eval ( const CSphMatch & tMatch ) const final { int64_t a = INT64FIRST; int64_t b = INT64SECOND; return IFINT ( _op3 ); } \
+		DECLARE_BINARY_BATCH_INT64 ( IFINT ( _op3 ) ) \
+		DECLARE_BINARY_BATCH_CMP ( int64_t, IFINT ( _op3 ) ) \
+	};
+
+DECLARE_BINARY_OP ( Expr_Add_c,		a + b,		(DWORD)a + (DWORD)b,		(uint64_t)a + (uint64_t)b )
+DECLARE_BINARY_OP ( Expr_Sub_c,		a - b,		(DWORD)a - (DWORD)b,		(uint64_t)a - (uint64_t)b )
+DECLARE_BINARY_OP ( Expr_Mul_c,		a * b,		(DWORD)a * (DWORD)b,		(uint64_t)a * (uint64_t)b )
 DECLARE_BINARY_INT ( Expr_BitAnd_c,	(float)(int(FIRST)&int(SECOND)),	INTFIRST & INTSECOND,				INT64FIRST & INT64SECOND )
 DECLARE_BINARY_INT ( Expr_BitOr_c,	(float)(int(FIRST)|int(SECOND)),	INTFIRST | INTSECOND,				INT64FIRST | INT64SECOND )
 DECLARE_BINARY_INT ( Expr_Mod_c,	(float)(int(FIRST)%int(SECOND)),	INTFIRST % INTSECOND,				INT64FIRST % INT64SECOND )
 
+/// evaluate divisor in batches, then dividend only over the matches where divisor is non-zero (exactly as scalar Eval does)
+static void DivBatch ( const ISphExpr * pFirst, const ISphExpr * pSecond, const VecTraits_T<CSphMatch *> & dMatches, float * pOut )
+{
+	float dFirst[EXPR_BATCH_SIZE];
+	float dSecond[EXPR_BATCH_SIZE];
+	CSphMatch * dNonZero[EXPR_BATCH_SIZE];
+	int dIndexes[EXPR_BATCH_SIZE];
+
+	for ( int iStart = 0; iStart<dMatches.GetLength(); iStart += EXPR_BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, EXPR_BATCH_SIZE );
+		ExprEvalBatch ( pSecond, dChunk, dSecond );
+
+		// ideally this would be SQLNULL instead of plain 0.0f
+		float * pChunkOut = pOut + iStart;
+		int iNonZero = 0;
+		for ( int i = 0, iLen = (int)dChunk.GetLength(); i<iLen; ++i )
+		{
+			pChunkOut[i] = 0.0f;
+			if ( dSecond[i]!=0.0f )
+			{
+				dNonZero[iNonZero] = dChunk[i];
+				dIndexes[iNonZero++] = i;
+			}
+		}
+
+		if ( !iNonZero )
+			continue;
+
+		ExprEvalBatch ( pFirst, VecTraits_T<CSphMatch *> ( dNonZero, iNonZero ), dFirst );
+		for ( int i = 0; i<iNonZero; ++i )
+			pChunkOut[dIndexes[i]] = dFirst[i]/dSecond[dIndexes[i]];
+	}
+}
+
+
 DECLARE_BINARY_TRAITS ( Expr_Div_c )
 	   float Eval ( const CSphMatch & tMatch ) const final
 	   {
@@ -3336,6 +3520,8 @@ DECLARE_BINARY_TRAITS ( Expr_Div_c )
 			   // ideally this would be SQLNULL instead of plain 0.0f
 			   return fSecond!=0.0f ? m_pFirst->Eval ( tMatch )/fSecond : 0.0f;
 	   }
+
+	   void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final { DivBatch ( m_pFirst, m_pSecond, dMatches, pOut ); }
 DECLARE_END()
 
 DECLARE_BINARY_TRAITS ( Expr_Idiv_c )
@@ -3361,15 +3547,15 @@ DECLARE_BINARY_TRAITS ( Expr_Idiv_c )
 	}
 DECLARE_END()
 
-DECLARE_BINARY_POLY ( Expr_Lt,		IFFLT ( FIRST<SECOND ),					IFINT ( INTFIRST<INTSECOND ),		IFINT ( INT64FIRST<INT64SECOND ) )
-DECLARE_BINARY_POLY ( Expr_Gt,		IFFLT ( FIRST>SECOND ),					IFINT ( INTFIRST>INTSECOND ),		IFINT ( INT64FIRST>INT64SECOND ) )
-DECLARE_BINARY_POLY ( Expr_Lte,		IFFLT ( FIRST<=SECOND ),				IFINT ( INTFIRST<=INTSECOND ),		IFINT ( INT64FIRST<=INT64SECOND ) )
-DECLARE_BINARY_POLY ( Expr_Gte,		IFFLT ( FIRST>=SECOND ),				IFINT ( INTFIRST>=INTSECOND ),		IFINT ( INT64FIRST>=INT64SECOND ) )
-DECLARE_BINARY_POLY ( Expr_Eq,		IFFLT ( fabs ( FIRST-SECOND )<=1e-6 ),	IFINT ( INTFIRST==INTSECOND ),		IFINT ( INT64FIRST==INT64SECOND ) )
-DECLARE_BINARY_POLY ( Expr_Ne,		IFFLT ( fabs ( FIRST-SECOND )>1e-6 ),	IFINT ( INTFIRST!=INTSECOND ),		IFINT ( INT64FIRST!=INT64SECOND ) )
+DECLARE_BINARY_CMP ( Expr_Lt,		a<b,					a<b,		a<b )
+DECLARE_BINARY_CMP ( Expr_Gt,		a>b,					a>b,		a>b )
+DECLARE_BINARY_CMP ( Expr_Lte,		a<=b,					a<=b,		a<=b )
+DECLARE_BINARY_CMP ( Expr_Gte,		a>=b,					a>=b,		a>=b )
+DECLARE_BINARY_CMP ( Expr_Eq,		fabs ( a-b )<=1e-6,		a==b,		a==b )
+DECLARE_BINARY_CMP ( Expr_Ne,		fabs ( a-b )>1e-6,		a!=b,		a!=b )
 
-DECLARE_BINARY_INT ( Expr_Min_c,	Min ( FIRST, SECOND ),					Min ( INTFIRST, INTSECOND ),		Min ( INT64FIRST, INT64SECOND ) )
-DECLARE_BINARY_INT ( Expr_Max_c,	Max ( FIRST, SECOND ),					Max ( INTFIRST, INTSECOND ),		Max ( INT64FIRST, INT64SECOND ) )
+DECLARE_BINARY_OP ( Expr_Min_c,		Min ( a, b ),			Min ( a, b ),		Min ( a, b ) )
+DECLARE_BINARY_OP ( Expr_Max_c,		Max ( a, b ),			Max ( a, b ),		Max ( a, b ) )
 DECLARE_BINARY_FLT ( Expr_Pow_c,	float ( pow ( FIRST, SECOND ) ) )
 
 DECLARE_BINARY_POLY ( Expr_And,		FIRST!=0.0f && SECOND!=0.0f,		IFINT ( INTFIRST && INTSECOND ),	IFINT ( INT64FIRST && INT64SECOND ) )
@@ -3447,7 +3633,60 @@ protected:
 		ISphExpr* Clone() const final { return new _classname(*this); } \
 	};
 
-DECLARE_TERNARY ( Expr_If_c,	( FIRST!=0.0f ) ? SECOND : THIRD,	INTFIRST ? INTSECOND : INTTHIRD,	INT64FIRST ? INT64SECOND : INT64THIRD )
+/// evaluate condition in batches, then every branch in batch, but only over the matches which selected it (exactly as IF() does)
+template<typename T>
+static void IfBatch ( const ISphExpr * pCond, const ISphExpr * pTrue, const ISphExpr * pFalse, const VecTraits_T<CSphMatch *> & dMatches, T * pOut )
+{
+	T dCond[EXPR_BATCH_SIZE];
+	T dValues[EXPR_BATCH_SIZE];
+	CSphMatch * dBranch[EXPR_BATCH_SIZE];
+	int dIndexes[EXPR_BATCH_SIZE];
+
+	for ( int iStart = 0; iStart<dMatches.GetLength(); iStart += EXPR_BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, EXPR_BATCH_SIZE );
+		ExprEvalBatch ( pCond, dChunk, dCond );
+
+		T * pChunkOut = pOut + iStart;
+		for ( bool bTrue : { true, false } )
+		{
+			int iBranch = 0;
+			for ( int i = 0, iLen = (int)dChunk.GetLength(); i<iLen; ++i )
+				if ( ( dCond[i]!=0 )==bTrue )
+				{
+					dBranch[iBranch] = dChunk[i];
+					dIndexes[iBranch++] = i;
+				}
+
+			if ( !iBranch )
+				continue;
+
+			ExprEvalBatch ( bTrue ? pTrue : pFalse, VecTraits_T<CSphMatch *> ( dBranch, iBranch ), dValues );
+			for ( int i = 0; i<iBranch; ++i )
+				pChunkOut[dIndexes[i]] = dValues[i];
+		}
+	}
+}
+
+
+class Expr_If_c : public ExprThreeway_c
+{
+public:
+	Expr_If_c ( ISphExpr * pFirst, ISphExpr * pSecond, ISphExpr * pThird )
+		: ExprThreeway_c ( "Expr_If_c", pFirst, pSecond, pThird ) {}
+
+	float Eval ( const CSphMatch & tMatch ) const final { return ( FIRST!=0.0f ) ? SECOND : THIRD; }
+	int IntEval ( const CSphMatch & tMatch ) const final { return INTFIRST ? INTSECOND : INTTHIRD; }
+	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return INT64FIRST ? INT64SECOND : INT64THIRD; }
+
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const final			{ IfBatch ( m_pFirst, m_pSecond, m_pThird, dMatches, pOut ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final			{ IfBatch ( m_pFirst, m_pSecond, m_pThird, dMatches, pOut ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const final		{ IfBatch ( m_pFirst, m_pSecond, m_pThird, dMatches, pOut ); }
+
+	Expr_If_c ( const Expr_If_c& rhs ) : ExprThreeway_c (rhs) {}
+	ISphExpr* Clone() const final { return new Expr_If_c(*this); }
+};
+
 DECLARE_TERNARY ( Expr_Madd_c,	FIRST*SECOND+THIRD,					INTFIRST*INTSECOND + INTTHIRD,		INT64FIRST*INT64SECOND + INT64THIRD )
 DECLARE_TERNARY ( Expr_Mul3_c,	FIRST*SECOND*THIRD,					INTFIRST*INTSECOND*INTTHIRD,		INT64FIRST*INT64SECOND*INT64THIRD )
 
@@ -7253,17 +7492,12 @@ public:
 	int IntEval ( const CSphMatch & tMatch ) const final
 	{
 		T val = this->ExprEval ( this->m_pArg, tMatch ); // 'this' fixes gcc braindamage
+		return IsIn ( val );
+	}
 
-		if_const ( BINARY )
-			return this->m_dValues.BinarySearch ( val )!=nullptr;
-		else
-		{
-			for ( auto i : this->m_dValues )
-				if ( i==val )
-					return 1;
-
-			return 0;
-		}
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const final
+	{
+		UnaryBatch<int,T> ( this->m_pArg, dMatches, pOut, [this] ( T val ) { return IsIn ( val ); } );
 	}
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -7279,6 +7513,20 @@ public:
 
 private:
 	Expr_In_c ( const Expr_In_c& ) = default;
+
+	inline int IsIn ( T val ) const
+	{
+		if_const ( BINARY )
+			return this->m_dValues.BinarySearch ( val )!=nullptr;
+		else
+		{
+			for ( auto i : this->m_dValues )
+				if ( i==val )
+					return 1;
+
+			return 0;
+		}
+	}
 };
 
 
@@ -110,6 +110,12 @@ public:
 	/// evaluate this expression for that match, using int64 math
 	virtual int64_t Int64Eval ( const CSphMatch & tMatch ) const { assert ( 0 ); return (int64_t) Eval ( tMatch ); }
 
+	/// evaluate this expression for a block of matches (batch versions of Eval/IntEval/Int64Eval)
+	/// default is a per-match loop; attribute, const, arithmetic, comparison, IF and IN nodes do it with tight loops
+	virtual void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pOut ) const;
+	virtual void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pOut ) const;
+	virtual void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pOut ) const;
+
 	/// Evaluate string attr.
 	/// Note, that sometimes this method returns pointer to a static buffer
 	/// and sometimes it allocates a new buffer, so aware of memory leaks.
@@ -21,6 +21,7 @@
 #include "conversion.h"
 #include "geodist.h"
 #include "secondarylib.h"
+#include "jsoncolumns.h"
 
 #include <boost/icl/interval.hpp>
 
@@ -1969,8 +1970,114 @@ static std::unique_ptr<ISphFilter> CreateFilter ( const CSphFilterSettings & tSe
 }
 
 
+/// filter on a typed json_columns copy of a json path
+/// documents where the copy is not exact (eg. json value has another type) are filtered by the json value itself
+class Filter_JsonColumn_c final : public ISphFilter
+{
+public:
+	Filter_JsonColumn_c ( std::unique_ptr<ISphFilter> pTyped, std::unique_ptr<ISphFilter> pJson, std::unique_ptr<ISphFilter> pInexact, const CSphAttrLocator & tMaskLocator, int iColumn )
+		: m_pTyped ( std::move ( pTyped ) )
+		, m_pJson ( std::move ( pJson ) )
+		, m_pInexact ( std::move ( pInexact ) )
+		, m_tMaskLocator ( tMaskLocator )
+		, m_iShift ( iColumn*2 )
+	{}
+
+	bool Eval ( const CSphMatch & tMatch ) const final
+	{
+		auto uBits = (uint64_t)tMatch.GetAttr ( m_tMaskLocator ) >> m_iShift;
+
+		// same as json filters, missing keys never match
+		if ( !( uBits & 1 ) )
+			return false;
+
+		if ( uBits & 2 )
+			return m_pTyped->Eval ( tMatch );
+
+		return m_pJson->Eval ( tMatch );
+	}
+
+	// json attributes have no block min/max, so blocks are checked on the copy only:
+	// a block may match if its exact values pass the typed filter or it has inexact copies (these hold the marker value)
+	bool EvalBlock ( const DWORD * pMin, const DWORD * pMax ) const final
+	{
+		return m_pTyped->EvalBlock ( pMin, pMax ) || !m_pInexact || m_pInexact->EvalBlock ( pMin, pMax );
+	}
+
+	bool Test ( const columnar::MinMaxVec_t & dMinMax ) const final
+	{
+		return m_pTyped->Test(dMinMax) || !m_pInexact || m_pInexact->Test(dMinMax);
+	}
+
+	void SetColumnar ( const columnar::Columnar_i * pColumnar ) final
+	{
+		m_pTyped->SetColumnar(pColumnar);
+		m_pJson->SetColumnar(pColumnar);
+		if ( m_pInexact )
+			m_pInexact->SetColumnar(pColumnar);
+	}
+
+	void SetBlobStorage ( const BYTE * pBlobPool ) final
+	{
+		m_pTyped->SetBlobStorage ( pBlobPool );
+		m_pJson->SetBlobStorage ( pBlobPool );
+		if ( m_pInexact )
+			m_pInexact->SetBlobStorage ( pBlobPool );
+	}
+
+private:
+	std::unique_ptr<ISphFilter>	m_pTyped;
+	std::unique_ptr<ISphFilter>	m_pJson;
+	std::unique_ptr<ISphFilter>	m_pInexact;	///< matches the marker of inexact copies; only used to check blocks
+	CSphAttrLocator				m_tMaskLocator;
+	int							m_iShift = 0;
+};
+
+
+static std::unique_ptr<ISphFilter> TryToCreateJsonColumnFilter ( const CSphFilterSettings & tSettings, const CreateFilterContext_t & tCtx, CSphString & sError, CSphString & sWarning )
+{
+	assert ( tCtx.m_pSchema );
+	const ISphSchema & tSchema = *tCtx.m_pSchema;
+
+	int iMask = tCtx.m_iJsonMask==-2 ? tSchema.GetAttrIndex ( sphGetJsonMaskName() ) : tCtx.m_iJsonMask;
+	if ( iMask<0 )
+		return nullptr;
+
+	int iColumn = -1;
+	int iAttr = GetJsonColumn ( tSchema, tSettings.m_sAttrName, iColumn );
+	if ( iAttr<0 || !CanUseJsonColumn ( tSettings, tSchema.GetAttr(iAttr).m_eAttrType ) )
+		return nullptr;
+
+	const CSphColumnInfo & tCopy = tSchema.GetAttr(iAttr);
+
+	// can't use the typed copy for some reason? fall back to a plain json filter
+	std::unique_ptr<ISphFilter> pTyped = CreateFilter ( tSettings, tCopy.m_sName, tCtx, false, sError, sWarning );
+	if ( !pTyped )
+	{
+		sError = "";
+		return nullptr;
+	}
+
+	std::unique_ptr<ISphFilter> pJson = CreateFilter ( tSettings, tSettings.m_sAttrName, tCtx, false, sError, sWarning );
+	if ( !pJson )
+		return nullptr;
+
+	// no marker filter just disables block skipping
+	CSphFilterSettings tInexact;
+	CreateJsonColumnInexactFilter ( tCopy, tInexact );
+	CSphString sInexactError, sInexactWarning;
+	std::unique_ptr<ISphFilter> pInexact = CreateFilter ( tInexact, tCopy.m_sName, tCtx, false, sInexactError, sInexactWarning );
+
+	return std::make_unique<Filter_JsonColumn_c> ( std::move ( pTyped ), std::move ( pJson ), std::move ( pInexact ), tSchema.GetAttr(iMask).m_tLocator, iColumn );
+}
+
+
 std::unique_ptr<ISphFilter> sphCreateFilter ( const CSphFilterSettings & tSettings, const CreateFilterContext_t & tCtx, CSphString & sError, CSphString & sWarning )
 {
+	std::unique_ptr<ISphFilter> pFilter = TryToCreateJsonColumnFilter ( tSettings, tCtx, sError, sWarning );
+	if ( pFilter || !sError.IsEmpty() )
+		return pFilter;
+
 	return CreateFilter ( tSettings, tSettings.m_sAttrName, tCtx, false, sError, sWarning );
 }
 
@@ -2134,6 +2241,9 @@ bool sphCreateFilters ( CreateFilterContext_t & tCtx, CSphString & sError, CSphS
 	if ( !tCtx.m_pFilters || !tCtx.m_pFilters->GetLength() )
 		return true;
 
+	if ( tCtx.m_pSchema )
+		tCtx.m_iJsonMask = tCtx.m_pSchema->GetAttrIndex ( sphGetJsonMaskName() );
+
 	if ( tCtx.m_pFilterTree && tCtx.m_pFilterTree->GetLength() )
 	{
 		const int TREE_SIZE_THRESH = 200;
@@ -83,6 +83,7 @@ struct CreateFilterContext_t
 	const HistogramContainer_c * m_pHistograms = nullptr;
 	const SI::Index_i *			m_pSI = nullptr;
 	int64_t						m_iTotalDocs = 0;
+	int							m_iJsonMask = -2;	///< json_columns mask attr in m_pSchema; -1 if none, -2 if not looked up yet
 
 	CreateFilterContext_t ( const ISphSchema * pSchema=nullptr )
 		: m_pSchema ( pSchema ) {}
@@ -116,6 +116,7 @@ enum ExtraData_e
 	EXTRA_SET_BOUNDARIES,
 	EXTRA_SET_ITERATOR,
 	EXTRA_SET_COLUMNAR,
+	EXTRA_SET_WEIGHT_THRESHOLD,		///< min weight a match needs to get into the sorter; ranker may skip docs that can't reach it
 };
 
 /// generic COM-like interface
@@ -181,6 +182,8 @@ public:
 	const SmallStringHash_T<int64_t> *		m_pLocalDocs = nullptr;
 	int64_t									m_iTotalDocs = 0;
 	int64_t									m_iIndexTotalDocs = 0;
+	int										m_iDynamicSize = 0;		///< dynamic part size of the matches (set up by SetupCalc)
+	int64_t									m_iQcacheTableId = 0;	///< query cache quota owner; 0 means the searched index itself
 
 public:
 	explicit CSphQueryContext ( const CSphQuery & q );
@@ -194,6 +197,9 @@ public:
 	void	CalcSort ( CSphMatch & tMatch ) const;
 	void	CalcFinal ( CSphMatch & tMatch ) const;
 	void	CalcItem ( CSphMatch & tMatch, const CalcItem_t & tCalc ) const;
+	void	CalcItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, const CalcItem_t & tCalc ) const;
+	void	CalcFilterBatch ( const VecTraits_T<CSphMatch *> & dMatches ) const;
+	void	CalcSortBatch ( const VecTraits_T<CSphMatch *> & dMatches ) const;
 
 	void	FreeDataFilter ( CSphMatch & tMatch ) const;
 	void	FreeDataSort ( CSphMatch & tMatch ) const;
@@ -215,6 +221,80 @@ private:
 };
 
 
+/// a block of matches with their own dynamic parts
+/// full scans collect rows here to evaluate filter and sort expressions over the whole block at once
+class MatchBlock_c : public ISphNoncopyable
+{
+public:
+	static const int MAX_MATCHES = 128;
+
+	explicit MatchBlock_c ( int iDynamicSize )
+	{
+		for ( auto & tMatch : m_dMatches )
+			tMatch.Reset ( iDynamicSize );
+	}
+
+	/// next match of the block; weight and tag are taken from tProto
+	void Add ( RowID_t tRowID, const CSphRowitem * pStatic, const CSphMatch & tProto )
+	{
+		assert ( !IsFull() );
+		CSphMatch & tMatch = m_dMatches[m_iUsed];
+		tMatch.m_tRowID = tRowID;
+		tMatch.m_pStatic = pStatic;
+		tMatch.m_iWeight = tProto.m_iWeight;
+		tMatch.m_iTag = tProto.m_iTag;
+		m_dBlock[m_iUsed++] = &tMatch;
+	}
+
+	bool						IsFull() const	{ return m_iUsed==MAX_MATCHES; }
+	bool						IsEmpty() const	{ return !m_iUsed; }
+	VecTraits_T<CSphMatch *>	Matches()		{ return { m_dBlock, m_iUsed }; }
+	void						Clear()			{ m_iUsed = 0; }
+
+private:
+	CSphMatch	m_dMatches[MAX_MATCHES];
+	CSphMatch *	m_dBlock[MAX_MATCHES];
+	int			m_iUsed = 0;
+};
+
+/// evaluate filter expressions over the block, filter it, call fnBeforeSort for every match that passed,
+/// evaluate sort expressions over them, then push them one by one with fnPush, until it returns true (cutoff)
+/// returns whether fnPush stopped it; expression data of all the matches is freed in any case
+template<typename BEFORE_SORT, typename PUSH>
+bool FilterSortAndPush ( const CSphQueryContext & tCtx, VecTraits_T<CSphMatch *> dMatches, BEFORE_SORT && fnBeforeSort, PUSH && fnPush )
+{
+	tCtx.CalcFilterBatch ( dMatches );
+
+	int iPassed = 0;
+	for ( CSphMatch * pMatch : dMatches )
+	{
+		if ( tCtx.m_pFilter && !tCtx.m_pFilter->Eval ( *pMatch ) )
+		{
+			tCtx.FreeDataFilter ( *pMatch );
+			continue;
+		}
+
+		fnBeforeSort ( *pMatch );
+		dMatches[iPassed++] = pMatch;
+	}
+
+	auto dPassed = dMatches.Slice ( 0, iPassed );
+	tCtx.CalcSortBatch ( dPassed );
+
+	bool bStop = false;
+	for ( CSphMatch * pMatch : dPassed )
+	{
+		// stringptr expressions should be duplicated (or taken over) by the sorters
+		if ( !bStop )
+			bStop = fnPush ( *pMatch );
+
+		tCtx.FreeDataFilter ( *pMatch );
+		tCtx.FreeDataSort ( *pMatch );
+	}
+
+	return bStop;
+}
+
 // collect valid schemas from sorters, excluding one
 CSphVector<const ISphSchema *> SorterSchemas ( const VecTraits_T<ISphMatchSorter *> & dSorters, int iSkipSorter );
 
@@ -597,6 +677,25 @@ inline int sphUTF8ToWideChar ( const char * pSrc, int * pDst, int iMaxLen )
 static const int FIELD_BITS = 8;
 typedef Hitman_c<FIELD_BITS> HITMAN;
 
+/// indexing order of hits: word id, row id, position (field end flag does not count)
+struct CmpHit_fn
+{
+	inline static bool IsLess ( const CSphWordHit & a, const CSphWordHit & b )
+	{
+		return ( a.m_uWordID<b.m_uWordID ) ||
+				( a.m_uWordID==b.m_uWordID && a.m_tRowID<b.m_tRowID ) ||
+				( a.m_uWordID==b.m_uWordID && a.m_tRowID==b.m_tRowID && HITMAN::GetPosWithField ( a.m_uWordPos )<HITMAN::GetPosWithField ( b.m_uWordPos ) );
+	}
+};
+
+/// sorts hits in CmpHit_fn order with radix sort; pTmp is scratch space for iHits hits
+/// returns either pHits or pTmp, whichever holds the sorted hits
+CSphWordHit *	sphSortHits ( CSphWordHit * pHits, CSphWordHit * pTmp, int iHits );
+
+/// sorts a block of collected hits with up to iThreads threads (indexer --threads), using dTmp (of the same size)
+/// as scratch space; dHits holds the sorted block on return. Each thread gets at least iMinHitsPerThread hits
+void			SortHits ( CSphFixedVector<CSphWordHit> & dHits, CSphFixedVector<CSphWordHit> & dTmp, int iHits, int iThreads, int iMinHitsPerThread=65536 );
+
 /// hit in the stream
 /// combines posting info (docid and hitpos) with a few more matching/ranking bits
 ///
@@ -880,6 +979,8 @@ int				ConsiderStackAbsolute ( const struct XQNode_t* pRoot );
 void			sphTransformExtendedQuery ( XQNode_t ** ppNode, const CSphIndexSettings & tSettings, bool bHasBooleanOptimization, const ISphKeywordsStat * pKeywords );
 void			TransformAotFilter ( XQNode_t * pNode, const CSphWordforms * pWordforms, const CSphIndexSettings& tSettings );
 bool			sphMerge ( const CSphIndex * pDst, const CSphIndex * pSrc, VecTraits_T<CSphFilterSettings> dFilters, CSphIndexProgress & tProgress, CSphString& sError );
+/// merges several tables of the same schema and settings in one pass; result goes to tmp files of the first one
+bool			sphMerge ( const VecTraits_T<const CSphIndex *> & dIndexes, CSphIndexProgress & tProgress, CSphString & sError );
 int				ExpandKeywords ( int iIndexOpt, QueryOption_e eQueryOpt, const CSphIndexSettings & tSettings, bool bWordDict );
 bool			ParseMorphFields ( const CSphString & sMorphology, const CSphString & sMorphFields, const CSphVector<CSphColumnInfo> & dFields, CSphBitvec & tMorphFields, CSphString & sError );
 
@@ -1413,10 +1514,16 @@ BYTE PrereadMapping ( const char * sIndexName, const char * sFor, bool bMlock, b
 	auto pCur = (const BYTE*)tBuf.GetReadPtr();
 	const BYTE * pEnd = pCur + tBuf.GetLengthBytes();
 	const int iHalfPage = 2048;
+	const int64_t iThrottleBlock = 1024*1024; // touching pages is accounted as I/O of that size
 
 	g_uHash = 0xff;
-	for ( ; pCur<pEnd; pCur+=iHalfPage )
-		g_uHash ^= *pCur;
+	while ( pCur<pEnd )
+	{
+		int64_t iBlock = Min ( iThrottleBlock, pEnd-pCur );
+		ThrottleIO ( iBlock );
+		for ( const BYTE * pBlockEnd = pCur+iBlock; pCur<pBlockEnd; pCur+=iHalfPage )
+			g_uHash ^= *pCur;
+	}
 	g_uHash ^= *(pEnd-1);
 
 	// we want to prevent PrereadMapping() from being aggressively optimized away
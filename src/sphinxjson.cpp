@@ -15,10 +15,6 @@
 #include "conversion.h"
 #include "json/cJSON.h"
 
-#if _WIN32
-#include <io.h> // for isatty() in sphinxjson.c
-#endif
-
 
 //////////////////////////////////////////////////////////////////////////
 // helpers
@@ -172,43 +168,6 @@ int JsonUnescape ( char * pTarget, const char * pEscaped, int iLen )
 }
 
 //////////////////////////////////////////////////////////////////////////
-// just a pair of numbers (std::pair is not suitable since assumes non-trivial ctrs)
-struct BlobLocator_t
-{
-	int		m_iStart;
-	int 	m_iLen;
-};
-
-/// parser view on a generic node
-struct JsonNode_t
-{
-	union {
-		int64_t			m_iValue;	///< integer value (only JSON_INT32 and JSON_INT64 )
-		double			m_fValue;	///< floating point (only JSON_DOUBLE )
-		BlobLocator_t	m_sValue;	///< string locator (value of JSON_STRING)
-		BlobLocator_t	m_dChildren; ///< children locator (first, len) for obj/mix arrays
-		INIT_WITH_0 ( int64_t, double, BlobLocator_t );
-	};
-	union {
-		BlobLocator_t m_sName;				///< node name locator
-		INIT_WITH_0 ( int64_t, BlobLocator_t );
-	};
-	int 				m_iNext = -1;		///< idx of next sibling
-	ESphJsonType m_eType { JSON_TOTAL };	///< node type
-
-	inline int GetLength() const { return m_dChildren.m_iLen; }
-
-	JsonNode_t() = default;
-	explicit JsonNode_t ( ESphJsonType eType )
-	{
-		m_eType = eType;
-		m_sName.m_iLen = 0;
-		m_sValue.m_iLen = 0;
-	}
-
-};
-#define YYSTYPE JsonNode_t
-
 namespace // static unnamed
 {
 	void StoreInt ( CSphVector<BYTE> & dBsonBuffer, int v )
@@ -280,11 +239,6 @@ namespace // static unnamed
 		return dBsonBuffer.AddN ( iLen );
 	}
 
-	inline DWORD JsonKeyMask ( CSphVector<BYTE> & dBsonBuffer, const BlobLocator_t &sKey )
-	{
-		return sphJsonKeyMask ( ( const char * ) &dBsonBuffer[sKey.m_iStart], sKey.m_iLen );
-	}
-
 	void StoreMask ( CSphVector<BYTE> & dBsonBuffer, int iOfs, DWORD uMask )
 	{
 #if UNALIGNED_RAM_ACCESS && USE_LITTLE_ENDIAN
@@ -556,11 +510,6 @@ public:
 		return ::PackStrUnescaped ( m_dBsonBuffer, s, iLen );
 	}
 
-	inline DWORD JsonKeyMask ( const BlobLocator_t &sKey )
-	{
-		return ::JsonKeyMask ( m_dBsonBuffer, sKey );
-	}
-
 	inline void StoreMask ( int iOfs, DWORD uMask )
 	{
 		::StoreMask ( m_dBsonBuffer, iOfs, uMask );
@@ -587,233 +536,638 @@ public:
 	}
 };
 
-/// actually, JSON-to-SphinxBSON converter helper, but who cares
+//////////////////////////////////////////////////////////////////////////
+// single-pass JSON-to-SphinxBSON parser
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP>=2 )
+#include <emmintrin.h>
+#define JSON_USE_SSE2 1
+#else
+#define JSON_USE_SSE2 0
+#endif
+
+namespace {
+
+inline bool IsJsonSpace ( char c )
+{
+	return c==' ' || c=='\t' || c=='\n' || c=='\r';
+}
+
+inline bool IsJsonDigit ( char c )
+{
+	return c>='0' && c<='9';
+}
+
+inline bool IsJsonIdentStart ( char c )
+{
+	return ( c>='a' && c<='z' ) || ( c>='A' && c<='Z' ) || c=='_';
+}
+
+inline bool IsJsonIdent ( char c )
+{
+	return IsJsonIdentStart ( c ) || IsJsonDigit ( c );
+}
+
+#if JSON_USE_SSE2
+// index of the lowest set bit of non-zero movemask
+inline int FirstHit ( DWORD uMask )
+{
+	assert ( uMask );
+	return sphLog2 ( uMask & ( 0U-uMask ) ) - 1;
+}
+#endif
+
+} // namespace
+
+// compact json has no gaps at all, so the first byte decides; pretty-printed one has long indents, so go 16 bytes at once
+const char * sphJsonSkipWhitespace ( const char * p, const char * pEnd )
+{
+	if ( p>=pEnd || !IsJsonSpace ( *p ) )
+		return p;
+
+#if JSON_USE_SSE2
+	const __m128i tSpace = _mm_set1_epi8 ( ' ' );
+	const __m128i tTab = _mm_set1_epi8 ( '\t' );
+	const __m128i tLF = _mm_set1_epi8 ( '\n' );
+	const __m128i tCR = _mm_set1_epi8 ( '\r' );
+	for ( ; p+16<=pEnd; p += 16 )
+	{
+		__m128i tChunk = _mm_loadu_si128 ( (const __m128i *) p );
+		__m128i tWs = _mm_or_si128 ( _mm_or_si128 ( _mm_cmpeq_epi8 ( tChunk, tSpace ), _mm_cmpeq_epi8 ( tChunk, tTab ) ),
+				_mm_or_si128 ( _mm_cmpeq_epi8 ( tChunk, tLF ), _mm_cmpeq_epi8 ( tChunk, tCR ) ) );
+		auto uOther = DWORD ( _mm_movemask_epi8 ( tWs ) ) ^ 0xFFFF;
+		if ( uOther )
+			return p + FirstHit ( uOther );
+	}
+#endif
+
+	while ( p<pEnd && IsJsonSpace ( *p ) )
+		++p;
+	return p;
+}
+
+const char * sphJsonFindQuoteOrEscape ( const char * p, const char * pEnd, char cQuote )
+{
+#if JSON_USE_SSE2
+	const __m128i tQuote = _mm_set1_epi8 ( cQuote );
+	const __m128i tEscape = _mm_set1_epi8 ( '\\' );
+	for ( ; p+16<=pEnd; p += 16 )
+	{
+		__m128i tChunk = _mm_loadu_si128 ( (const __m128i *) p );
+		auto uHits = DWORD ( _mm_movemask_epi8 ( _mm_or_si128 ( _mm_cmpeq_epi8 ( tChunk, tQuote ), _mm_cmpeq_epi8 ( tChunk, tEscape ) ) ) );
+		if ( uHits )
+			return p + FirstHit ( uHits );
+	}
+#endif
+
+	for ( ; p<pEnd; ++p )
+		if ( *p==cQuote || *p=='\\' )
+			return p;
+	return pEnd;
+}
+
+namespace {
+
+// case-insensitive match of the whole token against true/false/null
+bool IsJsonLiteral ( const char * s, int iLen, const char * sLiteral )
+{
+	if ( iLen!=(int) strlen ( sLiteral ) )
+		return false;
+	for ( int i = 0; i<iLen; ++i )
+		if ( Mytolower ( s[i] )!=sLiteral[i] )
+			return false;
+	return true;
+}
+
+/// scalar value as met by the parser; strings are kept as raw (quoted, escaped) source locators
+struct JsonScalar_t
+{
+	union {
+		int64_t		m_iValue;	///< integer value (only JSON_INT32 and JSON_INT64 )
+		double		m_fValue;	///< floating point (only JSON_DOUBLE )
+		INIT_WITH_0 ( int64_t, double );
+	};
+	const char *	m_sRaw = nullptr;	///< source of JSON_STRING, including quotes
+	int				m_iRawLen = 0;
+	ESphJsonType	m_eType { JSON_TOTAL };
+};
+
+/// object or array which is open now
+struct JsonFrame_t
+{
+	int		m_iTypeOfs = -1;	///< where to put node type once it is known; -1 for the root object
+	int		m_iSizeOfs = -1;	///< reserved byte for packed size of object or mixed vector
+	int		m_iCountOfs = -1;	///< reserved byte for packed count of mixed vector
+	int		m_iFirstScalar = 0;	///< first pending scalar of a vector which is not (yet) mixed
+	int		m_iCount = 0;		///< values written into mixed vector
+	DWORD	m_uMask = 0;		///< bloom mask of object keys
+	bool	m_bObject = false;
+	bool	m_bMixed = false;
+};
+
+} // namespace
+
+/// JSON-to-SphinxBSON converter
+/// walks the source exactly once and writes bson straight into the output buffer. Nesting is kept in an explicit
+/// stack, not in recursion, so deep documents are safe on small coroutine stacks. Only scalars of a vector are
+/// held back until the vector is closed (or meets an object/array), as vector type depends on all of them.
 class JsonParser_c : public BsonHelper
 {
-	bool m_bAutoconv;
-	bool m_bToLowercase;
-public:
-	void * m_pScanner = nullptr;
-	const char * m_pLastToken = nullptr;
-	StringBuilder_c &m_sError;
-	const char * m_pSource = nullptr;
-	CSphVector<JsonNode_t> m_dNodes;
+	const char *	m_p;
+	const char *	m_pEnd;
+	bool			m_bAutoconv;
+	bool			m_bToLowercase;
+	StringBuilder_c & m_sError;
+
+	CSphVector<JsonFrame_t>		m_dStack;
+	CSphVector<JsonScalar_t>	m_dScalars;
 
 public:
-	JsonParser_c ( CSphVector<BYTE> &dBuffer, bool bAutoconv, bool bToLowercase, StringBuilder_c &sError )
-		: BsonHelper (dBuffer)
+	JsonParser_c ( CSphVector<BYTE> & dBuffer, char * sSource, int iLen, bool bAutoconv, bool bToLowercase, StringBuilder_c & sError )
+		: BsonHelper ( dBuffer )
+		, m_p ( sSource )
+		, m_pEnd ( sSource + iLen )
 		, m_bAutoconv ( bAutoconv )
 		, m_bToLowercase ( bToLowercase )
 		, m_sError ( sError )
 	{}
 
-private:
-	void PackNodeStr ( const JsonNode_t &tNode )
+	/// topmost value must be object or array; empty input gives empty root
+	bool Parse ()
 	{
-		PackStrUnescaped ( m_pSource + tNode.m_sValue.m_iStart, tNode.m_sValue.m_iLen );
+		SkipSpaces ();
+		if ( m_p>=m_pEnd )
+			return true;
+
+		if ( *m_p=='{' )
+			OpenObject ( -1 );
+		else if ( *m_p=='[' )
+			OpenArray ( ReserveType () );
+		else
+			return Unexpected ( m_p );
+		++m_p;
+
+		bool bFirst = true; // right after opening bracket
+		bool bOpened = false;
+		while ( true )
+		{
+			// element position: just after opening bracket or comma
+			SkipSpaces ();
+			if ( m_p>=m_pEnd )
+				return Unexpected ( m_p );
+
+			if ( bFirst && *m_p==Closing ( m_dStack.Last () ) )
+			{
+				++m_p;
+				CloseContainer ();
+			} else if ( !ParseElement ( bOpened ) )
+				return false;
+			else if ( bOpened )
+			{
+				bFirst = true;
+				continue;
+			}
+
+			// after complete value: closing brackets, then comma
+			while ( !m_dStack.IsEmpty () )
+			{
+				SkipSpaces ();
+				if ( m_p>=m_pEnd )
+					return Unexpected ( m_p );
+				if ( *m_p==',' )
+					break;
+				if ( *m_p!=Closing ( m_dStack.Last () ) )
+					return Unexpected ( m_p );
+				++m_p;
+				CloseContainer ();
+			}
+
+			if ( m_dStack.IsEmpty () )
+			{
+				SkipSpaces ();
+				return m_p>=m_pEnd || Unexpected ( m_p );
+			}
+
+			++m_p; // comma
+			bFirst = false;
+		}
 	}
 
-	// take string from source locator, write packed/unescaped string to output and return it's locator
-	void WriteKeyUnescaped ( BlobLocator_t &sKey )
+private:
+	static char Closing ( const JsonFrame_t & tFrame )
 	{
-		auto sPacked = PackStrUnescaped ( m_pSource + sKey.m_iStart, sKey.m_iLen );
-		sKey.m_iStart = m_dBsonBuffer.Idx ( sPacked );
-		sKey.m_iLen = m_dBsonBuffer.GetLength () - sKey.m_iStart;
-		if ( m_bToLowercase )
-			for ( auto &c : VecTraits_T<char> ( ( char * ) sPacked, sKey.m_iLen ) )
-				c = ( char ) Mytolower ( c ); // OPTIMIZE! not sure if significant, but known to be hell slow
+		return tFrame.m_bObject ? '}' : ']';
 	}
 
-public:
+	void SkipSpaces ()
+	{
+		while ( true )
+		{
+			m_p = sphJsonSkipWhitespace ( m_p, m_pEnd );
+			if ( m_p>=m_pEnd )
+				return;
 
-#define JSON_FOREACH( _index, _node ) \
-    for ( auto i=0, _index=_node.m_dChildren.m_iStart; i<_node.GetLength(); ++i, _index = m_dNodes[_index].m_iNext )
+			if ( *m_p!='#' && !( *m_p=='/' && m_p+1<m_pEnd && m_p[1]=='/' ) )
+				return;
 
-	void NumericFixup ( JsonNode_t &tNode )
+			// comment till the end of line
+			auto * pEol = (const char *) memchr ( m_p, '\n', m_pEnd - m_p );
+			m_p = pEol ? pEol+1 : m_pEnd;
+		}
+	}
+
+	bool Unexpected ( const char * pAt )
 	{
-		// auto-convert string values, if necessary
-		if ( m_bAutoconv && tNode.m_eType==JSON_STRING )
-			if ( !sphJsonStringToNumber ( m_pSource + tNode.m_sValue.m_iStart + 1, tNode.m_sValue.m_iLen - 2
-										  , tNode.m_eType, tNode.m_iValue, tNode.m_fValue ) )
-				return;
+		const char * sToken = "end of file";
+		CSphString sChar;
+		if ( pAt<m_pEnd )
+		{
+			if ( *pAt=='"' || *pAt=='\'' )
+				sToken = "TOK_STRING";
+			else if ( IsJsonDigit ( *pAt ) )
+				sToken = "TOK_INT";
+			else if ( IsJsonIdentStart ( *pAt ) )
+				sToken = "TOK_IDENT";
+			else
+			{
+				sChar.SetSprintf ( "'%c'", *pAt );
+				sToken = sChar.cstr ();
+			}
+		}
 
-		// parser and converter emits int64 values, fix them up to int32 if possible
-		if ( tNode.m_eType==JSON_INT64 && tNode.m_iValue==int64_t ( int ( tNode.m_iValue ) ) )
-			tNode.m_eType = JSON_INT32;
+		CSphString sNear;
+		sNear.SetBinary ( pAt, (int) Min ( m_pEnd - pAt, 32 ) );
+		m_sError.Sprintf ( "P10: syntax error, unexpected %s near '%s'", sToken, sNear.cstr () );
+		return false;
 	}
 
-	ESphJsonType OptimizeMixedVector ( JsonNode_t &tNode )
+	int ReserveType ()
 	{
-		assert ( tNode.m_eType==JSON_MIXED_VECTOR );
+		m_dBsonBuffer.Add ( JSON_TOTAL );
+		return m_dBsonBuffer.GetLength () - 1;
+	}
 
-		if ( !tNode.m_dChildren.m_iLen )
-			return JSON_MIXED_VECTOR;
+	/// pack value into byte reserved with ReserveSize(), moving the data after it if necessary
+	void PackReserved ( int iOfs, DWORD uValue )
+	{
+		int iTail = m_dBsonBuffer.GetLength () - iOfs - 1;
+		int iPackLen = PackedLen ( uValue );
+		if ( iPackLen!=1 )
+		{
+			m_dBsonBuffer.Resize ( iOfs + iPackLen + iTail );
+			memmove ( m_dBsonBuffer.Begin () + iOfs + iPackLen, m_dBsonBuffer.Begin () + iOfs + 1, iTail );
+		}
+		m_dBsonBuffer.Resize ( iOfs );
+		PackInt ( uValue );
+		m_dBsonBuffer.AddN ( iTail );
+	}
 
-		JSON_FOREACH ( j, tNode )
-			NumericFixup ( m_dNodes[j] );
+	void OpenObject ( int iTypeOfs )
+	{
+		JsonFrame_t tFrame;
+		tFrame.m_bObject = true;
+		tFrame.m_iTypeOfs = iTypeOfs;
+		if ( iTypeOfs>=0 ) // root has no type and size, and its bloom mask is already reserved at 0
+		{
+			m_dBsonBuffer[iTypeOfs] = JSON_OBJECT;
+			tFrame.m_iSizeOfs = ReserveSize ();
+			StoreInt ( 0 );
+		}
+		m_dStack.Add ( tFrame );
+	}
 
-		ESphJsonType eBase = m_dNodes[tNode.m_dChildren.m_iStart].m_eType;
-		bool bAllSame = true;
-		JSON_FOREACH ( j, tNode )
-			if ( eBase!=m_dNodes[j].m_eType )
-				bAllSame = false;
-		if ( bAllSame )
-			switch ( eBase )
+	void OpenArray ( int iTypeOfs )
+	{
+		JsonFrame_t tFrame;
+		tFrame.m_iTypeOfs = iTypeOfs;
+		tFrame.m_iFirstScalar = m_dScalars.GetLength ();
+		m_dStack.Add ( tFrame );
+	}
+
+	void CloseContainer ()
+	{
+		auto tFrame = m_dStack.Pop ();
+		if ( tFrame.m_bObject )
+		{
+			Add ( JSON_EOF );
+			if ( tFrame.m_iTypeOfs<0 )
 			{
-			case JSON_INT32: return JSON_INT32_VECTOR;
-			case JSON_INT64: return JSON_INT64_VECTOR;
-			case JSON_DOUBLE: return JSON_DOUBLE_VECTOR;
-			case JSON_STRING: return JSON_STRING_VECTOR;
-			default: break; // type matches across all entries, but we do not have a special format for that type
+				StoreMask ( 0, tFrame.m_uMask );
+				return;
 			}
-		return JSON_MIXED_VECTOR;
+			StoreMask ( tFrame.m_iSizeOfs+1, tFrame.m_uMask );
+			PackSize ( tFrame.m_iSizeOfs ); // MUST be in this order, because PackSize() might move the data!
+			return;
+		}
+
+		if ( tFrame.m_bMixed )
+		{
+			PackReserved ( tFrame.m_iCountOfs, tFrame.m_iCount );
+			PackSize ( tFrame.m_iSizeOfs );
+			m_dBsonBuffer[tFrame.m_iTypeOfs] = JSON_MIXED_VECTOR;
+			return;
+		}
+
+		m_dBsonBuffer[tFrame.m_iTypeOfs] = WriteVector ( m_dScalars.Slice ( tFrame.m_iFirstScalar ) );
+		m_dScalars.Resize ( tFrame.m_iFirstScalar );
 	}
 
-	bool WriteRoot ( JsonNode_t &tNode ) // called in case of tompost obj enclosed in {}.
+	/// vector met object or array; flush scalars collected so far as mixed vector, and write the rest directly
+	void SwitchToMixed ( JsonFrame_t & tFrame )
 	{
-		DWORD uMask = 0;
-		JSON_FOREACH ( j, tNode )
+		assert ( !tFrame.m_bObject && !tFrame.m_bMixed );
+		tFrame.m_iSizeOfs = ReserveSize ();
+		tFrame.m_iCountOfs = ReserveSize ();
+		for ( const auto & tScalar : m_dScalars.Slice ( tFrame.m_iFirstScalar ) )
 		{
-			auto &dNode = m_dNodes[j];
-			WriteNode ( dNode, true );
-			uMask |= JsonKeyMask ( dNode.m_sName );
+			Add ( tScalar.m_eType );
+			WriteScalar ( tScalar );
 		}
-		m_dBsonBuffer.Add ( JSON_EOF );
-		StoreMask ( 0, uMask );
-		return true;
+		tFrame.m_iCount = m_dScalars.GetLength () - tFrame.m_iFirstScalar;
+		m_dScalars.Resize ( tFrame.m_iFirstScalar );
+		tFrame.m_bMixed = true;
 	}
 
-	// main proc which do whole magic over the topmost obj/array
-	bool WriteNode ( JsonNode_t &tNode, bool bNamed=false )
+	/// key (for object) and value; object or array value is only opened here
+	bool ParseElement ( bool & bOpened )
 	{
-		// convert int64 to int32, strings to numbers if needed
-		NumericFixup ( tNode );
+		bOpened = false;
+		int iTypeOfs = -1;
+		if ( m_dStack.Last ().m_bObject )
+		{
+			iTypeOfs = ReserveType ();
+			if ( !ParseKey () )
+				return false;
+			SkipSpaces ();
+			if ( m_p>=m_pEnd || *m_p!=':' )
+				return Unexpected ( m_p );
+			++m_p;
+			SkipSpaces ();
+			if ( m_p>=m_pEnd )
+				return Unexpected ( m_p );
+		}
 
-		auto eType = tNode.m_eType;
+		if ( *m_p=='{' || *m_p=='[' )
+		{
+			auto & tFrame = m_dStack.Last ();
+			if ( !tFrame.m_bObject )
+			{
+				if ( !tFrame.m_bMixed )
+					SwitchToMixed ( tFrame );
+				++tFrame.m_iCount;
+				iTypeOfs = ReserveType ();
+			}
 
-		// process mixed vector, convert to generic vector if possible
-		if ( eType==JSON_MIXED_VECTOR )
-			eType = OptimizeMixedVector ( tNode );
+			if ( *m_p=='{' )
+				OpenObject ( iTypeOfs );
+			else
+				OpenArray ( iTypeOfs );
+			++m_p;
+			bOpened = true;
+			return true;
+		}
 
-		// write type
-		m_dBsonBuffer.Add ( eType );
+		JsonScalar_t tScalar;
+		if ( !ParseScalar ( tScalar ) )
+			return false;
 
-		// write key name if exists
-		if ( bNamed && tNode.m_sName.m_iLen )
-			WriteKeyUnescaped ( tNode.m_sName );
+		auto & tFrame = m_dStack.Last ();
+		if ( tFrame.m_bObject )
+		{
+			m_dBsonBuffer[iTypeOfs] = tScalar.m_eType;
+			WriteScalar ( tScalar );
+		} else if ( tFrame.m_bMixed )
+		{
+			Add ( tScalar.m_eType );
+			WriteScalar ( tScalar );
+			++tFrame.m_iCount;
+		} else
+			m_dScalars.Add ( tScalar );
+		return true;
+	}
 
-		// write nodes
-		switch ( eType )
+	// key is quoted string or bare identifier; written unescaped (and lowercased, if necessary)
+	bool ParseKey ()
+	{
+		const char * sKey = m_p;
+		if ( *m_p=='"' || *m_p=='\'' )
 		{
-			// basic types
-		case JSON_INT32: StoreInt ( ( int ) tNode.m_iValue );
-			break;
-		case JSON_INT64: StoreBigint ( tNode.m_iValue );
-			break;
-		case JSON_DOUBLE: StoreBigint ( sphD2QW ( tNode.m_fValue ) );
-			break;
-		case JSON_STRING: PackNodeStr ( tNode );
-			break;
+			if ( !SkipString () )
+				return false;
+		} else if ( IsJsonIdentStart ( *m_p ) )
+		{
+			while ( m_p<m_pEnd && IsJsonIdent ( *m_p ) )
+				++m_p;
+			auto iLen = int ( m_p - sKey );
+			if ( IsJsonLiteral ( sKey, iLen, "true" ) || IsJsonLiteral ( sKey, iLen, "false" ) || IsJsonLiteral ( sKey, iLen, "null" ) )
+				return Unexpected ( sKey );
+		} else
+			return Unexpected ( m_p );
 
-			// literals
-		case JSON_TRUE:
-		case JSON_FALSE:
-		case JSON_NULL:
-			// no content
-			break;
+		auto * pKey = PackStrUnescaped ( sKey, int ( m_p - sKey ) );
+		auto iKeyLen = int ( m_dBsonBuffer.end () - pKey );
+		if ( m_bToLowercase )
+			for ( auto & c : VecTraits_T<char> ( (char *) pKey, iKeyLen ) )
+				c = Mytolower ( c );
 
-			// associative arrays
-		case JSON_OBJECT:
+		m_dStack.Last ().m_uMask |= sphJsonKeyMask ( (const char *) pKey, iKeyLen );
+		return true;
+	}
+
+	// m_p is at opening quote; move right after the closing one
+	bool SkipString ()
+	{
+		char cQuote = *m_p;
+		const char * p = m_p+1;
+		while ( true )
 		{
-			DWORD uMask = 0;
-			int iOfs = ReserveSize ();
-			StoreInt ( 0 );
-			JSON_FOREACH ( j, tNode )
+			p = sphJsonFindQuoteOrEscape ( p, m_pEnd, cQuote );
+			if ( p>=m_pEnd )
+				return Unexpected ( m_p );
+
+			if ( *p==cQuote )
 			{
-				auto &dNode = m_dNodes[j];
-				WriteNode ( dNode, true );
-				uMask |= JsonKeyMask ( dNode.m_sName );
+				m_p = p+1;
+				return true;
 			}
-			m_dBsonBuffer.Add ( JSON_EOF );
-			StoreMask ( iOfs + 1, uMask );
-			PackSize ( iOfs ); // MUST be in this order, because PackSize() might move the data!
-			break;
+
+			// escaped char is taken as is (unescaped later), except line break
+			if ( p+1>=m_pEnd || p[1]=='\n' )
+				return Unexpected ( m_p );
+			p += 2;
 		}
+	}
 
-			// mixed array
-		case JSON_MIXED_VECTOR:
+	bool ParseScalar ( JsonScalar_t & tScalar )
+	{
+		const char * sToken = m_p;
+		if ( *m_p=='"' || *m_p=='\'' )
 		{
-			int iOfs = ReserveSize ();
-			PackInt ( tNode.GetLength () );
-			JSON_FOREACH ( j, tNode )
-				WriteNode ( m_dNodes[j] );
-			PackSize ( iOfs );
-			break;
+			if ( !SkipString () )
+				return false;
+			tScalar.m_eType = JSON_STRING;
+			tScalar.m_sRaw = sToken;
+			tScalar.m_iRawLen = int ( m_p - sToken );
+		} else if ( IsJsonIdentStart ( *m_p ) )
+		{
+			while ( m_p<m_pEnd && IsJsonIdent ( *m_p ) )
+				++m_p;
+			auto iLen = int ( m_p - sToken );
+			if ( IsJsonLiteral ( sToken, iLen, "true" ) )
+				tScalar.m_eType = JSON_TRUE;
+			else if ( IsJsonLiteral ( sToken, iLen, "false" ) )
+				tScalar.m_eType = JSON_FALSE;
+			else if ( IsJsonLiteral ( sToken, iLen, "null" ) )
+				tScalar.m_eType = JSON_NULL;
+			else
+				return Unexpected ( sToken );
+		} else if ( !ParseNumber ( tScalar ) )
+			return false;
+
+		NumericFixup ( tScalar );
+		return true;
+	}
+
+	// [+-]digits, or float with '.' and/or exponent; '1.' and '.5' are both fine
+	bool ParseNumber ( JsonScalar_t & tScalar )
+	{
+		const char * sToken = m_p;
+		const char * p = m_p;
+		if ( p<m_pEnd && ( *p=='+' || *p=='-' ) )
+			++p;
+
+		const char * pDigits = p;
+		while ( p<m_pEnd && IsJsonDigit ( *p ) )
+			++p;
+		bool bInt = p>pDigits;
+		bool bFloat = false;
+
+		if ( p<m_pEnd && *p=='.' )
+		{
+			const char * pFrac = p+1;
+			while ( pFrac<m_pEnd && IsJsonDigit ( *pFrac ) )
+				++pFrac;
+			if ( bInt || pFrac>p+1 )
+			{
+				p = pFrac;
+				bFloat = true;
+			}
 		}
 
-			// optimized (generic) arrays
-		case JSON_INT32_VECTOR: PackInt ( tNode.GetLength () );
-			JSON_FOREACH ( j, tNode )
-				StoreInt ( ( int ) m_dNodes[j].m_iValue );
-			break;
-		case JSON_INT64_VECTOR: PackInt ( tNode.GetLength () );
-			JSON_FOREACH ( j, tNode )
-				StoreBigint ( m_dNodes[j].m_iValue );
-			break;
-		case JSON_DOUBLE_VECTOR: PackInt ( tNode.GetLength () );
-			JSON_FOREACH ( j, tNode )
-				StoreBigint ( sphD2QW ( m_dNodes[j].m_fValue ) );
-			break;
-		case JSON_STRING_VECTOR:
+		if ( !bInt && !bFloat )
+			return Unexpected ( sToken );
+
+		if ( p<m_pEnd && ( *p=='e' || *p=='E' ) )
 		{
-			int iOfs = ReserveSize ();
-			PackInt ( tNode.GetLength () );
-			JSON_FOREACH ( j, tNode )
-				PackNodeStr ( m_dNodes[j] );
-			PackSize ( iOfs );
-			break;
+			const char * pExp = p+1;
+			if ( pExp<m_pEnd && ( *pExp=='+' || *pExp=='-' ) )
+				++pExp;
+			const char * pExpDigits = pExp;
+			while ( pExp<m_pEnd && IsJsonDigit ( *pExp ) )
+				++pExp;
+			if ( pExp>pExpDigits )
+			{
+				p = pExp;
+				bFloat = true;
+			}
 		}
-		default: assert ( 0 && "internal error: unhandled type" );
-			return false;
+
+		// source is ours to modify (as with the lexer's hold char); terminate the token so strtod() can't run past it
+		auto * pHold = const_cast<char *> ( p );
+		char cHold = *pHold;
+		*pHold = '\0';
+		if ( bFloat )
+		{
+			tScalar.m_eType = JSON_DOUBLE;
+			tScalar.m_fValue = strtod ( sToken, nullptr );
+		} else
+		{
+			tScalar.m_eType = JSON_INT64;
+			tScalar.m_iValue = strtoll ( sToken, nullptr, 10 );
 		}
+		*pHold = cHold;
+		m_p = p;
 		return true;
 	}
 
-	void AddNode ( const JsonNode_t & tNode )
+	void NumericFixup ( JsonScalar_t & tScalar ) const
 	{
-		m_dNodes.Add ( tNode );
-	}
-};
+		// auto-convert string values, if necessary
+		if ( m_bAutoconv && tScalar.m_eType==JSON_STRING )
+			if ( !sphJsonStringToNumber ( tScalar.m_sRaw+1, tScalar.m_iRawLen-2, tScalar.m_eType, tScalar.m_iValue, tScalar.m_fValue ) )
+				return;
 
-// unused parameter, simply to avoid type clash between all my yylex() functions
-#define YY_NO_UNISTD_H 1
-#define YY_DECL inline static int my_lex ( YYSTYPE * lvalp, void * yyscanner, JsonParser_c * pParser )
+		// parser and converter emits int64 values, fix them up to int32 if possible
+		if ( tScalar.m_eType==JSON_INT64 && tScalar.m_iValue==int64_t ( int ( tScalar.m_iValue ) ) )
+			tScalar.m_eType = JSON_INT32;
+	}
 
-#include "flexsphinxjson.c"
+	void WriteScalar ( const JsonScalar_t & tScalar )
+	{
+		switch ( tScalar.m_eType )
+		{
+		case JSON_INT32: StoreInt ( (int) tScalar.m_iValue ); break;
+		case JSON_INT64: StoreBigint ( tScalar.m_iValue ); break;
+		case JSON_DOUBLE: StoreBigint ( sphD2QW ( tScalar.m_fValue ) ); break;
+		case JSON_STRING: PackStrUnescaped ( tScalar.m_sRaw, tScalar.m_iRawLen ); break;
+		default: break; // literals have no content
+		}
+	}
 
-static void yyerror ( JsonParser_c * pParser, const char * sMessage )
-{
-	yy2lex_unhold ( pParser->m_pScanner );
-	pParser->m_sError.Sprintf ( "P10: %s near '%s'", sMessage, pParser->m_pLastToken );
-}
+	/// all-scalar vector is closed; write it in generic form if all values are of same type, as mixed otherwise
+	ESphJsonType WriteVector ( const VecTraits_T<JsonScalar_t> & dScalars )
+	{
+		ESphJsonType eType = JSON_MIXED_VECTOR;
+		if ( !dScalars.IsEmpty () )
+		{
+			ESphJsonType eBase = dScalars[0].m_eType;
+			if ( dScalars.all_of ( [eBase] ( const JsonScalar_t & tScalar ) { return tScalar.m_eType==eBase; } ) )
+				switch ( eBase )
+				{
+				case JSON_INT32: eType = JSON_INT32_VECTOR; break;
+				case JSON_INT64: eType = JSON_INT64_VECTOR; break;
+				case JSON_DOUBLE: eType = JSON_DOUBLE_VECTOR; break;
+				case JSON_STRING: eType = JSON_STRING_VECTOR; break;
+				default: break; // type matches across all entries, but we do not have a special format for that type
+				}
+		}
 
-#ifndef NDEBUG
+		switch ( eType )
+		{
+		case JSON_INT32_VECTOR:
+		case JSON_INT64_VECTOR:
+		case JSON_DOUBLE_VECTOR:
+			PackInt ( dScalars.GetLength () );
+			for ( const auto & tScalar : dScalars )
+				WriteScalar ( tScalar );
+			break;
 
-// using a proxy to be possible to debug inside yylex
-static int yylex ( YYSTYPE * lvalp, JsonParser_c * pParser )
-{
-	int res = my_lex ( lvalp, pParser->m_pScanner, pParser );
-	return res;
-}
+		case JSON_STRING_VECTOR:
+		{
+			int iOfs = ReserveSize ();
+			PackInt ( dScalars.GetLength () );
+			for ( const auto & tScalar : dScalars )
+				WriteScalar ( tScalar );
+			PackSize ( iOfs );
+			break;
+		}
 
-#else
-inline static int yylex ( YYSTYPE * lvalp, JsonParser_c * pParser )
-{
-	return my_lex ( lvalp, pParser->m_pScanner, pParser );
-}
-#endif
+		default:
+		{
+			int iOfs = ReserveSize ();
+			PackInt ( dScalars.GetLength () );
+			for ( const auto & tScalar : dScalars )
+			{
+				Add ( tScalar.m_eType );
+				WriteScalar ( tScalar );
+			}
+			PackSize ( iOfs );
+		}
+		}
+		return eType;
+	}
+};
 
-#include "bissphinxjson.c"
 #include "sphinxutils.h"
 
 bool sphJsonParse ( CSphVector<BYTE>& dData, const CSphString& sFileName, CSphString& sError )
@@ -852,34 +1206,20 @@ bool sphJsonParse ( CSphVector<BYTE> &dData, char * sData, bool bAutoconv, bool
 		return false;
 	}
 
-	JsonParser_c tParser ( dData, bAutoconv, bToLowercase, sMsg );
-	yy2lex_init ( &tParser.m_pScanner );
-
-	tParser.m_pSource = sData; // sphJsonParse() is intentionally destructive, no need to copy data here
-
-	YY_BUFFER_STATE tLexerBuffer = yy2_scan_buffer ( sData, iLen+2, tParser.m_pScanner );
-	if ( !tLexerBuffer )
-	{
-		sMsg << "internal error: yy_scan_buffer() failed";
-		return false;
-	}
-
-	int iRes = yyparse ( &tParser );
-	yy2_delete_buffer ( tLexerBuffer, tParser.m_pScanner );
-	yy2lex_destroy ( tParser.m_pScanner );
-
+	JsonParser_c tParser ( dData, sData, iLen, bAutoconv, bToLowercase, sMsg ); // sphJsonParse() is intentionally destructive, no need to copy data here
+	bool bOk = tParser.Parse();
 	tParser.Finalize();
 
-	if ( bCheckSize && dData.AllocatedBytes()>=0x400000 )
+	if ( bOk && bCheckSize && dData.AllocatedBytes()>=0x400000 )
 	{
 		sMsg << "data exceeds 0x400000 bytes";
-		iRes = -1;
+		bOk = false;
 	}
 
-	if ( iRes!=0 )
+	if ( !bOk )
 		dData.Reset();
 
-	return ( iRes==0 );
+	return bOk;
 }
 
 //////////////////////////////////////////////////////////////////////////
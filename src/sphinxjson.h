@@ -361,6 +361,12 @@ bool sphJsonParse ( CSphVector<BYTE> & dData, char * sData, bool bAutoconv, bool
 bool sphJsonParse ( CSphVector<BYTE> & dData, char * sData, bool bAutoconv, bool bToLowercase, bool bCheckSize, StringBuilder_c & sMsg );
 bool sphJsonParse ( CSphVector<BYTE> & dData, const CSphString& sFileName, CSphString & sError );
 
+/// skip JSON whitespace (space, tab, CR, LF); SSE2-accelerated on long runs
+const char * sphJsonSkipWhitespace ( const char * p, const char * pEnd );
+
+/// find closing quote or backslash in JSON string body; SSE2-accelerated; returns pEnd if none
+const char * sphJsonFindQuoteOrEscape ( const char * p, const char * pEnd, char cQuote='"' );
+
 /// convert SphinxBSON blob back to JSON document
 void sphJsonFormat ( JsonEscapedBuilder & dOut, const BYTE * pData );
 
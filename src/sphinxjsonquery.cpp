@@ -972,6 +972,18 @@ bool sphParseJsonQuery ( const JsonObj_c & tRoot, JsonQuery_c & tQuery, bool & b
 }
 
 
+static bool CheckInsertIntegrity ( SqlStmt_t & tStmt, CSphString & sError )
+{
+	if ( !tStmt.CheckInsertIntegrity() )
+	{
+		sError = "wrong number of values";
+		return false;
+	}
+
+	return true;
+}
+
+
 bool ParseJsonInsert ( const JsonObj_c & tRoot, SqlStmt_t & tStmt, DocID_t & tDocId, bool bReplace, bool bCompat, CSphString & sError )
 {
 	if ( !ParseIndexId ( tRoot, tStmt, tDocId, sError ) )
@@ -1042,18 +1054,701 @@ bool ParseJsonInsertSource ( const JsonObj_c & tSource, SqlStmt_t & tStmt, bool
 		}
 	}
 
-	if ( !tStmt.CheckInsertIntegrity() )
+	return CheckInsertIntegrity ( tStmt, sError );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// DOM-free reader of insert/replace requests
+
+/// Reads plain insert/replace documents (/insert, /replace, /bulk) straight into SqlStmt_t in a single pass, without
+/// building cJSON tree. It is strict and cautious: on anything beyond plain well-formed documents (malformed json,
+/// nulls, duplicate or escaped properties, unsigned or huge numbers, odd escapes, etc.) it gives up, and caller
+/// re-parses the request with cJSON, so that results and error messages are exactly the same as before.
+/// Values which go to statement as json text (objects, compat arrays) are printed the same way cJSON prints them.
+class InsertJsonReader_c
+{
+public:
+	explicit InsertJsonReader_c ( const char * szJson )
+		: m_p ( szJson )
+		, m_pEnd ( szJson + strlen ( szJson ) )
+	{}
+
+	/// request is the insert object itself
+	bool ReadInsert ( SqlStmt_t & tStmt, DocID_t & tDocId, bool bReplace, bool bCompat )
 	{
-		sError = "wrong number of values";
-		return false;
+		SkipSpaces();
+		return ReadInsertObject ( tStmt, tDocId, bReplace, bCompat );
 	}
 
-	return true;
+	/// request is bulk line like {"insert":{...}}; only insert-like statements are handled
+	bool ReadStatement ( SqlStmt_t & tStmt, CSphString & sStmt, CSphString & sQuery, DocID_t & tDocId )
+	{
+		SkipSpaces();
+		if ( !Expect ( '{' ) )
+			return false;
+
+		SkipSpaces();
+		Str_t sName;
+		if ( !ReadString ( sName ) || m_bEscaped )
+			return false;
+
+		bool bReplace = false;
+		if ( IsName ( sName, "index" ) || IsName ( sName, "replace" ) )
+			bReplace = true;
+		else if ( !IsName ( sName, "create" ) && !IsName ( sName, "insert" ) )
+			return false;
+
+		SkipSpaces();
+		if ( !Expect ( ':' ) )
+			return false;
+
+		SkipSpaces();
+		const char * pStmt = m_p;
+		if ( !ReadInsertObject ( tStmt, tDocId, bReplace, false ) )
+			return false;
+		const char * pStmtEnd = m_p;
+
+		// rest of the root is not used, but must be valid
+		if ( !SkipMembers() )
+			return false;
+
+		// statement text as cJSON would print it
+		JsonEscapedBuilder tQuery;
+		m_p = pStmt;
+		m_pEnd = pStmtEnd;
+		if ( !CopyValue ( &tQuery ) )
+			return false;
+
+		sStmt.SetBinary ( sName.first, sName.second );
+		tQuery.MoveTo ( sQuery );
+		return true;
+	}
+
+private:
+	static constexpr int MAX_DEPTH = 256;
+
+	const char *		m_p;
+	const char *		m_pEnd;
+	int					m_iDepth = 0;
+	bool				m_bEscaped = false;	///< whether last string read had escapes
+	CSphVector<char>	m_dUnescaped;
+
+	// same as in cJSON, any control char is a space
+	void SkipSpaces()
+	{
+		m_p = sphJsonSkipWhitespace ( m_p, m_pEnd );
+		while ( m_p<m_pEnd && (BYTE)*m_p<=' ' )
+			++m_p;
+	}
+
+	bool Expect ( char c )
+	{
+		if ( m_p>=m_pEnd || *m_p!=c )
+			return false;
+		++m_p;
+		return true;
+	}
+
+	static bool IsName ( Str_t sName, const char * szName )
+	{
+		return sName.second==(int)strlen ( szName ) && !memcmp ( sName.first, szName, sName.second );
+	}
+
+	static bool IsNameCI ( Str_t sName, const char * szName )
+	{
+		return sName.second==(int)strlen ( szName ) && !strncasecmp ( sName.first, szName, sName.second );
+	}
+
+	static bool IsDigit ( char c )
+	{
+		return c>='0' && c<='9';
+	}
+
+	bool ReadInsertObject ( SqlStmt_t & tStmt, DocID_t & tDocId, bool bReplace, bool bCompat )
+	{
+		if ( !Expect ( '{' ) )
+			return false;
+
+		// docid goes first, but its value is only known at the end
+		tStmt.m_dInsertSchema.Add ( sphGetDocidName() );
+		int iIdValue = tStmt.m_dInsertValues.GetLength();
+		tStmt.m_dInsertValues.Add();
+
+		bool bIndex = false, bId = false, bCluster = false, bDoc = false;
+		int64_t iId = 0;
+		CSphString sIndex, sCluster;
+
+		SkipSpaces();
+		if ( m_p<m_pEnd && *m_p=='}' )
+			return false; // no index
+
+		while ( true )
+		{
+			SkipSpaces();
+			Str_t sKey;
+			if ( !ReadString ( sKey ) || m_bEscaped )
+				return false;
+			SkipSpaces();
+			if ( !Expect ( ':' ) )
+				return false;
+			SkipSpaces();
+
+			if ( IsNameCI ( sKey, "index" ) )
+			{
+				Str_t sVal;
+				if ( bIndex || !ReadString ( sVal ) || !sVal.second || memchr ( sVal.first, ':', sVal.second ) )
+					return false;
+				sIndex.SetBinary ( sVal.first, sVal.second );
+				bIndex = true;
+			} else if ( IsNameCI ( sKey, "id" ) )
+			{
+				bool bFloat = false;
+				double fFoo;
+				if ( bId || !ReadNumber ( bFloat, iId, fFoo ) || bFloat || iId<0 )
+					return false;
+				bId = true;
+			} else if ( IsNameCI ( sKey, "cluster" ) )
+			{
+				Str_t sVal;
+				if ( bCluster || !ReadString ( sVal ) || !sVal.second )
+					return false;
+				sCluster.SetBinary ( sVal.first, sVal.second );
+				bCluster = true;
+			} else if ( IsNameCI ( sKey, "doc" ) )
+			{
+				if ( bDoc || !ReadDoc ( tStmt, bCompat ) )
+					return false;
+				bDoc = true;
+			} else if ( !CopyValue ( nullptr ) )
+				return false;
+
+			SkipSpaces();
+			if ( m_p<m_pEnd && *m_p==',' )
+			{
+				++m_p;
+				continue;
+			}
+			if ( !Expect ( '}' ) )
+				return false;
+			break;
+		}
+
+		if ( !bIndex )
+			return false;
+
+		tStmt.m_eStmt = bReplace ? STMT_REPLACE : STMT_INSERT;
+		tStmt.m_sIndex = sIndex;
+		tStmt.m_tQuery.m_sIndexes = sIndex;
+		if ( bCluster )
+			tStmt.m_sCluster = sCluster;
+
+		tDocId = iId; // 0 enables auto-id
+		SqlInsert_t & tId = tStmt.m_dInsertValues[iIdValue];
+		tId.m_iType = SqlInsert_t::CONST_INT;
+		tId.SetValueInt ( (uint64_t)tDocId, false );
+		return true;
+	}
+
+	bool ReadDoc ( SqlStmt_t & tStmt, bool bCompat )
+	{
+		if ( !Expect ( '{' ) )
+			return false;
+
+		SkipSpaces();
+		if ( m_p<m_pEnd && *m_p=='}' )
+		{
+			++m_p;
+			return true;
+		}
+
+		while ( true )
+		{
+			SkipSpaces();
+			Str_t sKey;
+			if ( !ReadString ( sKey ) )
+				return false;
+			CSphString & sName = tStmt.m_dInsertSchema.Add();
+			sName.SetBinary ( sKey.first, sKey.second );
+			sName.ToLower();
+
+			SkipSpaces();
+			if ( !Expect ( ':' ) )
+				return false;
+			SkipSpaces();
+			if ( !ReadDocValue ( tStmt.m_dInsertValues.Add(), bCompat ) )
+				return false;
+
+			SkipSpaces();
+			if ( m_p<m_pEnd && *m_p==',' )
+			{
+				++m_p;
+				continue;
+			}
+			return Expect ( '}' );
+		}
+	}
+
+	bool ReadDocValue ( SqlInsert_t & tValue, bool bCompat )
+	{
+		if ( m_p>=m_pEnd )
+			return false;
+
+		switch ( *m_p )
+		{
+		case '"':
+		{
+			Str_t sVal;
+			if ( !ReadString ( sVal ) )
+				return false;
+			tValue.m_iType = SqlInsert_t::QUOTED_STRING;
+			tValue.m_sVal.SetBinary ( sVal.first, sVal.second );
+			return true;
+		}
+
+		case 't':
+		case 'f':
+		{
+			bool bTrue = *m_p=='t';
+			const char * szLiteral = bTrue ? "true" : "false";
+			auto iLen = (int)strlen ( szLiteral );
+			if ( m_pEnd-m_p<iLen || memcmp ( m_p, szLiteral, iLen ) )
+				return false;
+			m_p += iLen;
+			tValue.m_iType = SqlInsert_t::CONST_INT;
+			tValue.SetValueInt ( int64_t ( bTrue ) );
+			return true;
+		}
+
+		case '{':
+			return ReadJsonText ( tValue );
+
+		case '[':
+			if ( bCompat )
+				return ReadJsonText ( tValue );
+			return ReadMva ( tValue );
+
+		default:
+		{
+			bool bFloat = false;
+			int64_t iVal = 0;
+			double fVal = 0.0;
+			if ( !ReadNumber ( bFloat, iVal, fVal ) )
+				return false;
+
+			if ( bFloat )
+			{
+				tValue.m_iType = SqlInsert_t::CONST_FLOAT;
+				tValue.m_fVal = (float)fVal;
+			} else
+			{
+				tValue.m_iType = SqlInsert_t::CONST_INT;
+				tValue.SetValueInt ( iVal );
+			}
+			return true;
+		}
+		}
+	}
+
+	bool ReadJsonText ( SqlInsert_t & tValue )
+	{
+		JsonEscapedBuilder tOut;
+		if ( !CopyValue ( &tOut ) )
+			return false;
+		tValue.m_iType = SqlInsert_t::QUOTED_STRING;
+		tOut.MoveTo ( tValue.m_sVal );
+		return true;
+	}
+
+	bool ReadMva ( SqlInsert_t & tValue )
+	{
+		++m_p; // '['
+		tValue.m_iType = SqlInsert_t::CONST_MVA;
+		tValue.m_pVals = new RefcountedVector_c<SphAttr_t>;
+
+		SkipSpaces();
+		if ( m_p<m_pEnd && *m_p==']' )
+		{
+			++m_p;
+			return true;
+		}
+
+		while ( true )
+		{
+			SkipSpaces();
+			bool bFloat = false;
+			int64_t iVal = 0;
+			double fFoo;
+			if ( !ReadNumber ( bFloat, iVal, fFoo ) || bFloat )
+				return false;
+			tValue.m_pVals->Add ( iVal );
+
+			SkipSpaces();
+			if ( m_p<m_pEnd && *m_p==',' )
+			{
+				++m_p;
+				continue;
+			}
+			return Expect ( ']' );
+		}
+	}
+
+	// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?; integers are only taken up to 18 digits, to fit int64 for sure
+	bool ReadNumber ( bool & bFloat, int64_t & iValue, double & fValue )
+	{
+		const char * sStart = m_p;
+		const char * p = m_p;
+		bool bNegative = p<m_pEnd && *p=='-';
+		if ( bNegative )
+			++p;
+
+		if ( p>=m_pEnd || !IsDigit ( *p ) )
+			return false;
+
+		const char * pDigits = p;
+		if ( *p=='0' )
+			++p;
+		else
+			while ( p<m_pEnd && IsDigit ( *p ) )
+				++p;
+		const char * pDigitsEnd = p;
+
+		bFloat = false;
+		if ( p<m_pEnd && *p=='.' )
+		{
+			++p;
+			if ( p>=m_pEnd || !IsDigit ( *p ) )
+				return false;
+			while ( p<m_pEnd && IsDigit ( *p ) )
+				++p;
+			bFloat = true;
+		}
+
+		if ( p<m_pEnd && ( *p=='e' || *p=='E' ) )
+		{
+			++p;
+			if ( p<m_pEnd && ( *p=='+' || *p=='-' ) )
+				++p;
+			if ( p>=m_pEnd || !IsDigit ( *p ) )
+				return false;
+			while ( p<m_pEnd && IsDigit ( *p ) )
+				++p;
+			bFloat = true;
+		}
+
+		// cJSON takes at most 63 chars of [0-9.eE+-] as number, don't try to mimic it on the edges
+		const int MAX_NUMBER_LEN = 63;
+		if ( p-sStart>MAX_NUMBER_LEN || ( p<m_pEnd && ( IsDigit ( *p ) || strchr ( ".eE+-", *p ) ) ) )
+			return false;
+
+		if ( bFloat )
+		{
+			char sNumber[MAX_NUMBER_LEN+1];
+			memcpy ( sNumber, sStart, p-sStart );
+			sNumber[p-sStart] = '\0';
+
+			// cJSON checks errno without resetting it, so keep it intact for the fallback path
+			// and leave out-of-range values to cJSON
+			int iSavedErrno = errno;
+			errno = 0;
+			fValue = strtod ( sNumber, nullptr );
+			bool bOutOfRange = errno==ERANGE;
+			errno = iSavedErrno;
+			if ( bOutOfRange )
+				return false;
+		} else
+		{
+			if ( pDigitsEnd-pDigits>18 )
+				return false;
+			iValue = 0;
+			for ( const char * s = pDigits; s<pDigitsEnd; ++s )
+				iValue = iValue*10 + ( *s-'0' );
+			if ( bNegative )
+				iValue = -iValue;
+		}
+
+		m_p = p;
+		return true;
+	}
+
+	// same as in cJSON: 4 hex digits; zero and invalid codes are left for cJSON
+	static int ParseHex4 ( const char * s )
+	{
+		int iCode = 0;
+		for ( int i = 0; i<4; ++i )
+		{
+			char c = s[i];
+			int iDigit;
+			if ( c>='0' && c<='9' )
+				iDigit = c-'0';
+			else if ( c>='a' && c<='f' )
+				iDigit = c-'a'+10;
+			else if ( c>='A' && c<='F' )
+				iDigit = c-'A'+10;
+			else
+				return 0;
+			iCode = ( iCode<<4 ) + iDigit;
+		}
+		return iCode;
+	}
+
+	// p points to backslash of \uXXXX; returns length of escape sequence, or 0 on failure
+	int UnescapeUtf16 ( const char * p )
+	{
+		if ( m_pEnd-p<6 )
+			return 0;
+
+		int iCode = ParseHex4 ( p+2 );
+		if ( !iCode || ( iCode>=0xDC00 && iCode<=0xDFFF ) )
+			return 0;
+
+		int iLen = 6;
+		if ( iCode>=0xD800 && iCode<=0xDBFF )
+		{
+			// surrogate pair
+			if ( m_pEnd-p<12 || p[6]!='\\' || p[7]!='u' )
+				return 0;
+			int iLow = ParseHex4 ( p+8 );
+			if ( iLow<0xDC00 || iLow>0xDFFF )
+				return 0;
+			iCode = 0x10000 + ( ( ( iCode & 0x3FF )<<10 ) | ( iLow & 0x3FF ) );
+			iLen = 12;
+		}
+
+		BYTE * pOut = (BYTE *)m_dUnescaped.AddN ( 4 );
+		int iBytes = sphUTF8Encode ( pOut, iCode );
+		m_dUnescaped.Resize ( m_dUnescaped.GetLength()-4+iBytes );
+		return iLen;
+	}
+
+	// string is returned in place if it has no escapes, or unescaped into m_dUnescaped (valid till the next call)
+	bool ReadString ( Str_t & sValue )
+	{
+		if ( !Expect ( '"' ) )
+			return false;
+
+		const char * sStart = m_p;
+		const char * p = sphJsonFindQuoteOrEscape ( sStart, m_pEnd );
+		if ( p>=m_pEnd )
+			return false;
+
+		m_bEscaped = *p=='\\';
+		if ( !m_bEscaped )
+		{
+			sValue = { sStart, int ( p-sStart ) };
+			m_p = p+1;
+			return true;
+		}
+
+		m_dUnescaped.Resize ( 0 );
+		m_dUnescaped.Append ( sStart, int ( p-sStart ) );
+		while ( *p=='\\' )
+		{
+			if ( p+1>=m_pEnd )
+				return false;
+
+			int iSkip = 2;
+			switch ( p[1] )
+			{
+			case 'b': m_dUnescaped.Add ( '\b' ); break;
+			case 'f': m_dUnescaped.Add ( '\f' ); break;
+			case 'n': m_dUnescaped.Add ( '\n' ); break;
+			case 'r': m_dUnescaped.Add ( '\r' ); break;
+			case 't': m_dUnescaped.Add ( '\t' ); break;
+			case '"':
+			case '\\':
+			case '/': m_dUnescaped.Add ( p[1] ); break;
+			case 'u': iSkip = UnescapeUtf16 ( p ); break;
+			default: iSkip = 0; break;
+			}
+			if ( !iSkip )
+				return false;
+			p += iSkip;
+
+			const char * pNext = sphJsonFindQuoteOrEscape ( p, m_pEnd );
+			if ( pNext>=m_pEnd )
+				return false;
+			m_dUnescaped.Append ( p, int ( pNext-p ) );
+			p = pNext;
+		}
+
+		sValue = { m_dUnescaped.Begin(), m_dUnescaped.GetLength() };
+		m_p = p+1;
+		return true;
+	}
+
+	// cJSON prints doubles with 15 digits, or with 17 if 15 are not enough to get the same value back
+	static void PrintDouble ( JsonEscapedBuilder & tOut, double fValue )
+	{
+		if ( fValue*0!=0 )
+		{
+			tOut << "null";
+			return;
+		}
+
+		char sBuf[32];
+		snprintf ( sBuf, sizeof(sBuf), "%1.15g", fValue );
+		double fTest;
+		if ( sscanf ( sBuf, "%lg", &fTest )!=1 || fTest!=fValue )
+			snprintf ( sBuf, sizeof(sBuf), "%1.17g", fValue );
+		tOut += sBuf;
+	}
+
+	/// validate json value and print it (if pOut is given) as unformatted cJSON output
+	bool CopyValue ( JsonEscapedBuilder * pOut )
+	{
+		if ( m_p>=m_pEnd )
+			return false;
+
+		switch ( *m_p )
+		{
+		case '"':
+		{
+			Str_t sVal;
+			if ( !ReadString ( sVal ) )
+				return false;
+			if ( pOut )
+				pOut->AppendEscapedWithComma ( sVal.first, sVal.second );
+			return true;
+		}
+
+		case '{':
+		case '[':
+		{
+			if ( ++m_iDepth>MAX_DEPTH )
+				return false;
+
+			bool bObject = *m_p=='{';
+			char cClose = bObject ? '}' : ']';
+			if ( pOut )
+				*pOut << *m_p;
+			++m_p;
+
+			SkipSpaces();
+			bool bEmpty = m_p<m_pEnd && *m_p==cClose;
+			while ( !bEmpty )
+			{
+				SkipSpaces();
+				if ( bObject )
+				{
+					if ( m_p>=m_pEnd || *m_p!='"' || !CopyValue ( pOut ) )
+						return false;
+					SkipSpaces();
+					if ( !Expect ( ':' ) )
+						return false;
+					if ( pOut )
+						*pOut << ':';
+					SkipSpaces();
+				}
+
+				if ( !CopyValue ( pOut ) )
+					return false;
+
+				SkipSpaces();
+				if ( m_p<m_pEnd && *m_p==',' )
+				{
+					++m_p;
+					if ( pOut )
+						*pOut << ',';
+					continue;
+				}
+				break;
+			}
+
+			if ( !Expect ( cClose ) )
+				return false;
+			if ( pOut )
+				*pOut << cClose;
+			--m_iDepth;
+			return true;
+		}
+
+		case 't':
+		case 'f':
+		case 'n':
+		{
+			const char * szLiteral = *m_p=='t' ? "true" : ( *m_p=='f' ? "false" : "null" );
+			auto iLen = (int)strlen ( szLiteral );
+			if ( m_pEnd-m_p<iLen || memcmp ( m_p, szLiteral, iLen ) )
+				return false;
+			m_p += iLen;
+			if ( pOut )
+				*pOut << szLiteral;
+			return true;
+		}
+
+		default:
+		{
+			bool bFloat = false;
+			int64_t iVal = 0;
+			double fVal = 0.0;
+			if ( !ReadNumber ( bFloat, iVal, fVal ) )
+				return false;
+			if ( !pOut )
+				return true;
+			if ( bFloat )
+				PrintDouble ( *pOut, fVal );
+			else
+				pOut->NtoA ( iVal );
+			return true;
+		}
+		}
+	}
+
+	// skip the rest of object members after the first one, till the closing brace
+	bool SkipMembers()
+	{
+		while ( true )
+		{
+			SkipSpaces();
+			if ( m_p<m_pEnd && *m_p==',' )
+			{
+				++m_p;
+				SkipSpaces();
+				if ( m_p>=m_pEnd || *m_p!='"' || !CopyValue ( nullptr ) )
+					return false;
+				SkipSpaces();
+				if ( !Expect ( ':' ) )
+					return false;
+				SkipSpaces();
+				if ( !CopyValue ( nullptr ) )
+					return false;
+				continue;
+			}
+			return Expect ( '}' );
+		}
+	}
+};
+
+
+// fast reader failed; drop whatever it managed to add, before re-parsing with cJSON
+static void RollbackInsert ( SqlStmt_t & tStmt, int iSchema, int iValues )
+{
+	tStmt.m_dInsertSchema.Resize ( iSchema );
+	tStmt.m_dInsertValues.Resize ( iValues );
+}
+
+
+bool ReadJsonInsert ( const char * szInsert, SqlStmt_t & tStmt, DocID_t & tDocId, bool bReplace, bool bCompat )
+{
+	return InsertJsonReader_c ( szInsert ).ReadInsert ( tStmt, tDocId, bReplace, bCompat );
+}
+
+
+bool ReadJsonStatement ( const char * szStmt, SqlStmt_t & tStmt, CSphString & sStmt, CSphString & sQuery, DocID_t & tDocId )
+{
+	return InsertJsonReader_c ( szStmt ).ReadStatement ( tStmt, sStmt, sQuery, tDocId );
 }
 
 
 bool sphParseJsonInsert ( const char * szInsert, SqlStmt_t & tStmt, DocID_t & tDocId, bool bReplace, bool bCompat, CSphString & sError )
 {
+	int iSchema = tStmt.m_dInsertSchema.GetLength();
+	int iValues = tStmt.m_dInsertValues.GetLength();
+	if ( ReadJsonInsert ( szInsert, tStmt, tDocId, bReplace, bCompat ) )
+		return CheckInsertIntegrity ( tStmt, sError );
+
+	RollbackInsert ( tStmt, iSchema, iValues );
 	JsonObj_c tRoot ( szInsert );
 	return ParseJsonInsert ( tRoot, tStmt, tDocId, bReplace, bCompat, sError );
 }
@@ -1226,6 +1921,12 @@ bool sphParseJsonDelete ( Str_t sDelete, SqlStmt_t & tStmt, DocID_t & tDocId, CS
 
 bool sphParseJsonStatement ( const char * szStmt, SqlStmt_t & tStmt, CSphString & sStmt, CSphString & sQuery, DocID_t & tDocId, CSphString & sError )
 {
+	int iSchema = tStmt.m_dInsertSchema.GetLength();
+	int iValues = tStmt.m_dInsertValues.GetLength();
+	if ( ReadJsonStatement ( szStmt, tStmt, sStmt, sQuery, tDocId ) )
+		return CheckInsertIntegrity ( tStmt, sError );
+
+	RollbackInsert ( tStmt, iSchema, iValues );
 	JsonObj_c tRoot ( szStmt );
 	if ( !tRoot )
 	{
@@ -1729,13 +2430,29 @@ CSphString sphEncodeResultJson ( const VecTraits_T<const AggrResult_t *> & dRes,
 {
 	assert ( dRes.GetLength()>=1 );
 	assert ( dRes[0]!=nullptr );
-	const AggrResult_t & tRes = *dRes[0];
 
-	if ( !tRes.m_iSuccesses )
-		return JsonEncodeResultError ( tRes.m_sError );
+	if ( !dRes[0]->m_iSuccesses )
+		return JsonEncodeResultError ( dRes[0]->m_sError );
 
 	JsonEscapedBuilder tOut;
 	CSphString sResult;
+	sphEncodeResultJson ( dRes, tQuery, pProfile, bCompat, tOut, nullptr );
+	tOut.MoveTo ( sResult );
+	return sResult;
+}
+
+
+void sphEncodeResultJson ( const VecTraits_T<const AggrResult_t *> & dRes, const JsonQuery_c & tQuery, QueryProfile_c * pProfile, bool bCompat, JsonEscapedBuilder & tOut, const JsonFlush_fn & fnFlush )
+{
+	assert ( dRes.GetLength()>=1 );
+	assert ( dRes[0]!=nullptr );
+	const AggrResult_t & tRes = *dRes[0];
+
+	if ( !tRes.m_iSuccesses )
+	{
+		tOut << JsonEncodeResultError ( tRes.m_sError ).cstr();
+		return;
+	}
 
 	tOut.ObjectBlock();
 
@@ -1809,7 +2526,7 @@ CSphString sphEncodeResultJson ( const VecTraits_T<const AggrResult_t *> & dRes,
 	auto dMatches = tRes.m_dResults.First ().m_dMatches.Slice ( tRes.m_iOffset, tRes.m_iCount );
 	for ( const auto& tMatch : dMatches )
 	{
-		ScopedComma_c sQueryComma ( tOut, ",", "{", "}" );
+		tOut.StartBlock ( ",", "{", "}" );
 
 		// note, that originally there is string UID, so we just output number in quotes for docid here
 		if ( bCompatId )
@@ -1867,6 +2584,10 @@ CSphString sphEncodeResultJson ( const VecTraits_T<const AggrResult_t *> & dRes,
 			if ( tQuery.m_dSortFields.GetLength() )
 				EncodeFields ( tQuery.m_dSortFields, tRes, tMatch, tSchema, true, R"("sort":[)", "]", tOut );
 		}
+
+		tOut.FinishBlock();
+		if ( fnFlush )
+			fnFlush ( tOut );
 	}
 
 	tOut.FinishBlocks ( sHitMeta, false ); // hits array, hits meta
@@ -1892,7 +2613,7 @@ CSphString sphEncodeResultJson ( const VecTraits_T<const AggrResult_t *> & dRes,
 			tOut.Sprintf ( R"("profile":{"query":%s})", sPlan.cstr () );
 	}
 
-	tOut.FinishBlocks (); tOut.MoveTo ( sResult ); return sResult;
+	tOut.FinishBlocks ();
 }
 
 
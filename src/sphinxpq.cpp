@@ -36,21 +36,6 @@ static auto &g_bRTChangesAllowed = RTChangesAllowed ();
 //////////////////////////////////////////////////////////////////////////
 // percolate index
 
-struct StoredQuery_t : public StoredQuery_i, public ISphRefcountedMT
-{
-	CSphFixedVector<uint64_t>		m_dRejectTerms { 0 };
-	CSphFixedVector<uint64_t>		m_dRejectWilds { 0 };
-	CSphFixedVector<uint64_t>		m_dTags { 0 };
-	CSphVector<CSphString>			m_dSuffixes;
-	DictMap_t						m_hDict;
-	std::unique_ptr<XQQuery_t>		m_pXQ;
-	int								m_iStackRequired = 0;
-	static int 						m_iStackBaseRequired; // additional stack which was in use at the moment of measuring
-
-	bool							m_bOnlyTerms = false; // flag of simple query, ie only words and no operators
-	bool							IsFullscan() const { return m_pXQ->m_bEmpty; }
-};
-
 #ifdef NDEBUG
 static constexpr int PQ_BASE_STACK = 24 * 1024;
 #else
@@ -81,6 +66,76 @@ public:
 	int64_t Generation() const { return m_iGeneration; };
 };
 
+static bool IsAnchorable ( const StoredQuery_t * pQuery )
+{
+	return pQuery->m_bOnlyTerms && !pQuery->IsFullscan() && pQuery->m_dRejectTerms.GetLength() && !pQuery->m_dRejectWilds.GetLength();
+}
+
+
+void PercolateTermIndex_c::Add ( const StoredQuery_t * pQuery )
+{
+	++m_iEntries;
+	if ( !IsAnchorable ( pQuery ) )
+	{
+		m_dComplex.Add ( pQuery->m_iQUID );
+		return;
+	}
+
+	// use the term with shortest posting as an anchor; that keeps postings of the frequent terms short
+	uint64_t uAnchor = pQuery->m_dRejectTerms[0];
+	int iBestLen = INT_MAX;
+	for ( uint64_t uTerm : pQuery->m_dRejectTerms )
+	{
+		int * pPosting = m_hTerms.Find ( uTerm );
+		int iLen = pPosting ? m_dPostings[*pPosting].GetLength() : 0;
+		if ( iLen<iBestLen )
+		{
+			uAnchor = uTerm;
+			iBestLen = iLen;
+			if ( !iLen )
+				break;
+		}
+	}
+
+	int & iPosting = m_hTerms.FindOrAdd ( uAnchor, m_dPostings.GetLength() );
+	if ( iPosting==m_dPostings.GetLength() )
+		m_dPostings.Add();
+
+	m_dPostings[iPosting].Add ( pQuery->m_iQUID );
+}
+
+
+void PercolateTermIndex_c::Reset()
+{
+	m_hTerms.Reset ( 0 );
+	m_dPostings.Reset();
+	m_dComplex.Reset();
+	m_iEntries = 0;
+	m_iStale = 0;
+}
+
+
+void PercolateTermIndex_c::GetCandidates ( const VecTraits_T<uint64_t> & dTerms, CSphVector<int64_t> & dQUIDs ) const
+{
+	dQUIDs.Append ( m_dComplex );
+	for ( uint64_t uTerm : dTerms )
+	{
+		int * pPosting = m_hTerms.Find ( uTerm );
+		if ( pPosting )
+			dQUIDs.Append ( m_dPostings[*pPosting] );
+	}
+}
+
+
+int64_t PercolateTermIndex_c::GetLengthBytes() const
+{
+	int64_t iBytes = m_hTerms.GetLengthBytes() + m_dPostings.GetLengthBytes64() + m_dComplex.GetLengthBytes64();
+	for ( const auto & dPosting : m_dPostings )
+		iBytes += dPosting.GetLengthBytes64();
+
+	return iBytes;
+}
+
 static FileAccessSettings_t g_tDummyFASettings;
 
 class PercolateIndex_c : public PercolateIndex_i
@@ -157,6 +212,7 @@ private:
 
 	StoredQuerySharedPtrVecSharedPtr_t	m_pQueries GUARDED_BY ( m_tLock );
 	OpenHashTable_T<int64_t, int>		m_hQueries GUARDED_BY ( m_tLock ); // QUID -> query
+	PercolateTermIndex_c				m_tTermIndex GUARDED_BY ( m_tLock ); // term -> QUID of candidate queries
 	int64_t							m_iGeneration GUARDED_BY ( m_tLock ) { 0 }; // eliminate ABA race on insert/delete
 	mutable RwLock_t				m_tLock;
 
@@ -185,6 +241,8 @@ private:
 	void PostSetupUnl () REQUIRES ( m_tLock  );
 	SharedPQSlice_t GetStored () const EXCLUDES ( m_tLock );
 	SharedPQSlice_t GetStoredUnl () const REQUIRES_SHARED ( m_tLock );
+	SharedPQSlice_t GetCandidates ( const SegmentReject_t & tReject, CSphVector<int> & dCandidates ) const EXCLUDES ( m_tLock );
+	void RebuildTermIndexUnl () REQUIRES ( m_tLock );
 
 	void BinlogReconfigure ( CSphReconfigureSetup & tSetup );
 
@@ -239,6 +297,11 @@ static SegmentReject_t SegmentGetRejects ( const RtSegment_t * pSeg, bool bBuild
 		uint64_t uHash = sphFNV64 ( pDictWord, iLen );
 		tReject.m_dTerms.Add ( uHash );
 
+		Slice_t tRows;
+		tRows.m_uOff = tReject.m_dTermRows.GetLength();
+		if ( !bMultiDocs )
+			tReject.m_dTermRows.Add ( 0 );
+
 		if ( bBuildInfix )
 		{
 			BuildBloom ( pDictWord, iLen, BLOOM_NGRAM_0, bUtf8, PERCOLATE_BLOOM_WILD_COUNT, tBloom0 );
@@ -253,6 +316,7 @@ static SegmentReject_t SegmentGetRejects ( const RtSegment_t * pSeg, bool bBuild
 
 				assert ( tDoc->m_tRowID<pSeg->m_uRows );
 				tReject.m_dPerDocTerms[tDoc->m_tRowID].Add ( uHash );
+				tReject.m_dTermRows.Add ( tDoc->m_tRowID );
 
 				if ( bBuildInfix )
 				{
@@ -264,6 +328,10 @@ static SegmentReject_t SegmentGetRejects ( const RtSegment_t * pSeg, bool bBuild
 				}
 			}
 		}
+
+		tRows.m_uLen = tReject.m_dTermRows.GetLength() - tRows.m_uOff;
+		if ( !tReject.m_hTermRows.Add ( uHash, tRows ) )
+			tReject.m_bTermRows = false; // different words with same hash; can't tell which one query means
 	}
 
 	tReject.m_dTerms.Uniq();
@@ -419,6 +487,106 @@ static void QueryGetTerms ( const XQNode_t * pNode, const DictRefPtr_c& pDict, D
 	hDict.m_dKeywords.CopyFrom ( dKeywords );
 }
 
+// hash of the keyword as it is stored in segment dictionary; 0 for keywords that can't be matched as a plain term
+static uint64_t GetPlainTermHash ( const XQKeyword_t & tWord, const DictRefPtr_c & pDict )
+{
+	int iLen = tWord.m_sWord.Length();
+	if ( !iLen || tWord.m_bFieldStart || tWord.m_bFieldEnd )
+		return 0;
+
+	BYTE sTmp[3 * SPH_MAX_WORD_LEN + 16];
+	assert ( iLen < (int)sizeof( sTmp ) );
+	for ( int i=0; i<iLen; i++ )
+	{
+		if ( sphIsWild ( tWord.m_sWord.cstr()[i] ) )
+			return 0;
+		sTmp[i] = tWord.m_sWord.cstr()[i];
+	}
+	sTmp[iLen] = '\0';
+
+	SphWordID_t uWord = tWord.m_bMorphed ? pDict->GetWordIDNonStemmed ( sTmp ) : pDict->GetWordID ( sTmp );
+	if ( !uWord )
+		return 0;
+
+	return sphFNV64 ( sTmp );
+}
+
+static bool DoBuildTermTree ( const XQNode_t * pNode, const DictRefPtr_c & pDict, CSphVector<TermTreeNode_t> & dTree, int iDepth, int & iMaxDepth )
+{
+	// FIXME!!! replace recursion to prevent stack overflow for large and complex queries
+	if ( !pNode || !pNode->m_dSpec.IsEmpty() )
+		return false;
+
+	iMaxDepth = Max ( iMaxDepth, pNode->m_dWords.GetLength()>1 ? iDepth+1 : iDepth );
+	TermTreeNode_t::Op_e eOp;
+	switch ( pNode->GetOp() )
+	{
+	case SPH_QUERY_AND:		eOp = TermTreeNode_t::Op_e::AND; break;
+	case SPH_QUERY_OR:		eOp = TermTreeNode_t::Op_e::OR; break;
+	case SPH_QUERY_ANDNOT:
+		if ( pNode->m_dChildren.GetLength()!=2 )
+			return false;
+		eOp = TermTreeNode_t::Op_e::ANDNOT;
+		break;
+	default:
+		return false;
+	}
+
+	if ( pNode->m_dWords.GetLength()+pNode->m_dChildren.GetLength()==0 )
+		return false;
+
+	// single word leaf needs no operator node
+	if ( pNode->m_dWords.GetLength()==1 && pNode->m_dChildren.IsEmpty() )
+	{
+		TermTreeNode_t & tTerm = dTree.Add();
+		tTerm.m_uTerm = GetPlainTermHash ( pNode->m_dWords[0], pDict );
+		return tTerm.m_uTerm!=0;
+	}
+
+	int iNode = dTree.GetLength();
+	dTree.Add().m_eOp = eOp;
+
+	for ( const auto & tWord : pNode->m_dWords )
+	{
+		TermTreeNode_t & tTerm = dTree.Add();
+		tTerm.m_uTerm = GetPlainTermHash ( tWord, pDict );
+		if ( !tTerm.m_uTerm )
+			return false;
+	}
+
+	ARRAY_FOREACH ( i, pNode->m_dChildren )
+	{
+		const XQNode_t * pChild = pNode->m_dChildren[i];
+
+		// NOT is only computable as the subtrahend of ANDNOT; ANDNOT itself does the negation
+		if ( pChild->GetOp()==SPH_QUERY_NOT )
+		{
+			if ( eOp!=TermTreeNode_t::Op_e::ANDNOT || i!=1 || pChild->m_dChildren.GetLength()!=1 || !pChild->m_dSpec.IsEmpty() )
+				return false;
+			pChild = pChild->m_dChildren[0];
+		}
+
+		if ( !DoBuildTermTree ( pChild, pDict, dTree, iDepth+1, iMaxDepth ) )
+			return false;
+	}
+
+	dTree[iNode].m_iNodes = dTree.GetLength() - iNode;
+	return true;
+}
+
+// compile term-only query (plain terms under AND, OR, NOT) for the batch matcher; other queries get empty tree
+static void BuildTermTree ( StoredQuery_t & tStored, const DictRefPtr_c & pDict )
+{
+	if ( tStored.IsFullscan() || tStored.m_dRejectWilds.GetLength() )
+		return;
+
+	int iMaxDepth = 0;
+	if ( DoBuildTermTree ( tStored.m_pXQ->m_pRoot, pDict, tStored.m_dTermTree, 0, iMaxDepth ) )
+		tStored.m_iTermTreeDepth = iMaxDepth+1;
+	else
+		tStored.m_dTermTree.Reset();
+}
+
 static bool TermsReject ( const VecTraits_T<uint64_t> & dDocs, const VecTraits_T<uint64_t> & dQueries )
 {
 	if ( !dDocs.GetLength() || !dQueries.GetLength() )
@@ -1168,6 +1336,85 @@ int FtMatchingCollectingDocs ( const StoredQuery_t * pStored, PercolateMatchCont
 	return iMatchesCount;
 }
 
+// evaluate term tree node into rows bitmap; every tree level has its own iWords-long slot in the scratch after pDst
+void EvalTermTree ( const TermTreeNode_t * pNode, const SegmentReject_t & tReject, uint64_t * pDst, int iWords )
+{
+	if ( pNode->m_eOp==TermTreeNode_t::Op_e::TERM )
+	{
+		memset ( pDst, 0, iWords*sizeof(pDst[0]) );
+		const Slice_t * pRows = tReject.m_hTermRows.Find ( pNode->m_uTerm );
+		if ( pRows )
+			for ( RowID_t tRowID : VecTraits_T<RowID_t> ( tReject.m_dTermRows.Begin()+pRows->m_uOff, pRows->m_uLen ) )
+				pDst[tRowID>>6] |= 1ULL << ( tRowID & 63 );
+		return;
+	}
+
+	uint64_t * pArg = pDst + iWords;
+	const TermTreeNode_t * pChild = pNode+1;
+	const TermTreeNode_t * pEnd = pNode + pNode->m_iNodes;
+	EvalTermTree ( pChild, tReject, pDst, iWords );
+
+	for ( pChild += pChild->m_iNodes; pChild<pEnd; pChild += pChild->m_iNodes )
+	{
+		// nothing to intersect or subtract from
+		bool bEmpty = true;
+		for ( int i=0; i<iWords && bEmpty; i++ )
+			bEmpty = !pDst[i];
+		if ( bEmpty && pNode->m_eOp!=TermTreeNode_t::Op_e::OR )
+			return;
+
+		EvalTermTree ( pChild, tReject, pArg, iWords );
+		switch ( pNode->m_eOp )
+		{
+		case TermTreeNode_t::Op_e::AND:		for ( int i=0; i<iWords; i++ ) pDst[i] &= pArg[i]; break;
+		case TermTreeNode_t::Op_e::OR:		for ( int i=0; i<iWords; i++ ) pDst[i] |= pArg[i]; break;
+		case TermTreeNode_t::Op_e::ANDNOT:	for ( int i=0; i<iWords; i++ ) pDst[i] &= ~pArg[i]; break;
+		default: break;
+		}
+	}
+}
+
+// term-only query evaluated as bitmaps over the batch term->rows map; no ranker, no qwords
+int TermTreeMatching ( const StoredQuery_t * pStored, PercolateMatchContext_t & tMatchCtx )
+{
+	const SegmentReject_t & tReject = tMatchCtx.m_tReject;
+	int iWords = ( tReject.m_iRows+63 ) / 64;
+	tMatchCtx.m_dTermBitmaps.Resize ( iWords*pStored->m_iTermTreeDepth );
+	const uint64_t * pRows = tMatchCtx.m_dTermBitmaps.Begin();
+	EvalTermTree ( pStored->m_dTermTree.Begin(), tReject, tMatchCtx.m_dTermBitmaps.Begin(), iWords );
+
+	const CSphIndex * pIndex = tMatchCtx.m_pTermSetup->m_pIndex;
+	const auto * pSeg = (const RtSegment_t *)tMatchCtx.m_pCtx->m_pIndexData;
+	bool bFilter = !!tMatchCtx.m_pCtx->m_pFilter;
+
+	int iCountIdx = tMatchCtx.m_dDocsMatched.GetLength();
+	if ( tMatchCtx.m_bGetDocs )
+		tMatchCtx.m_dDocsMatched.Add ( 0 ); // placeholder for counter
+
+	CSphMatch tDoc;
+	int iMatchesCount = 0;
+	for ( int iWord=0; iWord<iWords; iWord++ )
+		for ( uint64_t uBits = pRows[iWord]; uBits; uBits &= uBits-1 )
+		{
+			tDoc.m_tRowID = iWord*64 + sphLog2 ( uBits & ( ~uBits+1 ) ) - 1;
+			if ( bFilter && pIndex->EarlyReject ( tMatchCtx.m_pCtx.get(), tDoc ) )
+				continue;
+
+			if ( tMatchCtx.m_bGetDocs )
+				tMatchCtx.m_dDocsMatched.Add ( (int)sphGetDocID ( pSeg->GetDocinfoByRowID ( tDoc.m_tRowID ) ) );
+			++iMatchesCount;
+		}
+
+	if ( !tMatchCtx.m_bGetDocs )
+		return iMatchesCount;
+
+	if ( iMatchesCount ) // write counter of docs into placeholder
+		tMatchCtx.m_dDocsMatched[iCountIdx] = iMatchesCount;
+	else
+		tMatchCtx.m_dDocsMatched.Resize ( iCountIdx ); // pop's up reserved but not used matched counter
+	return iMatchesCount;
+}
+
 // percolate matching
 void MatchingWorkAction ( const StoredQuery_t * pStored, PercolateMatchContext_t & tMatchCtx )
 {
@@ -1184,6 +1431,9 @@ void MatchingWorkAction ( const StoredQuery_t * pStored, PercolateMatchContext_t
 	++tMatchCtx.m_iEarlyPassed;
 	AT_SCOPE_EXIT ( [&tMatchCtx]() { tMatchCtx.m_pCtx->ResetFilters(); } );
 
+	// term-only queries without filters need no setup at all
+	bool bTermTree = pStored->m_dTermTree.GetLength() && tMatchCtx.m_tReject.m_bTermRows;
+
 	CSphString sError;
 	CSphString sWarning;
 
@@ -1194,7 +1444,7 @@ void MatchingWorkAction ( const StoredQuery_t * pStored, PercolateMatchContext_t
 	tFlx.m_pSchema = &tMatchCtx.m_tSchema;
 	tFlx.m_pBlobPool = pBlobs;
 
-	bool bRes = tMatchCtx.m_pCtx->CreateFilters ( tFlx, sError, sWarning );
+	bool bRes = ( bTermTree && pStored->m_dFilters.IsEmpty() ) || tMatchCtx.m_pCtx->CreateFilters ( tFlx, sError, sWarning );
 	tMatchCtx.m_dMsg.Err ( sError );
 	tMatchCtx.m_dMsg.Warn ( sWarning );
 
@@ -1205,7 +1455,9 @@ void MatchingWorkAction ( const StoredQuery_t * pStored, PercolateMatchContext_t
 	}
 
 	int iMatchesCount;
-	if ( tMatchCtx.m_bGetDocs )
+	if ( bTermTree )
+		iMatchesCount = TermTreeMatching ( pStored, tMatchCtx );
+	else if ( tMatchCtx.m_bGetDocs )
 		iMatchesCount = pStored->IsFullscan ()
 				? FullScanCollectingDocs ( tMatchCtx )
 				: FtMatchingCollectingDocs ( pStored, tMatchCtx );
@@ -1499,11 +1751,16 @@ void PercolateIndex_c::DoMatchDocuments ( const RtSegment_t * pSeg, PercolateMat
 	auto tReject = SegmentGetRejects (
 		  pSeg, ( m_tSettings.m_iMinInfixLen>0 || m_tSettings.GetMinPrefixLen ( m_pDict->GetSettings().m_bWordDict )>0 ), m_iMaxCodepointLength>1, m_tSettings.m_eHitless );
 
-	auto dStored = GetStored();
-	auto iJobs = dStored.GetLength ();
-	tRes.m_iTotalQueries = iJobs;
+	// only queries anchored by the segment terms, and ones which can't be anchored at all, need to be checked
+	CSphVector<int> dCandidates;
+	auto dStored = GetCandidates ( tReject, dCandidates );
+	tRes.m_iTotalQueries = dStored.GetLength();
+	auto iJobs = dCandidates.GetLength ();
 	if ( !iJobs )
+	{
+		tRes.m_iEarlyOutQueries = tRes.m_iOnlyTerms = tRes.m_iTotalQueries;
 		return;
+	}
 
 	// the context
 	ClonableCtx_T<PqMatchContextRef_t, PqMatchContextClone_t, Threads::ECONTEXT::UNORDERED> dCtx { this, pSeg, tReject, tRes };
@@ -1534,7 +1791,7 @@ void PercolateIndex_c::DoMatchDocuments ( const RtSegment_t * pSeg, PercolateMat
 		{
 			sphLogDebugv ( "DoMatchDocuments %d, iJob: %d", tJobContext.second, iJob );
 			pInfo->m_iCurrent = iJob;
-			MatchingWork ( dStored[iJob], *tCtx.m_pMatchCtx );
+			MatchingWork ( dStored[dCandidates[iJob]], *tCtx.m_pMatchCtx );
 			iJob = -1; // mark it consumed
 
 			if ( !pSource->FetchTask ( iJob ) )
@@ -1551,6 +1808,7 @@ void PercolateIndex_c::DoMatchDocuments ( const RtSegment_t * pSeg, PercolateMat
 
 	// merge result set
 	PercolateMergeResults ( dResults, tRes );
+	tRes.m_iOnlyTerms += tRes.m_iTotalQueries - iJobs; // skipped queries are only-terms ones
 	dResults.Apply ( [] ( PercolateMatchContext_t *& pCtx ) { SafeDelete ( pCtx ); } );
 }
 
@@ -1638,7 +1896,7 @@ void PercolateIndex_c::GetStatus ( CSphIndexStatus * pRes ) const
 		ScRL_t rLock { m_tLock };
 		iRamUse = m_hQueries.GetLengthBytes();
 		iRamUse += m_dHitlessWords.GetLengthBytes64() + m_dLoadedQueries.GetLengthBytes64();
-		iRamUse = m_pQueries->GetLengthBytes64 ();
+		iRamUse += m_pQueries->GetLengthBytes64 () + m_tTermIndex.GetLengthBytes();
 		for ( auto & pItem : *m_pQueries )
 		{
 			iMaxStack = Max ( iMaxStack, pItem->m_iStackRequired );
@@ -1867,6 +2125,7 @@ std::unique_ptr<StoredQuery_i> PercolateIndex_c::CreateQuery ( PercolateQueryArg
 	if ( pStored->m_pXQ->m_bEmpty && sQuery )
 		pStored->m_pXQ->m_bEmpty = IsEmpty ( FromSz ( sQuery ) );
 
+	BuildTermTree ( *pStored, pDict );
 	CalcNecessaryStack ( pStored.get(), sError );
 
 	return pStored;
@@ -2059,6 +2318,7 @@ int PercolateIndex_c::ReplayInsertAndDeleteQueries ( const VecTraits_T<StoredQue
 
 		// perform inserts into clone
 		int64_t iNewInserted = 0;
+		int iReplaced = 0;
 		if ( bWithFullClone )
 		{
 			for ( auto& pQuery : dNewSharedQueries )
@@ -2070,7 +2330,10 @@ int PercolateIndex_c::ReplayInsertAndDeleteQueries ( const VecTraits_T<StoredQue
 					pNewVec->Add ( pQuery );
 					++iNewInserted;
 				} else
+				{
 					( *pNewVec )[*pIdx] = pQuery;
+					++iReplaced;
+				}
 			}
 		}
 
@@ -2083,6 +2346,14 @@ int PercolateIndex_c::ReplayInsertAndDeleteQueries ( const VecTraits_T<StoredQue
 			m_pQueries = pNewVec;
 			m_hQueries = std::move(hQueries);
 			++m_iGeneration;
+
+			// postings of deleted and replaced queries are left in place, and skipped on lookup
+			m_tTermIndex.AddStale ( iDeleted + iReplaced );
+			if ( m_tTermIndex.NeedRebuild() )
+				RebuildTermIndexUnl();
+			else
+				for ( const StoredQuery_t * pQuery : dNewSharedQueries )
+					m_tTermIndex.Add ( pQuery );
 		} else {
 			for ( auto& pQuery : dNewSharedQueries )
 			{
@@ -2957,6 +3228,7 @@ bool PercolateIndex_c::Truncate ( CSphString & sError )
 
 	m_hQueries.Reset ( 256 );
 	m_pQueries = new CSphVector<StoredQuerySharedPtr_t>;
+	m_tTermIndex.Reset();
 
 	// update and save meta
 	// current TID will be saved, so replay will properly skip preceding txns
@@ -3093,6 +3365,7 @@ bool PercolateIndex_c::Reconfigure ( CSphReconfigureSetup & tSetup )
 
 	m_pQueries = new CSphVector<StoredQuerySharedPtr_t>;
 	m_hQueries.Clear();
+	m_tTermIndex.Reset();
 
 	// note: m_tLockHash and m_tLock is still held here.
 	PostSetupUnl();
@@ -3388,6 +3661,7 @@ void PercolateIndex_c::AddToStoredUnl ( StoredQuerySharedPtr_t tNew ) REQUIRES (
 {
 	m_hQueries.Add ( tNew->m_iQUID, m_pQueries->GetLength ());
 	assert ( m_hQueries.Find ( tNew->m_iQUID ) && ( *m_hQueries.Find ( tNew->m_iQUID )==m_pQueries->GetLength ()));
+	m_tTermIndex.Add ( tNew );
 	if ( m_pQueries->GetLength() < m_pQueries->GetLimit() ) // fast add possible
 	{
 		m_pQueries->Add ( std::move ( tNew ) );
@@ -3415,6 +3689,34 @@ SharedPQSlice_t PercolateIndex_c::GetStored () const EXCLUDES ( m_tLock )
 	return GetStoredUnl();
 }
 
+// snapshot of stored queries along with positions of the ones which may match terms of the segment
+SharedPQSlice_t PercolateIndex_c::GetCandidates ( const SegmentReject_t & tReject, CSphVector<int> & dCandidates ) const EXCLUDES ( m_tLock )
+{
+	CSphVector<int64_t> dQUIDs;
+	ScRL_t rLock ( m_tLock );
+	m_tTermIndex.GetCandidates ( tReject.m_dTerms, dQUIDs );
+
+	dCandidates.Reserve ( dQUIDs.GetLength() );
+	for ( int64_t iQUID : dQUIDs )
+	{
+		// stale posting of deleted query
+		const int * pIdx = m_hQueries.Find ( iQUID );
+		if ( pIdx )
+			dCandidates.Add ( *pIdx );
+	}
+
+	// replaced queries might be referred more than once
+	dCandidates.Uniq();
+	return GetStoredUnl();
+}
+
+void PercolateIndex_c::RebuildTermIndexUnl () REQUIRES ( m_tLock )
+{
+	m_tTermIndex.Reset();
+	for ( const StoredQuery_t * pQuery : *m_pQueries )
+		m_tTermIndex.Add ( pQuery );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 void LoadStoredQueryV6 ( DWORD uVersion, StoredQueryDesc_t & tQuery, CSphReader & tReader )
@@ -134,8 +134,65 @@ struct DictMap_t
 };
 
 
-struct StoredQuery_t;
+/// node of term-only query tree, as evaluated by the batch matcher; nodes are stored in prefix order
+struct TermTreeNode_t
+{
+	enum class Op_e : BYTE
+	{
+		TERM,
+		AND,
+		OR,
+		ANDNOT		// 1st argument minus 2nd one
+	};
+
+	Op_e		m_eOp = Op_e::TERM;
+	int			m_iNodes = 1;	// size of the subtree, including the node itself
+	uint64_t	m_uTerm = 0;	// term hash, same as in reject terms
+};
+
+struct StoredQuery_t : public StoredQuery_i, public ISphRefcountedMT
+{
+	CSphFixedVector<uint64_t>		m_dRejectTerms { 0 };
+	CSphFixedVector<uint64_t>		m_dRejectWilds { 0 };
+	CSphFixedVector<uint64_t>		m_dTags { 0 };
+	CSphVector<CSphString>			m_dSuffixes;
+	DictMap_t						m_hDict;
+	std::unique_ptr<XQQuery_t>		m_pXQ;
+	int								m_iStackRequired = 0;
+	static int 						m_iStackBaseRequired; // additional stack which was in use at the moment of measuring
+
+	bool							m_bOnlyTerms = false; // flag of simple query, ie only words and no operators
+	bool							IsFullscan() const { return m_pXQ->m_bEmpty; }
+
+	CSphVector<TermTreeNode_t>		m_dTermTree;	// boolean tree over plain terms; empty if query needs full-text matching
+	int								m_iTermTreeDepth = 0;
+};
 
+/// term -> stored queries inverted index, used to pick candidate queries for a documents batch instead of scanning all of them.
+/// Only-terms queries can't match unless every of their terms is in the batch, so each is anchored by one term (the one with shortest posting).
+/// Complex, wildcard and fullscan queries can't be anchored and are always candidates; they go through the regular reject path.
+/// Deletes and replaces are lazy: postings refer to QUIDs which are resolved (and validated) against the QUID hash on lookup.
+class PercolateTermIndex_c
+{
+public:
+	void	Add ( const StoredQuery_t * pQuery );
+	void	Reset();
+
+	void	AddStale ( int iCount )		{ m_iStale += iCount; }
+	bool	NeedRebuild() const			{ return m_iStale>MIN_STALE && m_iStale*2>m_iEntries; }
+
+	void	GetCandidates ( const VecTraits_T<uint64_t> & dTerms, CSphVector<int64_t> & dQUIDs ) const;
+	int64_t	GetLengthBytes() const;
+
+private:
+	static const int MIN_STALE = 1024;
+
+	OpenHashTable_T<uint64_t, int>		m_hTerms { 0 };		// term hash -> index of posting
+	CSphVector<CSphVector<int64_t>>		m_dPostings;		// anchored only-terms queries
+	CSphVector<int64_t>					m_dComplex;			// queries that are always candidates
+	int64_t								m_iEntries = 0;
+	int64_t								m_iStale = 0;
+};
 
 struct SegmentReject_t
 {
@@ -145,6 +202,11 @@ struct SegmentReject_t
 	CSphFixedVector<uint64_t> m_dPerDocWilds { 0 };
 	int m_iRows = 0;
 
+	// term -> rows map of the whole batch, used to evaluate term-only queries without ranker
+	CSphVector<RowID_t> m_dTermRows;					///< rows of every term, concatenated
+	OpenHashTable_T<uint64_t, Slice_t> m_hTermRows { 0 };	///< term hash -> its span of m_dTermRows
+	bool m_bTermRows = true;							///< false if the map is unusable (hash collision)
+
 	bool Filter ( const StoredQuery_t * pStored, bool bUtf8 ) const;
 };
 
@@ -227,6 +289,7 @@ struct PercolateMatchContext_t : public PQMatchContextResult_t
 	const SegmentReject_t &m_tReject;
 	const bool m_bUtf8 = false;
 	int64_t m_iMaxStackSize = session::GetMaxStackSize();
+	CSphVector<uint64_t> m_dTermBitmaps; // scratch of term-only queries matcher
 
 	PercolateMatchContext_t ( const RtSegment_t * pSeg, int iMaxCodepointLength, bool bHasMorph, DictRefPtr_c pDictMorph, const PercolateIndex_i * pIndex, const ISphSchema & tSchema,
 			const SegmentReject_t & tReject, ESphHitless eHitless, bool bHasWideFields )
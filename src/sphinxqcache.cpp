@@ -14,6 +14,8 @@
 #include "exprtraits.h"
 #include "mini_timer.h"
 
+#include <atomic>
+
 //////////////////////////////////////////////////////////////////////////
 // QUERY CACHE
 //////////////////////////////////////////////////////////////////////////
@@ -21,35 +23,102 @@
 // TODO: maybe optmized storage for const weight frames?
 // TODO: stop accumulating once entry is bigger than max total cache size
 // TODO: maybe estimate and report peak temporary RAM usage
-// TODO: maybe account and report locking time
 
 #define QCACHE_NO_ENTRY			(NULL)
 #define QCACHE_DEAD_ENTRY		((QcacheEntry_c*)-1)
 
-/// query cache
-class Qcache_c : public QcacheStatus_t
+static const int QCACHE_SHARDS = 16;			///< number of independently locked cache shards; must be a power of 2
+static const int QCACHE_SHARD_INIT_SIZE = 32;	///< initial hash size of every shard; must be a power of 2
+static const int QCACHE_RETIRE_BATCH = 64;		///< retired ids are purged from the shards in batches of this size
+
+/// one shard of the query cache
+/// entries are spread over shards by key, and every shard has its own lock, hash and CLOCK eviction hand
+struct QcacheShard_t : public ISphNoncopyable
+{
+	CSphMutex					m_tLock;
+	CSphVector<QcacheEntry_c*>	m_hData GUARDED_BY ( m_tLock );			///< our little queries hash
+	int							m_iMaxQueries GUARDED_BY ( m_tLock );	///< max load
+	int							m_iClockHand GUARDED_BY ( m_tLock ) = 0;	///< next hash slot to be visited by eviction
+
+	// statistics are only changed under the lock, but read without it
+	std::atomic<int>			m_iCachedQueries { 0 };
+	std::atomic<int64_t>		m_iUsedBytes { 0 };
+	std::atomic<int64_t>		m_iHits { 0 };
+	std::atomic<int64_t>		m_iMisses { 0 };
+	std::atomic<int64_t>		m_iEvictions { 0 };
+	std::atomic<int64_t>		m_iLockWaits { 0 };
+	std::atomic<int64_t>		m_iLockWaitUs { 0 };
+
+								QcacheShard_t();
+
+	void						Lock() ACQUIRE ( m_tLock );
+	bool						IsValidEntry ( int i ) const REQUIRES ( m_tLock ) { return m_hData[i]!=QCACHE_NO_ENTRY && m_hData[i]!=QCACHE_DEAD_ENTRY; }
+	void						Insert ( QcacheEntry_c * pEntry ) REQUIRES ( m_tLock );
+
+private:
+	void						Rehash() REQUIRES ( m_tLock );
+};
+
+/// scoped shard lock; accounts time spent waiting on a contended lock
+class SCOPED_CAPABILITY QcacheShardLock_c : public ISphNoncopyable
 {
+public:
+	explicit QcacheShardLock_c ( QcacheShard_t & tShard ) ACQUIRE ( tShard.m_tLock )
+		: m_tShard ( tShard )
+	{
+		tShard.Lock();
+	}
+
+	~QcacheShardLock_c() RELEASE()
+	{
+		m_tShard.m_tLock.Unlock();
+	}
+
 private:
-	CSphMutex					m_tLock;			///< hash lock
-	CSphVector<QcacheEntry_c*>	m_hData;			///< our little queries hash
-	int							m_iMaxQueries;		///< max load
-	int							m_iMruHead;			///< most recently used entry
+	QcacheShard_t &				m_tShard;
+};
 
+/// query cache
+class Qcache_c
+{
 public:
 								Qcache_c();
 								~Qcache_c();
 
-	void						Setup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec );
+	void						Setup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec, int64_t iTableMaxBytes );
 	void						Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema );
-	QcacheEntry_c *				Find ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema );
-	void						DeleteIndex ( int64_t iIndexId ) EXCLUDES ( m_tLock );
+	QcacheEntry_c *				Find ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema, uint64_t uVersion );
+	void						DeleteIndex ( int64_t iIndexId );
+	void						RetireIndex ( int64_t iIndexId );
+	QcacheStatus_t				GetStatus() const;
+	int64_t						GetMaxBytes() const { return m_iMaxBytes.load ( std::memory_order_relaxed ); }
 
 private:
-	static uint64_t				GetKey ( int64_t iIndexId, const CSphQuery & q );
-	bool						IsValidEntry ( int i ) { return m_hData[i]!=QCACHE_NO_ENTRY && m_hData[i]!=QCACHE_DEAD_ENTRY; }
-	void						EnforceLimits ( bool bSizeOnly ) EXCLUDES ( m_tLock );
-	void						MruToHead ( int iRes );
-	void						DeleteEntry ( int iEntry );
+	// settings are read without locks
+	std::atomic<int64_t>		m_iMaxBytes;
+	std::atomic<int64_t>		m_iTableMaxBytes { 0 };
+	std::atomic<int>			m_iThreshMs;
+	std::atomic<int>			m_iTtlS;
+
+	QcacheShard_t				m_dShards[QCACHE_SHARDS];
+
+	CSphMutex					m_tTablesLock;
+	OpenHashTable_T<int64_t, int64_t> m_hTableBytes GUARDED_BY ( m_tTablesLock );	///< used bytes per table (RT disk chunks and RAM segments count to their table)
+	OpenHashTable_T<int64_t, int> m_hIndexEntries GUARDED_BY ( m_tTablesLock );	///< cached entries per index id
+	CSphVector<int64_t>			m_dRetired GUARDED_BY ( m_tTablesLock );		///< ids that will never be looked up again, but still have entries
+
+	static uint64_t				GetKey ( int64_t iIndexId, const CSphQuery & q, uint64_t uVersion );
+	static int					GetShard ( uint64_t uKey ) { return (int)( uKey>>32 ) & ( QCACHE_SHARDS-1 ); }
+	int64_t						GetUsedBytes() const;
+	int64_t						GetTableBytes ( int64_t iTableId );
+	int64_t						AccountEntry ( const QcacheEntry_c * pEntry, int64_t iSize, int iEntries );
+	void						DeleteEntry ( QcacheShard_t & tShard, int iEntry, bool bEvicted ) REQUIRES ( tShard.m_tLock );
+	template <typename DONE>
+	void						EvictClock ( QcacheShard_t & tShard, int64_t iTableId, const QcacheEntry_c * pKeep, DONE && fnDone ) REQUIRES ( tShard.m_tLock );
+	void						EnforceLimits ( int iFirstShard, const QcacheEntry_c * pKeep );
+	void						EnforceTableLimit ( int64_t iTableId, int iFirstShard, const QcacheEntry_c * pKeep );
+	void						SweepExpired();
+	void						DeleteIndexes ( const VecTraits_T<int64_t> & dIndexIds );
 	bool						CanCacheQuery ( const CSphQuery & q ) const;
 };
 
@@ -248,6 +317,62 @@ void QcacheEntry_c::Finish()
 
 //////////////////////////////////////////////////////////////////////////
 
+QcacheShard_t::QcacheShard_t()
+{
+	m_hData.Resize ( QCACHE_SHARD_INIT_SIZE );
+	m_hData.Fill ( QCACHE_NO_ENTRY );
+	m_iMaxQueries = (int)( m_hData.GetLength()*0.7f );
+}
+
+void QcacheShard_t::Lock()
+{
+	// zero timeout is a try-lock; only fall back to a (measured) blocking wait when the shard is busy
+	if ( m_tLock.TimedLock(0) )
+		return;
+
+	int64_t tmStart = sphMicroTimer();
+	m_tLock.Lock();
+	m_iLockWaits.fetch_add ( 1, std::memory_order_relaxed );
+	m_iLockWaitUs.fetch_add ( sphMicroTimer()-tmStart, std::memory_order_relaxed );
+}
+
+void QcacheShard_t::Rehash()
+{
+	CSphVector<QcacheEntry_c*> hNew ( 2*m_hData.GetLength() );
+	hNew.Fill ( QCACHE_NO_ENTRY );
+
+	int iLenMask = hNew.GetLength() - 1;
+	ARRAY_FOREACH ( i, m_hData )
+		if ( IsValidEntry(i) )
+	{
+		int j = m_hData[i]->m_Key & iLenMask;
+		while ( hNew[j]!=NULL )
+			j = ( j+1 ) & iLenMask;
+		hNew[j] = m_hData[i];
+	}
+
+	m_hData.SwapData ( hNew );
+	m_iMaxQueries *= 2;
+	m_iClockHand = 0;
+}
+
+void QcacheShard_t::Insert ( QcacheEntry_c * pEntry )
+{
+	if ( m_iCachedQueries>=m_iMaxQueries )
+		Rehash();
+
+	int iLenMask = m_hData.GetLength() - 1;
+	int j = pEntry->m_Key & iLenMask;
+	while ( IsValidEntry(j) )
+		j = ( j+1 ) & iLenMask;
+	m_hData[j] = pEntry;
+
+	m_iCachedQueries.fetch_add ( 1, std::memory_order_relaxed );
+	m_iUsedBytes.fetch_add ( pEntry->GetSize(), std::memory_order_relaxed );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 Qcache_c::Qcache_c()
 {
 	// defaults are here
@@ -258,59 +383,101 @@ Qcache_c::Qcache_c()
 
 	m_iThreshMs = 3000;
 	m_iTtlS = 60;
-
-	m_iCachedQueries = 0;
-	m_iUsedBytes = 0;
-	m_iHits = 0;
-	m_iMruHead = -1;
-
-	m_hData.Resize ( 256 );
-	m_hData.Fill ( QCACHE_NO_ENTRY );
-	m_iMaxQueries = (int)( m_hData.GetLength()*0.7f );
 }
 
 Qcache_c::~Qcache_c()
 {
-	ScopedMutex_t dLock ( m_tLock );
-	ARRAY_FOREACH ( i, m_hData )
-		if ( IsValidEntry(i) )
-			SafeRelease ( m_hData[i] );
+	for ( auto & tShard : m_dShards )
+	{
+		ScopedMutex_t dLock ( tShard.m_tLock );
+		ARRAY_FOREACH ( i, tShard.m_hData )
+			if ( tShard.IsValidEntry(i) )
+				SafeRelease ( tShard.m_hData[i] );
+	}
 }
 
-void Qcache_c::Setup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec )
+void Qcache_c::Setup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec, int64_t iTableMaxBytes )
 {
 	m_iMaxBytes = Max ( iMaxBytes, 0 );
+	m_iTableMaxBytes = Max ( iTableMaxBytes, 0 );
 	m_iThreshMs = Max ( iThreshMsec, 0 );
 	m_iTtlS = Max ( iTtlSec, 1 );
-	EnforceLimits ( false );
-}
 
-void Qcache_c::MruToHead ( int iRes )
-{
-	// already the head? nothing to do
-	if ( iRes==m_iMruHead )
+	SweepExpired();
+	EnforceLimits ( 0, nullptr );
+
+	if ( !m_iTableMaxBytes )
 		return;
 
-	// detach from previous node, prev.next = my.next
-	QcacheEntry_c * p = m_hData[iRes];
-	if ( p->m_iMruPrev>=0 )
-		m_hData [ p->m_iMruPrev ]->m_iMruNext = p->m_iMruNext;
+	CSphVector<int64_t> dOverQuota;
+	{
+		ScopedMutex_t tLock ( m_tTablesLock );
+		int64_t iIterator = 0;
+		std::pair<int64_t, int64_t*> tTable;
+		while ( ( tTable = m_hTableBytes.Iterate(iIterator) ).second )
+			if ( *tTable.second > m_iTableMaxBytes )
+				dOverQuota.Add ( tTable.first );
+	}
+
+	for ( auto iTableId : dOverQuota )
+		EnforceTableLimit ( iTableId, 0, nullptr );
+}
 
-	// detach from next node, next.prev = my.prev
-	if ( p->m_iMruNext>=0 )
-		m_hData [ p->m_iMruNext ]->m_iMruPrev = p->m_iMruPrev;
+QcacheStatus_t Qcache_c::GetStatus() const
+{
+	QcacheStatus_t tStatus;
+	tStatus.m_iMaxBytes = m_iMaxBytes;
+	tStatus.m_iTableMaxBytes = m_iTableMaxBytes;
+	tStatus.m_iThreshMs = m_iThreshMs;
+	tStatus.m_iTtlS = m_iTtlS;
 
-	// become the new head
-	p->m_iMruPrev = -1;
-	p->m_iMruNext = m_iMruHead;
-	if ( p->m_iMruNext>=0 )
+	for ( const auto & tShard : m_dShards )
 	{
-		assert ( m_hData [ p->m_iMruNext ]->m_iMruPrev<0 );
-		m_hData [ p->m_iMruNext ]->m_iMruPrev = iRes;
+		tStatus.m_iCachedQueries += tShard.m_iCachedQueries.load ( std::memory_order_relaxed );
+		tStatus.m_iUsedBytes += tShard.m_iUsedBytes.load ( std::memory_order_relaxed );
+		tStatus.m_iHits += tShard.m_iHits.load ( std::memory_order_relaxed );
+		tStatus.m_iMisses += tShard.m_iMisses.load ( std::memory_order_relaxed );
+		tStatus.m_iEvictions += tShard.m_iEvictions.load ( std::memory_order_relaxed );
+		tStatus.m_iLockWaits += tShard.m_iLockWaits.load ( std::memory_order_relaxed );
+		tStatus.m_iLockWaitUs += tShard.m_iLockWaitUs.load ( std::memory_order_relaxed );
 	}
-	m_iMruHead = iRes;
+
+	return tStatus;
+}
+
+int64_t Qcache_c::GetUsedBytes() const
+{
+	int64_t iBytes = 0;
+	for ( const auto & tShard : m_dShards )
+		iBytes += tShard.m_iUsedBytes.load ( std::memory_order_relaxed );
+
+	return iBytes;
 }
 
+int64_t Qcache_c::GetTableBytes ( int64_t iTableId )
+{
+	ScopedMutex_t tLock ( m_tTablesLock );
+	int64_t * pBytes = m_hTableBytes.Find ( iTableId );
+	return pBytes ? *pBytes : 0;
+}
+
+/// adds (or, with negative values, removes) entry bytes to its table, and the entry to its index; returns new table bytes
+int64_t Qcache_c::AccountEntry ( const QcacheEntry_c * pEntry, int64_t iSize, int iEntries )
+{
+	ScopedMutex_t tLock ( m_tTablesLock );
+	int & iIndexEntries = m_hIndexEntries.Acquire ( pEntry->m_iIndexId );
+	iIndexEntries += iEntries;
+	if ( iIndexEntries<=0 )
+		m_hIndexEntries.Delete ( pEntry->m_iIndexId );
+
+	int64_t & iBytes = m_hTableBytes.Acquire ( pEntry->m_iTableId );
+	iBytes += iSize;
+	if ( iBytes>0 )
+		return iBytes;
+
+	m_hTableBytes.Delete ( pEntry->m_iTableId );
+	return 0;
+}
 
 static bool CalcFilterHashes ( CSphVector<uint64_t> & dFilters, const CSphQuery & q, const ISphSchema & tSorterSchema )
 {
@@ -353,7 +520,12 @@ void Qcache_c::Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSch
 
 	// do not cache too fast queries or too big rsets, for obvious reasons
 	// do not cache full scans, because we'll get an incorrect empty result set here
-	if ( pResult->m_iElapsedMsec < m_iThreshMs || pResult->GetSize() > m_iMaxBytes )
+	int64_t iSize = pResult->GetSize();
+	if ( pResult->m_iElapsedMsec < m_iThreshMs.load ( std::memory_order_relaxed ) || iSize > GetMaxBytes() )
+		return;
+
+	int64_t iTableMaxBytes = m_iTableMaxBytes.load ( std::memory_order_relaxed );
+	if ( iTableMaxBytes && iSize > iTableMaxBytes )
 		return;
 
 	if ( !CanCacheQuery(q) )
@@ -363,96 +535,64 @@ void Qcache_c::Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSch
 		return;	// this query can't be cached because of the nature of expressions in filters
 
 	pResult->AddRef();
-	pResult->m_Key = GetKey ( pResult->m_iIndexId, q );
-
-	ScopedMutex_t dLock (m_tLock);
-
-	// rehash if needed
-	if ( m_iCachedQueries>=m_iMaxQueries )
+	pResult->m_Key = GetKey ( pResult->m_iIndexId, q, pResult->m_uVersion );
+	pResult->m_bReferenced = true;
+	if ( pResult->m_iTableId<0 )
+		pResult->m_iTableId = pResult->m_iIndexId;
+
+	// entry might be gone once the shard is unlocked, so only use the pointer as eviction guard from now on
+	int64_t iTableId = pResult->m_iTableId;
+	int iShard = GetShard ( pResult->m_Key );
+	int64_t iTableBytes;
 	{
-		CSphVector<QcacheEntry_c*> hNew ( 2*m_hData.GetLength() );
-		hNew.Fill ( QCACHE_NO_ENTRY );
-
-		CSphVector<int> dRemap ( m_hData.GetLength() );
-		dRemap.Fill ( -1 );
-
-		int iLenMask = hNew.GetLength() - 1;
-		ARRAY_FOREACH ( i, m_hData )
-			if ( IsValidEntry(i) )
-		{
-			int j = m_hData[i]->m_Key & iLenMask;
-			while ( hNew[j]!=NULL )
-				j = ( j+1 ) & iLenMask;
-			hNew[j] = m_hData[i];
-			dRemap[i] = j;
-		}
-
-		ARRAY_FOREACH ( i, m_hData )
-			if ( IsValidEntry(i) )
-		{
-			QcacheEntry_c * p = hNew [ dRemap[i] ];
-			if ( p->m_iMruNext>=0 )
-				p->m_iMruNext = dRemap [ p->m_iMruNext ];
-			if ( p->m_iMruPrev>=0 )
-				p->m_iMruPrev = dRemap [ p->m_iMruPrev ];
-		}
-
-		m_hData.SwapData ( hNew );
-		m_iMruHead = dRemap [ m_iMruHead ];
-
-		m_iMaxQueries *= 2;
+		QcacheShard_t & tShard = m_dShards[iShard];
+		QcacheShardLock_c tLock ( tShard );
+		tShard.Insert ( pResult );
+		iTableBytes = AccountEntry ( pResult, iSize, 1 );
 	}
 
-	// add entry
-	int iLenMask = m_hData.GetLength() - 1;
-	int j = pResult->m_Key & iLenMask;
-	while ( IsValidEntry(j) )
-		j = ( j+1 ) & iLenMask;
-	m_hData[j] = pResult;
-
-	m_iCachedQueries++;
-	m_iUsedBytes += pResult->GetSize();
-	MruToHead(j);
+	if ( iTableMaxBytes && iTableBytes > iTableMaxBytes )
+		EnforceTableLimit ( iTableId, iShard, pResult );
 
-	dLock.Unlock();
-	EnforceLimits ( true );
+	EnforceLimits ( iShard, pResult );
 }
 
-QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema )
+QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema, uint64_t uVersion )
 {
-	if ( m_iMaxBytes<=0 )
+	if ( GetMaxBytes()<=0 )
 		return nullptr;
 
 	if ( !CanCacheQuery(q) )
 		return nullptr;
 
-	uint64_t k = GetKey ( iIndexId, q );
+	uint64_t k = GetKey ( iIndexId, q, uVersion );
 
 	bool bFilterHashesCalculated = false;
 	CSphVector<uint64_t> dFilters;
-	
-	ScopedMutex_t dLock (m_tLock);
+
+	QcacheShard_t & tShard = m_dShards [ GetShard(k) ];
+	QcacheShardLock_c tLock ( tShard );
 
 	int64_t tmMin = sphMicroTimer() - int64_t( m_iTtlS)*1000000;
-	int iLenMask = m_hData.GetLength() - 1;
-	int iLoop = m_hData.GetLength();
+	int iLenMask = tShard.m_hData.GetLength() - 1;
+	int iLoop = tShard.m_hData.GetLength();
 	int iRes = -1;
-	for ( int i = k & iLenMask; m_hData[i]!=QCACHE_NO_ENTRY && iLoop--!=0; i = ( i+1 ) & iLenMask )
+	for ( int i = k & iLenMask; tShard.m_hData[i]!=QCACHE_NO_ENTRY && iLoop--!=0; i = ( i+1 ) & iLenMask )
 	{
 		// check that entry is alive
-		QcacheEntry_c * e = m_hData[i]; // shortcut
+		QcacheEntry_c * e = tShard.m_hData[i]; // shortcut
 		if ( e==QCACHE_DEAD_ENTRY )
 			continue;
 
 		// check if we need to evict this one based on ttl
 		if ( e->m_tmStarted < tmMin )
 		{
-			DeleteEntry(i);
+			DeleteEntry ( tShard, i, false );
 			continue;
 		}
 
 		// check that key matches
-		if ( e->m_Key!=k )
+		if ( e->m_Key!=k || e->m_iIndexId!=iIndexId || e->m_uVersion!=uVersion )
 			continue;
 
 		// check that filters are compatible (ie. that entry filters are a subset of query filters)
@@ -473,29 +613,31 @@ QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, const CSphQuery & q, const IS
 		if ( j==e->m_dFilters.GetLength() )
 		{
 			iRes = i;
-			m_iHits++;
 			break;
 		}
 	}
 
-	QcacheEntry_c * p = nullptr;
-	if ( iRes>=0 )
+	if ( iRes<0 )
 	{
-		p = m_hData[iRes];
-		p->AddRef();
-		MruToHead(iRes);
+		tShard.m_iMisses.fetch_add ( 1, std::memory_order_relaxed );
+		return nullptr;
 	}
 
+	tShard.m_iHits.fetch_add ( 1, std::memory_order_relaxed );
+	QcacheEntry_c * p = tShard.m_hData[iRes];
+	p->AddRef();
+	p->m_bReferenced = true;
 	return p;
 }
 
-uint64_t Qcache_c::GetKey ( int64_t iIndexId, const CSphQuery & q )
+uint64_t Qcache_c::GetKey ( int64_t iIndexId, const CSphQuery & q, uint64_t uVersion )
 {
 	// query cache key combines a bunch of data affecting things:
-	// - index id
+	// - index id and data version
 	// - MATCH() part
 	// - ranker
 	uint64_t k = sphFNV64 ( &iIndexId, sizeof(iIndexId) );
+	k = sphFNV64 ( &uVersion, sizeof(uVersion), k );
 	k = sphFNV64cont ( q.m_sQuery.cstr(), k );
 	k = sphFNV64 ( &q.m_eRanker, 1, k );
 	if ( q.m_eRanker==SPH_RANK_EXPR )
@@ -508,28 +650,23 @@ uint64_t Qcache_c::GetKey ( int64_t iIndexId, const CSphQuery & q )
 	return k;
 }
 
-void Qcache_c::DeleteEntry ( int i )
+void Qcache_c::DeleteEntry ( QcacheShard_t & tShard, int iEntry, bool bEvicted )
 {
-	assert ( IsValidEntry(i) );
-	QcacheEntry_c * p = m_hData[i];
-
-	// adjust MRU list
-	if ( p->m_iMruNext>=0 )
-		m_hData[p->m_iMruNext]->m_iMruPrev = p->m_iMruPrev;
-
-	assert ( p->m_iMruPrev>=0 || m_iMruHead==i );
-	if ( p->m_iMruPrev>=0 )
-		m_hData[p->m_iMruPrev]->m_iMruNext = p->m_iMruNext;
-	else
-		m_iMruHead = p->m_iMruNext;
+	assert ( tShard.IsValidEntry(iEntry) );
+	QcacheEntry_c * p = tShard.m_hData[iEntry];
+	int64_t iSize = p->GetSize();
 
 	// adjust stats
-	m_iCachedQueries--;
-	m_iUsedBytes -= p->GetSize();
+	tShard.m_iCachedQueries.fetch_sub ( 1, std::memory_order_relaxed );
+	tShard.m_iUsedBytes.fetch_sub ( iSize, std::memory_order_relaxed );
+	if ( bEvicted )
+		tShard.m_iEvictions.fetch_add ( 1, std::memory_order_relaxed );
+
+	AccountEntry ( p, -iSize, -1 );
 
 	// release entry
 	p->Release();
-	m_hData[i] = QCACHE_DEAD_ENTRY;
+	tShard.m_hData[iEntry] = QCACHE_DEAD_ENTRY;
 }
 
 
@@ -538,44 +675,128 @@ bool Qcache_c::CanCacheQuery ( const CSphQuery & q ) const
 	return q.m_eMode!=SPH_MATCH_FULLSCAN && !q.m_sQuery.IsEmpty();
 }
 
-void Qcache_c::EnforceLimits ( bool bSizeOnly )
+/// CLOCK sweep over a shard; evicts entries of the given table (or of any table when iTableId<0) until fnDone() is satisfied
+/// entries hit since the previous visit of the hand get a second chance; two full turns are enough to evict anything
+template <typename DONE>
+void Qcache_c::EvictClock ( QcacheShard_t & tShard, int64_t iTableId, const QcacheEntry_c * pKeep, DONE && fnDone )
 {
-	if ( bSizeOnly && m_iUsedBytes<=m_iMaxBytes )
+	if ( fnDone() )
 		return;
 
-	ScopedMutex_t dLock ( m_tLock );
-
-	// first, enforce size limits
-	int iCur = m_iMruHead;
-	int64_t iBytes = 0;
-	while ( iCur>=0 && m_iUsedBytes>m_iMaxBytes )
+	int iLenMask = tShard.m_hData.GetLength() - 1;
+	for ( int iStep = 0; iStep < 2*tShard.m_hData.GetLength(); iStep++ )
 	{
-		assert ( IsValidEntry(iCur) );
-		int iNext = m_hData[iCur]->m_iMruNext;
-		if ( iBytes + m_hData[iCur]->GetSize() > m_iMaxBytes )
-			DeleteEntry ( iCur );
-		else
-			iBytes += m_hData[iCur]->GetSize();
-		iCur = iNext;
+		int i = tShard.m_iClockHand;
+		tShard.m_iClockHand = ( i+1 ) & iLenMask;
+		if ( !tShard.IsValidEntry(i) )
+			continue;
+
+		QcacheEntry_c * p = tShard.m_hData[i];
+		if ( p==pKeep || ( iTableId>=0 && p->m_iTableId!=iTableId ) )
+			continue;
+
+		if ( p->m_bReferenced )
+		{
+			p->m_bReferenced = false;
+			continue;
+		}
+
+		DeleteEntry ( tShard, i, true );
+		if ( fnDone() )
+			return;
 	}
+}
 
-	if ( bSizeOnly )
+void Qcache_c::EnforceLimits ( int iFirstShard, const QcacheEntry_c * pKeep )
+{
+	int64_t iMaxBytes = GetMaxBytes();
+	if ( GetUsedBytes()<=iMaxBytes )
 		return;
 
-	// if requested, do a full sweep, and recheck ttl and thresh limits
-	int64_t tmMin = sphMicroTimer() - int64_t( m_iTtlS)*1000000;
-	ARRAY_FOREACH ( i, m_hData )
-		if ( IsValidEntry(i) && ( m_hData[i]->m_tmStarted < tmMin || m_hData[i]->m_iElapsedMsec < m_iThreshMs ) )
-			DeleteEntry(i);
+	// first pass only trims shards above their fair share, so that one busy shard can not drain the others
+	// second pass evicts from whatever is left
+	int64_t iShardShare = iMaxBytes / QCACHE_SHARDS;
+	for ( int iPass = 0; iPass<2; iPass++ )
+		for ( int i = 0; i<QCACHE_SHARDS; i++ )
+		{
+			QcacheShard_t & tShard = m_dShards [ ( iFirstShard+i ) & ( QCACHE_SHARDS-1 ) ];
+			QcacheShardLock_c tLock ( tShard );
+			EvictClock ( tShard, -1, pKeep, [&]
+			{
+				if ( !iPass && tShard.m_iUsedBytes.load ( std::memory_order_relaxed )<=iShardShare )
+					return true;
+				return GetUsedBytes()<=iMaxBytes;
+			});
 
+			if ( GetUsedBytes()<=iMaxBytes )
+				return;
+		}
+}
+
+void Qcache_c::EnforceTableLimit ( int64_t iTableId, int iFirstShard, const QcacheEntry_c * pKeep )
+{
+	int64_t iTableMaxBytes = m_iTableMaxBytes.load ( std::memory_order_relaxed );
+	for ( int i = 0; i<QCACHE_SHARDS; i++ )
+	{
+		QcacheShard_t & tShard = m_dShards [ ( iFirstShard+i ) & ( QCACHE_SHARDS-1 ) ];
+		QcacheShardLock_c tLock ( tShard );
+		EvictClock ( tShard, iTableId, pKeep, [&] { return GetTableBytes(iTableId)<=iTableMaxBytes; } );
+
+		if ( GetTableBytes(iTableId)<=iTableMaxBytes )
+			return;
+	}
+}
+
+void Qcache_c::SweepExpired()
+{
+	// full sweep that rechecks ttl and thresh limits
+	int64_t tmMin = sphMicroTimer() - int64_t( m_iTtlS)*1000000;
+	int iThreshMs = m_iThreshMs;
+	for ( auto & tShard : m_dShards )
+	{
+		QcacheShardLock_c tLock ( tShard );
+		ARRAY_FOREACH ( i, tShard.m_hData )
+			if ( tShard.IsValidEntry(i) && ( tShard.m_hData[i]->m_tmStarted < tmMin || tShard.m_hData[i]->m_iElapsedMsec < iThreshMs ) )
+				DeleteEntry ( tShard, i, false );
+	}
 }
 
 void Qcache_c::DeleteIndex ( int64_t iIndexId )
 {
-	ScopedMutex_t dLock ( m_tLock );
-	ARRAY_FOREACH ( i, m_hData )
-		if ( IsValidEntry(i) && m_hData[i]->m_iIndexId==iIndexId )
-			DeleteEntry(i);
+	DeleteIndexes ( VecTraits_T<int64_t> ( &iIndexId, 1 ) );
+}
+
+/// full sweep over all shards that drops entries of any of the given (sorted) ids
+void Qcache_c::DeleteIndexes ( const VecTraits_T<int64_t> & dIndexIds )
+{
+	for ( auto & tShard : m_dShards )
+	{
+		QcacheShardLock_c tLock ( tShard );
+		ARRAY_FOREACH ( i, tShard.m_hData )
+			if ( tShard.IsValidEntry(i) && dIndexIds.BinarySearch ( tShard.m_hData[i]->m_iIndexId ) )
+				DeleteEntry ( tShard, i, false );
+	}
+}
+
+/// id is gone for good (e.g. RAM segment was merged away), so its entries can never be hit again
+/// instead of a full sweep per id, ids are collected and purged in batches; until then CLOCK may evict them as usual
+void Qcache_c::RetireIndex ( int64_t iIndexId )
+{
+	CSphVector<int64_t> dBatch;
+	{
+		ScopedMutex_t tLock ( m_tTablesLock );
+		if ( !m_hIndexEntries.Find ( iIndexId ) )
+			return;
+
+		m_dRetired.Add ( iIndexId );
+		if ( m_dRetired.GetLength()<QCACHE_RETIRE_BATCH )
+			return;
+
+		dBatch.SwapData ( m_dRetired );
+	}
+
+	dBatch.Uniq();
+	DeleteIndexes ( dBatch );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -675,9 +896,9 @@ void QcacheAdd ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema
 	return g_Qcache.Add ( q, pResult, tSorterSchema );
 }
 
-QcacheEntry_c * QcacheFind ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema )
+QcacheEntry_c * QcacheFind ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema, uint64_t uVersion )
 {
-	return g_Qcache.Find ( iIndexId, q, tSorterSchema );
+	return g_Qcache.Find ( iIndexId, q, tSorterSchema, uVersion );
 }
 
 std::unique_ptr<ISphRanker> QcacheRanker ( QcacheEntry_c * pEntry, const ISphQwordSetup & tSetup )
@@ -685,17 +906,62 @@ std::unique_ptr<ISphRanker> QcacheRanker ( QcacheEntry_c * pEntry, const ISphQwo
 	return std::make_unique<QcacheRanker_c> ( pEntry, tSetup );
 }
 
-const QcacheStatus_t & QcacheGetStatus()
+QcacheStatus_t QcacheGetStatus()
+{
+	return g_Qcache.GetStatus();
+}
+
+int64_t QcacheGetMaxBytes()
 {
-	return g_Qcache;
+	return g_Qcache.GetMaxBytes();
 }
 
-void QcacheSetup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec )
+void QcacheSetup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec, int64_t iTableMaxBytes )
 {
-	g_Qcache.Setup ( iMaxBytes, iThreshMsec, iTtlSec );
+	g_Qcache.Setup ( iMaxBytes, iThreshMsec, iTtlSec, iTableMaxBytes );
 }
 
 void QcacheDeleteIndex ( int64_t iIndexId )
 {
 	g_Qcache.DeleteIndex ( iIndexId );
 }
+
+void QcacheRetireIndex ( int64_t iIndexId )
+{
+	g_Qcache.RetireIndex ( iIndexId );
+}
+
+/// whether weights depend on collection stats (idf); other rankers only look at the matched document itself
+static bool RankerUsesStats ( ESphRankMode eRanker )
+{
+	switch ( eRanker )
+	{
+	case SPH_RANK_NONE:
+	case SPH_RANK_WORDCOUNT:
+	case SPH_RANK_PROXIMITY:
+	case SPH_RANK_MATCHANY:
+	case SPH_RANK_FIELDMASK:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+uint64_t QcacheVersion ( const CSphQuery & q, int64_t iAttrUpdates, int64_t iTotalDocs, const SmallStringHash_T<int64_t> * pLocalDocs, uint64_t uSegmentsHash )
+{
+	uint64_t uVersion = sphFNV64 ( &iAttrUpdates, sizeof(iAttrUpdates) );
+	if ( !RankerUsesStats ( q.m_eRanker ) )
+		return uVersion;
+
+	uVersion = sphFNV64 ( &iTotalDocs, sizeof(iTotalDocs), uVersion );
+	uVersion = sphFNV64 ( &uSegmentsHash, sizeof(uSegmentsHash), uVersion );
+	if ( pLocalDocs )
+		for ( const auto & tDocs : *pLocalDocs )
+		{
+			uVersion = sphFNV64cont ( tDocs.first.cstr(), uVersion );
+			uVersion = sphFNV64 ( &tDocs.second, sizeof(tDocs.second), uVersion );
+		}
+
+	return uVersion;
+}
@@ -32,12 +32,13 @@ class QcacheEntry_c : public ISphRefcountedMT
 
 public:
 	int64_t						m_iIndexId = -1;
+	int64_t						m_iTableId = -1;	///< owner of the per-table quota; differs from m_iIndexId for RT disk chunks and RAM segments
 	int64_t						m_tmStarted { sphMicroTimer() };
 	int							m_iElapsedMsec = 0;
 	CSphVector<uint64_t>		m_dFilters;			///< hashes of the filters that were applied to cached query
+	uint64_t					m_uVersion = 0;		///< version of the index data the result depends on besides the index id (see QcacheVersion())
 	uint64_t					m_Key = 0;
-	int							m_iMruPrev = -1;
-	int							m_iMruNext = -1;
+	bool						m_bReferenced = true;	///< CLOCK reference bit, set on every hit
 
 private:
 	static const int			MAX_FRAME_SIZE = 32;
@@ -69,22 +70,34 @@ using QcacheEntryRefPtr_t = CSphRefcountedPtr<QcacheEntry_c>;
 struct QcacheStatus_t
 {
 	// settings that can be changed
-	int64_t		m_iMaxBytes;		///< max RAM bytes
-	int			m_iThreshMs;		///< minimum wall time to cache, in msec
-	int			m_iTtlS;			///< cached query TTL, in msec
+	int64_t		m_iMaxBytes = 0;		///< max RAM bytes
+	int64_t		m_iTableMaxBytes = 0;	///< max RAM bytes per table, 0 means no per-table limit
+	int			m_iThreshMs = 0;		///< minimum wall time to cache, in msec
+	int			m_iTtlS = 0;			///< cached query TTL, in msec
 
 	// report-only statistics
-	int			m_iCachedQueries;	///< cached queries counts
-	int64_t		m_iUsedBytes;		///< used RAM bytes
-	int64_t		m_iHits;			///< cache hits
+	int			m_iCachedQueries = 0;	///< cached queries counts
+	int64_t		m_iUsedBytes = 0;		///< used RAM bytes
+	int64_t		m_iHits = 0;			///< cache hits
+	int64_t		m_iMisses = 0;			///< cache misses
+	int64_t		m_iEvictions = 0;		///< entries evicted by size limits
+	int64_t		m_iLockWaits = 0;		///< how many times a shard lock was contended
+	int64_t		m_iLockWaitUs = 0;		///< total time spent waiting for contended shard locks, in usec
 };
 
 
 void					QcacheAdd ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema );
-QcacheEntry_c *			QcacheFind ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema );
+QcacheEntry_c *			QcacheFind ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema, uint64_t uVersion = 0 );
 std::unique_ptr<ISphRanker>			QcacheRanker ( QcacheEntry_c * pEntry, const ISphQwordSetup & tSetup );
-const QcacheStatus_t &	QcacheGetStatus();
-void					QcacheSetup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec );
+QcacheStatus_t			QcacheGetStatus();
+int64_t					QcacheGetMaxBytes();	///< cheap check for the per-query path; 0 means cache is disabled
+void					QcacheSetup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec, int64_t iTableMaxBytes );
 void					QcacheDeleteIndex ( int64_t iIndexId );
+void					QcacheRetireIndex ( int64_t iIndexId );	///< lazy QcacheDeleteIndex() for ids that will never be looked up again
+
+/// version of the index data that a cached result depends on, besides the index id
+/// attribute updates change the filtered set; collection stats (total docs, local df, term stats of other segments) change bm25 weights
+/// results of an older version are never hit again, and go away with ttl or eviction
+uint64_t				QcacheVersion ( const CSphQuery & q, int64_t iAttrUpdates, int64_t iTotalDocs, const SmallStringHash_T<int64_t> * pLocalDocs, uint64_t uSegmentsHash = 0 );
 
 #endif // _sphinxqcache_
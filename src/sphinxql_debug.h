@@ -41,6 +41,7 @@ enum class Cmd_e : BYTE
 	META,
 	TRACE,
 	CURL,
+	CALIBRATE,
 
 	INVALID_CMD,
 	PARSE_SYNTAX_ERROR,
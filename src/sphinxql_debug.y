@@ -58,6 +58,7 @@
 %token <sValue>	TOK_META
 %token <sValue>	TOK_TRACE
 %token <sValue> TOK_CURL
+%token <sValue> TOK_CALIBRATE
 
 %type <iValue> boolpar timeint
 %type <sValue> ident szparam ident_special szparam_special
@@ -92,6 +93,7 @@ debugcommand:
 	| TOK_META		{ pParser->SetCommand ( Cmd_e::META ); }
 	| trace			{ pParser->SetCommand ( Cmd_e::TRACE ); }
 	| curl			{ pParser->SetCommand ( Cmd_e::CURL ); }
+	| TOK_CALIBRATE	{ pParser->SetCommand ( Cmd_e::CALIBRATE ); }
 	;
 
 //////////////////////////////////////////////////////////////////////////
@@ -99,7 +101,7 @@ debugcommand:
 ident_special:
 	TOK_IDENT | TOK_DEBUG | TOK_SHUTDOWN | TOK_CRASH | TOK_TOKEN | TOK_MALSTATS | TOK_MALTRIM
 	| TOK_PROCDUMP | TOK_CLOSE | TOK_SETGDB | TOK_SLEEP | TOK_SCHED | TOK_MERGE | TOK_FILES
-	| TOK_STATUS | TOK_COMPRESS | TOK_SPLIT | TOK_WAIT | TOK_LIKE | TOK_CURL
+	| TOK_STATUS | TOK_COMPRESS | TOK_SPLIT | TOK_WAIT | TOK_LIKE | TOK_CURL | TOK_CALIBRATE
 	;
 
 ident:
@@ -40,6 +40,7 @@
 #include "task_dispatcher.h"
 #include "tracer.h"
 #include "pseudosharding.h"
+#include "jsoncolumns.h"
 #include "std/sys.h"
 
 #include <sys/stat.h>
@@ -262,6 +263,9 @@ RtSegment_t::~RtSegment_t ()
 {
 	if ( m_pRAMCounter )
 		FixupRAMCounter ( -GetUsedRam() );
+
+	if ( m_bQcached.load ( std::memory_order_relaxed ) )
+		QcacheRetireIndex ( m_iQcacheId );
 }
 
 
@@ -1152,7 +1156,7 @@ public:
 	int					CommonOptimize ( OptimizeTask_t tTask );
 	void				DropDiskChunk ( int iChunk, int* pAffected=nullptr );
 	bool				CompressOneChunk ( int iChunk, int* pAffected = nullptr );
-	bool				MergeTwoChunks ( int iA, int iB, int* pAffected = nullptr );
+	bool				MergeChunks ( const VecTraits_T<int> & dChunkIDs, int* pAffected = nullptr );
 	bool				MergeCanRun () const;
 	bool				SplitOneChunk ( int iChunkID, const char* szUvarFilter, int* pAffected = nullptr );
 	bool				SplitOneChunkFast ( int iChunkID, const char * szUvarFilter, bool& bResult, int* pAffected = nullptr );
@@ -1165,6 +1169,8 @@ public:
 
 	// helpers
 	ConstDiskChunkRefPtr_t	MergeDiskChunks (  const char* szParentAction, const ConstDiskChunkRefPtr_t& pChunkA, const ConstDiskChunkRefPtr_t& pChunkB, CSphIndexProgress& tProgress, VecTraits_T<CSphFilterSettings> dFilters );
+	ConstDiskChunkRefPtr_t	MergeDiskChunks (  const char* szParentAction, const VecTraits_T<ConstDiskChunkRefPtr_t>& dChunks, CSphIndexProgress& tProgress );
+	ConstDiskChunkRefPtr_t	PreallocMergedChunk ( const char* szParentAction, const CSphIndex& tDstChunk );
 	bool				PublishMergedChunks ( const char * szParentAction,std::function<bool ( int, DiskChunkVec_c & )> && fnPusher) REQUIRES ( m_tWorkers.SerialChunkAccess() );
 	bool 				RenameOptimizedChunk ( const ConstDiskChunkRefPtr_t& pChunk, const char * szParentAction );
 	bool				SkipOrDrop ( int iChunk, const CSphIndex& dChunk, bool bCheckAlive, int* pAffected = nullptr );
@@ -1301,6 +1307,7 @@ private:
 	CSphVector<SphWordID_t>		m_dHitlessWords;
 
 	std::unique_ptr<DocstoreFields_i> m_pDocstoreFields;	// rt index doesn't have its own docstore, but it must keep all fields to get their ids for GetDoc
+	std::unique_ptr<JsonColumnsBuilder_c> m_pJsonColumns;	// fills hidden json_columns attrs on insert
 	mutable int					m_iTrackFailedRamActions;
 	int							m_iAlterGeneration = 0;		// increased every time index altered
 
@@ -1374,6 +1381,7 @@ private:
 	int							DebugCheckDisk ( DebugCheckError_i & tReporter );
 
 	void						SetSchema ( CSphSchema tSchema );
+	void						SetupJsonColumns();
 
 	void						SetMemLimit ( int64_t iMemLimit );
 	void						RecalculateRateLimit ( int64_t iSaved, int64_t iInserted, bool bEmergent );
@@ -1876,6 +1884,11 @@ bool RtIndex_c::AddDocument ( InsertDocData_t & tDoc, bool bReplace, const CSphS
 	DocstoreBuilder_i::Doc_t tStoredDoc;
 	DocstoreBuilder_i::Doc_t * pStoredDoc = FetchDocFields ( tStoredDoc, tDoc, tSrc, dTmpAttrStorage );
 	tDoc.m_iTotalBytes = tSrc.GetStats().m_iTotalBytes;
+
+	StrVec_t dJsonColumnStrings;
+	if ( m_pJsonColumns )
+		m_pJsonColumns->Fill ( tDoc, dJsonColumnStrings );
+
 	return AddDocument ( pHits, tDoc, bReplace, pStoredDoc, sError, sWarning, pAcc );
 }
 
@@ -2271,10 +2284,7 @@ private:
 
 	RowID_t SkipDeadRows ( RowID_t tRowID ) const
 	{
-		while ( tRowID<m_tRowIDMax && m_tDeadRowMap.IsSet(tRowID) )
-			++tRowID;
-
-		return tRowID;
+		return Min ( m_tDeadRowMap.NextAlive ( tRowID ), m_tRowIDMax );
 	}
 
 	RowID_t FirstAliveRow() const			{ return SkipDeadRows(m_tRowID); }
@@ -2660,6 +2670,7 @@ void RtSegment_t::UpdateAttributesOffline ( VecTraits_T<PostponedUpdate_t>& dPos
 		tCtx.m_pAttrPool = m_dRows.begin();
 		tCtx.m_pBlobPool = m_dBlobs.begin();
 		Update_UpdateAttributes ( tPostUpdate.m_dRowsToUpdate, tCtx, bCritical, sError );
+		m_iAttrUpdates.fetch_add ( 1, std::memory_order_relaxed );
 	}
 }
 
@@ -3437,7 +3448,7 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 
 	tWriterHits.PutByte(1);
 	tWriterDocs.PutByte(1);
-	tWriterSkips.PutByte(1);
+	tWriterSkips.PutByte(SKIPLIST_BLOCKMAX);
 
 	int iSegments = tCtx.m_tRamSegments.GetLength();
 
@@ -3455,6 +3466,7 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 	CSphKeywordDeltaWriter tLastWord;
 	SphWordID_t uLastWordID = 0;
 	CSphVector<SkiplistEntry_t> dSkiplist;
+	CSphVector<SkipBlockMax_t> dSkipBlockMax;
 
 	tCtx.m_tLastDocPos = 0;
 
@@ -3480,6 +3492,7 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 		int iDocs = 0;
 		int iHits = 0;
 		dSkiplist.Resize(0);
+		dSkipBlockMax.Resize(0);
 
 		// loop all segments that have this keyword
 		CSphBitvec tSegsWithWord ( iSegments );
@@ -3506,8 +3519,13 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 					t.m_tBaseRowIDPlus1 = tSkiplistRowID+1;
 					t.m_iOffset = tWriterDocs.GetPos();
 					t.m_iBaseHitlistPos = uLastHitpos;
+					dSkipBlockMax.Add();
 				}
 
+				SkipBlockMax_t & tBlockMax = dSkipBlockMax.Last();
+				tBlockMax.m_uMaxHits = Max ( tBlockMax.m_uMaxHits, pDoc->m_uHits );
+				tBlockMax.m_uFields |= pDoc->m_uDocFields;
+
 				++iDocs;
 				iHits += pDoc->m_uHits;
 				tSkiplistRowID = tRowID;
@@ -3549,6 +3567,13 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 			tWriterSkips.ZipOffset ( tCur.m_iBaseHitlistPos - tPrev.m_iBaseHitlistPos );
 		}
 
+		if ( iDocs>iSkiplistBlockSize )
+			for ( const auto & tMax : dSkipBlockMax )
+			{
+				tWriterSkips.ZipInt ( tMax.m_uMaxHits );
+				tWriterSkips.ZipInt ( tMax.m_uFields );
+			}
+
 		// write dict entry if necessary
 		if ( tWriterDocs.GetPos()!=uDocpos )
 		{
@@ -3948,6 +3973,8 @@ bool RtIndex_c::SaveDiskChunk ( bool bForced, bool bEmergent, bool bBootstrap )
 		m_tNSavesNow.ModifyValueAndNotifyAll ( [] ( int& iVal ) { --iVal; } );
 	} );
 
+	ScopedIOClass_c tIOClass ( IOClass_e::FLUSH );
+
 	const int iSaveOp = m_tWorkers.GetNextOpTicket();
 	TRACE_SCHED_VARID ( "rt", "SaveDiskChunk", iSaveOp );
 
@@ -6849,7 +6876,7 @@ static bool CalcDiskChunkSplits ( IntVec_t & dThreads, int iJobs, const CSphQuer
 }
 
 
-static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tResult, const CSphMultiQueryArgs & tArgs, const RtGuard_t & tGuard, VecTraits_T<ISphMatchSorter *> & dSorters, QueryProfile_c * pProfiler, bool bGotLocalDF, const SmallStringHash_T<int64_t> * pLocalDocs, int64_t iTotalDocs, const char * szIndexName, SorterSchemaTransform_c & tSSTransform, int64_t tmMaxTimer )
+static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tResult, const CSphMultiQueryArgs & tArgs, const RtGuard_t & tGuard, VecTraits_T<ISphMatchSorter *> & dSorters, QueryProfile_c * pProfiler, bool bGotLocalDF, const SmallStringHash_T<int64_t> * pLocalDocs, int64_t iTotalDocs, const char * szIndexName, int64_t iIndexId, SorterSchemaTransform_c & tSSTransform, int64_t tmMaxTimer )
 {
 	// counter of tasks we will issue now
 	int iJobs = tGuard.m_dDiskChunks.GetLength();
@@ -6928,6 +6955,7 @@ static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tR
 			tMultiArgs.m_bLocalDF = bGotLocalDF;
 			tMultiArgs.m_pLocalDocs = pLocalDocs;
 			tMultiArgs.m_iTotalDocs = iTotalDocs;
+			tMultiArgs.m_iQcacheTableId = iIndexId; // all the chunks share the quota of the table
 			tMultiArgs.m_iThreads = dSplits[iChunk];
 			tMultiArgs.m_iTotalThreads = iThreads;
 
@@ -7079,6 +7107,31 @@ static bool PerformFullscan ( const VecTraits_T<RtSegmentRefPtf_t> & dRamChunks,
 	tMatch.Reset ( iMaxDynamicSize );
 	tMatch.m_iWeight = iIndexWeight;
 
+	// expressions are evaluated over blocks of rows, one batch call per expression node
+	auto pBlock = std::make_unique<MatchBlock_c> ( iMaxDynamicSize );
+	auto fnSetWeight = [bRandomize, iIndexWeight] ( CSphMatch & tMatch )
+	{
+		if ( bRandomize )
+			tMatch.m_iWeight = ( sphRand() & 0xffff ) * iIndexWeight;
+	};
+
+	auto fnPush = [&dSorters, &iCutoff] ( CSphMatch & tMatch )
+	{
+		bool bNewMatch = false;
+		for ( auto * pSorter: dSorters )
+			bNewMatch |= pSorter->Push ( tMatch );
+
+		// handle cutoff
+		return bNewMatch && --iCutoff==0;
+	};
+
+	auto fnProcessBlock = [&]
+	{
+		bool bCutoff = FilterSortAndPush ( tCtx, pBlock->Matches(), fnSetWeight, fnPush );
+		pBlock->Clear();
+		return bCutoff;
+	};
+
 	ARRAY_FOREACH ( iSeg, dRamChunks )
 	{
 		RtSegment_t & tSeg = *dRamChunks[iSeg];
@@ -7098,38 +7151,17 @@ static bool PerformFullscan ( const VecTraits_T<RtSegmentRefPtf_t> & dRamChunks,
 
 		session::Info().m_pSessionOpaque2 = (void*)tSeg.m_pDocstore.get();
 
+		// storing segment in matches tag for finding strings attrs offset later, biased against default zero
+		tMatch.m_iTag = iSeg+1;
+
 		for ( auto tRowID : RtLiveRows_c(tSeg) )
 		{
-			tMatch.m_tRowID = tRowID;
-			tMatch.m_pStatic = tSeg.m_dRows.Begin() + (int64_t)tRowID*iStride;
-
-			tCtx.CalcFilter ( tMatch );
-			if ( tCtx.m_pFilter && !tCtx.m_pFilter->Eval ( tMatch ) )
-			{
-				tCtx.FreeDataFilter ( tMatch );
+			pBlock->Add ( tRowID, tSeg.m_dRows.Begin() + (int64_t)tRowID*iStride, tMatch );
+			if ( !pBlock->IsFull() )
 				continue;
-			}
-
-			if ( bRandomize )
-				tMatch.m_iWeight = ( sphRand() & 0xffff ) * iIndexWeight;
-
-			tCtx.CalcSort ( tMatch );
-
-			// storing segment in matches tag for finding strings attrs offset later, biased against default zero
-			tMatch.m_iTag = iSeg+1;
 
-			bool bNewMatch = false;
-			for ( auto * pSorter: dSorters )
-				bNewMatch |= pSorter->Push ( tMatch );
-
-			// stringptr expressions should be duplicated (or taken over) at this point
-			tCtx.FreeDataFilter ( tMatch );
-			tCtx.FreeDataSort ( tMatch );
-
-			// handle cutoff
-			if ( bNewMatch )
-				if ( --iCutoff==0 )
-					return true;
+			if ( fnProcessBlock() )
+				return true;
 
 			// handle timer
 			if ( sph::TimeExceeded ( tmMaxTimer ) )
@@ -7148,6 +7180,10 @@ static bool PerformFullscan ( const VecTraits_T<RtSegmentRefPtf_t> & dRamChunks,
 				Threads::Coro::RescheduleAndKeepCrashQuery();
 			}
 		}
+
+		// the rest of the segment, while its pools are set
+		if ( !pBlock->IsEmpty() && fnProcessBlock() )
+			return true;
 	}
 
 	return false;
@@ -7176,12 +7212,27 @@ static bool DoFullScanQuery ( const RtSegVec_c & dRamChunks, const ISphSchema &
 }
 
 
-static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_t & tTermSetup, ISphRanker * pRanker, int iIndexWeight, int iCutoff, QueryProfile_c * pProfiler, CSphQueryContext & tCtx, VecTraits_T<ISphMatchSorter*> & dSorters )
+static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_t & tTermSetup, ISphRanker * pRanker, int iIndexWeight, int iCutoff, QueryProfile_c * pProfiler, CSphQueryContext & tCtx, VecTraits_T<ISphMatchSorter*> & dSorters, const ISphSchema & tMaxSorterSchema, int64_t tmQueryStart )
 {
 	if ( !iCutoff )
 		return;
 
 	bool bRandomize = dSorters[0]->IsRandom();
+
+	// no per-segment bounds here (ram segments have no skiplists), so the ranker falls back to per-term ones
+	ISphMatchSorter * pPruningSorter = tTermSetup.m_bDynamicPruning && iCutoff<0 ? dSorters[0] : nullptr;
+	int iMinWeight = INT_MIN;
+
+	// segments never get new rows, only kills and attribute updates; so results are cached per segment, and kills are applied on read
+	// updates and collection stats (which change with any segment) are the part of the entry version
+	// cache ranker can't provide packed factors, so these queries are never cached; pruned results are not complete
+	bool bQcache = QcacheGetMaxBytes()>0 && !( tCtx.m_uPackedFactorFlags & SPH_FACTOR_ENABLE ) && !tTermSetup.m_bDynamicPruning;
+	CSphVector<QcacheEntryRefPtr_t> dToCache;
+	uint64_t uSegmentsHash = SPH_FNV64_SEED;
+	if ( bQcache )
+		for ( const auto & pSeg : dRamChunks )
+			uSegmentsHash = sphFNV64 ( &pSeg->m_iQcacheId, sizeof(pSeg->m_iQcacheId), uSegmentsHash );
+
 	// query matching
 	ARRAY_FOREACH ( iSeg, dRamChunks )
 	{
@@ -7189,12 +7240,36 @@ static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_
 		SccRL_t rLock ( pSeg->m_tLock );
 		SwitchProfile ( pProfiler, SPH_QSTATE_INIT_SEGMENT );
 
-		tTermSetup.SetSegment ( iSeg );
-		pRanker->Reset ( tTermSetup );
-
-		// for lookups to work
+		// for lookups to work (cached ranker filters matches right on decoding)
 		tCtx.m_pIndexData = pSeg;
 
+		QcacheEntryRefPtr_t pCached;
+		QcacheEntryRefPtr_t pToCache;
+		std::unique_ptr<ISphRanker> pCachedRanker;
+		uint64_t uVersion = 0;
+		if ( bQcache )
+		{
+			uVersion = QcacheVersion ( tCtx.m_tQuery, pSeg->m_iAttrUpdates.load ( std::memory_order_relaxed ), tCtx.m_iTotalDocs, tCtx.m_pLocalDocs, uSegmentsHash );
+			pCached = QcacheFind ( pSeg->m_iQcacheId, tCtx.m_tQuery, tMaxSorterSchema, uVersion );
+		}
+
+		if ( pCached )
+			pCachedRanker = QcacheRanker ( pCached, tTermSetup );
+		else if ( bQcache )
+		{
+			pToCache = new QcacheEntry_c;
+			pToCache->m_iIndexId = pSeg->m_iQcacheId;
+			pToCache->m_iTableId = tTermSetup.m_pIndex->GetIndexId();
+			pToCache->m_uVersion = uVersion;
+		}
+
+		ISphRanker * pSegRanker = pCachedRanker ? pCachedRanker.get() : pRanker;
+		if ( !pCachedRanker )
+		{
+			tTermSetup.SetSegment ( iSeg );
+			pRanker->Reset ( tTermSetup );
+		}
+
 		// set blob pool for string on_sort expression fix up
 		const BYTE * pBlobPool = pSeg->m_dBlobs.Begin ();
 		tCtx.SetBlobPool ( pBlobPool );
@@ -7212,31 +7287,55 @@ static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_
 		// storing segment in matches tag for finding strings attrs offset later, biased against default zero
 		int iTag = iSeg+1;
 		if ( tCtx.m_uPackedFactorFlags & SPH_FACTOR_ENABLE )
-			pRanker->ExtraData ( EXTRA_SET_MATCHTAG, (void**)&iTag );
+			pSegRanker->ExtraData ( EXTRA_SET_MATCHTAG, (void**)&iTag );
 
-		pRanker->ExtraData ( EXTRA_SET_BLOBPOOL, (void**)&pBlobPool );
-		pRanker->ExtraData ( EXTRA_SET_COLUMNAR, (void**)&pColumnar );
+		pSegRanker->ExtraData ( EXTRA_SET_BLOBPOOL, (void**)&pBlobPool );
+		pSegRanker->ExtraData ( EXTRA_SET_COLUMNAR, (void**)&pColumnar );
 
-		CSphMatch * pMatch = pRanker->GetMatchesBuffer();
+		CSphMatch * pMatch = pSegRanker->GetMatchesBuffer();
+		CSphVector<CSphMatch *> dBlock;
 		while (true)
 		{
 			// ranker does profile switches internally in GetMatches()
-			int iMatches = pRanker->GetMatches();
+			int iMatches = pSegRanker->GetMatches();
 			if ( iMatches<=0 )
 				break;
 
+			if ( pToCache )
+			{
+				CSphScopedProfile tProf ( pProfiler, SPH_QSTATE_QCACHE_UP );
+				for ( int i=0; i<iMatches; i++ )
+					pToCache->Append ( pMatch[i].m_tRowID, pMatch[i].m_iWeight );
+			}
+
 			SwitchProfile ( pProfiler, SPH_QSTATE_SORT );
 
+			dBlock.Resize(0);
 			for ( int i=0; i<iMatches; i++ )
 			{
 				CSphMatch & tMatch = pMatch[i];
 
+				// cached matches might be killed since they were stored
+				if ( pCachedRanker && pSeg->m_tDeadRowMap.IsSet ( tMatch.m_tRowID ) )
+				{
+					tCtx.FreeDataFilter ( tMatch );
+					continue;
+				}
+
 				tMatch.m_pStatic = pSeg->GetDocinfoByRowID ( tMatch.m_tRowID );
 				tMatch.m_iWeight *= iIndexWeight;
 				if ( bRandomize )
 					tMatch.m_iWeight = ( sphRand() & 0xffff ) * iIndexWeight;
 
-				tCtx.CalcSort ( tMatch );
+				dBlock.Add ( &tMatch );
+			}
+
+			// sort expressions are evaluated over the whole block, one batch call per expression node
+			tCtx.CalcSortBatch ( dBlock );
+
+			ARRAY_FOREACH ( iMatch, dBlock )
+			{
+				CSphMatch & tMatch = *dBlock[iMatch];
 
 				if ( tCtx.m_pWeightFilter && !tCtx.m_pWeightFilter->Eval ( tMatch ) )
 				{
@@ -7265,9 +7364,11 @@ static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_
 				tCtx.FreeDataFilter ( tMatch );
 				tCtx.FreeDataSort ( tMatch );
 
-				if ( bNewMatch )
-					if ( --iCutoff==0 )
-						break;
+				if ( bNewMatch && --iCutoff==0 )
+				{
+					dBlock.Slice ( iMatch+1 ).for_each ( [&tCtx] ( CSphMatch * pRest ) { tCtx.FreeDataSort ( *pRest ); } );
+					break;
+				}
 			}
 
 			if ( iCutoff==0 )
@@ -7275,12 +7376,34 @@ static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_
 				iSeg = dRamChunks.GetLength();
 				break;
 			}
+
+			if ( pPruningSorter )
+				UpdatePruningThreshold ( pPruningSorter, pRanker, iIndexWeight, iMinWeight );
 		}
+
+		// segment results are only complete when no cutoff hit
+		if ( pToCache && iCutoff!=0 )
+		{
+			pSeg->m_bQcached.store ( true, std::memory_order_relaxed );
+			dToCache.Add ( pToCache );
+		}
+	}
+
+	if ( dToCache.IsEmpty() )
+		return;
+
+	// a single segment scan is almost never slower than qcache_thresh_msec, so entries are timed by the whole query instead
+	// (disk chunks are already searched at this point)
+	CSphScopedProfile tProf ( pProfiler, SPH_QSTATE_QCACHE_FINAL );
+	for ( auto & pToCache : dToCache )
+	{
+		pToCache->m_tmStarted = tmQueryStart;
+		QcacheAdd ( tCtx.m_tQuery, pToCache, tMaxSorterSchema );
 	}
 }
 
 
-static bool DoFullTextSearch ( const RtSegVec_c & dRamChunks, const ISphSchema & tMaxSorterSchema, const CSphQuery & tQuery, const char * szIndexName, const CSphMultiQueryArgs & tArgs, int iMatchPoolSize, int iStackNeed, RtQwordSetup_t & tTermSetup, QueryProfile_c * pProfiler, CSphQueryContext & tCtx, VecTraits_T<ISphMatchSorter*> & dSorters, XQQuery_t & tParsed, CSphQueryResultMeta & tMeta, ISphMatchSorter * pSorter )
+static bool DoFullTextSearch ( const RtSegVec_c & dRamChunks, const ISphSchema & tMaxSorterSchema, const CSphQuery & tQuery, const char * szIndexName, const CSphMultiQueryArgs & tArgs, int iMatchPoolSize, int iStackNeed, RtQwordSetup_t & tTermSetup, QueryProfile_c * pProfiler, CSphQueryContext & tCtx, VecTraits_T<ISphMatchSorter*> & dSorters, XQQuery_t & tParsed, CSphQueryResultMeta & tMeta, ISphMatchSorter * pSorter, int64_t tmQueryStart )
 {
 	// set zonespanlist settings
 	tParsed.m_bNeedSZlist = tQuery.m_bZSlist;
@@ -7319,7 +7442,7 @@ static bool DoFullTextSearch ( const RtSegVec_c & dRamChunks, const ISphSchema &
 
 		// do searching
 		int iCutoff = ApplyImplicitCutoff ( tQuery, dSorters );
-		PerformFullTextSearch ( dRamChunks, tTermSetup, pRanker.get (), tArgs.m_iIndexWeight, iCutoff, pProfiler, tCtx, dSorters );
+		PerformFullTextSearch ( dRamChunks, tTermSetup, pRanker.get (), tArgs.m_iIndexWeight, iCutoff, pProfiler, tCtx, dSorters, tMaxSorterSchema, tmQueryStart );
 	}
 
 	FinalExpressionCalculation ( tCtx, dRamChunks, dSorters, tArgs.m_bFinalizeSorters );
@@ -7475,7 +7598,7 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 
 	if ( !dDiskChunks.IsEmpty() )
 	{
-		if ( !QueryDiskChunks ( tQuery, tMeta, tArgs, tGuard, dSorters, pProfiler, bGotLocalDF, pLocalDocs, iTotalDocs, GetName(), tSSTransform, tmMaxTimer ) )
+		if ( !QueryDiskChunks ( tQuery, tMeta, tArgs, tGuard, dSorters, pProfiler, bGotLocalDF, pLocalDocs, iTotalDocs, GetName(), GetIndexId(), tSSTransform, tmMaxTimer ) )
 			return false;
 	}
 
@@ -7516,6 +7639,7 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 	tTermSetup.SetSegment ( -1 );
 	tTermSetup.m_pCtx = &tCtx;
 	tTermSetup.m_bHasWideFields = ( m_tSchema.GetFieldsCount()>32 );
+	tTermSetup.m_bDynamicPruning = !!GetPruningSorter ( tQuery, dSorters, tArgs.m_iIndexWeight );
 
 	// setup prediction constrain
 	CSphQueryStats tQueryStats;
@@ -7544,9 +7668,8 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 
 	CSphScopedPayload tPayloads;
 
-	// FIXME!!! add proper
-	// - qcache invalidation after INSERT \ DELETE \ UPDATE and for plain index afte UPDATE #256
-	// - qcache duplicates removal from killed document at segment #263
+	// whole-index ranker cache is useless for RT as any commit changes segments set
+	// instead, PerformFullTextSearch() caches results per RAM segment (disk chunks use own per-chunk ids anyway)
 	tCtx.m_bSkipQCache = true;
 
 	int iStackNeed = -1;
@@ -7592,7 +7715,7 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 		tFTArgs.m_bFinalizeSorters = tArgs.m_bFinalizeSorters;
 		tMeta.m_bBigram = ( m_tSettings.m_eBigramIndex!=SPH_BIGRAM_NONE );
 
-		bResult = DoFullTextSearch ( tGuard.m_dRamSegs, tMaxSorterSchema, tQuery, GetName(), tFTArgs, iMatchPoolSize, iStackNeed, tTermSetup, pProfiler, tCtx, dSorters, tParsed, tMeta, dSorters.GetLength()==1 ? dSorters[0] : nullptr );
+		bResult = DoFullTextSearch ( tGuard.m_dRamSegs, tMaxSorterSchema, tQuery, GetName(), tFTArgs, iMatchPoolSize, iStackNeed, tTermSetup, pProfiler, tCtx, dSorters, tParsed, tMeta, dSorters.GetLength()==1 ? dSorters[0] : nullptr, tmQueryStart );
 	}
 
 	if (!bResult)
@@ -7989,6 +8112,8 @@ int RtIndex_c::CheckThenUpdateAttributes ( AttrUpdateInc_t& tUpd, bool& bCritica
 		if ( !pSeg->Update_UpdateAttributes ( dRamUpdateSets[i], tCtx, bCritical, sError ) )
 			return -1;
 
+		pSeg->m_iAttrUpdates.fetch_add ( 1, std::memory_order_relaxed );
+
 		pSeg->MaybeAddPostponedUpdate( dRamUpdateSets[i], tCtx );
 
 		if ( tUpd.AllApplied () )
@@ -8273,6 +8398,7 @@ bool RtIndex_c::AddRemoveAttribute ( bool bAdd, const AttrAddRemoveCtx_t & tCtx,
 
 	m_tSchema = tNewSchema;
 	m_iStride = m_tSchema.GetRowSize();
+	SetupJsonColumns();
 
 	auto tGuard = RtGuard();
 
@@ -8614,6 +8740,22 @@ static ChunkAndSize_t GetNextSmallestChunkByID ( const DiskChunkVec_c& dDiskChun
 	return { iRes, iLastSize };
 }
 
+// ids of (at most) iCount smallest chunks, which are not optimizing now
+static CSphVector<int> GetSmallestChunkIDs ( const DiskChunkVec_c& dDiskChunks, int iCount )
+{
+	CSphVector<ChunkAndSize_t> dChunks;
+	for ( const auto& pDiskChunk : dDiskChunks )
+		if ( !pDiskChunk->m_bOptimizing.load ( std::memory_order_relaxed ) )
+			dChunks.Add ( { pDiskChunk->Cidx().m_iChunk, GetChunkSize ( pDiskChunk->Cidx() ) } );
+
+	dChunks.Sort ( Lesser ( [] ( const ChunkAndSize_t& a, const ChunkAndSize_t& b ) { return a.m_iSize < b.m_iSize; } ) );
+
+	CSphVector<int> dIDs;
+	for ( const auto& tChunk : dChunks.Slice ( 0, Min ( iCount, dChunks.GetLength() ) ) )
+		dIDs.Add ( tChunk.m_iId );
+	return dIDs;
+}
+
 static int GetNumOfOptimizingNow ( const DiskChunkVec_c& dDiskChunks )
 {
 	return (int)dDiskChunks.count_of ( [] ( auto& i ) { return i->m_bOptimizing.load ( std::memory_order_relaxed ); } );
@@ -8743,16 +8885,46 @@ ConstDiskChunkRefPtr_t RtIndex_c::MergeDiskChunks ( const char* szParentAction,
 		return pChunk;
 	}
 
+	return PreallocMergedChunk ( szParentAction, tChunkA );
+}
+
+// same as above, but merges any number of chunks in one pass; result is named after the first chunk
+ConstDiskChunkRefPtr_t RtIndex_c::MergeDiskChunks ( const char* szParentAction, const VecTraits_T<ConstDiskChunkRefPtr_t>& dChunks, CSphIndexProgress& tProgress )
+{
+	CSphString sError;
+
+	CSphFixedVector<const CSphIndex*> dIndexes { dChunks.GetLength() };
+	ARRAY_FOREACH ( i, dChunks )
+		dIndexes[i] = &dChunks[i]->Cidx();
+
+	const CSphIndex& tDstChunk = *dIndexes.First();
+
+	if ( !sphMerge ( dIndexes, tProgress, sError ) )
+	{
+		if ( sError.IsEmpty() && tProgress.GetMergeCb().NeedStop() )
+			sError = "interrupted because of shutdown";
+		sphWarning ( "rt %s: table %s: failed to merge %s (%s)", szParentAction, GetName(), tDstChunk.GetFilebase(), sError.cstr() );
+		return {};
+	}
+
+	return PreallocMergedChunk ( szParentAction, tDstChunk );
+}
+
+ConstDiskChunkRefPtr_t RtIndex_c::PreallocMergedChunk ( const char* szParentAction, const CSphIndex& tDstChunk )
+{
+	CSphString sError;
+	ConstDiskChunkRefPtr_t pChunk;
+
 	auto fnFnameBuilder = GetIndexFilenameBuilder();
 	std::unique_ptr<FilenameBuilder_i> pFilenameBuilder;
 	if ( fnFnameBuilder )
 		pFilenameBuilder = fnFnameBuilder ( GetName() );
 
 	// prealloc new (optimized) chunk
-	CSphString sChunk = tChunkA.GetFilename ( "tmp" );
+	CSphString sChunk = tDstChunk.GetFilename ( "tmp" );
 
 	StrVec_t dWarnings;
-	pChunk = DiskChunk_c::make ( PreallocDiskChunk ( sChunk, tChunkA.m_iChunk, pFilenameBuilder.get(), dWarnings, sError, tChunkA.GetName() ) );
+	pChunk = DiskChunk_c::make ( PreallocDiskChunk ( sChunk, tDstChunk.m_iChunk, pFilenameBuilder.get(), dWarnings, sError, tDstChunk.GetName() ) );
 	dWarnings.for_each ( [] ( const auto& sWarning ) { sphWarning ( "PreallocDiskChunk warning: %s", sWarning.cstr() ); } );
 
 	if ( pChunk )
@@ -9267,45 +9439,54 @@ bool RtIndex_c::SplitOneChunk ( int iChunkID, const char* szUvarFilter, int* pAf
 	return true;
 }
 
-bool RtIndex_c::MergeTwoChunks ( int iAID, int iBID, int* pAffected )
+// merge given chunks in one pass. Merged chunk is named after the first one and placed at the position of the last one
+bool RtIndex_c::MergeChunks ( const VecTraits_T<int> & dChunkIDs, int* pAffected )
 {
-	TRACE_SCHED ( "rt", "RtIndex_c::MergeTwoChunks" );
+	TRACE_SCHED ( "rt", "RtIndex_c::MergeChunks" );
+	assert ( dChunkIDs.GetLength()>=2 );
 
-	auto pA = m_tRtChunks.DiskChunkByID ( iAID );
-	if ( !pA )
-	{
-		sphWarning ( "rt optimize: table %s: merge chunks %d and %d failed, chunk ID %d is not valid!", GetName(), iAID, iBID, iAID );
-		return false;
-	}
+	StringBuilder_c sChunks ( ", " );
+	for ( int iID : dChunkIDs )
+		sChunks << iID;
 
-	auto pB = m_tRtChunks.DiskChunkByID ( iBID );
-	if ( !pB )
+	CSphVector<ConstDiskChunkRefPtr_t> dChunks;
+	for ( int iID : dChunkIDs )
 	{
-		sphWarning ( "rt optimize: table %s: merge chunks %d and %d failed, chunk ID %d is not valid!", GetName(), iAID, iBID, iBID );
-		return false;
+		auto pChunk = m_tRtChunks.DiskChunkByID ( iID );
+		if ( !pChunk )
+		{
+			sphWarning ( "rt optimize: table %s: merge chunks %s failed, chunk ID %d is not valid!", GetName(), sChunks.cstr(), iID );
+			return false;
+		}
+		dChunks.Add ( pChunk );
 	}
 
-	pA->m_bOptimizing.store ( true, std::memory_order_relaxed );
-	auto tResetOptimizingA = AtScopeExit ( [pA] { pA->m_bOptimizing.store ( false, std::memory_order_relaxed ); } );
-	pB->m_bOptimizing.store ( true, std::memory_order_relaxed );
-	auto tResetOptimizingB = AtScopeExit ( [pB] { pB->m_bOptimizing.store ( false, std::memory_order_relaxed ); } );
+	for ( auto & pChunk : dChunks )
+		pChunk->m_bOptimizing.store ( true, std::memory_order_relaxed );
+	auto tResetOptimizing = AtScopeExit ( [&dChunks] {
+		for ( auto & pChunk : dChunks )
+			pChunk->m_bOptimizing.store ( false, std::memory_order_relaxed );
+	} );
 
-	sphLogDebug ( "common merge - merging %d (%d kb) with %d (%d kb)",
-			iAID,
-			(int)( GetChunkSize ( pA->Cidx() ) / 1024 ),
-			iBID,
-			(int)( GetChunkSize ( pB->Cidx() ) / 1024 ) );
+	if ( g_eLogLevel>=SPH_LOG_DEBUG )
+	{
+		StringBuilder_c sSizes ( ", " );
+		for ( auto & pChunk : dChunks )
+			sSizes.Sprintf ( "%d (%d kb)", pChunk->Cidx().m_iChunk, (int)( GetChunkSize ( pChunk->Cidx() ) / 1024 ) );
+		sphLogDebug ( "common merge - merging %s", sSizes.cstr() );
+	}
 
 	// merge data to disk ( data is constant during that phase )
 	RTMergeCb_c tMonitor ( &m_bOptimizeStop, this );
 	CSphIndexProgress tProgress ( &tMonitor );
 
-	// get 1-st chunk - one which doesn't match filter the filter
-	auto pMerged = MergeDiskChunks ( "common merge", pA, pB, tProgress, { nullptr, 0 } );
+	auto pMerged = ( dChunks.GetLength()==2 )
+		? MergeDiskChunks ( "common merge", dChunks[0], dChunks[1], tProgress, { nullptr, 0 } )
+		: MergeDiskChunks ( "common merge", dChunks, tProgress );
 
-	auto tFinallyStopCollectingUpdates = AtScopeExit ( [pA, pB] {
-		pA->CastIdx().ResetPostponedUpdates();
-		pB->CastIdx().ResetPostponedUpdates();
+	auto tFinallyStopCollectingUpdates = AtScopeExit ( [&dChunks] {
+		for ( auto & pChunk : dChunks )
+			pChunk->CastIdx().ResetPostponedUpdates();
 	} );
 
 	// check forced exit after long operation (that is - after merge)
@@ -9319,11 +9500,10 @@ bool RtIndex_c::MergeTwoChunks ( int iAID, int iBID, int* pAffected )
 
 	// going to modify list of chunks; so fall into serial fiber
 	ScopedScheduler_c tSerialFiber ( m_tWorkers.SerialChunkAccess() );
-	TRACE_SCHED ( "rt", "MergeTwoChunks" );
+	TRACE_SCHED ( "rt", "MergeChunks" );
 
 	// reset kill hook explicitly to override default order of destruction
-	SetKillHookFor ( nullptr, iAID );
-	SetKillHookFor ( nullptr, iBID );
+	SetKillHookFor ( nullptr, dChunkIDs );
 
 	// apply collected kill-list before including chunks to the set
 	// as we are in serial worker, that is safe here; no new kills may arrive.
@@ -9332,32 +9512,30 @@ bool RtIndex_c::MergeTwoChunks ( int iAID, int iBID, int* pAffected )
 		iKilled = tMerged.KillMulti ( tMonitor.GetKilled() );
 
 	// and also apply collected updates
-	CSphVector<ConstDiskChunkRefPtr_t> tUpdated;
-	tUpdated.Add ( pA );
-	tUpdated.Add ( pB );
-	auto dUpdates = GatherUpdates::FromChunksOrSegments ( tUpdated );
+	auto dUpdates = GatherUpdates::FromChunksOrSegments ( dChunks );
 	if ( !dUpdates.IsEmpty() )
 	{
 		tMerged.UpdateAttributesOffline ( dUpdates );
 		dUpdates.Reset();
 	}
 
-	if ( !PublishMergedChunks ( "optimize", [iAID, iBID, pMerged] ( int iChunk, DiskChunkVec_c& tRes ) {
-			 if ( iChunk == iBID )
+	int iLastID = dChunkIDs.Last();
+	if ( !PublishMergedChunks ( "optimize", [dChunkIDs, iLastID, pMerged] ( int iChunk, DiskChunkVec_c& tRes ) {
+			 if ( iChunk == iLastID )
 				 tRes.Add ( pMerged );
-			 return ( iChunk == iAID || iChunk == iBID );
+			 return dChunkIDs.Contains ( iChunk );
 		 } ) )
 		return false;
 
-	sphLogDebug ( "optimized a=%s, b=%s, new=%s, killed=%d", pA->Cidx().GetFilebase(), pB->Cidx().GetFilebase(), tMerged.GetFilebase(), iKilled );
+	sphLogDebug ( "optimized %s, new=%s, killed=%d", sChunks.cstr(), tMerged.GetFilebase(), iKilled );
 
-	pA->m_bFinallyUnlink = true;
-	pB->m_bFinallyUnlink = true;
+	for ( auto & pChunk : dChunks )
+		pChunk->m_bFinallyUnlink = true;
 	pMerged->m_bFinallyUnlink = false;
 	SaveMeta();
 	Preread();
 	if ( pAffected )
-		++*pAffected;
+		*pAffected += dChunks.GetLength() - 1;
 	return true;
 }
 
@@ -9458,6 +9636,9 @@ bool RtIndex_c::MergeCanRun() const
 	return !sphInterrupted() && !m_bOptimizeStop.load(std::memory_order_relaxed);
 }
 
+// limits open files and read buffers of one merge pass
+static constexpr int MAX_CHUNKS_PER_MERGE = 32;
+
 int RtIndex_c::ClassicOptimize ()
 {
 	TRACE_SCHED ( "rt", "RtIndex_c::ClassicOptimize" );
@@ -9465,7 +9646,13 @@ int RtIndex_c::ClassicOptimize ()
 	int iAffected = 0;
 	bool bWork = true;
 	while ( bWork && m_tRtChunks.GetDiskChunksCount() >= 2 )
-		bWork &= MergeCanRun() && MergeTwoChunks ( ChunkIDByChunkIdx ( 0 ), ChunkIDByChunkIdx ( 1 ), &iAffected );
+	{
+		// merge leading chunks in one pass
+		CSphVector<int> dChunkIDs;
+		for ( int i = 0, iChunks = Min ( m_tRtChunks.GetDiskChunksCount(), MAX_CHUNKS_PER_MERGE ); i < iChunks; ++i )
+			dChunkIDs.Add ( ChunkIDByChunkIdx ( i ) );
+		bWork &= MergeCanRun() && MergeChunks ( dChunkIDs, &iAffected );
+	}
 	return iAffected;
 }
 
@@ -9489,13 +9676,14 @@ int RtIndex_c::ProgressiveOptimize ( int iCutoff )
 	while ( bWork &= MergeCanRun() )
 	{
 		auto pChunks = m_tRtChunks.DiskChunks();
-		if ( ( pChunks->GetLength() - GetNumOfOptimizingNow ( *pChunks ) ) <= iCutoff )
+		int iAvailable = pChunks->GetLength() - GetNumOfOptimizingNow ( *pChunks );
+		if ( iAvailable <= iCutoff )
 			break;
 
-		// merge 'smallest' to 'smaller' and get 'merged' that names like 'A'+.tmp
-		// however 'merged' got placed at 'B' position and 'merged' renamed to 'B' name
-
 		auto chA = GetNextSmallestChunkByID ( *pChunks, -1 );
+		if ( chA.m_iId < 0 )
+			break;
+
 		if ( !chA.m_iSize ) // empty chunk - just remove
 		{
 			RTDLOG << "Optimize: drop chunk " << chA.m_iId;
@@ -9503,21 +9691,21 @@ int RtIndex_c::ProgressiveOptimize ( int iCutoff )
 			continue;
 		}
 
-		auto chB = GetNextSmallestChunkByID ( *pChunks, chA.m_iId );
-		if ( chA.m_iId < 0 || chB.m_iId < 0 )
+		// merge as many 'smallest' chunks as necessary to fit the cutoff in one pass, instead of merging them pairwise.
+		// 'merged' got named like the first one +.tmp, placed at position of the last one and renamed to fresh chunk name
+		auto dChunkIDs = GetSmallestChunkIDs ( *pChunks, Min ( iAvailable - iCutoff + 1, MAX_CHUNKS_PER_MERGE ) );
+		if ( dChunkIDs.GetLength() < 2 )
 		{
-			//	sphWarning ( "Couldn't find smallest chunk" );
+			//	sphWarning ( "Couldn't find smallest chunks" );
 			break;
 		}
 
-		// we need to make sure that A is the oldest one
-		// indexes go from oldest to newest so A must go before B (A is always older than B)
+		// we need to make sure that chunks go from oldest to newest
 		// this is not required by bitmap killlists, but by some other stuff (like ALTER RECONFIGURE)
-		if ( chA.m_iId > chB.m_iId )
-			Swap ( chB, chA );
+		dChunkIDs.Sort();
 
-		RTDLOG << "Optimize: merge chunks " << chA.m_iId << " and " << chB.m_iId;
-		bWork &= MergeTwoChunks ( chA.m_iId, chB.m_iId, &iAffected );
+		RTDLOG << "Optimize: merge " << dChunkIDs.GetLength() << " chunks, from " << dChunkIDs.First() << " to " << dChunkIDs.Last();
+		bWork &= MergeChunks ( dChunkIDs, &iAffected );
 	}
 
 	RTDLOG << "Optimize: start compressing pass for the rest of " << m_tRtChunks.GetDiskChunksCount() << " chunks.";
@@ -9532,12 +9720,18 @@ int RtIndex_c::ProgressiveOptimize ( int iCutoff )
 
 int RtIndex_c::CommonOptimize ( OptimizeTask_t tTask )
 {
+	ScopedIOClass_c tIOClass ( IOClass_e::MERGE );
 	bool bProgressive = g_bProgressiveMerge;
 	int iChunks = 0;
 
 	switch ( tTask.m_eVerb ) // process all 'single' manual commands
 	{
-	case OptimizeTask_t::eMerge: MergeTwoChunks ( tTask.m_iFrom, tTask.m_iTo, &iChunks ); return iChunks;
+	case OptimizeTask_t::eMerge:
+	{
+		int dChunkIDs[] = { tTask.m_iFrom, tTask.m_iTo };
+		MergeChunks ( VecTraits_T<int> ( dChunkIDs, 2 ), &iChunks );
+		return iChunks;
+	}
 	case OptimizeTask_t::eDrop: DropDiskChunk ( tTask.m_iFrom, &iChunks ); return iChunks;
 	case OptimizeTask_t::eCompress: CompressOneChunk ( tTask.m_iFrom, &iChunks ); return iChunks;
 	case OptimizeTask_t::eSplit: SplitOneChunk ( tTask.m_iFrom, tTask.m_sUvarFilter.cstr(), &iChunks ); return iChunks;
@@ -9617,6 +9811,8 @@ void RtIndex_c::GetStatus ( CSphIndexStatus * pRes ) const
 		pRes->m_iMappedHits += tDisk.m_iMappedHits;
 		pRes->m_iMappedResidentHits += tDisk.m_iMappedResidentHits;
 		pRes->m_iDead += tDisk.m_iDead;
+		pRes->m_iDocstoreCacheHits += tDisk.m_iDocstoreCacheHits;
+		pRes->m_iDocstoreCacheMisses += tDisk.m_iDocstoreCacheMisses;
 	}
 
 	pRes->m_iNumRamChunks = tGuard.m_dRamSegs.GetLength();
@@ -10184,6 +10380,10 @@ bool sphRTSchemaConfigure ( const CSphConfigSection & hIndex, CSphSchema & tSche
 		}
 	}
 
+	// hidden typed copies of json paths
+	if ( !bPQ && hIndex.Exists ( "json_columns" ) && !AddJsonColumns ( hIndex.GetStr ( "json_columns" ), tSchema, sError ) )
+		return false;
+
 	// add blob attr locator
 	if ( tSchema.HasBlobAttrs() )
 	{
@@ -10211,6 +10411,14 @@ bool sphRTSchemaConfigure ( const CSphConfigSection & hIndex, CSphSchema & tSche
 
 
 
+void RtIndex_c::SetupJsonColumns()
+{
+	m_pJsonColumns = std::make_unique<JsonColumnsBuilder_c> ( m_tSchema );
+	if ( m_pJsonColumns->IsEmpty() )
+		m_pJsonColumns.reset();
+}
+
+
 void RtIndex_c::SetSchema ( CSphSchema tSchema )
 {
 	m_tSchema = std::move ( tSchema );
@@ -10223,6 +10431,8 @@ void RtIndex_c::SetSchema ( CSphSchema tSchema )
 		SetupDocstoreFields ( *m_pDocstoreFields.get(), m_tSchema );
 	}
 
+	SetupJsonColumns();
+
 	ARRAY_FOREACH ( i, m_dFieldLens )
 	{
 		m_dFieldLens[i] = 0;
@@ -249,6 +249,10 @@ public:
 
 	mutable bool					m_bConsistent{false};
 
+	const int64_t					m_iQcacheId { GenerateIndexId() };	///< query cache key of the segment results
+	mutable std::atomic<bool>		m_bQcached { false };				///< whether any results of this segment were ever cached
+	std::atomic<int64_t>			m_iAttrUpdates { 0 };				///< attribute updates counter; cached results of older versions are never hit
+
 							RtSegment_t ( DWORD uDocs, const ISphSchema& tSchema );
 
 	int64_t					GetUsedRam() const;				// get cached ram usage counter
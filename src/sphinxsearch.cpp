@@ -38,7 +38,10 @@ void SkipData_t::Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs
 	m_dSkiplist.Last().m_iOffset = tRes.m_iDoclistOffset;
 	m_dSkiplist.Last().m_iBaseHitlistPos = 0;
 
-	for ( int i=1; i < iDocs/iSkipBlockSize; i++ )
+	// files with block maxima have them right after all the entries, so we need to read the (otherwise unused) last entry too
+	bool bBlockMax = pSkips[0]==SKIPLIST_BLOCKMAX && iDocs>iSkipBlockSize;
+	int iEntries = bBlockMax ? ( iDocs+iSkipBlockSize-1 ) / iSkipBlockSize : iDocs/iSkipBlockSize;
+	for ( int i=1; i < iEntries; i++ )
 	{
 		SkiplistEntry_t & t = m_dSkiplist.Add();
 		SkiplistEntry_t & p = m_dSkiplist [ m_dSkiplist.GetLength()-2 ];
@@ -46,6 +49,18 @@ void SkipData_t::Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs
 		t.m_iOffset = p.m_iOffset + 4*iSkipBlockSize + UnzipOffsetBE(pSkip);
 		t.m_iBaseHitlistPos = p.m_iBaseHitlistPos + UnzipOffsetBE(pSkip);
 	}
+
+	if ( !bBlockMax )
+		return;
+
+	m_dBlockMax.Resize ( iEntries );
+	for ( auto & tMax : m_dBlockMax )
+	{
+		tMax.m_uMaxHits = UnzipIntBE(pSkip);
+		tMax.m_uFields = UnzipIntBE(pSkip);
+		m_tTermMax.m_uMaxHits = Max ( m_tTermMax.m_uMaxHits, tMax.m_uMaxHits );
+		m_tTermMax.m_uFields |= tMax.m_uFields;
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -70,6 +85,35 @@ RowID_t	ISphQword::AdvanceTo ( RowID_t tRowID )
 }
 
 
+bool ISphQword::GetBlockMax ( RowID_t tRowID, SkipBlockMax_t & tMax, RowID_t & tLastRowID ) const
+{
+	if ( !m_pSkipData || m_pSkipData->m_dBlockMax.IsEmpty() )
+		return false;
+
+	const auto & dSkiplist = m_pSkipData->m_dSkiplist;
+	assert ( dSkiplist.GetLength()==m_pSkipData->m_dBlockMax.GetLength() );
+
+	// block i holds rowids from m_tBaseRowIDPlus1[i] up to m_tBaseRowIDPlus1[i+1]-1
+	int iBlock = FindSpan ( dSkiplist, tRowID );
+	if ( iBlock<0 )
+		return false;
+
+	tMax = m_pSkipData->m_dBlockMax[iBlock];
+	tLastRowID = iBlock+1<dSkiplist.GetLength() ? dSkiplist[iBlock+1].m_tBaseRowIDPlus1-1 : INVALID_ROWID;
+	return true;
+}
+
+
+bool ISphQword::GetTermMax ( SkipBlockMax_t & tMax ) const
+{
+	if ( !m_pSkipData || m_pSkipData->m_dBlockMax.IsEmpty() )
+		return false;
+
+	tMax = m_pSkipData->m_tTermMax;
+	return true;
+}
+
+
 void ISphQword::CollectHitMask()
 {
 	if ( m_bAllFieldsKnown )
@@ -132,6 +176,7 @@ struct RankerSettings_t
 	bool	m_bSkipQCache = false;
 	bool	m_bCollectHits = true;
 	RowIdBoundaries_t m_tBoundaries;
+	uint64_t m_uQcacheVersion = 0;
 };
 
 /// ranker interface
@@ -168,6 +213,7 @@ public:
 protected:
 	std::unique_ptr<ExtNode_i>	m_pRoot;
 	ExtNode_i *					m_pOriginalRoot = nullptr;			///< set if we replace the
+	ExtNode_i *					m_pPruningNode = nullptr;			///< root node that accepts weight threshold (owned by the tree)
 	const ExtDoc_t *			m_pDoclist = nullptr;
 	const ExtHit_t *			m_pHitlist = nullptr;
 	ExtDoc_t					m_dMyDocs[MAX_BLOCK_DOCS];			///< my local documents pool; for filtering
@@ -212,7 +258,15 @@ protected:
 		case EXTRA_SET_BOUNDARIES:
 			m_pRoot->SetRowidBoundaries ( *(const RowIdBoundaries_t*)ppResult );
 			return true;
-		
+
+		case EXTRA_SET_WEIGHT_THRESHOLD:
+			if ( !m_pPruningNode )
+				return false;
+
+			// weight is (int)((tfidf+0.5)*SPH_BM25_SCALE) + rank*SPH_BM25_SCALE; leave some slack for float rounding
+			m_pPruningNode->SetWeightThreshold ( float ( *(int*)ppResult - 2 ) / SPH_BM25_SCALE - 0.5f );
+			return true;
+
 		default:
 			return false;
 		}
@@ -244,7 +298,7 @@ protected:
 
 public:
 	ExtRanker_WeightSum_c ( const XQQuery_t & tXQ, const ISphQwordSetup & tSetup, const RankerSettings_t & tSettings )
-		: ExtRanker_T<USE_BM25> ( tXQ, tSetup, { tSettings.m_bRowidLimits, tSettings.m_bSkipQCache, false, tSettings.m_tBoundaries } )
+		: ExtRanker_T<USE_BM25> ( tXQ, tSetup, { tSettings.m_bRowidLimits, tSettings.m_bSkipQCache, false, tSettings.m_tBoundaries, tSettings.m_uQcacheVersion } )
 	{}
 
 	int		GetMatches () override;
@@ -265,7 +319,7 @@ class ExtRanker_None_c : public ExtRanker_T<false>
 
 public:
 	ExtRanker_None_c ( const XQQuery_t & tXQ, const ISphQwordSetup & tSetup, const RankerSettings_t & tSettings )
-		: ExtRanker_T<false> ( tXQ, tSetup, { tSettings.m_bRowidLimits, tSettings.m_bSkipQCache, false, tSettings.m_tBoundaries } )
+		: ExtRanker_T<false> ( tXQ, tSetup, { tSettings.m_bRowidLimits, tSettings.m_bSkipQCache, false, tSettings.m_tBoundaries, tSettings.m_uQcacheVersion } )
 	{}
 
 	int		GetMatches () override;
@@ -625,7 +679,14 @@ ExtRanker_c::ExtRanker_c ( const XQQuery_t & tXQ, const ISphQwordSetup & tSetup,
 	assert ( tXQ.m_pRoot );
 	tSetup.m_pZoneChecker = this;
 	assert ( !m_pRoot );
-	m_pRoot.reset ( ExtNode_i::Create ( tXQ.m_pRoot, tSetup, bUseBM25, tSettings.m_bRowidLimits ? &tSettings.m_tBoundaries : nullptr ) );
+	if ( tSetup.m_bDynamicPruning && bUseBM25 && !tSettings.m_bCollectHits )
+	{
+		m_pPruningNode = ExtNode_i::CreateWand ( tXQ.m_pRoot, tSetup, tSettings.m_bRowidLimits );
+		m_pRoot.reset ( m_pPruningNode );
+	}
+
+	if ( !m_pRoot )
+		m_pRoot.reset ( ExtNode_i::Create ( tXQ.m_pRoot, tSetup, bUseBM25, tSettings.m_bRowidLimits ? &tSettings.m_tBoundaries : nullptr ) );
 	if ( m_pRoot && tSettings.m_bCollectHits )
 		m_pRoot->SetCollectHits();
 
@@ -681,10 +742,12 @@ ExtRanker_c::ExtRanker_c ( const XQQuery_t & tXQ, const ISphQwordSetup & tSetup,
 		m_dZoneEnd[i] = nullptr;
 	}
 
-	if ( QcacheGetStatus().m_iMaxBytes>0 && !tSettings.m_bSkipQCache )
+	if ( QcacheGetMaxBytes()>0 && !tSettings.m_bSkipQCache )
 	{
 		m_pQcacheEntry = new QcacheEntry_c();
 		m_pQcacheEntry->m_iIndexId = m_pIndex->GetIndexId();
+		m_pQcacheEntry->m_iTableId = m_pCtx->m_iQcacheTableId ? m_pCtx->m_iQcacheTableId : m_pIndex->GetIndexId();
+		m_pQcacheEntry->m_uVersion = tSettings.m_uQcacheVersion;
 	}
 
 	memset ( m_dMyDocs, 0, sizeof ( m_dMyDocs ) );
@@ -4415,12 +4478,15 @@ std::unique_ptr<ISphRanker> sphCreateRanker ( const XQQuery_t & tXQ, const CSphQ
 	bool bGotDupes = HasQwordDupes ( tXQ.m_pRoot );
 
 	RankerSettings_t tRankerSettings;
-	tRankerSettings.m_bSkipQCache = tCtx.m_bSkipQCache;
+	tRankerSettings.m_bSkipQCache = tCtx.m_bSkipQCache || tTermSetup.m_bDynamicPruning; // pruned result set is not complete
 
 	// can we serve this from cache?
 	QcacheEntryRefPtr_t pCached;
 	if ( !tRankerSettings.m_bSkipQCache )
-		pCached = QcacheFind ( pIndex->GetIndexId(), tQuery, tSorterSchema );
+	{
+		tRankerSettings.m_uQcacheVersion = QcacheVersion ( tQuery, pIndex->GetAttrUpdates(), tCtx.m_iTotalDocs, tCtx.m_pLocalDocs );
+		pCached = QcacheFind ( pIndex->GetIndexId(), tQuery, tSorterSchema, tRankerSettings.m_uQcacheVersion );
+	}
 
 	if ( pCached )
 		return QcacheRanker ( pCached, tTermSetup );
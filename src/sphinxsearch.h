@@ -43,10 +43,23 @@ bool operator < ( const SkiplistEntry_t & a, RowID_t b );
 bool operator == ( const SkiplistEntry_t & a, RowID_t b );
 bool operator < ( RowID_t a, const SkiplistEntry_t & b );
 
+/// first byte of the skiplist file; tells whether per-block maxima follow the skiplist entries of every term
+/// (older files start with a dummy 1 and only carry the entries)
+const BYTE SKIPLIST_BLOCKMAX = 2;
+
+/// per-block term stats upper bounds (for dynamic pruning)
+struct SkipBlockMax_t
+{
+	DWORD		m_uMaxHits = 0;		///< max hits per document within the block
+	DWORD		m_uFields = 0;		///< union of the (lowest 32) fields matched within the block
+};
+
 struct DictEntry_t;
 struct SkipData_t
 {
 	CSphVector<SkiplistEntry_t> m_dSkiplist;
+	CSphVector<SkipBlockMax_t>	m_dBlockMax;	///< one per skiplist entry; empty if the index has no block maxima
+	SkipBlockMax_t				m_tTermMax;		///< maxima over the whole doclist
 
 	void Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs, int iSkipBlockSize );
 };
@@ -106,6 +119,10 @@ public:
 
 	int							GetAtomPos() const;
 
+	/// upper bounds of the block that contains (or follows) the given rowid; tLastRowID is the last rowid of that block
+	bool						GetBlockMax ( RowID_t tRowID, SkipBlockMax_t & tMax, RowID_t & tLastRowID ) const;
+	bool						GetTermMax ( SkipBlockMax_t & tMax ) const;
+
 	virtual bool SetupScan ( const RtIndex_c * pIndex, int iSegment, const RtGuard_t& tGuard ) { return false; }
 };
 
@@ -128,6 +145,7 @@ public:
 	mutable bool			m_bSetQposMask	{false};
 	DictRefPtr_c			m_pDict;
 	bool					m_bHasWideFields { false };
+	bool					m_bDynamicPruning { false };	///< whether OR-of-terms may skip docs scoring below the sorter's threshold
 
 	virtual ~ISphQwordSetup () {}
 
@@ -51,6 +51,17 @@ bool GetAccurateAggregationDefault()
 }
 
 
+static int64_t g_iExactGroupbyMaxBytes = 128*1024*1024;
+static CSphString g_sExactGroupbyTmpDir = "/tmp";
+
+void SetExactGroupbySettings ( int64_t iMaxBytes, const CSphString & sTmpDir )
+{
+	g_iExactGroupbyMaxBytes = iMaxBytes;
+	if ( !sTmpDir.IsEmpty() )
+		g_sExactGroupbyTmpDir = sTmpDir;
+}
+
+
 void SetDistinctThreshDefault ( int iThresh )
 {
 	g_iDistinctThresh = iThresh;
@@ -611,7 +622,8 @@ public:
 		// CSphMatchQueueTraits
 		m_dData.SwapData ( rhs.m_dData );
 		m_dIData.SwapData ( rhs.m_dIData );
-		assert ( m_iSize==rhs.m_iSize );
+		::Swap ( m_iSize, rhs.m_iSize );	// exact group-by sorters might have grown their buffers
+		::Swap ( m_iMatchCapacity, rhs.m_iMatchCapacity );
 	}
 
 	const VecTraits_T<CSphMatch>& GetMatches() const { return m_dData; }
@@ -2443,6 +2455,7 @@ struct CSphGroupSorterSettings
 	int					m_iMaxMatches = 0;
 	bool				m_bGrouped = false;	///< are we going to push already grouped matches to it?
 	int					m_iDistinctAccuracy = 16;	///< HyperLogLog accuracy. 0 means "don't use HLL"
+	bool				m_bExact = false;	///< never cut groups; grow the buffer and spill it to disk instead
 
 	void FixupLocators ( const ISphSchema * pOldSchema, const ISphSchema * pNewSchema )
 	{
@@ -2971,6 +2984,206 @@ protected:
 	}
 };
 
+/// radix-partitioned temp files for the groups an exact group-by sorter can't keep in memory
+/// partitions hold disjoint sets of group keys, so they can be merged back one at a time
+class GroupSpill_c : ISphNoncopyable
+{
+public:
+	static const int PARTITION_BITS = 4;
+	static const int PARTITIONS = 1<<PARTITION_BITS;
+
+	static int GetPartition ( SphGroupKey_t uKey )
+	{
+		return int ( ( uint64_t(uKey)*0x9E3779B97F4A7C15ULL ) >> ( 64-PARTITION_BITS ) );
+	}
+
+	/// append given matches to their partitions; on failure nothing from this batch is considered written
+	bool Write ( const VecTraits_T<CSphMatch> & dData, const VecTraits_T<int> & dIndexes, const CSphAttrLocator & tLocGroupby, int iDynamic, CSphString & sError )
+	{
+		if ( !m_dOwn[0] && !Open ( sError ) )
+			return false;
+
+		int64_t dWritten[PARTITIONS];
+		for ( int i=0; i<PARTITIONS; ++i )
+			dWritten[i] = m_dOwn[i]->m_iMatches;
+
+		for ( auto iMatch : dIndexes )
+		{
+			const CSphMatch & tMatch = dData[iMatch];
+			Chunk_t & tChunk = *m_dOwn[GetPartition ( tMatch.GetAttr ( tLocGroupby ) )];
+			CSphWriter & tWriter = tChunk.m_tWriter;
+			tWriter.PutDword ( tMatch.m_tRowID );
+			tWriter.PutDword ( tMatch.m_iWeight );
+			tWriter.PutDword ( tMatch.m_iTag );
+			tWriter.PutOffset ( (SphOffset_t)tMatch.m_pStatic ); // static part is owned by the index and outlives the query
+			tWriter.PutBytes ( tMatch.m_pDynamic, iDynamic*sizeof(CSphRowitem) );
+			++tChunk.m_iMatches;
+		}
+
+		// flush every batch, so that a failure can't take previously spilled groups with it
+		bool bOk = true;
+		for ( auto & pChunk : m_dOwn )
+		{
+			pChunk->m_tWriter.Flush();
+			bOk &= !pChunk->m_tWriter.IsError();
+		}
+
+		if ( bOk )
+			return true;
+
+		for ( int i=0; i<PARTITIONS; ++i )
+			m_dOwn[i]->m_iMatches = dWritten[i];
+
+		sError = m_sError;
+		return false;
+	}
+
+	/// stop writing; spilled data becomes readable (or transferable)
+	void Seal()
+	{
+		for ( int i=0; i<PARTITIONS; ++i )
+			if ( m_dOwn[i] )
+			{
+				m_dOwn[i]->m_tWriter.CloseFile();
+				m_dSealed[i].Add ( std::move ( m_dOwn[i] ) );
+			}
+	}
+
+	/// take over all the data spilled by another sorter
+	void Adopt ( GroupSpill_c & tDonor )
+	{
+		tDonor.Seal();
+		for ( int i=0; i<PARTITIONS; ++i )
+		{
+			for ( auto & pChunk : tDonor.m_dSealed[i] )
+				m_dSealed[i].Add ( std::move(pChunk) );
+
+			tDonor.m_dSealed[i].Reset();
+		}
+	}
+
+	/// read back (and drop) one partition
+	template <typename FN>
+	void Read ( int iPartition, int iDynamic, FN && fnMatch )
+	{
+		CSphMatch tMatch;
+		tMatch.Reset ( iDynamic );
+
+		for ( auto & pChunk : m_dSealed[iPartition] )
+		{
+			CSphReader tReader;
+			tReader.SetFile ( pChunk->m_tFile );
+			for ( int64_t i=0; i<pChunk->m_iMatches && !tReader.GetErrorFlag(); ++i )
+			{
+				tMatch.m_tRowID = tReader.GetDword();
+				tMatch.m_iWeight = (int)tReader.GetDword();
+				tMatch.m_iTag = (int)tReader.GetDword();
+				tMatch.m_pStatic = (const CSphRowitem *)tReader.GetOffset();
+				tReader.GetBytes ( tMatch.m_pDynamic, iDynamic*sizeof(CSphRowitem) );
+				fnMatch ( tMatch );
+			}
+
+			if ( tReader.GetErrorFlag() )
+				sphWarning ( "exact group-by: %s", tReader.GetErrorMessage().cstr() );
+
+			pChunk.reset();
+		}
+
+		m_dSealed[iPartition].Reset();
+	}
+
+	/// pass every spilled group through fnMatch and spill it again, one partition at a time, so memory stays bounded
+	/// groups that can't be written back are handed to fnFailed instead
+	template <typename FN, typename FAILED>
+	void Rewrite ( const CSphAttrLocator & tLocGroupby, int iDynamic, FN && fnMatch, FAILED && fnFailed )
+	{
+		Seal();
+
+		GroupSpill_c tRewritten;
+		CSphFixedVector<CSphMatch> dBatch { REWRITE_BATCH };
+		for ( auto & tMatch : dBatch )
+			tMatch.Reset ( iDynamic );
+
+		CSphVector<int> dIndexes;
+		dIndexes.Reserve ( REWRITE_BATCH );
+		bool bFailed = false;
+		auto fnFlush = [&]
+		{
+			CSphString sError;
+			if ( !bFailed && !tRewritten.Write ( dBatch, dIndexes, tLocGroupby, iDynamic, sError ) )
+			{
+				sphWarning ( "exact group-by spill failed, keeping groups in memory: %s", sError.cstr() );
+				bFailed = true;
+			}
+
+			if ( bFailed )
+				for ( auto i : dIndexes )
+					fnFailed ( dBatch[i] );
+
+			dIndexes.Resize(0);
+		};
+
+		for ( int iPartition=0; iPartition<PARTITIONS; ++iPartition )
+			Read ( iPartition, iDynamic, [&] ( const CSphMatch & tMatch )
+			{
+				CSphMatch & tCopy = dBatch[dIndexes.GetLength()];
+				tCopy.m_tRowID = tMatch.m_tRowID;
+				tCopy.m_iWeight = tMatch.m_iWeight;
+				tCopy.m_iTag = tMatch.m_iTag;
+				tCopy.m_pStatic = tMatch.m_pStatic;
+				memcpy ( tCopy.m_pDynamic, tMatch.m_pDynamic, iDynamic*sizeof(CSphRowitem) );
+				fnMatch ( tCopy );
+
+				dIndexes.Add ( dIndexes.GetLength() );
+				if ( dIndexes.GetLength()==REWRITE_BATCH )
+					fnFlush();
+			});
+
+		fnFlush();
+		Adopt ( tRewritten );
+	}
+
+private:
+	static const int WRITE_BUFFER = 65536;
+	static const int REWRITE_BATCH = 1024;
+
+	struct Chunk_t
+	{
+		CSphAutofile	m_tFile;
+		CSphWriter		m_tWriter;
+		SphOffset_t		m_iSharedPos = 0;
+		int64_t			m_iMatches = 0;
+	};
+
+	std::unique_ptr<Chunk_t>				m_dOwn[PARTITIONS];		///< chunks we're writing to
+	CSphVector<std::unique_ptr<Chunk_t>>	m_dSealed[PARTITIONS];	///< finished chunks, ours and adopted ones
+	CSphString								m_sError;
+
+	bool Open ( CSphString & sError )
+	{
+		static std::atomic<int> iSpill { 0 };
+		for ( auto & pChunk : m_dOwn )
+		{
+			auto pNew = std::make_unique<Chunk_t>();
+			CSphString sName;
+			sName.SetSprintf ( "%s/groupby.%d.%d.spill", g_sExactGroupbyTmpDir.cstr(), (int)getpid(), iSpill.fetch_add ( 1, std::memory_order_relaxed ) );
+			if ( pNew->m_tFile.Open ( sName, SPH_O_NEW, sError, true )<0 )
+			{
+				for ( auto & pOpened : m_dOwn )
+					pOpened.reset();
+
+				return false;
+			}
+
+			pNew->m_tWriter.SetBufferSize ( WRITE_BUFFER );
+			pNew->m_tWriter.SetFile ( pNew->m_tFile, &pNew->m_iSharedPos, m_sError );
+			pChunk = std::move(pNew);
+		}
+
+		return true;
+	}
+};
+
 /// match sorter with k-buffering and group-by
 /// invoking by select ... group by ... where only plain attributes (i.e. NO mva, NO jsons)
 template < typename COMPGROUP, typename UNIQ, int DISTINCT, bool NOTIFICATIONS, bool HAS_AGGREGATES >
@@ -3075,10 +3288,22 @@ public:
 
 	void MoveTo ( ISphMatchSorter * pRhs, bool bCopyMeta ) final
 	{
-		if ( !Used () )
+		if ( !Used () && !m_pSpill )
 			return;
 
 		auto& dRhs = *(MYTYPE *) pRhs;
+		if ( m_pSpill )
+		{
+			// spilled partitions are handed over as is; rhs will merge them on finalize
+			if ( !dRhs.m_pSpill )
+				dRhs.m_pSpill = std::make_unique<GroupSpill_c>();
+
+			dRhs.m_pSpill->Adopt ( *m_pSpill );
+			m_pSpill.reset();
+			if ( !Used() )
+				return;
+		}
+
 		if ( dRhs.IsEmpty () )
 		{
 			CSphMatchQueueTraits::SwapMatchQueueTraits ( dRhs );
@@ -3102,7 +3327,15 @@ public:
 
 		// if we're copying meta (uniq counters), we don't need distinct calculation right now
 		// we can do it later after all sorters are merged
-		FinalizeMatches ( !bCopyMeta );
+		if ( IsExact() )
+		{
+			// exact mode hands over every group, so no cutting here
+			if ( DISTINCT && !bCopyMeta )
+				CountDistinct();
+
+			CalcAvg ( Avg_e::FINALIZE );
+		} else
+			FinalizeMatches ( !bCopyMeta );
 
 		// matches in dRhs are using a new (standalone) schema
 		// however, some supposedly unused matches still have old schema
@@ -3132,19 +3365,25 @@ public:
 
 	void Finalize ( MatchProcessor_i & tProcessor, bool, bool bFinalizeMatches ) override
 	{
-		if ( !Used() )
+		if ( !Used() && !m_pSpill )
 			return;
 
 		if ( bFinalizeMatches )
 			FinalizeMatches();
-		else if constexpr ( DISTINCT )
+		else
 		{
-			// if we are not finalizing matches, we are using global sorters
+			// if we are not finalizing matches, more matches may come, or we'll be merged with other sorters (that adopt our spill)
+			// so spilled groups stay on disk; they only pass through the processor
+			ProcessSpilled ( tProcessor );
+
 			// let's try to remove dupes while we are processing data in separate threads
 			// so that the main thread will have fewer data to work with
-			m_tUniq.Sort();
-			VecTraits_T<SphGroupKey_t> dStub;
-			m_tUniq.Compact(dStub);
+			if constexpr ( DISTINCT )
+			{
+				m_tUniq.Sort();
+				VecTraits_T<SphGroupKey_t> dStub;
+				m_tUniq.Compact(dStub);
+			}
 		}
 
 		// just evaluate in heap order
@@ -3244,8 +3483,8 @@ protected:
 		if constexpr ( DISTINCT )
 			KBufferGroupSorter::template UpdateDistinct<GROUPED> ( tEntry, uGroupKey );
 
-		// if we're full, let's cut off some worst groups
-		if ( Used()==m_iSize )
+		// if we're full, let's cut off some worst groups (unless we're exact and can grow or spill instead)
+		if ( Used()==m_iSize && !( IsExact() && MakeRoomExact() ) )
 			CutWorst ( m_iLimit * (int)(GROUPBY_FACTOR/2) );
 
 		// do add
@@ -3285,6 +3524,14 @@ private:
 	bool	m_bUpdateDistinct = true;
 	bool	m_bMerge = false;
 	CSphVector<SphGroupKey_t> m_dRemove;
+	std::unique_ptr<GroupSpill_c> m_pSpill;	///< exact mode: groups evicted to disk
+	bool	m_bSpillFailed = false;
+	bool	m_bMergingSpill = false;
+
+	bool IsExact() const
+	{
+		return !NOTIFICATIONS && this->m_bExact;
+	}
 
 	void CalcAvg ( Avg_e eGroup )
 	{
@@ -3317,6 +3564,7 @@ private:
 		if ( m_bMatchesFinalized )
 			return;
 
+		MergeSpilled();
 		m_bMatchesFinalized = true;
 
 		if ( Used() > m_iLimit )
@@ -3331,6 +3579,150 @@ private:
 		}
 	}
 
+	/// rough memory footprint of iGroups groups (match, dynamic part, index and hash entry)
+	int64_t EstimateGroupsBytes ( int iGroups ) const
+	{
+		int64_t iGroupBytes = sizeof(CSphMatch) + sizeof(int) + ( m_pSchema->GetDynamicSize()+1 )*sizeof(CSphRowitem) + 2*sizeof(SphGroupKey_t);
+		return iGroupBytes*iGroups;
+	}
+
+	/// exact mode: make room for one more group without dropping any; false means we have to cut after all
+	bool MakeRoomExact()
+	{
+		if ( m_bMergingSpill || EstimateGroupsBytes ( m_iSize*2 )<=g_iExactGroupbyMaxBytes )
+		{
+			Grow();
+			return true;
+		}
+
+		return SpillGroups();
+	}
+
+	/// double the buffer; match ids for the new slots go to the (unused) tail of m_dIData, same as in ctor
+	void Grow()
+	{
+		int iUsed = Used();
+		int iNewSize = m_iSize*2;
+
+		CSphFixedVector<CSphMatch> dData { iNewSize };
+		for ( int i=0; i<m_iSize; ++i )
+			Swap ( dData[i], m_dData[i] );
+		m_dData.SwapData ( dData );
+
+		this->m_dIData.Resize ( iNewSize );
+		for ( int i=m_iSize; i<iNewSize; ++i )
+			this->m_dIData[i] = i;
+		this->m_dIData.Resize ( iUsed );
+
+		m_iSize = iNewSize;
+		this->m_iMatchCapacity = iNewSize;
+
+		m_hGroup2Match.Clear();
+		RebuildHash();
+	}
+
+	/// spill needs groups to be self-contained: no distinct counters and no data ptrs in the dynamic part
+	bool CanSpill() const
+	{
+		if ( DISTINCT || m_bSpillFailed )
+			return false;
+
+		for ( int i=0; i<m_pSchema->GetAttrsCount(); ++i )
+		{
+			const CSphColumnInfo & tAttr = m_pSchema->GetAttr(i);
+			if ( tAttr.m_tLocator.m_bDynamic && sphIsDataPtrAttr ( tAttr.m_eAttrType ) )
+				return false;
+		}
+
+		return true;
+	}
+
+	/// exact mode: move all in-memory groups to disk
+	bool SpillGroups()
+	{
+		if ( !CanSpill() )
+			return false;
+
+		if ( !m_pSpill )
+			m_pSpill = std::make_unique<GroupSpill_c>();
+
+		// spilled groups are merged back as grouped matches, and those carry finalized averages
+		CalcAvg ( Avg_e::FINALIZE );
+
+		CSphString sError;
+		if ( !m_pSpill->Write ( m_dData, this->m_dIData, m_tLocGroupby, m_pSchema->GetDynamicSize(), sError ) )
+		{
+			sphWarning ( "exact group-by spill failed, grouping is approximate from now on: %s", sError.cstr() );
+			m_bSpillFailed = true;
+			CalcAvg ( Avg_e::UNGROUP );
+			return false;
+		}
+
+		m_iMaxUsed = Max ( m_iMaxUsed, Used() );
+		this->m_dIData.Resize ( 0 );
+		m_hGroup2Match.Clear();
+		return true;
+	}
+
+	/// exact mode: load spilled groups back one partition at a time
+	/// only the best m_iLimit groups survive each partition, so memory is bounded by the largest one
+	void MergeSpilled()
+	{
+		if ( !m_pSpill )
+			return;
+
+		// leftovers go to disk too, so that each partition is complete once loaded
+		// if that fails, merge everything in memory instead (hash takes care of the duplicates)
+		bool bCut = SpillGroups();
+
+		auto pSpill = std::move ( m_pSpill );
+		pSpill->Seal();
+
+		int iDynamic = m_pSchema->GetDynamicSize();
+		int64_t iGroups = Used();
+		bool bMerge = m_bMerge;
+		m_bMerge = true;
+		m_bMergingSpill = true;
+
+		for ( int iPartition=0; iPartition<GroupSpill_c::PARTITIONS; ++iPartition )
+		{
+			int64_t iTotal = m_iTotal;
+			pSpill->Read ( iPartition, iDynamic, [this] ( const CSphMatch & tMatch ) { PushEx<true> ( tMatch, tMatch.GetAttr ( m_tLocGroupby ), false, false, true, nullptr ); } );
+			iGroups += m_iTotal-iTotal;
+
+			if ( bCut && Used()>m_iLimit )
+				CutWorst ( m_iLimit );
+		}
+
+		m_bMergingSpill = false;
+		m_bMerge = bMerge;
+		m_iTotal = iGroups; // every group was counted once per spill; now we know the exact number
+	}
+
+	/// exact mode, not finalizing: run the processor over spilled groups without loading them all back
+	void ProcessSpilled ( MatchProcessor_i & tProcessor )
+	{
+		if ( !m_pSpill )
+			return;
+
+		int64_t iTotal = m_iTotal;
+		bool bMerge = m_bMerge;
+		m_bMerge = true;
+		m_bMergingSpill = true;
+
+		m_pSpill->Rewrite ( m_tLocGroupby, m_pSchema->GetDynamicSize(),
+			[&tProcessor] ( CSphMatch & tMatch ) { tProcessor.Process ( &tMatch ); },
+			[this] ( const CSphMatch & tMatch )
+			{
+				m_bSpillFailed = true;
+				PushEx<true> ( tMatch, tMatch.GetAttr ( m_tLocGroupby ), false, false, true, nullptr );
+			});
+
+		m_bMergingSpill = false;
+		m_bMerge = bMerge;
+		m_iTotal = iTotal; // groups kept in memory were counted when spilled
+	}
+
 	void RebuildHash ()
 	{
 		for ( auto iMatch : this->m_dIData ) {
@@ -7015,6 +7407,7 @@ ISphMatchSorter * QueueCreator_c::SpawnQueue()
 	if ( m_bGotGroupby )
 	{
 		m_tGroupSorterSettings.m_bGrouped = m_tSettings.m_bGrouped;
+		m_tGroupSorterSettings.m_bExact = m_tQuery.m_bExactGroupby;
 		m_tGroupSorterSettings.m_iMaxMatches = AdjustMaxMatches ( m_tGroupSorterSettings.m_iMaxMatches );
 		if ( m_pProfile )
 			m_pProfile->m_iMaxMatches = m_tGroupSorterSettings.m_iMaxMatches;
@@ -7264,6 +7657,49 @@ int ApplyImplicitCutoff ( const CSphQuery & tQuery, const VecTraits_T<ISphMatchS
 }
 
 
+/// dynamic pruning feeds the sorter's worst weight back to the ranker, so the sorter must rank by weight desc first
+ISphMatchSorter * GetPruningSorter ( const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *> & dSorters, int iIndexWeight )
+{
+	if ( !tQuery.m_bDynamicPruning || tQuery.m_eRanker!=SPH_RANK_BM25 || tQuery.m_iCutoff>0 || dSorters.GetLength()!=1 || iIndexWeight<=0 )
+		return nullptr;
+
+	ISphMatchSorter * pSorter = dSorters[0];
+	if ( pSorter->IsGroupby() || pSorter->IsRandom() )
+		return nullptr;
+
+	switch ( tQuery.m_eSort )
+	{
+	case SPH_SORT_RELEVANCE:
+		return pSorter;
+
+	case SPH_SORT_EXTENDED:
+		{
+			const CSphMatchComparatorState & tState = pSorter->GetState();
+			return ( tState.m_eKeypart[0]==SPH_KEYPART_WEIGHT && ( tState.m_uAttrDesc & 1 ) ) ? pSorter : nullptr;
+		}
+
+	default:
+		return nullptr;
+	}
+}
+
+
+
+void UpdatePruningThreshold ( ISphMatchSorter * pSorter, ISphExtra * pRanker, int iIndexWeight, int & iMinWeight )
+{
+	// once the sorter is full, matches below its worst weight are of no use; let the ranker skip them
+	if ( pSorter->GetLength()<pSorter->GetMatchCapacity() )
+		return;
+
+	const CSphMatch * pWorst = pSorter->GetWorst();
+	if ( pWorst && pWorst->m_iWeight/iIndexWeight>iMinWeight )
+	{
+		iMinWeight = pWorst->m_iWeight/iIndexWeight;
+		pRanker->ExtraData ( EXTRA_SET_WEIGHT_THRESHOLD, (void**)&iMinWeight );
+	}
+}
+
+
 ISphMatchSorter * sphCreateQueue ( const SphQueueSettings_t & tQueue, const CSphQuery & tQuery, CSphString & sError, SphQueueRes_t & tRes, StrVec_t * pExtra, QueryProfile_c * pProfile )
 {
 	QueueCreator_c tCreator ( tQueue, tQuery, sError, pExtra, pProfile );
@@ -20,6 +20,8 @@ namespace columnar
 	class Columnar_i;
 }
 
+class ISphExtra;
+
 
 class MatchProcessor_i
 {
@@ -196,6 +198,7 @@ int				GetAliasedAttrIndex ( const CSphString & sAttr, const CSphQuery & tQuery,
 
 void			SetAccurateAggregationDefault ( bool bEnabled );
 bool			GetAccurateAggregationDefault();
+void			SetExactGroupbySettings ( int64_t iMaxBytes, const CSphString & sTmpDir );
 
 void			SetDistinctThreshDefault ( int iThresh );
 int 			GetDistinctThreshDefault();
@@ -203,6 +206,12 @@ int 			GetDistinctThreshDefault();
 int				ApplyImplicitCutoff ( const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter*> & dSorters );
 bool			HasImplicitGrouping ( const CSphQuery & tQuery );
 
+/// sorter whose worst weight lets the ranker skip docs (OPTION dynamic_pruning); nullptr if the query can't be pruned
+ISphMatchSorter * GetPruningSorter ( const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter*> & dSorters, int iIndexWeight );
+
+/// passes the worst weight of a full pruning sorter to the ranker; iMinWeight is the last threshold passed
+void			UpdatePruningThreshold ( ISphMatchSorter * pSorter, ISphExtra * pRanker, int iIndexWeight, int & iMinWeight );
+
 /// creates proper queue for given query
 /// may return NULL on error; in this case, error message is placed in sError
 /// if the pUpdate is given, creates the updater's queue and perform the index update
@@ -918,6 +918,7 @@ static KeyDesc_t g_dKeysIndex[] =
 	{ "columnar_no_fast_fetch", 0, nullptr },
 	{ "rowwise_attrs",			0, nullptr },
 	{ "columnar_strings_no_hash", 0, nullptr },
+	{ "json_columns",			0, nullptr },
 	{ "columnar_compression_uint32", KEY_REMOVED, nullptr },
 	{ "columnar_compression_int64", KEY_REMOVED, nullptr },
 	{ "columnar_subblock",		KEY_REMOVED, nullptr },
@@ -999,6 +1000,12 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "sphinxql_state",			0, NULL },
 	{ "rt_merge_iops",			0, NULL },
 	{ "rt_merge_maxiosize",		0, NULL },
+	{ "rt_merge_bandwidth",		0, NULL },
+	{ "rt_flush_iops",			0, NULL },
+	{ "rt_flush_maxiosize",		0, NULL },
+	{ "rt_flush_bandwidth",		0, NULL },
+	{ "preread_bandwidth",		0, NULL },
+	{ "background_io_yield",	0, NULL },
 	{ "ha_ping_interval",		0, NULL },
 	{ "ha_period_karma",		0, NULL },
 	{ "predicted_time_costs",	0, NULL },
@@ -1019,6 +1026,7 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "qcache_ttl_sec",			0, NULL },
 	{ "qcache_max_bytes",		0, NULL },
 	{ "qcache_thresh_msec",		0, NULL },
+	{ "qcache_table_max_bytes",	0, NULL },
 	{ "sphinxql_timeout",		0, NULL },
 	{ "hostname_lookup",		0, NULL },
 	{ "grouping_in_utc",		0, NULL },
@@ -1046,6 +1054,11 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "optimize_cutoff",		0, nullptr },
 	{ "secondary_indexes",		0, nullptr },
 	{ "accurate_aggregation",	0, nullptr },
+	{ "exact_groupby_max_bytes",	0, nullptr },
+	{ "exact_groupby_tmpdir",	0, nullptr },
+	{ "cost_model_file",		0, nullptr },
+	{ "cost_model_calibrate",	0, nullptr },
+	{ "cost_model_feedback",	0, nullptr },
 	{ "distinct_precision_threshold", 0, nullptr },
 	{ "preopen_tables",			0, nullptr },
 	{ "buddy_path",				0, nullptr },
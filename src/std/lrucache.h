@@ -28,6 +28,13 @@ public:
 	bool	Add ( KEY tKey, const VALUE & tData );
 	void	Release ( KEY tKey );
 
+	/// same as Add(), but fnAdmit ( victim key ) may veto the evictions needed to make room for the new entry
+	/// nothing is evicted (and false is returned) if any of the victims is vetoed
+	template <typename ADMIT>
+	bool	Add ( KEY tKey, const VALUE & tData, ADMIT && fnAdmit );
+
+	int64_t	GetMemUsed();
+
 	template <typename COND>
 	void	Delete ( COND && fnCond );
 
@@ -55,6 +62,8 @@ private:
 	void	MoveToHead ( LinkedEntry_t * pEntry );
 	void	Add ( LinkedEntry_t * pEntry );
 	void	SweepUnused ( DWORD uSpaceNeeded );
+	template <typename ADMIT>
+	bool	CanSweep ( DWORD uSpaceNeeded, ADMIT && fnAdmit ) const;
 	bool	HaveSpaceFor ( DWORD uSpaceNeeded ) const;
 };
 
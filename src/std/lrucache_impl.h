@@ -48,6 +48,13 @@ bool LRUCache_T<KEY,VALUE,HELPER>::Find ( KEY tKey, VALUE & tData )
 
 template <typename KEY, typename VALUE, typename HELPER>
 bool LRUCache_T<KEY,VALUE,HELPER>::Add ( KEY tKey, const VALUE & tData )
+{
+	return Add ( tKey, tData, []( const KEY & ){ return true; } );
+}
+
+template <typename KEY, typename VALUE, typename HELPER>
+template <typename ADMIT>
+bool LRUCache_T<KEY,VALUE,HELPER>::Add ( KEY tKey, const VALUE & tData, ADMIT && fnAdmit )
 {
 	ScopedMutex_t tLock(m_tLock);
 
@@ -64,6 +71,9 @@ bool LRUCache_T<KEY,VALUE,HELPER>::Add ( KEY tKey, const VALUE & tData )
 		if ( uSpaceNeeded>MAX_BLOCK_SIZE )
 			return false;
 
+		if ( !CanSweep ( uSpaceNeeded, fnAdmit ) )
+			return false;
+
 		SweepUnused ( uSpaceNeeded );
 		if ( !HaveSpaceFor ( uSpaceNeeded ) )
 			return false;
@@ -92,6 +102,13 @@ void LRUCache_T<KEY,VALUE,HELPER>::Release ( KEY tKey )
 	assert ( pEntry->m_iRefcount>=0 );
 }
 
+template <typename KEY, typename VALUE, typename HELPER>
+int64_t LRUCache_T<KEY,VALUE,HELPER>::GetMemUsed()
+{
+	ScopedMutex_t tLock(m_tLock);
+	return m_iMemUsed;
+}
+
 template <typename KEY, typename VALUE, typename HELPER>
 template <typename COND>
 void LRUCache_T<KEY,VALUE,HELPER>::Delete ( COND && fnCond )
@@ -197,6 +214,29 @@ void LRUCache_T<KEY,VALUE,HELPER>::SweepUnused ( DWORD uSpaceNeeded )
 	}
 }
 
+template <typename KEY, typename VALUE, typename HELPER>
+template <typename ADMIT>
+bool LRUCache_T<KEY,VALUE,HELPER>::CanSweep ( DWORD uSpaceNeeded, ADMIT && fnAdmit ) const
+{
+	// dry run of SweepUnused; ask about every entry that would be evicted
+	int64_t iFreed = 0;
+	const LinkedEntry_t * pEntry = m_pTail;
+	while ( pEntry && m_iMemUsed-iFreed+uSpaceNeeded > m_iCacheSize )
+	{
+		if ( !pEntry->m_iRefcount )
+		{
+			if ( !fnAdmit ( pEntry->m_tKey ) )
+				return false;
+
+			iFreed += pEntry->m_uSize + sizeof(LinkedEntry_t);
+		}
+
+		pEntry = pEntry->m_pPrev;
+	}
+
+	return true;
+}
+
 template <typename KEY, typename VALUE, typename HELPER>
 bool LRUCache_T<KEY,VALUE,HELPER>::HaveSpaceFor ( DWORD uSpaceNeeded ) const
 {
@@ -22,4 +22,10 @@ void sphSort ( T* pData, int iCount, U&& COMP );
 template<typename T>
 void sphSort ( T* pData, int iCount );
 
+/// stable LSD radix sort over a fixed-width key of iKeyBytes bytes; fnByte ( tValue, iByte ) returns byte iByte
+/// of the key, least significant first. Bytes that are the same in all the keys are skipped.
+/// pTmp is scratch space for iCount values; returns either pData or pTmp, whichever holds the sorted values
+template<typename T, typename BYTEFN>
+T* sphRadixSort ( T* pData, T* pTmp, int iCount, int iKeyBytes, BYTEFN&& fnByte );
+
 #include "sort_impl.h"
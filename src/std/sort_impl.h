@@ -11,6 +11,8 @@
 //
 
 #include <utility>
+#include <memory>
+#include <cstring>
 
 #include "log2.h"
 #include "accessor.h"
@@ -175,4 +177,39 @@ template<typename T>
 void sphSort ( T* pData, int iCount )
 {
 	sphSort ( pData, iCount, SphLess_T<T>() );
-}
\ No newline at end of file
+}
+
+template<typename T, typename BYTEFN>
+T* sphRadixSort ( T* pData, T* pTmp, int iCount, int iKeyBytes, BYTEFN&& fnByte )
+{
+	if ( iCount < 2 )
+		return pData;
+
+	// histograms of all the key bytes in a single pass
+	std::unique_ptr<int[]> pCounts { new int[iKeyBytes * 256] };
+	memset ( pCounts.get(), 0, iKeyBytes * 256 * sizeof ( int ) );
+	for ( int i = 0; i < iCount; ++i )
+		for ( int iByte = 0; iByte < iKeyBytes; ++iByte )
+			++pCounts[iByte * 256 + fnByte ( pData[i], iByte )];
+
+	for ( int iByte = 0; iByte < iKeyBytes; ++iByte )
+	{
+		int* pOffsets = pCounts.get() + iByte * 256;
+		if ( pOffsets[fnByte ( *pData, iByte )] == iCount )
+			continue;
+
+		for ( int i = 0, iSum = 0; i < 256; ++i )
+		{
+			int iBucket = pOffsets[i];
+			pOffsets[i] = iSum;
+			iSum += iBucket;
+		}
+
+		for ( int i = 0; i < iCount; ++i )
+			pTmp[pOffsets[fnByte ( pData[i], iByte )]++] = pData[i];
+
+		std::swap ( pData, pTmp );
+	}
+
+	return pData;
+}
@@ -14,6 +14,10 @@
 
 #include "ints.h"
 
+/// max length of zipped (7 bits per byte) DWORD and uint64_t values
+constexpr int ZIPPED_INT_MAXLEN = 5;
+constexpr int ZIPPED_OFFSET_MAXLEN = 10;
+
 // big-endian (most significant septets first)
 template<typename T>
 int sphCalcZippedLen ( T tValue );
@@ -39,6 +43,10 @@ DWORD UnzipIntBE ( const BYTE*& pBuf );
 // big-endian (most significant septets first)
 SphOffset_t UnzipOffsetBE ( const BYTE*& pBuf );
 
+// big-endian (most significant septets first); reads at most ZIPPED_OFFSET_MAXLEN bytes.
+// returns false on longer (corrupted) values, with pBuf and uRes advanced past the bytes read
+bool UnzipOffsetBEBounded ( const BYTE*& pBuf, uint64_t& uRes );
+
 // little-endian (least significant septets first)
 template<typename T, typename WRITER>
 int ZipValueLE ( WRITER fnPut, T tValue );
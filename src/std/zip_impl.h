@@ -134,6 +134,19 @@ inline SphOffset_t UnzipOffsetBE ( const BYTE*& pBuf )
 	return UnzipValueBE<SphOffset_t> ( [&pBuf]() mutable { return *pBuf++; } );
 }
 
+inline bool UnzipOffsetBEBounded ( const BYTE*& pBuf, uint64_t& uRes )
+{
+	const BYTE* pMax = pBuf + ZIPPED_OFFSET_MAXLEN;
+	while ( pBuf<pMax )
+	{
+		BYTE b = *pBuf++;
+		uRes = ( uRes << 7 ) | ( b & 0x7f );
+		if ( !( b & 0x80 ) )
+			return true;
+	}
+	return false;
+}
+
 
 template<typename T, typename WRITER>
 inline int ZipValueLE ( WRITER fnPut, T tValue )